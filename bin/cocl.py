@@ -20,9 +20,10 @@ DEVICE_PARSE_OPT_LEVEL = os.environ.get('DEVICE_PARSE_OPT_LEVEL', '')
 if DEVICE_PARSE_OPT_LEVEL == '':
     DEVICE_PARSE_OPT_LEVEL = '2'
 
+# why loop-unroll is in here: see doc/advanced_options.md
 DEVICE_PARSE_PASSES = os.environ.get('DEVICE_PARSE_PASSES', '')
 if DEVICE_PARSE_PASSES == '':
-    DEVICE_PARSE_PASSES = 'inline,mem2reg,instcombine'
+    DEVICE_PARSE_PASSES = 'inline,mem2reg,instcombine,loop-rotate,loop-unroll,instcombine'
 
 HOSTSIDE_PARSE_OPT_LEVEL = os.environ.get('HOSTSIDE_PARSE_OPT_LEVEL', '')
 if HOSTSIDE_PARSE_OPT_LEVEL == '':
@@ -58,6 +59,9 @@ Usage: cocl [options] <targetfile>
   -c compile to .o only, dont link
   -o final output filepath
   --clang-home Path to llvm4.0
+  --default-stream [legacy|per-thread] What stream 0 means, default legacy
+  -use_fast_math Build the OpenCL with -cl-fast-relaxed-math -cl-mad-enable -cl-denorms-are-zero
+  --cl-build-options <options> Other options to build the OpenCL with
 
   Options passed through to clang compiler:
     -fPIC
@@ -91,6 +95,8 @@ CLANG_HOME = os.environ.get('CLANG_HOME', '')
 COCL_BIN = os.environ.get('COCL_BIN', '')
 INCLUDES = []
 INFILES = []
+HOSTSIDE_DEFINES = []
+CL_BUILD_OPTIONS = []
 
 args = sys.argv[1:]
 while len(args) > 0:
@@ -143,6 +149,21 @@ while len(args) > 0:
         elif THISARG == '--cocl-include':
             COCL_INCLUDE = args[1]
             args = args[1:]
+        elif THISARG == '--default-stream':
+            if args[1] == 'per-thread':
+                HOSTSIDE_DEFINES = ['-DCUDA_API_PER_THREAD_DEFAULT_STREAM']
+            elif args[1] in ['legacy', 'null']:
+                HOSTSIDE_DEFINES = []
+            else:
+                print('Unknown --default-stream %s, should be legacy or per-thread' % args[1])
+                sys.exit(-1)
+            args = args[1:]
+        elif THISARG in ['-use_fast_math', '--use_fast_math']:
+            CL_BUILD_OPTIONS += ['-cl-fast-relaxed-math', '-cl-mad-enable', '-cl-denorms-are-zero']
+            PASS_THRU += [' -D__USE_FAST_MATH__']
+        elif THISARG == '--cl-build-options':
+            CL_BUILD_OPTIONS += [args[1]]
+            args = args[1:]
         elif THISARG in ['-?', '-h', '-help']:
             display_help()
             sys.exit(0)
@@ -321,7 +342,10 @@ for infile in INFILES:
             '-S'
         ] + ADDFLAGS + [
             '-Wno-gnu-anonymous-struct',
-            '-Wno-nested-anon-types'
+            '-Wno-nested-anon-types',
+            # for cuda_fp16.h: __half is __fp16, so keep its arithmetic in half, and let functions take and return it
+            '-Xclang', '-fnative-half-type',
+            '-Xclang', '-fallow-half-arguments-and-returns'
         ] + LLVM_COMPILE_FLAGS_LIST + [
             # '-I%s' % join(COCL_INCLUDE, 'EasyCL'),
             # '-I%s' % join(COCL_INCLUDE, 'EasyCL', 'third_party', 'clew', 'include'),
@@ -358,11 +382,12 @@ for infile in INFILES:
             '-std=c++11', '-x', 'cuda', '-nocudainc', '--cuda-host-only', '-emit-llvm',
             '-O%s' % HOSTSIDE_PARSE_OPT_LEVEL,
             '-S'
-        ] + OPT_G + [
+        ] + OPT_G + HOSTSIDE_DEFINES + [
             '-D__CUDACC__',
             '-D__CORIANDERCC__',
             '-Wno-gnu-anonymous-struct',
-            '-Wno-nested-anon-types'
+            '-Wno-nested-anon-types',
+            '-Xclang', '-fallow-half-arguments-and-returns'
         ] + LLVM_COMPILE_FLAGS_LIST + [
             '-I%s' % COCL_INCLUDE,
             # '-I%s' % join(COCL_INCLUDE, 'EasyCL'),
@@ -378,12 +403,16 @@ for infile in INFILES:
     run(cmdline_list)
 
     # patch_hostside: -hostraw.ll => -hostpatched.ll
+    # the OpenCL is built at runtime, so the build options go into the embedded device IR, as metadata
+    PATCH_HOSTSIDE_OPTIONS = []
+    if len(CL_BUILD_OPTIONS) > 0:
+        PATCH_HOSTSIDE_OPTIONS = ['--clbuildoptions', ' '.join(CL_BUILD_OPTIONS)]
     run([
             join(COCL_BIN, 'patch_hostside'),
             '--hostrawfile', '%s-hostraw.ll' % OUTPUTBASEPATH,
             '--devicellfile', '%s-device.ll' % OUTPUTBASEPATH,
             '--hostpatchedfile', '%s-hostpatched.ll' % OUTPUTBASEPATH
-        ])
+        ] + PATCH_HOSTSIDE_OPTIONS)
 
     # -hostpatched.ll => .o
     run(
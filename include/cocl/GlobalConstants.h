@@ -1,4 +1,4 @@
-// Copyright Hugh Perkins 2016
+// Copyright Hugh Perkins 2016, 2017
 
 // Licensed under the Apache License, Version 2.0 (the "License");
 // you may not use this file except in compliance with the License.
@@ -12,12 +12,44 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Lays out the __constant__ variables of a module (address space 4) in a single buffer.  Each kernel
+// receives that buffer as a `constant char *constants` parameter, and we read the variables at fixed
+// offsets into it.  The host fills the buffer from the initializers, ie getImage(), then overwrites
+// each variable with its host-side copy, which is what cudaMemcpyToSymbol writes to.
+
 #pragma once
 
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
 namespace cocl {
 
 class GlobalConstants {
 public:
+    GlobalConstants(llvm::Module *M);
+    // whether var goes in the buffer: __constant__, with an initializer
+    static bool isInBuffer(const llvm::GlobalVariable *var);
+    bool empty() const { return variables.empty(); }
+    bool hasVariable(llvm::Value *value) const;
+    int getOffset(llvm::Value *value) const;
+    int getSize() const { return size; }
+
+    // initial contents of the buffer, from the initializers of the variables
+    std::string getImage() const;
+    std::map<std::string, int> getOffsetByName() const;
+
+protected:
+    void writeConstant(llvm::Constant *constant, char *dest) const;
+
+    llvm::Module *M;
+    std::vector<llvm::GlobalVariable *> variables;
+    std::map<llvm::Value *, int> offsetByVariable;
+    int size = 0;
 };
 
 } // namespace cocl
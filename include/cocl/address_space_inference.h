@@ -0,0 +1,65 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Works out which address space (private 0, global 1, local 3, constant 4) each pointer in a kernel, and in
+// the functions it calls, points into, before we start writing any OpenCL.  Where we can prove an address
+// space, the instruction dumper uses it, instead of guessing global, or falling back to vmem, for pointers
+// that have been through memory.
+
+#pragma once
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace cocl {
+
+class AddressSpaceInference {
+public:
+    // analyses kernel, and everything it calls, in M; updates the types of instructions whose address space
+    // we proved, so later passes see it
+    void run(llvm::Module *M, llvm::Function *kernel);
+
+    // returns the address space we proved for value, or -1 if we couldnt prove one
+    int getAddressSpace(llvm::Value *value) const;
+
+    // the instruction dumper clones functions to specialize them on argument address spaces; the clones
+    // get our results too
+    void copyToClone(llvm::ValueToValueMapTy &valueMap);
+
+protected:
+    int getValueSpace(llvm::Value *value);
+    int evaluate(llvm::Instruction *instr);
+    void findTrackedAllocas(llvm::Function *F);
+    bool sweep();
+
+    llvm::Function *kernel = 0;
+    std::vector<llvm::Function *> functions; // kernel, and everything it might call
+    std::map<llvm::Function *, std::vector<llvm::CallInst *> > callsByFunction;
+    std::map<llvm::Value *, llvm::AllocaInst *> allocaByPointer; // for pointers into allocas that dont escape
+    std::map<llvm::AllocaInst *, std::vector<llvm::StoreInst *> > storesByAlloca;
+    std::set<llvm::AllocaInst *> allocasWithOpaqueContents; // we cant, or wont, track what these contain
+    std::map<llvm::AllocaInst *, int> contentSpaceByAlloca; // address space of pointers stored in the alloca
+    std::set<llvm::Argument *> conflictedArgs;
+    std::map<llvm::Value *, int> spaceByValue;
+
+    std::map<llvm::Value *, int> addressSpaceByValue;
+};
+
+} // namespace cocl
@@ -81,6 +81,26 @@ public:
         instructionDumper->addIRToCl(set);
         return this;
     }
+    BasicBlockDumper *setGlobalFenceBarriers(const std::set<llvm::Instruction *> *barriers) {
+        instructionDumper->setGlobalFenceBarriers(barriers);
+        return this;
+    }
+    BasicBlockDumper *setAddressSpaceInference(AddressSpaceInference *inference) {
+        instructionDumper->setAddressSpaceInference(inference);
+        return this;
+    }
+    BasicBlockDumper *setGlobalConstants(const GlobalConstants *constants) {
+        instructionDumper->setGlobalConstants(constants);
+        return this;
+    }
+    BasicBlockDumper *setGroupIdsFromGlobalVars(bool fromGlobalVars) {
+        instructionDumper->setGroupIdsFromGlobalVars(fromGlobalVars);
+        return this;
+    }
+    BasicBlockDumper *setFastMath(bool fast) {
+        instructionDumper->setFastMath(fast);
+        return this;
+    }
 
     // std::set<std::string> shimFunctionsNeeded; // for __shfldown_3 etc, that we provide as opencl directly
     cocl::Shims shims;
@@ -91,6 +111,7 @@ public:
 
     bool usesVmem = false;
     bool usesScratch = false;
+    int scratchBytesPerWorkItem = 0;
 
 protected:
     llvm::Module *M;
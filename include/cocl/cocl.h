@@ -22,6 +22,7 @@
 #include "cocl/cocl_funcs.h"
 #include "cocl/hostside_opencl_funcs_ext.h"
 #include "cocl/vector_types.h"
+#include "cocl/cocl_texture.h"
 
 // #include <iostream>
 
@@ -64,17 +65,4 @@ __device__ void free(void *ptr);
 
 #endif // __CUDA_ARCH__ deviceside
 
-typedef int64_t cudaTextureObject_t;
-typedef int64_t TextureWord;
-struct cudaChannelFormatDesc {
-};
-struct cudaTextureDesc {
-};
-struct cudaResourceDesc {
-};
-typedef int64_t cudaResourceTypeLinear;
-
-template<typename T> cudaChannelFormatDesc cudaCreateChannelDesc();
-template<typename T> TextureWord tex1Dfetch();
-
 #endif // _COCL_H
@@ -0,0 +1,33 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OpenCL 2.0 core entry points, eg clCreateCommandQueueWithProperties and clSVMAlloc.
+//
+// clew only loads the OpenCL 1.2 functions, and clGetExtensionFunctionAddressForPlatform only returns extension
+// functions, not core ones, so we look these up by name in the OpenCL library itself.  The ICD loader exports them
+// whatever the devices support, so we only return them for devices whose CL_DEVICE_VERSION is 2.0 or later.
+
+#pragma once
+
+#include "EasyCL/EasyCL.h"
+
+namespace cocl {
+
+// eg 2 for "OpenCL 2.1 ...", 0 if we cant tell
+int getDeviceOpenCLMajorVersion(cl_device_id device);
+
+// the OpenCL 2.0 function called name, or 0 if device is older than OpenCL 2.0, or the library doesnt have it
+void *getOpenCL20Function(cl_device_id device, const char *name);
+
+} // namespace cocl
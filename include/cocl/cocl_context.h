@@ -4,6 +4,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include <memory>
 #include <mutex>
 
@@ -33,12 +34,21 @@ namespace easycl {
 namespace cocl {
     class Memory;
     class CoclStream;
+    class CallbackExecutor;
 
     class KernelInfo {
     public:
         // CLKernel *kernel = 0;
         bool usesVmem = false;
         bool usesScratch = false;
+        int scratchBytesPerWorkItem = 0;  // for the kernel's local scratch parameter, when usesScratch
+        bool usesConstants = false;
+        bool usesSharedMemory = false;
+        std::set<int> writtenClmems;  // clmems the kernel might write to, other than through vmem
+        std::vector<bool> textureArgIsImage;  // whether the kernel reads each texture argument as an image, or a buffer
+        std::string constantsImage;  // see GlobalConstants
+        std::map<std::string, int> constantOffsetByName;
+        std::string buildOptions;  // eg -cl-fast-relaxed-math, or -cl-std for kernels using float atomics
     };
 
     class Context {
@@ -54,11 +64,23 @@ namespace cocl {
         long long nextAllocPos = 1;
         std::map< long long, cocl::Memory *>memoryByAllocPos;
         int numKernelCalls = 0;
+        // constants buffer for each device module, and the getConstantSymbolsVersion() we last wrote to it
+        std::map<const char *, cl_mem> constantsBufferByModule;
+        std::map<const char *, long long> constantsVersionByModule;
         const int gpuOrdinal;
         easycl::EasyCL *getCl() {
             return cl.get();
         }
+        void synchronize();
         std::mutex mu;
+
+        // all streams other than default_stream. guarded by streamsMutex
+        std::set<cocl::CoclStream *> streams;
+        std::mutex streamsMutex;
+
+        // created on first use, guarded by mu
+        cocl::CallbackExecutor *getCallbackExecutor();
+        std::unique_ptr<cocl::CallbackExecutor> callbackExecutor;
     };
 
     class ContextMutex {
@@ -73,9 +95,11 @@ namespace cocl {
         ThreadVars();
         ~ThreadVars();
         Context *getContext();
+        cocl::CoclStream *getPerThreadStream();
         cocl::Context *currentContext = 0;
         int currentGpuOrdinal = 0;
         bool offsets_32bit = false;
+        std::map<cocl::Context *, std::unique_ptr<cocl::CoclStream> > perThreadStreams;
     };
 
     ThreadVars *getThreadVars();
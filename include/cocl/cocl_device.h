@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <string>
 // #include "OpenCL/cl.h"
 
 #include "EasyCL/EasyCL.h"
@@ -36,6 +37,14 @@ namespace cocl {
         cl_platform_id platformId;
         cl_device_id deviceId;
         CoclDevice(int _gpuOrdinal, cl_platform_id _platform_id, cl_device_id _device_id);
+
+        // options for building kernels that use the float atomic shims on this device: OpenCL C 2.0 or
+        // later, if the device has cl_ext_float_atomics, so the shims can use it.  Other kernels build as 1.2
+        std::string floatAtomicsBuildOptions = "";
+
+        // the limit on a kernel's parameters, which bounds how many launches we can fuse, see launch_fusion.h
+        size_t maxParameterSize = 1024;
+        int addressBits = 64;
     };
     CoclDevice *getCoclDeviceByGpuOrdinal(int gpuOrdinal);
 } //namespace cocl
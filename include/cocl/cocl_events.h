@@ -3,16 +3,34 @@
 // #include "CL/cl.h"
 #include "EasyCL/EasyCL.h"
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
 namespace cocl {
     class CoclEvent {
         // since cuda creates events then records them, but opencl doesnt create events until
         // the time of 'record', and the cuda client already has a pointer to the event, before record is called,
         // so we will create our own object to interface between these two behaviors
         // we'll send a CoclEvent to the client, and tell them its a CUevent object. approximately
+        //
+        // CoclEvents come from a pool, see eventPool in cocl_events.cpp. Each one has its own lock, which
+        // is only held to swap/read the underlying cl_event, never while waiting on it
     public:
         CoclEvent();
         ~CoclEvent();
         // bool has_event();
+
+        // returns the current cl_event, retained, or 0 if never recorded. Caller releases it
+        cl_event retainClEvent();
+        // replaces the current cl_event with clevent, releasing the old one
+        void setClEvent(cl_event clevent);
+
+        // for the pool
+        uint32_t poolIndex = 0;
+        std::atomic<uint32_t> nextFree;
+    private:
+        std::mutex mu;
         cl_event event = 0;
     };
 }
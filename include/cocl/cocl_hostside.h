@@ -1 +1,9 @@
 #pragma once
+
+#include "cocl/cocl_streams.h"
+
+#ifdef CUDA_API_PER_THREAD_DEFAULT_STREAM
+// defined by cocl_py when compiling with --default-stream per-thread, so that stream 0 means the
+// calling thread's own default stream, rather than the legacy default stream
+static size_t __cocl_per_thread_default_stream = coclSetPerThreadDefaultStream(1);
+#endif
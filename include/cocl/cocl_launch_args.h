@@ -7,6 +7,13 @@
 #include <string>
 
 namespace cocl {
+    // passes sampler as the kernel's next argument.  EasyCL only has a setter for cl_mem handles; clSetKernelArg
+    // takes a cl_sampler the same way, by the address of the handle
+    inline easycl::CLKernel *inSampler(easycl::CLKernel *kernel, cl_sampler *sampler) {
+        static_assert(sizeof(cl_sampler) == sizeof(cl_mem), "cl_sampler and cl_mem should both be opaque handles");
+        return kernel->inout(reinterpret_cast<cl_mem *>(sampler));
+    }
+
     // These Arg classes store kernel parameter values, which we can use
     // at kernel creation time, and then pass into the kernel at that point
     // we dont create the kernel until the actual launch command (which is after
@@ -24,7 +31,8 @@ namespace cocl {
             AK_FloatArg,
             AK_NullPtrArg,
             AK_ClmemArg,
-            AK_StructArg
+            AK_StructArg,
+            AK_TextureArg
         };
         Arg(ArgKind kind=AK_Base) : Kind(kind) {}
         virtual ~Arg() {}
@@ -137,4 +145,18 @@ namespace cocl {
             return arg->getKind() == AK_StructArg;
         }
     };
+    class TextureArg : public Arg {
+    public:
+        TextureArg(cl_mem image, cl_sampler sampler) : Arg(AK_TextureArg), image(image), sampler(sampler) {}
+        void inject(easycl::CLKernel *kernel) {
+            kernel->inout(&image);
+            inSampler(kernel, &sampler);
+        }
+        virtual std::string str() { return "TextureArg"; }
+        cl_mem image;
+        cl_sampler sampler;
+        static bool classof(const Arg *arg) {
+            return arg->getKind() == AK_TextureArg;
+        }
+    };
 } // namespace cocl
@@ -5,26 +5,59 @@
 #include <cstdint>
 
 namespace cocl {
+    class Context;
+    class CoclStream;
+
     class Memory {
     protected:
         Memory(cl_mem clmem, size_t bytes);
+        Memory(cl_mem clmem, size_t bytes, char *hostPtr, bool svm);  // managed
 
      public:
         static Memory *newDeviceAlloc(size_t bytes);
+        static Memory *newManagedAlloc(size_t bytes);
         ~Memory();
         size_t getOffset(const char *passedInAsCharStar);
         cl_mem clmem; // this is assumed to always be valid
         size_t bytes; // should always be valid (ideally > 0...)
         size_t fakePos; // the range (fakePos) to (fakePos + bytes) should not overlap with any other memory
         // otherwise, problems :-P
+
+        // managed memory: fakePos is hostPtr, so the host can dereference the pointer it got back
+        // from cudaMallocManaged.  The memory is either mapped (the host owns it) or unmapped (the
+        // device owns it); we hand it to the device when a command in some stream uses it, and back
+        // to the host at the next synchronization with that stream
+        bool managed = false;
+        bool svm = false;  // hostPtr came from clSVMAlloc, rather than from us
+        char *hostPtr = 0;
+        bool hostOwned = false;
+        CoclStream *deviceStream = 0;  // stream that last took ownership, if !hostOwned
+        void migrateToDevice(CoclStream *stream);  // no-op unless managed and hostOwned
+        void migrateToHost(CoclStream *stream, bool blocking=true);  // no-op unless managed and !hostOwned
     };
 
     Memory *findMemory(const char *passedInPointer);
+
+    // changes whenever cudaMemcpyToSymbol writes a __constant__ variable
+    long long getConstantSymbolsVersion();
     Memory *findMemoryByClmem(cl_mem clmem);
+
+    // hands back to the host any managed memory that the device took over in stream, or in any
+    // stream if stream is 0.  Call after the stream(s) have finished
+    void migrateManagedMemoryToHost(Context *context, CoclStream *stream);
 }
 
 #define CU_MEMHOSTALLOC_PORTABLE 123
 
+#define cudaMemAttachGlobal 0x01
+#define cudaMemAttachHost 0x02
+#define cudaMemAttachSingle 0x04
+#define CU_MEM_ATTACH_GLOBAL cudaMemAttachGlobal
+#define CU_MEM_ATTACH_HOST cudaMemAttachHost
+#define CU_MEM_ATTACH_SINGLE cudaMemAttachSingle
+#define cudaCpuDeviceId ((int)-1)
+#define CU_DEVICE_CPU cudaCpuDeviceId
+
 enum MemoryTypeEnum {
     CU_MEMORYTYPE_DEVICE = 60000,
     CU_MEMORYTYPE_HOST
@@ -46,6 +79,11 @@ extern "C" {
     size_t cuMemAlloc(CUdeviceptr *pMemory, size_t bytes);
     size_t cuMemFree(CUdeviceptr memory);
 
+    size_t cudaMallocManaged(void **pMemory, size_t bytes, unsigned int flags=cudaMemAttachGlobal);
+    size_t cuMemAllocManaged(CUdeviceptr *pMemory, size_t bytes, unsigned int flags);
+    size_t cudaMemPrefetchAsync(const void *devPtr, size_t count, int dstDevice, char *queue=0);
+    size_t cuMemPrefetchAsync(CUdeviceptr devPtr, size_t count, int dstDevice, char *queue);
+
     size_t cuMemHostAlloc(void **pHostPointer, unsigned int bytes, int type=CU_MEMHOSTALLOC_PORTABLE);
     size_t cuMemFreeHost(void *hostPointer);
 
@@ -63,6 +101,19 @@ extern "C" {
     size_t cuMemcpyDtoHAsync(void *host_dst, CUdeviceptr gpu_src, size_t size, char*queue);
 
     size_t cuDeviceTotalMem(size_t *value, CUdeviceptr device);
+
+    size_t cudaMemcpyToSymbol(const void *symbol, const void *src, size_t count, size_t offset=0, cudaMemcpyKind kind=cudaMemcpyHostToDevice);
+    size_t cudaMemcpyFromSymbol(void *dst, const void *symbol, size_t count, size_t offset=0, cudaMemcpyKind kind=cudaMemcpyDeviceToHost);
+}
+
+template<typename T>
+size_t cudaMemcpyToSymbol(const T &symbol, const void *src, size_t count, size_t offset=0, cudaMemcpyKind kind=cudaMemcpyHostToDevice) {
+    return cudaMemcpyToSymbol((const void *)&symbol, src, count, offset, kind);
+}
+
+template<typename T>
+size_t cudaMemcpyFromSymbol(void *dst, const T &symbol, size_t count, size_t offset=0, cudaMemcpyKind kind=cudaMemcpyDeviceToHost) {
+    return cudaMemcpyFromSymbol(dst, (const void *)&symbol, count, offset, kind);
 }
 
 size_t cudaMalloc(float **pMemory, size_t N);
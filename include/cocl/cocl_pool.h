@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+namespace cocl {
+    // Recycles objects of type T, so we dont new/delete one for each use. T needs members:
+    //     uint32_t poolIndex;
+    //     std::atomic<uint32_t> nextFree;
+    //
+    // The free list is a lock-free stack. Objects are addressed by index, and head packs the index of the
+    // top object into its low 32 bits, with a tag in the high 32 bits that we bump on each pop, so
+    // that a pop racing with a pop-and-push of the same object fails its compare-exchange, rather than
+    // corrupting the list.
+    //
+    // The pool only ever grows, a block at a time. Growing takes growMutex, but that only happens
+    // when the free list is empty. Objects are never deleted.
+    template<typename T>
+    class CoclPool {
+    public:
+        CoclPool(const char *name) : name(name) {
+            head = EMPTY;
+            for(int i = 0; i < MAX_BLOCKS; i++) {
+                blocks[i] = 0;
+            }
+        }
+        T *get() {
+            uint64_t oldHead = head.load();
+            while(true) {
+                uint32_t index = (uint32_t)oldHead;
+                if(index == EMPTY_INDEX) {
+                    grow();
+                    oldHead = head.load();
+                    continue;
+                }
+                T *object = byIndex(index);
+                uint64_t newHead = (((oldHead >> 32) + 1) << 32) | object->nextFree.load(std::memory_order_relaxed);
+                if(head.compare_exchange_weak(oldHead, newHead)) {
+                    return object;
+                }
+            }
+        }
+        void put(T *object) {
+            push(object, object);
+        }
+    private:
+        static const uint32_t BLOCK_SIZE = 256;
+        static const int MAX_BLOCKS = 4096;
+        static const uint32_t EMPTY_INDEX = 0xffffffff;
+        static const uint64_t EMPTY = EMPTY_INDEX;
+
+        T *byIndex(uint32_t index) {
+            return &blocks[index / BLOCK_SIZE].load()[index % BLOCK_SIZE];
+        }
+        // pushes the chain first..last, which must already be linked via nextFree
+        void push(T *first, T *last) {
+            uint64_t oldHead = head.load();
+            uint64_t newHead;
+            do {
+                last->nextFree.store((uint32_t)oldHead, std::memory_order_relaxed);
+                newHead = (oldHead & 0xffffffff00000000ull) | first->poolIndex;
+            } while(!head.compare_exchange_weak(oldHead, newHead));
+        }
+        void grow() {
+            std::lock_guard< std::mutex > guard(growMutex);
+            if((uint32_t)head.load() != EMPTY_INDEX) {
+                return;  // someone else grew it, or returned an object, whilst we waited
+            }
+            if(numBlocks >= MAX_BLOCKS) {
+                std::cout << "Error: too many " << name << " in use, more than " << (MAX_BLOCKS * BLOCK_SIZE) << std::endl;
+                throw std::runtime_error(std::string("Error: too many ") + name + " in use");
+            }
+            T *block = new T[BLOCK_SIZE];
+            uint32_t firstIndex = numBlocks * BLOCK_SIZE;
+            for(uint32_t i = 0; i < BLOCK_SIZE; i++) {
+                block[i].poolIndex = firstIndex + i;
+                if(i + 1 < BLOCK_SIZE) {
+                    block[i].nextFree.store(firstIndex + i + 1, std::memory_order_relaxed);
+                }
+            }
+            blocks[numBlocks].store(block);
+            numBlocks++;
+            push(&block[0], &block[BLOCK_SIZE - 1]);
+        }
+
+        const char *name;
+        std::atomic<uint64_t> head;
+        std::atomic<T *> blocks[MAX_BLOCKS];
+        int numBlocks = 0;  // guarded by growMutex
+        std::mutex growMutex;
+    };
+}
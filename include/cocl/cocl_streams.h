@@ -2,6 +2,13 @@
 
 #include "cocl/cocl_events.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace easycl {
     class EasyCL;
     class CLQueue;
@@ -16,11 +23,26 @@ extern "C" {
     size_t cuStreamSynchronize(char *queue);
 
     size_t cudaStreamCreate(char **pqueue);
+    size_t cudaStreamCreateWithFlags(char **pqueue, unsigned int flags);
+    size_t cudaStreamCreateWithPriority(char **pqueue, unsigned int flags, int priority);
+    size_t cuStreamCreateWithPriority(char **pqueue, unsigned int flags, int priority);
+    size_t cudaStreamGetFlags(char *stream, unsigned int *flags);
+    size_t cudaStreamGetPriority(char *stream, int *priority);
+    size_t cuStreamGetFlags(char *stream, unsigned int *flags);
+    size_t cuStreamGetPriority(char *stream, int *priority);
+    size_t cudaDeviceGetStreamPriorityRange(int *leastPriority, int *greatestPriority);
+    size_t cuCtxGetStreamPriorityRange(int *leastPriority, int *greatestPriority);
     size_t cudaStreamQuery(char *stream);
     size_t cudaStreamDestroy(char *queue);
 
     typedef void (*cudacallbacktype)(char *stream, size_t status, void*userdata);
     size_t cudaStreamAddCallback(char *stream, cudacallbacktype callback, void *userdata, int flags);
+    typedef void (*cudaHostFn_t)(void *userdata);
+    size_t cudaLaunchHostFunc(char *stream, cudaHostFn_t fn, void *userdata);
+    size_t cuLaunchHostFunc(char *stream, cudaHostFn_t fn, void *userdata);
+
+    // called by code compiled with --default-stream per-thread, see cocl_hostside.h
+    size_t coclSetPerThreadDefaultStream(int enabled);
 }
 #define cuStreamDestroy cuStreamDestroy_v2
 #define cuEventDestroy cuEventDestroy_v2
@@ -28,27 +50,130 @@ extern "C" {
 typedef char * cudaStream_t;
 typedef char *CUstream;
 typedef void (*cudacallbacktype)(char *stream, size_t status, void*userdata);
+typedef cudaHostFn_t CUhostFn;
 
 #define cudaStreamDefault 0
+#define cudaStreamNonBlocking 1
+#define CU_STREAM_DEFAULT 0
+#define CU_STREAM_NON_BLOCKING 1
+
+#define cudaStreamLegacy ((cudaStream_t)0x1)
+#define cudaStreamPerThread ((cudaStream_t)0x2)
+#define CU_STREAM_LEGACY ((CUstream)0x1)
+#define CU_STREAM_PER_THREAD ((CUstream)0x2)
 
 namespace cocl {
+    class Context;
+
+    class CallbackExecutor;
+
+    // one per cudaStreamAddCallback/cudaLaunchHostFunc call. These come from a pool, see callbackInfoPool
     class CoclCallbackInfo {
     public:
-        cudacallbacktype callback;
-        void *userdata;
+        CoclCallbackInfo() : nextFree(0) {}
+        cudacallbacktype callback = 0;
+        cudaHostFn_t hostFunc = 0;
+        void *userdata = 0;
         char *_queue;
+        cl_int status = 0;
+        cl_event hostDone = 0;  // user event, completed once the callback has run. holds back later work in the stream
+        CallbackExecutor *executor = 0;
+        CoclCallbackInfo *next = 0;  // for the CallbackExecutor queue
+
+        // for the pool
+        uint32_t poolIndex = 0;
+        std::atomic<uint32_t> nextFree;
     };
     void coclCallback(cl_event event, cl_int status, void *userdata);
 
+    // Runs host callbacks for one context, on its own thread, rather than on the opencl driver's
+    // callback thread, where calling back into Coriander, or just taking a long time, can stall or
+    // deadlock the driver.
+    //
+    // coclCallback, on the driver thread, pushes onto a lock-free stack. The executor thread takes
+    // the whole stack in one go, and runs it oldest first.
+    class CallbackExecutor {
+    public:
+        CallbackExecutor(cocl::Context *context);
+        ~CallbackExecutor();
+        void enqueue(CoclCallbackInfo *info);
+    private:
+        void run();
+        void execute(CoclCallbackInfo *info);
+
+        cocl::Context *context;
+        std::atomic<CoclCallbackInfo *> pending;
+        std::atomic<bool> stopping;
+        // only used for sleeping/waking the executor thread, not for the queue itself
+        std::mutex wakeMutex;
+        std::condition_variable wakeCondition;
+        std::thread thread;
+    };
+
     // a coclstream:
     // - is associated with one virtual cuda stream, from the point of view of the client
     // - is associated with exactly one opencl queue
     // - has a lock associated with it, so if there are more than one thread using it, they're method calls
     //   will run sequentially, not in parallel
+    //
+    // With COCL_OUT_OF_ORDER_QUEUES=1, the opencl queue is created out-of-order, and we keep the cuda
+    // in-stream ordering ourselves, by having each command wait on the event of the previous one.
+    // Callers that enqueue commands pass waitListSize()/waitList() as the wait list, and eventOut()
+    // as the event, then call commandEnqueued().  For in-order queues these are all no-ops.
+    //
+    // Streams created by the client, and per-thread default streams, are registered with their
+    // context, so that the legacy default stream can synchronize with them, see syncWithLegacyStream
     class CoclStream {
     public:
-        CoclStream(easycl::EasyCL *cl);
+        CoclStream(easycl::EasyCL *cl, unsigned int flags = cudaStreamDefault, int priority = 0);
         ~CoclStream();
         easycl::CLQueue *clqueue;
+        unsigned int flags = cudaStreamDefault;
+        int priority = 0;
+        bool outOfOrder = false;
+
+        cl_uint waitListSize();
+        const cl_event *waitList();
+        cl_event *eventOut();
+        void commandEnqueued();
+
+        // for commands where we cant pass in a wait list/event, eg kernel->run(...)
+        void beginUntrackedCommand();
+        void endUntrackedCommand();
+
+        // returns a new event, that completes once everything queued so far has completed.  Caller releases it
+        cl_event enqueueMarker();
+        // as enqueueMarker, but reuses the event of the last command, where we are tracking it
+        cl_event retainLastCommandEvent();
+        // holds back the next command in this stream until hostEvent has completed, eg for host callbacks
+        void waitForHostEvent(cl_event hostEvent);
+        // holds back anything queued after this, until events have completed
+        void waitForEvents(const std::vector<cl_event> &events);
+        // waits until everything queued so far has completed, including any host callback at the end of the
+        // stream, which only runs after the command before it, and which nothing might be waiting on yet
+        void finish();
+
+        cocl::Context *context = 0;  // only set for registered streams
+        // used by syncWithLegacyStream, to avoid re-synchronizing streams that have had no work since last time
+        long long numCommands = 0;
+        long long commandsSeenByLegacy = 0;
+        long long legacyCommandsSeen = 0;
+    private:
+        cl_event lastEvent = 0;
+        cl_event pendingEvent = 0;
+        cl_event hostEvent = 0;
+        cl_event waitListStorage[2];
     };
+
+    bool deviceSupportsPriorityHints(easycl::EasyCL *cl);
+
+    // maps the stream handle that the client passed in onto a CoclStream, handling 0, cudaStreamLegacy
+    // and cudaStreamPerThread
+    CoclStream *resolveStream(char *stream);
+
+    // call before enqueuing any command onto stream. Implements the cuda legacy default stream semantics:
+    // - commands on the legacy default stream wait for all blocking streams in the context
+    // - commands on blocking streams wait for the legacy default stream
+    // Streams created with cudaStreamNonBlocking are left alone.
+    void syncWithLegacyStream(CoclStream *stream);
 }
@@ -0,0 +1,182 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Texture objects.
+//
+// A cudaTextureObject_t is a pointer to an opaque CoclTexture, rather than an integer as in CUDA, so that
+// patch_hostside and the kernel dumper can recognise texture kernel parameters by their type:
+// - linear memory textures are passed to the kernel like any other gpu buffer, and tex1Dfetch is just a
+//   global load
+// - pitch2D textures are copied into an OpenCL image at each launch, and passed to the kernel as an
+//   image2d_t plus a sampler_t, so that tex2D can use read_imagef, with its filtering and addressing
+//
+// Only linear and pitch2D resources are supported (there are no cudaArrays in coriander)
+
+#pragma once
+
+#include "cocl/cocl_attributes.h"
+#include "cocl/vector_types.h"
+
+#include <cstddef>
+
+struct CoclTexture;
+typedef CoclTexture *cudaTextureObject_t;
+
+enum cudaResourceType {
+    cudaResourceTypeArray = 0,
+    cudaResourceTypeMipmappedArray,
+    cudaResourceTypeLinear,
+    cudaResourceTypePitch2D
+};
+
+enum cudaChannelFormatKind {
+    cudaChannelFormatKindSigned = 0,
+    cudaChannelFormatKindUnsigned,
+    cudaChannelFormatKindFloat,
+    cudaChannelFormatKindNone
+};
+
+enum cudaTextureAddressMode {
+    cudaAddressModeWrap = 0,
+    cudaAddressModeClamp,
+    cudaAddressModeMirror,
+    cudaAddressModeBorder
+};
+
+enum cudaTextureFilterMode {
+    cudaFilterModePoint = 0,
+    cudaFilterModeLinear
+};
+
+enum cudaTextureReadMode {
+    cudaReadModeElementType = 0,
+    cudaReadModeNormalizedFloat
+};
+
+struct cudaChannelFormatDesc {
+    int x;
+    int y;
+    int z;
+    int w;
+    cudaChannelFormatKind f;
+};
+
+struct cudaResourceDesc {
+    cudaResourceType resType;
+    union {
+        struct {
+            void *array;  // not supported
+        } array;
+        struct {
+            void *devPtr;
+            cudaChannelFormatDesc desc;
+            size_t sizeInBytes;
+        } linear;
+        struct {
+            void *devPtr;
+            cudaChannelFormatDesc desc;
+            size_t width;
+            size_t height;
+            size_t pitchInBytes;
+        } pitch2D;
+    } res;
+};
+
+struct cudaTextureDesc {
+    cudaTextureAddressMode addressMode[3];
+    cudaTextureFilterMode filterMode;
+    cudaTextureReadMode readMode;
+    int sRGB;
+    float borderColor[4];  // OpenCL only supports a zero border
+    int normalizedCoords;
+    unsigned int maxAnisotropy;
+    cudaTextureFilterMode mipmapFilterMode;
+    float mipmapLevelBias;
+    float minMipmapLevelClamp;
+    float maxMipmapLevelClamp;
+};
+
+struct cudaResourceViewDesc;
+
+extern "C" {
+    size_t cudaCreateTextureObject(cudaTextureObject_t *pTexObject, const cudaResourceDesc *pResDesc,
+        const cudaTextureDesc *pTexDesc, const cudaResourceViewDesc *pResViewDesc);
+    size_t cudaDestroyTextureObject(cudaTextureObject_t texObject);
+}
+
+inline cudaChannelFormatDesc cudaCreateChannelDesc(int x, int y, int z, int w, cudaChannelFormatKind f) {
+    cudaChannelFormatDesc desc;
+    desc.x = x;
+    desc.y = y;
+    desc.z = z;
+    desc.w = w;
+    desc.f = f;
+    return desc;
+}
+
+template<typename T> cudaChannelFormatDesc cudaCreateChannelDesc();
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<float>() {
+    return cudaCreateChannelDesc(32, 0, 0, 0, cudaChannelFormatKindFloat);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<float2>() {
+    return cudaCreateChannelDesc(32, 32, 0, 0, cudaChannelFormatKindFloat);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<float4>() {
+    return cudaCreateChannelDesc(32, 32, 32, 32, cudaChannelFormatKindFloat);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<int>() {
+    return cudaCreateChannelDesc(32, 0, 0, 0, cudaChannelFormatKindSigned);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<unsigned int>() {
+    return cudaCreateChannelDesc(32, 0, 0, 0, cudaChannelFormatKindUnsigned);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<unsigned char>() {
+    return cudaCreateChannelDesc(8, 0, 0, 0, cudaChannelFormatKindUnsigned);
+}
+template<> inline cudaChannelFormatDesc cudaCreateChannelDesc<uchar4>() {
+    return cudaCreateChannelDesc(8, 8, 8, 8, cudaChannelFormatKindUnsigned);
+}
+
+#ifdef __CUDACC__
+// the kernel dumper lowers these, see NewInstructionDumper::dumpCall.  They only work on textures that are
+// parameters of the kernel itself
+extern "C" {
+    __device__ const void *__cocl_texture_linear(cudaTextureObject_t tex);
+    __device__ float __cocl_tex2D_float(cudaTextureObject_t tex, float x, float y);
+    __device__ int __cocl_tex2D_int(cudaTextureObject_t tex, float x, float y);
+    __device__ unsigned int __cocl_tex2D_uint(cudaTextureObject_t tex, float x, float y);
+    // float4 goes through a pointer, so we dont depend on how the nvptx abi returns structs
+    __device__ void __cocl_tex2D_float4(float4 *out, cudaTextureObject_t tex, float x, float y);
+}
+
+template<typename T> __device__ inline T tex1Dfetch(cudaTextureObject_t tex, int x) {
+    return ((const T *)__cocl_texture_linear(tex))[x];
+}
+
+template<typename T> __device__ T tex2D(cudaTextureObject_t tex, float x, float y);
+template<> __device__ inline float tex2D<float>(cudaTextureObject_t tex, float x, float y) {
+    return __cocl_tex2D_float(tex, x, y);
+}
+template<> __device__ inline int tex2D<int>(cudaTextureObject_t tex, float x, float y) {
+    return __cocl_tex2D_int(tex, x, y);
+}
+template<> __device__ inline unsigned int tex2D<unsigned int>(cudaTextureObject_t tex, float x, float y) {
+    return __cocl_tex2D_uint(tex, x, y);
+}
+template<> __device__ inline float4 tex2D<float4>(cudaTextureObject_t tex, float x, float y) {
+    float4 value;
+    __cocl_tex2D_float4(&value, tex, x, y);
+    return value;
+}
+#endif // __CUDACC__
@@ -0,0 +1,183 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The thread_block and tiled_partition subset of cooperative groups.
+//
+// Everything here is written in terms of things the kernel dumper already handles: a thread block's sync is
+// __syncthreads, ie a barrier, and a tile is a slice of a warp, so its sync, shuffles and votes are __syncwarp,
+// the __shfl shims, with the tile size as the width, and __ballot.  reduce with plus, less or greater goes to
+// the __tile_reduce_* shims, which use sub-group reductions where the sub-groups are as wide as the tile.
+//
+// Tiles are static, and at most a warp wide, ie tiled_partition<1>, <2>, ... <32>.  Like the warp shuffles,
+// without sub-group support on the device, every work-item in the work-group must reach a tile's shuffles,
+// votes and reductions.  Grid groups, coalesced_threads, and the dim3 accessors, like group_index(), arent
+// supported.
+
+#pragma once
+
+#include "cocl/cocl_attributes.h"
+
+// lowered to shims by NewInstructionDumper.  width is the tile size
+__device__ int __cocl_tile_reduce_add(int v, int width);
+__device__ unsigned int __cocl_tile_reduce_add(unsigned int v, int width);
+__device__ float __cocl_tile_reduce_add(float v, int width);
+__device__ double __cocl_tile_reduce_add(double v, int width);
+__device__ int __cocl_tile_reduce_min(int v, int width);
+__device__ unsigned int __cocl_tile_reduce_min(unsigned int v, int width);
+__device__ float __cocl_tile_reduce_min(float v, int width);
+__device__ double __cocl_tile_reduce_min(double v, int width);
+__device__ int __cocl_tile_reduce_max(int v, int width);
+__device__ unsigned int __cocl_tile_reduce_max(unsigned int v, int width);
+__device__ float __cocl_tile_reduce_max(float v, int width);
+__device__ double __cocl_tile_reduce_max(double v, int width);
+
+namespace cooperative_groups {
+
+class thread_block {
+public:
+    __device__ void sync() const {
+        __syncthreads();
+    }
+    // the same linear order as cuda warps
+    __device__ unsigned int thread_rank() const {
+        return threadIdx.x + blockDim.x * (threadIdx.y + blockDim.y * threadIdx.z);
+    }
+    __device__ unsigned int size() const {
+        return blockDim.x * blockDim.y * blockDim.z;
+    }
+    __device__ unsigned int num_threads() const {
+        return size();
+    }
+};
+
+template<unsigned int Size>
+class thread_block_tile {
+    static_assert(Size > 0 && Size <= 32 && (Size & (Size - 1)) == 0,
+        "tiled_partition size must be a power of 2, no bigger than a warp");
+public:
+    __device__ void sync() const {
+        __syncwarp();
+    }
+    __device__ unsigned int thread_rank() const {
+        return warpLane() % Size;
+    }
+    __device__ unsigned int size() const {
+        return Size;
+    }
+    __device__ unsigned int num_threads() const {
+        return Size;
+    }
+    // which tile we are, in the thread block, and how many tiles there are
+    __device__ unsigned int meta_group_rank() const {
+        return thread_block().thread_rank() / Size;
+    }
+    __device__ unsigned int meta_group_size() const {
+        return (thread_block().size() + Size - 1) / Size;
+    }
+
+    template<typename T>
+    __device__ T shfl(T var, int srcRank) const {
+        return __shfl(var, srcRank, Size);
+    }
+    template<typename T>
+    __device__ T shfl_up(T var, unsigned int delta) const {
+        return __shfl_up(var, (int)delta, Size);
+    }
+    template<typename T>
+    __device__ T shfl_down(T var, unsigned int delta) const {
+        return __shfl_down(var, (int)delta, Size);
+    }
+    template<typename T>
+    __device__ T shfl_xor(T var, unsigned int laneMask) const {
+        return __shfl_xor(var, (int)laneMask, Size);
+    }
+
+    // bit i is thread_rank i in this tile
+    __device__ unsigned int ballot(int predicate) const {
+        unsigned int bits = __ballot(predicate) >> (warpLane() - warpLane() % Size);
+        return Size == 32 ? bits : bits & ((1u << Size) - 1);
+    }
+    __device__ int any(int predicate) const {
+        return ballot(predicate) != 0;
+    }
+    __device__ int all(int predicate) const {
+        return ballot(predicate) == (Size == 32 ? 0xffffffffu : (1u << Size) - 1);
+    }
+
+protected:
+    __device__ unsigned int warpLane() const {
+        return thread_block().thread_rank() % 32;
+    }
+};
+
+__device__ inline thread_block this_thread_block() {
+    return thread_block();
+}
+
+template<unsigned int Size>
+__device__ inline thread_block_tile<Size> tiled_partition(const thread_block &parent) {
+    return thread_block_tile<Size>();
+}
+
+__device__ inline void sync(const thread_block &group) {
+    group.sync();
+}
+
+template<unsigned int Size>
+__device__ inline void sync(const thread_block_tile<Size> &group) {
+    group.sync();
+}
+
+// reduction operators
+template<typename T>
+struct plus {
+    __device__ T operator()(const T a, const T b) const {
+        return a + b;
+    }
+};
+template<typename T>
+struct less {
+    __device__ T operator()(const T a, const T b) const {
+        return a < b ? a : b;
+    }
+};
+template<typename T>
+struct greater {
+    __device__ T operator()(const T a, const T b) const {
+        return a > b ? a : b;
+    }
+};
+
+// every thread in the tile gets the result.  Any other operator goes through shfl_xor
+template<unsigned int Size, typename T, typename Op>
+__device__ inline T reduce(const thread_block_tile<Size> &group, T val, Op op) {
+    for(unsigned int offset = Size / 2; offset > 0; offset /= 2) {
+        val = op(val, group.shfl_xor(val, offset));
+    }
+    return val;
+}
+template<unsigned int Size, typename T>
+__device__ inline T reduce(const thread_block_tile<Size> &group, T val, plus<T> op) {
+    return __cocl_tile_reduce_add(val, Size);
+}
+template<unsigned int Size, typename T>
+__device__ inline T reduce(const thread_block_tile<Size> &group, T val, less<T> op) {
+    return __cocl_tile_reduce_min(val, Size);
+}
+template<unsigned int Size, typename T>
+__device__ inline T reduce(const thread_block_tile<Size> &group, T val, greater<T> op) {
+    return __cocl_tile_reduce_max(val, Size);
+}
+
+} // namespace cooperative_groups
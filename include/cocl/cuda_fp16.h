@@ -0,0 +1,135 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// __half and __half2.
+//
+// Rather than structs, as in CUDA, these are clang's __fp16, and a vector of two of them, so that the device IR
+// uses llvm's half and <2 x half> types directly, and the kernel dumper can write them as OpenCL half and half2.
+// cocl passes -fnative-half-type when parsing the device side, so arithmetic on them stays in half, rather than
+// going via float.  On devices without cl_khr_fp16, the generated OpenCL does the arithmetic in float, and only
+// stores them as halfs; see TypeDumper::dumpHalfDefinitions
+
+#pragma once
+
+#include "cocl/cocl_attributes.h"
+#include "cocl/vector_types.h"
+
+typedef __fp16 __half;
+typedef __fp16 __half2 __attribute__((ext_vector_type(2)));
+
+typedef __half half;
+typedef __half2 half2;
+
+// conversions
+
+__devicehost__ inline __half __float2half(const float a) {
+    return (__half)a;
+}
+__devicehost__ inline __half __float2half_rn(const float a) {
+    return (__half)a;
+}
+__devicehost__ inline float __half2float(const __half a) {
+    return (float)a;
+}
+__devicehost__ inline __half2 __float2half2_rn(const float a) {
+    return (__half2){(__half)a, (__half)a};
+}
+__devicehost__ inline __half2 __floats2half2_rn(const float a, const float b) {
+    return (__half2){(__half)a, (__half)b};
+}
+__devicehost__ inline __half2 __halves2half2(const __half a, const __half b) {
+    return (__half2){a, b};
+}
+__devicehost__ inline __half2 __half2half2(const __half a) {
+    return (__half2){a, a};
+}
+__devicehost__ inline float2 __half22float2(const __half2 a) {
+    return float2((float)a.x, (float)a.y);
+}
+__devicehost__ inline float __low2float(const __half2 a) {
+    return (float)a.x;
+}
+__devicehost__ inline float __high2float(const __half2 a) {
+    return (float)a.y;
+}
+__devicehost__ inline __half __low2half(const __half2 a) {
+    return a.x;
+}
+__devicehost__ inline __half __high2half(const __half2 a) {
+    return a.y;
+}
+__device__ inline __half __int2half_rn(const int i) {
+    return (__half)i;
+}
+__device__ inline int __half2int_rz(const __half h) {
+    return (int)h;
+}
+
+// arithmetic
+
+__device__ inline __half __hadd(const __half a, const __half b) {
+    return a + b;
+}
+__device__ inline __half __hsub(const __half a, const __half b) {
+    return a - b;
+}
+__device__ inline __half __hmul(const __half a, const __half b) {
+    return a * b;
+}
+__device__ inline __half __hdiv(const __half a, const __half b) {
+    return a / b;
+}
+__device__ inline __half __hneg(const __half a) {
+    return -a;
+}
+// written as opencl fma
+__device__ __half __hfma(const __half a, const __half b, const __half c);
+
+__device__ inline __half2 __hadd2(const __half2 a, const __half2 b) {
+    return a + b;
+}
+__device__ inline __half2 __hsub2(const __half2 a, const __half2 b) {
+    return a - b;
+}
+__device__ inline __half2 __hmul2(const __half2 a, const __half2 b) {
+    return a * b;
+}
+__device__ inline __half2 __h2div(const __half2 a, const __half2 b) {
+    return a / b;
+}
+__device__ inline __half2 __hneg2(const __half2 a) {
+    return -a;
+}
+__device__ __half2 __hfma2(const __half2 a, const __half2 b, const __half2 c);
+
+// comparisons
+
+__device__ inline bool __heq(const __half a, const __half b) {
+    return a == b;
+}
+__device__ inline bool __hne(const __half a, const __half b) {
+    return a != b;
+}
+__device__ inline bool __hlt(const __half a, const __half b) {
+    return a < b;
+}
+__device__ inline bool __hle(const __half a, const __half b) {
+    return a <= b;
+}
+__device__ inline bool __hgt(const __half a, const __half b) {
+    return a > b;
+}
+__device__ inline bool __hge(const __half a, const __half b) {
+    return a >= b;
+}
@@ -133,6 +133,18 @@ __device__ float ceil(float in1);
 
 __device__ void sincosf(float angle, float *sinres, float *cosres);
 
+// fast intrinsics, written as OpenCL native_ functions
+__device__ float __fdividef(float in1, float in2);
+__device__ float __expf(float in1);
+__device__ float __exp10f(float in1);
+__device__ float __logf(float in1);
+__device__ float __log2f(float in1);
+__device__ float __log10f(float in1);
+__device__ float __powf(float in1, float in2);
+__device__ float __sinf(float in1);
+__device__ float __cosf(float in1);
+__device__ float __tanf(float in1);
+
 __device__ float pow(float in1, float in2);
 __device__ float sqrt(float in1);
 __device__ float log(float in1);
@@ -172,8 +184,18 @@ __device__ T atomicCAS(T* address, T compare, T val);
 template<typename T>
 __device__ T atomicAdd(T* address, T val);
 template<typename T>
+__device__ T atomicSub(T* address, T val);
+template<typename T>
 __device__ T atomicMax(T* address, T val);
 template<typename T>
+__device__ T atomicMin(T* address, T val);
+template<typename T>
+__device__ T atomicAnd(T* address, T val);
+template<typename T>
+__device__ T atomicOr(T* address, T val);
+template<typename T>
+__device__ T atomicXor(T* address, T val);
+template<typename T>
 __device__ T atomicExch(T* address, T val);
 __device__ unsigned long long atomicExch(unsigned long long *address, unsigned long long val);
 
@@ -183,19 +205,36 @@ __device__ bool __isGlobal(const void *ptr);
 __device__ void __threadfence_block();
 __device__ void syncthreads();
 __device__ void __threadfence();
+__device__ void __threadfence_system();
 __device__ int __all(int bits);
 __device__ int __any(int bits);
+__device__ unsigned int __ballot(int predicate);
+__device__ int __all_sync(unsigned int mask, int predicate);
+__device__ int __any_sync(unsigned int mask, int predicate);
+__device__ unsigned int __ballot_sync(unsigned int mask, int predicate);
+__device__ void __syncwarp(unsigned int mask=0xffffffff);
 
 // https://en.wikipedia.org/wiki/Find_first_set
 __device__ int __clz(int val);
 __device__ int __brev(int val);
 __device__ int __popc(int val);
 
+// int, unsigned int, float and double
+template<typename T>
+__device__ T __shfl(T val, int srcLane);
+template<typename T>
+__device__ T __shfl(T val, int srcLane, int warpSize);
+template<typename T>
+__device__ T __shfl_up(T val, int offset);
+template<typename T>
+__device__ T __shfl_up(T val, int offset, int warpSize);
 template<typename T>
 __device__ T __shfl_down(T val, int offset);
 template<typename T>
 __device__ T __shfl_down(T val, int offset, int warpSize);
 template<typename T>
+__device__ T __shfl_xor(T val, int offset);
+template<typename T>
 __device__ T __shfl_xor(T val, int offset, int warpSize);
 
 __device__ int __shfl_xor(int a, int b);
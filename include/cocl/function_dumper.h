@@ -22,6 +22,8 @@
 #include "cocl/LocalValueInfo.h"
 #include "cocl/new_instruction_dumper.h"
 #include "cocl/shims.h"
+#include "cocl/structured_control_flow.h"
+#include "cocl/variable_coalescing.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -30,6 +32,7 @@
 
 #include <string>
 #include <set>
+#include <vector>
 #include <map>
 #include <sstream>
 #include <iostream>
@@ -92,10 +95,14 @@ public:
     std::string dumpKernelFunctionDeclarationWithoutReturn(llvm::Function *F);
     std::string dumpInternalFunctionDeclarationWithoutReturn(llvm::Function *F);
     std::string dumpFunctionDeclarationWithoutReturn(llvm::Function *F);
+    // the kernel argument that each launch arg, ie each entry in LaunchConfiguration::args, is for
+    static std::map<int, llvm::Argument *> getKernelArgByLaunchArgIndex(llvm::Function *F);
     void generateBlockIndex();
+    void analyzeBarrierFences();
 
     void addPHIDeclaration(llvm::PHINode *phi);
     std::string dumpPhi(std::string indent, llvm::BranchInst *branchInstr, llvm::BasicBlock *nextBlock);
+    std::string dumpBranchCondition(llvm::BranchInst *instr);
     std::string dumpBranch(llvm::BranchInst *instr);
     std::string dumpReturn(llvm::Type **pReturnType, llvm::ReturnInst *retInst);
     std::string dumpTerminator(llvm::Type **pReturnType, llvm::Instruction *terminator);
@@ -103,11 +110,63 @@ public:
     std::string dumpSharedDefinitions(std::string indent);
     std::string getDeclaration();
     void writeDeclarations(std::string indent, std::ostream &os);
+    void findVariables(std::map<llvm::Value *, std::string> *typeByVariable, std::set<llvm::Value *> *inlined);
+    void renameCoalescedVariables(
+        VariableCoalescing *coalescing, const std::map<llvm::Value *, std::string> &typeByVariable,
+        std::vector<std::pair<llvm::BasicBlock *, std::string> > *gotoBlocks);
+    std::map<int, std::string> narrowVariableDeclarations(
+        const StructuredControlFlow &structured, VariableCoalescing *coalescing,
+        const std::map<llvm::Value *, std::string> &typeByVariable);
 
     FunctionDumper *addIRToCl() {
         _addIRToCl = true;
         return this;
     }
+    // write ifs and while loops, rather than a label per block and gotos; see structured_control_flow.h
+    FunctionDumper *setStructuredControlFlow(bool structured) {
+        structuredControlFlow = structured;
+        return this;
+    }
+    // let phis share a variable with their incoming values, and reuse variables whose values are dead; see
+    // variable_coalescing.h
+    FunctionDumper *setCoalesceVariables(bool coalesce) {
+        coalesceVariables = coalesce;
+        return this;
+    }
+    // with structured control flow, declare variables in the innermost while or if they are used in, rather
+    // than all at the top of the function
+    FunctionDumper *setNarrowDeclarations(bool narrow) {
+        narrowDeclarations = narrow;
+        return this;
+    }
+    FunctionDumper *setAddressSpaceInference(AddressSpaceInference *inference) {
+        addressSpaceInference = inference;
+        instructionDumper->setAddressSpaceInference(inference);
+        return this;
+    }
+    FunctionDumper *setGlobalConstants(const GlobalConstants *constants) {
+        globalConstants = constants;
+        instructionDumper->setGlobalConstants(constants);
+        return this;
+    }
+    // written between "kernel" and the return type, eg __attribute__((reqd_work_group_size(64, 1, 1)))
+    FunctionDumper *setKernelAttributes(std::string attributes) {
+        kernelAttributes = attributes;
+        return this;
+    }
+    // the kernel is written as a plain function, taking its group ids and counts as parameters, for a dispatcher
+    // kernel to call; see KernelDumper::setFusedLaunches.  Its callees read them from GlobalVars
+    FunctionDumper *setFusedLaunch(bool fused) {
+        fusedLaunch = fused;
+        instructionDumper->setGroupIdsFromGlobalVars(fused);
+        return this;
+    }
+    // the .cu was built with -use_fast_math
+    FunctionDumper *setFastMath(bool fast) {
+        fastMath = fast;
+        instructionDumper->setFastMath(fast);
+        return this;
+    }
 
     // std::set<std::string> shimFunctionsNeeded; // for __shfldown_3 etc, that we provide as opencl directly
     cocl::Shims shims;
@@ -117,6 +176,7 @@ public:
     std::map<llvm::Value *, std::unique_ptr<LocalValueInfo > > localValueInfos;
 
     std::map<std::string, std::string> phiDeclarationsByName;
+    std::set<llvm::Instruction *> globalFenceBarriers; // __syncthreads that need CLK_GLOBAL_MEM_FENCE as well as local
 
     std::string shimCode = "";
     std::string functionDeclaration;
@@ -125,6 +185,9 @@ public:
     llvm::Type *returnType = 0;
     bool usesVmem = false;
     bool usesScratch = false;
+    int scratchBytesPerWorkItem = 0;
+    std::set<int> writtenClmems;  // for a kernel, the clmems its pointer arguments might be written through
+    std::vector<bool> textureArgIsImage;  // for a kernel, whether each texture argument, in order, is an image
 
 protected:
     // llvm::Function::iterator block_it;
@@ -140,7 +203,17 @@ protected:
     int kernelNumUniqueClmems;
     std::vector<int> &kernelClmemIndexByArgIndex;
     bool _addIRToCl = false;
+    bool structuredControlFlow = false;
+    bool coalesceVariables = false;
+    bool narrowDeclarations = false;
+    std::map<llvm::BasicBlock *, StructuredBlock> structuredBlocks;
+    std::set<llvm::Value *> declaredElsewhere;  // merged into another variable, or declared in an inner scope
     std::map<llvm::BasicBlock *, int> functionBlockIndex;
+    AddressSpaceInference *addressSpaceInference = 0;
+    const GlobalConstants *globalConstants = 0; // 0, or empty, if the module has no __constant__ variables
+    std::string kernelAttributes = "";
+    bool fusedLaunch = false;
+    bool fastMath = false;
 
     GlobalNames *globalNames;
     LocalNames localNames;
@@ -17,6 +17,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
 
 namespace cocl {
 
@@ -33,7 +34,7 @@ protected:
     void populateKnownValues();
     // std::set<std::string> ignoredFunctionNames;
     std::set<std::string> ignoredGlobalVariables;
-    std::map<std::string, std::string> knownFunctionsMap; // from cuda to opencl, eg tid.x => get_global_id
+    std::unordered_map<std::string, std::string> knownFunctionsMap; // from cuda to opencl, eg tid.x => get_global_id
 };
 
 } // namespace cocl
@@ -19,6 +19,8 @@
 
 #include "cocl/cocl_launch_args.h"
 #include "cocl/hostside_opencl_funcs_ext.h"
+#include "cocl/cocl_texture.h"
+#include "cocl/kernel_specialization.h"
 
 namespace easycl {
     class CLKernel;
@@ -27,6 +29,26 @@ namespace easycl {
 
 namespace cocl {
     class CoclStream;
+}
+
+// the runtime side of a cudaTextureObject_t, see cocl_texture.cpp
+struct CoclTexture {
+    cudaResourceType resType;
+    char *devPtr;
+    size_t width;  // pitch2D only, from here on
+    size_t height;
+    size_t pitchInBytes;
+    size_t elementSize;
+    cl_mem image = 0;
+    cl_sampler sampler = 0;
+
+    // copies the pitch2D memory into image, in coclStream.  We do this at each launch, since the kernels
+    // might have written to the memory since the last one
+    void copyToImage(cocl::CoclStream *coclStream);
+};
+
+namespace cocl {
+    CoclTexture *findTexture(const char *texture_as_charstar);  // throws if it's not a live texture object
 
     struct GenerateOpenCLResult {
         std::string clSourcecode;
@@ -34,11 +56,24 @@ namespace cocl {
         std::string shortKernelName;
         std::string uniqueKernelName;
     };
-    GenerateOpenCLResult generateOpenCL(int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, std::string origKernelName, std::string devicellsourcecode);
-    easycl::CLKernel *compileOpenCLKernel(std::string originalKernelName, std::string uniqueKernelName, std::string shortKernelName, std::string clSourcecode);
+    GenerateOpenCLResult generateOpenCL(int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, std::string origKernelName, std::string devicellsourcecode,
+        const KernelSpecialization &specialization = KernelSpecialization());
+    easycl::CLKernel *compileOpenCLKernel(std::string originalKernelName, std::string uniqueKernelName, std::string shortKernelName, std::string clSourcecode,
+        std::string buildOptions = "");
     easycl::CLKernel *compileOpenCLKernel(std::string shortKernelName, std::string clSourcecode);
+    // runs any launches this thread has held back for fusion, see launch_fusion.h.  Anything that could see their
+    // results, or needs them ordered before something else on a stream, calls this first
+    void flushFusedLaunches();
 
 
+    // hostside copy of a __constant__ variable
+    class ConstantSymbol {
+    public:
+        std::string name;
+        const char *hostPtr;
+        int size;
+    };
+
     class LaunchConfiguration {
     public:
         size_t grid[3];
@@ -52,11 +87,15 @@ namespace cocl {
         std::vector<cl_mem> clmems;
         std::vector<int> clmemIndexByClmemArgIndex;
 
+        std::vector<ConstantSymbol> constantSymbols;
+        std::vector<bool> textureArgIsImage;  // what setKernelArgTexture passed, see KernelInfo
+
         std::vector<cl_mem> kernelArgsToBeReleased;
         std::string kernelName = "";
         std::string uniqueKernelName = "";
         std::string shortKernelName = "";
         std::string devicellsourcecode = "";
+        const char *deviceModule = 0;  // identifies the device module, ie its devicellsourcecode global
     };
 }
 
@@ -54,6 +54,8 @@ extern "C" {
     void setKernelArgInt32(int value);
     void setKernelArgInt8(char value);
     void setKernelArgFloat(float value);
+    void setKernelArgTexture(char *texture_as_charstar);
+    void addConstantSymbol(const char *name, char *hostPtr, int size);
     void kernelGo();
 }
 
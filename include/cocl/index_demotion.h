@@ -0,0 +1,89 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Demotes 64-bit integer arithmetic, mostly array index calculations, to 32-bit, where we can prove the result is
+// the same.
+//
+// Clang widens int indices to 64 bits, eg in[i + 1] becomes sext(i) + 1, and the instruction dumper writes that
+// as long arithmetic, which is several times slower than int on many GPUs.  We work out a signed range for each
+// integer value, from constants, threadIdx and blockIdx, and the comparisons on the branches leading to it, eg
+// if(i < N).  threadIdx is bounded by the block size when the kernel is built for one, see kernel_specialization.h,
+// and otherwise, like blockIdx, by CUDA's limits.  A 64-bit add, sub, mul or shl of sign-extended 32-bit values, or
+// small constants, whose result fits in 32 bits, becomes the 32-bit instruction, sign extended.  64-bit compares of
+// such values compare the 32-bit values.
+//
+// We dont use the launch's grid size, or the sizes of the buffers, since we would then need a kernel per grid, or
+// buffer, size.  Phis, eg loop counters, arent bounded.
+
+#pragma once
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace cocl {
+
+// the largest block, and grid, any launch of the kernel can have
+class LaunchBounds {
+public:
+    int64_t block[3] = {1024, 1024, 64};
+    int64_t grid[3] = {2147483647, 65535, 65535};
+};
+
+// signed, inclusive
+class IntRange {
+public:
+    IntRange() {}
+    IntRange(int64_t lo, int64_t hi) : lo(lo), hi(hi) {}
+    // every value of a signed int this many bits wide
+    static IntRange full(int bits);
+
+    bool fitsIn(int bits) const;
+    IntRange intersect(const IntRange &other) const;
+    IntRange unite(const IntRange &other) const;
+
+    int64_t lo = INT64_MIN;
+    int64_t hi = INT64_MAX;
+};
+
+class IndexDemotion {
+public:
+    IndexDemotion(const LaunchBounds &bounds = LaunchBounds()) : bounds(bounds) {}
+
+    // returns how many instructions we demoted
+    int run(llvm::Function *F);
+
+    // the range of value, wherever block runs.  run must have been called on block's function
+    IntRange getRange(llvm::Value *value, llvm::BasicBlock *block, int depth = 0);
+
+    // how far back we follow operands, and comparisons
+    static const int MaxDepth = 8;
+
+protected:
+    IntRange getDefinitionRange(llvm::Value *value, llvm::BasicBlock *block, int depth);
+    IntRange getSpecialRegisterRange(std::string functionName);
+    IntRange applyConditions(llvm::Value *value, llvm::BasicBlock *block, IntRange range, int depth);
+    IntRange getConditionRange(llvm::CmpInst::Predicate predicate, llvm::Value *other, llvm::BasicBlock *block, int depth);
+    llvm::Value *get32BitValue(llvm::Value *value, llvm::BasicBlock *block);
+    bool demote(llvm::Instruction *instr);
+
+    LaunchBounds bounds;
+    std::unique_ptr<llvm::DominatorTree> domTree;
+};
+
+} // namespace cocl
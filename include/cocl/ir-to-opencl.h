@@ -19,8 +19,16 @@
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Function.h"
 
+#include "cocl/kernel_specialization.h"
+
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
+
+// named metadata in the device IR, holding the options to pass to clBuildProgram, eg -cl-fast-relaxed-math when
+// cocl was given -use_fast_math.  patch_hostside adds it, before embedding the device IR in the host object
+#define COCL_BUILD_OPTIONS_METADATA "cocl.build_options"
 
 namespace cocl {
 
@@ -29,11 +37,25 @@ public:
     std::string clSourcecode = "";
     bool usesVmem = false;
     bool usesScratch = false;
+    int scratchBytesPerWorkItem = 0;
+    bool usesConstants = false;
+    bool usesSharedMemory = false;
+    bool usesFloatAtomics = false;
+    std::set<int> writtenClmems;  // clmems the kernel's pointer arguments might be written through
+    std::vector<bool> textureArgIsImage;
+    std::string constantsImage = "";  // initial contents of the constants buffer, see GlobalConstants
+    std::map<std::string, int> constantOffsetByName;
+    std::string buildOptions = "";  // from COCL_BUILD_OPTIONS_METADATA
 };
 
+// the options in COCL_BUILD_OPTIONS_METADATA, space separated, or ""
+std::string getBuildOptions(llvm::Module *M);
+
 ModuleClRes convertModuleToCl(
-    int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, llvm::Module *M, std::string specificFunction, std::string generatedName, bool offsets_32bit);
+    int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, llvm::Module *M, std::string specificFunction, std::string generatedName, bool offsets_32bit,
+    const KernelSpecialization &specialization = KernelSpecialization());
 ModuleClRes convertLlStringToCl(
-    int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, std::string llString, std::string specificFunction, std::string generatedName, bool offsets_32bit);
+    int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, std::string llString, std::string specificFunction, std::string generatedName, bool offsets_32bit,
+    const KernelSpecialization &specialization = KernelSpecialization());
 
 } // namespace cocl
@@ -20,11 +20,15 @@
 #include "cocl/GlobalNames.h"
 #include "cocl/type_dumper.h"
 #include "cocl/shims.h"
+#include "cocl/address_space_inference.h"
+#include "cocl/GlobalConstants.h"
+#include "cocl/kernel_specialization.h"
 
 #include "llvm/IR/Module.h"
 
 #include <string>
 #include <set>
+#include <vector>
 
 #include "cocl/cocl_export.h"
 
@@ -54,15 +58,64 @@ public:
         _addIRToCl = true;
         return this;
     }
+    // by default we write ifs and while loops; this goes back to a label per basic block, and gotos
+    KernelDumper *setStructuredControlFlow(bool structured) {
+        structuredControlFlow = structured;
+        return this;
+    }
+    // by default phis share a variable with their incoming values, and variables are reused once dead
+    KernelDumper *setCoalesceVariables(bool coalesce) {
+        coalesceVariables = coalesce;
+        return this;
+    }
+    // declare variables in the innermost while or if using them, instead of at the top of the function
+    KernelDumper *setNarrowDeclarations(bool narrow) {
+        narrowDeclarations = narrow;
+        return this;
+    }
+    // bake int arguments, and the block size, into the kernel; see kernel_specialization.h.  With fusedLaunches,
+    // we write a dispatcher kernel that runs several launches of this kernel; see launch_fusion.h
+    KernelDumper *setSpecialization(const KernelSpecialization &specialization) {
+        this->specialization = specialization;
+        return this;
+    }
+    // 32-bit, rather than 64-bit, index arithmetic where we can prove it gives the same result; see index_demotion.h
+    KernelDumper *setDemoteIndices(bool demote) {
+        demoteIndices = demote;
+        return this;
+    }
+    // native_ versions of the math functions, for .cu files built with -use_fast_math; see math_functions.h
+    KernelDumper *setFastMath(bool fast) {
+        fastMath = fast;
+        return this;
+    }
 
     bool usesVmem = false;
     bool usesScratch = false;
+    int scratchBytesPerWorkItem = 0;  // how much local scratch each work-item needs, when usesScratch
+    bool usesSharedMemory = false;
+    bool usesFloatAtomics = false;  // __atomic_add_float or __atomic_add_double, which can use cl_ext_float_atomics
+    std::set<int> writtenClmems;  // clmems the kernel's pointer arguments might be written through
+    std::vector<bool> textureArgIsImage;  // see FunctionDumper
+    std::unique_ptr<cocl::GlobalConstants> globalConstants; // created by toCl
 
 protected:
+    void applySpecialization(llvm::Function *F);
+    std::string writeFusedDispatcher(std::string launchDeclaration);
+
     bool _addIRToCl = false;
+    bool structuredControlFlow = true;
+    bool coalesceVariables = true;
+    bool narrowDeclarations = false;
+    bool fastMath = false;
+    bool demoteIndices = true;
+    KernelSpecialization specialization;
+    std::string kernelAttributes = "";
+    std::string kernelDeclaration = "";
     cocl::GlobalNames globalNames;
     std::unique_ptr<cocl::TypeDumper> typeDumper;
     cocl::Shims shims;
+    cocl::AddressSpaceInference addressSpaceInference;
 };
 
 } // namespace cocl
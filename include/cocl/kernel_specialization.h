@@ -0,0 +1,106 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Launch-time specialisation of kernels on their int arguments, and on the block size.
+//
+// Normally a kernel is generated once per clmem signature, and scalar arguments like N, or strides, are passed
+// in at each launch.  When specialising, we replace the int arguments by their values at this launch, and
+// blockDim by the launch's block size, in the IR, before writing the OpenCL, and add reqd_work_group_size to
+// the kernel.  The OpenCL compiler can then fold the index arithmetic, and fully unroll loops over them.  The
+// arguments are still declared, and passed in, so the kernel's signature doesnt change.
+//
+// Each set of values gives a different kernel, so this is opt-in, using COCL_SPECIALIZE, see doc/options.md
+//
+// Separately, and by default, kernels get reqd_work_group_size for the block size they are launched with, so the
+// driver can size registers and local memory for exactly that many work-items.  A kernel launched with
+// a different block size later is built again, with that size, unless it has already used several; see
+// COCL_WORK_GROUP_SIZE
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <set>
+
+namespace cocl {
+
+class KernelSpecialization {
+public:
+    // values of the Int32Args we specialise on, by their index in LaunchConfiguration::args
+    std::map<int, int> int32ValueByArgIndex;
+    bool specializeBlock = false;  // replace blockDim by block, and use reqd_work_group_size
+    // "", "reqd_work_group_size" or "work_group_size_hint", for block, when we dont specialise on it
+    std::string workGroupSizeAttribute = "";
+    int block[3] = {0, 0, 0};
+    // if not 0, the number of launches of this kernel that one dispatch runs, see launch_fusion.h
+    int fusedLaunches = 0;
+
+    bool empty() const {
+        return int32ValueByArgIndex.size() == 0 && !specializeBlock && workGroupSizeAttribute == "" &&
+            fusedLaunches == 0;
+    }
+    // appended to the unique kernel name, so that each specialisation is cached separately, eg "_s1x128_b64x1x1"
+    std::string getSuffix() const;
+    // eg "__attribute__((reqd_work_group_size(64, 1, 1)))", or "" if none
+    std::string getKernelAttributes() const;
+};
+
+// decides which launches to specialise.  mode is the value of COCL_SPECIALIZE:
+// - "" or "0": never
+// - "all": every launch
+// - "auto": once a kernel has been launched with the same int arguments and block size several times in a row
+// - otherwise, a comma-separated list of kernel names, whose launches are always specialised
+// workGroupSizeMode is the value of COCL_WORK_GROUP_SIZE, for the launches we dont specialise:
+// - "" or "0": no attribute
+// - "reqd": reqd_work_group_size
+// - "hint": work_group_size_hint
+class KernelSpecializer {
+public:
+    KernelSpecializer(std::string mode, std::string workGroupSizeMode = "");
+    // int32ValueByArgIndex: all the Int32Args of this launch
+    KernelSpecialization choose(std::string kernelName, const std::map<int, int> &int32ValueByArgIndex,
+        const size_t block[3]);
+
+    // launches with the same values, in a row, before auto specialises them
+    static const int AutoStableLaunches = 3;
+    // after this many specialisations of one kernel, we use the unspecialised kernel for any new values
+    static const int MaxSpecializationsPerKernel = 8;
+    // after this many block sizes for one kernel, we use the kernel without a work group size for any new ones
+    static const int MaxWorkGroupSizesPerKernel = 4;
+
+protected:
+    bool isListed(std::string kernelName);
+    KernelSpecialization chooseWorkGroupSize(std::string kernelName, const size_t block[3]);
+
+    enum Mode {
+        Never,
+        All,
+        Auto,
+        Listed
+    };
+    Mode mode = Never;
+    std::set<std::string> kernelNames;
+    std::string workGroupSizeAttribute = "";
+
+    class KernelHistory {
+    public:
+        std::string lastSuffix = "";
+        int stableLaunches = 0;
+        std::set<std::string> specializedSuffixes;
+        std::set<std::string> workGroupSizeSuffixes;
+    };
+    std::map<std::string, KernelHistory> historyByKernelName;
+};
+
+} // namespace cocl
@@ -0,0 +1,98 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Fusion of tiny launches of a kernel, back-to-back on one stream, into a single dispatch.
+//
+// Each launch costs a clEnqueueNDRangeKernel, and a clFinish, which, for a grid of one or two blocks, can take
+// much longer than the kernel itself.  With COCL_LAUNCH_FUSION, see doc/options.md, kernelGo holds back such
+// launches, and, when it has to run them, eg at the thread's next memcpy, synchronize, or launch of something
+// else, or at its exit, runs them all in one dispatch of a generated kernel, whose work-groups are the launches'
+// blocks, in order.  See KernelDumper::writeFusedDispatcher.
+//
+// Work-groups in a dispatch run in any order, and at the same time, so we only fuse launches that dont touch
+// a buffer another launch in the batch writes to.  We only know which buffers a kernel writes to through its
+// pointer arguments, so kernels using vmem, __shared__ or __constant__ memory, or pitch2D textures, are never
+// fused.
+
+#pragma once
+
+#include <string>
+#include <set>
+#include <cstddef>
+
+namespace cocl {
+
+// what we need to know about a launch, to decide whether it can join a batch
+class FusableLaunch {
+public:
+    std::string uniqueKernelName;  // the generated kernel, ie including its clmem signature and specialisation
+    const void *queue = 0;
+    size_t grid[3] = {1, 1, 1};
+    size_t block[3] = {1, 1, 1};
+    std::set<const void *> buffers;  // every cl_mem the launch is passed
+    std::set<const void *> writtenBuffers;  // the ones it might write to
+};
+
+// launches waiting to run as one dispatch
+class LaunchBatch {
+public:
+    // same kernel, queue and block size as the launches so far, and no buffer written by one, and touched by
+    // another
+    bool canAdd(const FusableLaunch &launch, int maxLaunches) const;
+    void add(const FusableLaunch &launch);
+    void clear();
+    int size() const {
+        return numLaunches;
+    }
+    size_t getNumBlocks() const {
+        return numBlocks;
+    }
+
+protected:
+    int numLaunches = 0;
+    size_t numBlocks = 0;
+    std::string uniqueKernelName = "";
+    const void *queue = 0;
+    size_t block[3] = {0, 0, 0};
+    std::set<const void *> buffers;
+    std::set<const void *> writtenBuffers;
+};
+
+// mode is the value of COCL_LAUNCH_FUSION:
+// - "" or "0": no fusion
+// - "1": fuse up to DefaultMaxLaunches launches
+// - otherwise, the most launches to fuse
+class LaunchFuser {
+public:
+    LaunchFuser(std::string mode);
+    bool enabled() const {
+        return maxLaunches > 1;
+    }
+    int getMaxLaunches() const {
+        return maxLaunches;
+    }
+    // the most launches one dispatch can take, given that each adds launchParamBytes to the fused kernel's
+    // parameters, on top of its sharedParamBytes.  Never less than 1
+    int getMaxLaunches(size_t launchParamBytes, size_t sharedParamBytes, size_t maxParameterSize) const;
+    // few enough blocks that the launch overhead is likely more than the kernel
+    bool isSmall(const size_t grid[3]) const;
+
+    static const int DefaultMaxLaunches = 16;
+    static const int MaxBlocksPerLaunch = 4;
+
+protected:
+    int maxLaunches = 0;
+};
+
+} // namespace cocl
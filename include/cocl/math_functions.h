@@ -0,0 +1,60 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The CUDA math functions, and their OpenCL equivalents.
+//
+// One table covers each function under all the names it reaches the device IR by: libdevice's __nv_expf, the
+// C expf, the C++ overloads, eg _Z3expf, _ZSt3expf, and LLVM's llvm.exp.f32.  Each has a precision class,
+// and, for single precision, the native_ function we use instead under -use_fast_math, where CUDA itself
+// would use its fast intrinsics, eg __expf.  We only use native_, never half_, since half_ functions can be
+// much less accurate than CUDA's fast intrinsics.
+//
+// Functions with no OpenCL equivalent, eg the Bessel functions, are in the table as Unsupported, so patch_hostside
+// can report them when cocl builds the .cu, rather than the kernel failing when it is first launched.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace cocl {
+
+class MathFunction {
+public:
+    enum Precision {
+        Exact,  // same result as CUDA, eg fabs, floor, fma
+        Accurate,  // OpenCL's full precision builtin, within a few ulp, like libdevice, eg exp, sin
+        Approximate,  // built from other builtins, so can lose accuracy, or overflow, for some inputs, eg rhypot
+        Fast,  // CUDA's fast intrinsics, eg __expf, which are native_ functions whatever the build options
+        Unsupported  // no OpenCL equivalent
+    };
+
+    // an OpenCL function name, eg "exp", or a template, where $0, $1, ... are the arguments, $L is the suffix of
+    // a floating point literal, ie "f" for single precision, and $F that of a math constant, eg M_SQRT1_2_F
+    std::string expression;
+    std::string fastExpression;  // for single precision, under -use_fast_math; "" to use expression
+    Precision precision = Accurate;
+    bool isFloat = false;  // single precision
+
+    // the OpenCL for a call with these arguments
+    std::string write(const std::vector<std::string> &args, bool fastMath) const;
+};
+
+// 0 if name isnt one of the math functions
+const MathFunction *findMathFunction(const std::string &name);
+
+// a libdevice, ie __nv_, function, or a math function, we cant translate
+bool isUnsupportedMathFunction(const std::string &name);
+
+} // namespace cocl
@@ -18,8 +18,12 @@
 #include "cocl/InstructionDumper.h"
 #include "cocl/shims.h"
 #include "cocl/llvm_dump.h"
+#include "cocl/address_space_inference.h"
+#include "cocl/GlobalConstants.h"
+#include "cocl/math_functions.h"
 #include <string>
 #include <stdexcept>
+#include <set>
 
 namespace cocl {
 
@@ -68,12 +72,19 @@ public:
     void dumpStore(cocl::LocalValueInfo *localValueInfo);
     void dumpInsertValue(cocl::LocalValueInfo *localValueInfo);
     void dumpExtractValue(cocl::LocalValueInfo *localValueInfo);
+    void dumpInsertElement(cocl::LocalValueInfo *localValueInfo);
+    void dumpExtractElement(cocl::LocalValueInfo *localValueInfo);
 
     LocalValueInfo *getOperand(llvm::Value *op);
     LocalValueInfo *dumpConstant(llvm::Constant *constant);
     void dumpConstantExpr(LocalValueInfo *localValueInfo);
     void dumpMemcpy(LocalValueInfo *localValueInfo, int align);
-    void writeShimCall(LocalValueInfo *localValueInfo, std::string shimName, std::string extraArgs, llvm::CallInst *instr);
+    void writeShimCall(LocalValueInfo *localValueInfo, std::string shimName, std::string extraArgs, llvm::CallInst *instr,
+        std::string trailingArgs = "");
+    void useScratch(const std::string &shimName);
+    void dumpTex2D(LocalValueInfo *localValueInfo, std::string readFunction, std::string component);
+    void dumpMathCall(LocalValueInfo *localValueInfo, const MathFunction *mathFunction);
+    std::string getSpecialRegisterExpression(std::string specialRegister, int dimension);
     void dumpCall(LocalValueInfo *localValueInfo, const std::map<llvm::Function *, llvm::Type *> &returnTypeByFunction);
 
     void runGeneration(LocalValueInfo *localValueInfo, const std::map<llvm::Function *, llvm::Type *> &returnTypeByFunction);
@@ -82,6 +93,29 @@ public:
         _addIRToCl = set;
         return this;
     }
+    NewInstructionDumper *setGlobalFenceBarriers(const std::set<llvm::Instruction *> *barriers) {
+        globalFenceBarriers = barriers;
+        return this;
+    }
+    NewInstructionDumper *setAddressSpaceInference(AddressSpaceInference *inference) {
+        addressSpaceInference = inference;
+        return this;
+    }
+    NewInstructionDumper *setGlobalConstants(const GlobalConstants *constants) {
+        globalConstants = constants;
+        return this;
+    }
+    // blockIdx and gridDim come from GlobalVars, rather than get_group_id and get_num_groups, when several launches
+    // share one dispatch; see KernelDumper::setFusedLaunches
+    NewInstructionDumper *setGroupIdsFromGlobalVars(bool fromGlobalVars) {
+        groupIdsFromGlobalVars = fromGlobalVars;
+        return this;
+    }
+    // use the native_ math functions, as CUDA would its fast intrinsics; see math_functions.h
+    NewInstructionDumper *setFastMath(bool fast) {
+        fastMath = fast;
+        return this;
+    }
 
     llvm::Module *M = 0;
 
@@ -94,6 +128,12 @@ public:
     // std::set<std::string> *shimFunctionsNeeded = 0; // for __shfldown_3 etc, that we provide as opencl directly
     cocl::Shims *shims = 0;
     std::set<llvm::Function *> *neededFunctions = 0;
+    // __syncthreads calls that also need to fence global memory; 0 means fence global memory at every one
+    const std::set<llvm::Instruction *> *globalFenceBarriers = 0;
+    // address spaces proved before we started dumping; 0 means we only have the dumper's own heuristics
+    AddressSpaceInference *addressSpaceInference = 0;
+    // layout of the __constant__ variables in the constants kernel parameter
+    const GlobalConstants *globalConstants = 0;
 
     std::map<llvm::Value *, std::string> *globalExpressionByValue = 0;
     std::map<llvm::Value *, std::unique_ptr<LocalValueInfo > > *localValueInfos = 0;
@@ -101,8 +141,11 @@ public:
     bool forceSingle = true;
     bool _addIRToCl = false;
     bool checkCalledFunctionsDefined = true;
+    bool groupIdsFromGlobalVars = false;
+    bool fastMath = false;
     bool usesVmem = false;
     bool usesScratch = false;
+    int scratchBytesPerWorkItem = 0;  // the widest value a shuffle or vote puts in scratch
 };
 
 } // namespace cocl
@@ -218,6 +218,11 @@ public:
     // like, how are we going to clone it, first issue.  Possible to to do, but a bunch of work, unless we have to
     static llvm::Instruction *addSetKernelArgInst_pointerstruct(llvm::Instruction *lastInst, llvm::Value *structPointer);
 
+    // texture objects are pointers to an opaque struct CoclTexture, see cocl_texture.h.  They go to
+    //     setKernelArgTexture(char *texture_as_charstar)
+    // which passes linear memory textures as a gpu buffer, and pitch2D textures as an image and a sampler
+    static llvm::Instruction *addSetKernelArgInst_texture(llvm::Instruction *lastInst, llvm::Value *value);
+
     static llvm::Instruction *addSetKernelArgInst_byvaluevector(llvm::Instruction *lastInst, llvm::Value *structPointer);
 
     // all setKernelArgs pass through addSetKernelArgInst, which dispatches to other functions
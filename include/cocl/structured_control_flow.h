@@ -0,0 +1,127 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes the basic blocks of a function as nested if/else and while(1) loops, instead of one label per
+// block joined up with gotos, so that the OpenCL compiler can see the loops, and unroll or vectorize them.
+//
+// We follow Ramsey, "Beyond Relooper" (ICFP 2022): each block is written out inside its immediate
+// dominator.  Blocks with a single forward predecessor are written inline, where that predecessor branches
+// to them; blocks with several forward predecessors ("merge blocks") are written after the code of their
+// dominator, so branching to them is a fallthrough, or a break out of a loop.  Loop headers become
+// while(1) loops, and back edges become continue.  The few branches we cant express like that (leaving two
+// loops at once, or skipping over another merge block) become forward gotos.  This only works for reducible
+// control flow, so the function dumper falls back to gotos everywhere if isReducible() is false.
+
+#pragma once
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <functional>
+
+namespace cocl {
+
+// the already-generated OpenCL for one block, all indented by four spaces
+class StructuredBlock {
+public:
+    std::string label;
+    std::string code;  // the instructions, without the terminator
+    std::string returnCode;  // for blocks ending in a return
+    std::string condition;  // for conditional branches, already in brackets
+    std::map<llvm::BasicBlock *, std::string> edgeCode;  // phi assignments, by successor
+};
+
+// a while(1) body, or one side of an if, that we can declare variables at the start of.  Scope 0 is the
+// function body
+class StructuredScope {
+public:
+    int parent = -1;
+    llvm::BasicBlock *loopHeader = 0;  // for a while(1) body
+    llvm::BasicBlock *edgeFrom = 0;  // for one side of an if, the edge it is for
+    llvm::BasicBlock *edgeTo = 0;
+};
+
+class StructuredControlFlow {
+public:
+    StructuredControlFlow(llvm::Function *F);
+    bool isReducible() const {
+        return reducible;
+    }
+    // works out the structure, and the scopes; blocks unreachable from the entry block are not written out
+    void analyze(const std::map<llvm::BasicBlock *, StructuredBlock> &blocks);
+    // declarationsByScope: declarations to write at the start of each scope, other than scope 0
+    std::string generateCl(const std::map<int, std::string> &declarationsByScope = std::map<int, std::string>());
+
+    bool usesGotos() const {
+        return gotoTargets.size() > 0;
+    }
+    const std::vector<StructuredScope> &getScopes() const {
+        return scopes;
+    }
+    // scope ids, from scope 0 inwards, where the code for block, or the phi copies for the edge from -> to, are
+    // written.  Empty if they arent written
+    std::vector<int> getScopePath(llvm::BasicBlock *block) const;
+    std::vector<int> getScopePath(llvm::BasicBlock *from, llvm::BasicBlock *to) const;
+
+protected:
+    enum FrameKind {
+        IfFrame,
+        LoopFrame,  // a while(1) for the loop headed by block
+        MergeFrame  // code that is followed by the merge block block
+    };
+    class Frame {
+    public:
+        Frame(FrameKind kind, llvm::BasicBlock *block) : kind(kind), block(block) {}
+        FrameKind kind;
+        llvm::BasicBlock *block;
+    };
+    typedef std::vector<Frame> Context;  // innermost frame last
+
+    bool isLoopHeader(llvm::BasicBlock *block);
+    bool isMergeBlock(llvm::BasicBlock *block);
+    std::vector<llvm::BasicBlock *> getMergeChildren(llvm::BasicBlock *block);
+    std::string withMergeChildren(std::vector<llvm::BasicBlock *> children, const Context &context, std::string indent,
+        std::function<std::string(const Context &)> inner);
+    std::string doBlock(llvm::BasicBlock *block, const Context &context, std::string indent);
+    std::string doBlockCode(llvm::BasicBlock *block, const Context &context, std::string indent);
+    std::string doBranch(llvm::BasicBlock *from, llvm::BasicBlock *to, const Context &context, std::string indent);
+    std::string writeGoto(llvm::BasicBlock *to, std::string indent);
+    std::string openScope(const StructuredScope &scope, std::string indent);
+    void closeScope();
+    const StructuredBlock &getBlock(llvm::BasicBlock *block);
+
+    llvm::Function *F;
+    llvm::DominatorTree domTree;
+    llvm::LoopInfo loopInfo;
+    std::vector<llvm::BasicBlock *> blockOrder;  // reverse postorder
+    std::map<llvm::BasicBlock *, int> orderIndex;
+    bool reducible = true;
+
+    const std::map<llvm::BasicBlock *, StructuredBlock> *blocks = 0;
+    std::set<llvm::BasicBlock *> gotoTargets;
+
+    std::vector<StructuredScope> scopes;
+    std::vector<int> scopePath;
+    std::map<llvm::BasicBlock *, std::vector<int> > scopePathByBlock;
+    std::map<std::pair<llvm::BasicBlock *, llvm::BasicBlock *>, std::vector<int> > scopePathByEdge;
+    const std::map<int, std::string> *declarationsByScope = 0;
+};
+
+} // namespace cocl
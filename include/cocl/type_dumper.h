@@ -40,11 +40,20 @@ public:
     std::string dumpAddressSpace(llvm::Type *type);
     std::string dumpArrayType(llvm::ArrayType *type, bool decayArraysToPointer = false);
     std::string dumpVectorType(llvm::VectorType *type, bool decayArraysToPointer = false);
+    // the type to use for type in memory: the same as dumpType, except for halfs; see dumpHalfDefinitions
+    std::string dumpStorageType(llvm::Type *type, bool decayArraysToPointer = false);
+    // eg "global half*", for passing to vload_half
+    std::string dumpHalfPointerType(unsigned int addressSpace);
+    // 1 for half, N for a vector of N halfs, 0 otherwise
+    static int getHalfWidth(llvm::Type *type);
 
     int getPointerDepth(llvm::Type *type);
 
     std::string dumpStructDefinitions();
     std::string dumpStructDefinition(llvm::StructType *type, std::string name);
+    std::string dumpHalfDefinitions();
+
+    bool usesHalf = false;
 
     std::set<llvm::StructType *> structsToDefine;
     std::map<llvm::FunctionType *, std::string> functionsToDefine;
@@ -0,0 +1,102 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Decides which of the local variables of a function can share a name, once the function dumper has
+// generated the code.
+//
+// Each phi is written as a copy on every incoming edge, and each value that isnt inlined gets its own
+// variable, so kernels end up with lots of variables, and copy chains, that some OpenCL compilers dont
+// manage to coalesce, and spill.  We work out the liveness of the variables in the code as written, ie with
+// the phi copies at the end of the predecessor blocks, and with inlined expressions reading their operands
+// where they are used, and build an interference graph.  Then:
+// - each phi is merged with its incoming values, where they dont interfere, so the copies become v = v, and
+//   disappear
+// - optionally, any remaining variables of the same type that dont interfere are merged too, like a
+//   register allocator would
+//
+// The function dumper then renames the merged variables to the name of the first one.
+
+#pragma once
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Value.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace cocl {
+
+class VariableCoalescing {
+public:
+    // typeByVariable: the instructions written to their own variable, that we can rename, with the type they are
+    // declared as.  inlined: the instructions written as an expression where they are used
+    VariableCoalescing(llvm::Function *F, const std::map<llvm::Value *, std::string> &typeByVariable,
+        const std::set<llvm::Value *> &inlined);
+
+    // with neither option, just works out the liveness
+    void run(bool mergePhis, bool reuseVariables);
+
+    // the variable whose name value should use.  Itself, if it wasnt merged with anything
+    llvm::Value *getRepresentative(llvm::Value *value);
+    // is any variable merged into representative live at the start of block (after its phis have been assigned),
+    // or on the edge from -> to, before the phi copies?
+    bool isLiveIn(llvm::BasicBlock *block, llvm::Value *representative);
+    bool isLiveOnEdge(llvm::BasicBlock *from, llvm::BasicBlock *to, llvm::Value *representative);
+    // where the variables merged into representative are read or written
+    const std::set<llvm::BasicBlock *> &getBlocksUsing(llvm::Value *representative);
+    const std::set<std::pair<llvm::BasicBlock *, llvm::BasicBlock *> > &getEdgesUsing(llvm::Value *representative);
+
+protected:
+    typedef std::set<llvm::Value *> ValueSet;
+    // one statement of the code as written: an instruction, or a phi copy
+    class Statement {
+    public:
+        ValueSet reads;
+        llvm::Value *write = 0;
+        llvm::Value *copiedFrom = 0;  // for phi copies of a variable, which dont make the two interfere
+    };
+    typedef std::vector<Statement> Statements;
+
+    const ValueSet &getReads(llvm::Value *value);
+    void buildStatements();
+    void computeLiveness();
+    void addInterference(const Statements &statements, ValueSet live);
+    ValueSet liveBefore(const Statements &statements, ValueSet live);
+    llvm::Value *find(llvm::Value *value);
+    bool interferes(llvm::Value *a, llvm::Value *b);
+    bool tryMerge(llvm::Value *a, llvm::Value *b);
+
+    llvm::Function *F;
+    const std::map<llvm::Value *, std::string> &typeByVariable;
+    const std::set<llvm::Value *> &inlined;
+
+    std::vector<llvm::Value *> variables;  // in order of the function
+    std::map<llvm::Value *, int> variableIndex;
+    std::map<llvm::Value *, ValueSet> readsByValue;
+    std::map<llvm::BasicBlock *, Statements> statementsByBlock;
+    std::map<std::pair<llvm::BasicBlock *, llvm::BasicBlock *>, Statements> copiesByEdge;
+    std::map<llvm::BasicBlock *, ValueSet> liveInByBlock;
+    std::map<std::pair<llvm::BasicBlock *, llvm::BasicBlock *>, ValueSet> liveByEdge;
+    std::map<llvm::Value *, ValueSet> interference;
+
+    std::map<llvm::Value *, llvm::Value *> parent;  // union-find
+    std::map<llvm::Value *, ValueSet> membersByRepresentative;
+    std::map<llvm::Value *, std::set<llvm::BasicBlock *> > blocksUsing;
+    std::map<llvm::Value *, std::set<std::pair<llvm::BasicBlock *, llvm::BasicBlock *> > > edgesUsing;
+};
+
+} // namespace cocl
@@ -0,0 +1,32 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Combines field-by-field accesses to small homogeneous structs, such as float4, int2 or uchar4,
+// into single vector loads and stores, which the instruction dumper writes as vloadN/vstoreN
+
+#pragma once
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/DerivedTypes.h"
+
+namespace cocl {
+
+// returns the element type if structType has 2, 3 or 4 elements, all of the same scalar type, otherwise 0
+llvm::Type *getVectorLikeStructElementType(llvm::StructType *structType);
+
+// only combines accesses through pointers whose type is in address space 1, 3 or 4, eg after
+// AddressSpaceInference has run.  Returns true if it changed anything
+bool combineVectorAccesses(llvm::Function *F);
+
+} // namespace cocl
@@ -95,7 +95,7 @@ void AllocaClWriter::writeDeclaration(std::string indent, TypeDumper *typeDumper
     // AllocaInfo allocaInfo;
     if(PointerType *allocatypeptr = dyn_cast<PointerType>(alloca->getType())) {
         Type *ptrElementType = allocatypeptr->getElementType();
-        std::string typestring = typeDumper->dumpType(ptrElementType);
+        std::string typestring = typeDumper->dumpStorageType(ptrElementType);
         int count = ReadIR::readInt32Constant(alloca->getOperand(0));
         // string name = localNames->getOrCreateName(alloca);
         string name = l->name;
@@ -107,7 +107,7 @@ void AllocaClWriter::writeDeclaration(std::string indent, TypeDumper *typeDumper
                 // cout << "alloca, is arraytype" << endl;
                 int innercount = arrayType->getNumElements();
                 Type *elementType = arrayType->getElementType();
-                string allocaDeclaration = typeDumper->dumpType(elementType) + " " + 
+                string allocaDeclaration = typeDumper->dumpStorageType(elementType) + " " + 
                     localValueInfo->name + "[" + easycl::toString(innercount) + "]";
                 // allocaInfo.alloca = alloca;
                 // allocaInfo.refValue = alloca;
@@ -255,7 +255,7 @@ void SharedClWriter::writeDeclaration(std::string indent, TypeDumper *typeDumper
         // GlobalVariable *globalVariable = cast<GlobalVariable>(value);
         // int count = pointerType->getArrayNumElements();
         // cout << "num elements " << count << endl;
-        os << indent << "local " << typeDumper->dumpType(primitiveType) << " " << localValueInfo->name << "[" << numElements << "];\n";
+        os << indent << "local " << typeDumper->dumpStorageType(primitiveType) << " " << localValueInfo->name << "[" << numElements << "];\n";
     } else {
         cout << "sharedclwriter writedeclaration not implmeneted for htis type:" << endl;
         COCL_LLVM_DUMP(value);
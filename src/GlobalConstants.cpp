@@ -1,4 +1,4 @@
-// Copyright Hugh Perkins 2016
+// Copyright Hugh Perkins 2016, 2017
 
 // Licensed under the Apache License, Version 2.0 (the "License");
 // you may not use this file except in compliance with the License.
@@ -14,10 +14,112 @@
 
 #include "cocl/GlobalConstants.h"
 
+#include "cocl/llvm_dump.h"
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+
 using namespace llvm;
 using namespace std;
 
 namespace cocl {
 
+GlobalConstants::GlobalConstants(Module *M) : M(M) {
+    const DataLayout &dataLayout = M->getDataLayout();
+    for(auto it = M->global_begin(); it != M->global_end(); it++) {
+        GlobalVariable *var = &*it;
+        if(!isInBuffer(var)) {
+            continue;
+        }
+        Type *valueType = var->getValueType();
+        int alignment = dataLayout.getABITypeAlignment(valueType);
+        if((int)var->getAlignment() > alignment) {
+            alignment = var->getAlignment();
+        }
+        size = (size + alignment - 1) / alignment * alignment;
+        variables.push_back(var);
+        offsetByVariable[var] = size;
+        size += dataLayout.getTypeAllocSize(valueType);
+    }
+}
+
+bool GlobalConstants::isInBuffer(const GlobalVariable *var) {
+    return var->getType()->getAddressSpace() == 4 && var->hasInitializer();
+}
+
+bool GlobalConstants::hasVariable(Value *value) const {
+    return offsetByVariable.find(value) != offsetByVariable.end();
+}
+
+int GlobalConstants::getOffset(Value *value) const {
+    auto it = offsetByVariable.find(value);
+    if(it == offsetByVariable.end()) {
+        string name = value->getName().str();
+        cout << "GlobalConstants::getOffset() not a __constant__ variable " << name << endl;
+        throw runtime_error("GlobalConstants::getOffset() not a __constant__ variable " + name);
+    }
+    return it->second;
+}
+
+std::map<std::string, int> GlobalConstants::getOffsetByName() const {
+    map<string, int> offsetByName;
+    for(auto it = variables.begin(); it != variables.end(); it++) {
+        GlobalVariable *var = *it;
+        offsetByName[var->getName().str()] = offsetByVariable.at(var);
+    }
+    return offsetByName;
+}
+
+std::string GlobalConstants::getImage() const {
+    string image(size, '\0');
+    for(auto it = variables.begin(); it != variables.end(); it++) {
+        GlobalVariable *var = *it;
+        writeConstant(var->getInitializer(), &image[offsetByVariable.at(var)]);
+    }
+    return image;
+}
+
+// writes constant, in the device's layout, to dest.  dest should already be zeroed
+void GlobalConstants::writeConstant(Constant *constant, char *dest) const {
+    const DataLayout &dataLayout = M->getDataLayout();
+    if(isa<ConstantAggregateZero>(constant) || isa<UndefValue>(constant) || isa<ConstantPointerNull>(constant)) {
+        return;
+    }
+    if(ConstantInt *constantInt = dyn_cast<ConstantInt>(constant)) {
+        uint64_t value = constantInt->getZExtValue();
+        int numBytes = dataLayout.getTypeStoreSize(constantInt->getType());
+        for(int i = 0; i < numBytes; i++) {
+            dest[i] = (char)((value >> (i * 8)) & 0xff);
+        }
+    } else if(ConstantFP *constantFP = dyn_cast<ConstantFP>(constant)) {
+        uint64_t bits = constantFP->getValueAPF().bitcastToAPInt().getZExtValue();
+        int numBytes = dataLayout.getTypeStoreSize(constantFP->getType());
+        for(int i = 0; i < numBytes; i++) {
+            dest[i] = (char)((bits >> (i * 8)) & 0xff);
+        }
+    } else if(ConstantDataSequential *sequential = dyn_cast<ConstantDataSequential>(constant)) {
+        StringRef raw = sequential->getRawDataValues();
+        memcpy(dest, raw.data(), raw.size());
+    } else if(ConstantStruct *constantStruct = dyn_cast<ConstantStruct>(constant)) {
+        const StructLayout *structLayout = dataLayout.getStructLayout(constantStruct->getType());
+        for(unsigned i = 0; i < constantStruct->getNumOperands(); i++) {
+            writeConstant(constantStruct->getOperand(i), dest + structLayout->getElementOffset(i));
+        }
+    } else if(isa<ConstantArray>(constant) || isa<ConstantVector>(constant)) {
+        for(unsigned i = 0; i < constant->getNumOperands(); i++) {
+            Constant *element = cast<Constant>(constant->getOperand(i));
+            writeConstant(element, dest + i * dataLayout.getTypeAllocSize(element->getType()));
+        }
+    } else {
+        cout << "GlobalConstants: __constant__ initializer not implemented:" << endl;
+        COCL_LLVM_DUMP(constant);
+        cout << endl;
+        throw runtime_error("GlobalConstants: __constant__ initializer not implemented");
+    }
+}
 
 } // namespace cocl
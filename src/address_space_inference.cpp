@@ -0,0 +1,388 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This is a standard forward dataflow analysis, over a lattice of:
+// - UNKNOWN: nothing has flowed into this value yet
+// - one of the address spaces, 0, 1, 3, 4
+// - CONFLICT: could be more than one address space, or we cant tell
+//
+// We track pointers through SSA values (geps, bitcasts, phis, selects), through allocas that dont escape
+// (so we can see every store into them), and into called functions, when every call site passes a pointer
+// in the same, proven, address space.  Anything else is CONFLICT, and the instruction dumper falls back to
+// its old heuristics for it.
+
+#include "cocl/address_space_inference.h"
+
+#include "cocl/mutations.h"
+#include "cocl/GlobalConstants.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace llvm;
+
+namespace cocl {
+
+static const int UNKNOWN = -1;
+static const int CONFLICT = -2;
+
+static int join(int one, int two) {
+    if(one == UNKNOWN) {
+        return two;
+    }
+    if(two == UNKNOWN || one == two) {
+        return one;
+    }
+    return CONFLICT;
+}
+
+static bool typeContainsPointers(Type *type) {
+    if(isa<PointerType>(type)) {
+        return true;
+    }
+    if(StructType *structType = dyn_cast<StructType>(type)) {
+        for(unsigned i = 0; i < structType->getNumElements(); i++) {
+            if(typeContainsPointers(structType->getElementType(i))) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if(ArrayType *arrayType = dyn_cast<ArrayType>(type)) {
+        return typeContainsPointers(arrayType->getElementType());
+    }
+    if(VectorType *vectorType = dyn_cast<VectorType>(type)) {
+        return typeContainsPointers(vectorType->getElementType());
+    }
+    return false;
+}
+
+// kernel arguments are global, except structs containing pointers, which the kernel copies into private
+// memory, see FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn
+static int getKernelArgSpace(Argument *arg) {
+    Type *elementType = cast<PointerType>(arg->getType())->getElementType();
+    if(StructType *structType = dyn_cast<StructType>(elementType)) {
+        if(typeContainsPointers(structType)) {
+            return CONFLICT;
+        }
+    }
+    return 1;
+}
+
+int AddressSpaceInference::getValueSpace(Value *value) {
+    if(isa<ConstantPointerNull>(value) || isa<UndefValue>(value)) {
+        return UNKNOWN;
+    }
+    if(GlobalVariable *global = dyn_cast<GlobalVariable>(value)) {
+        // shared memory, or __constant__ variables, which live in the constants buffer.  We dont know
+        // where the dumper puts anything else
+        if(global->getType()->getAddressSpace() == 3) {
+            return 3;
+        }
+        return GlobalConstants::isInBuffer(global) ? 4 : CONFLICT;
+    }
+    if(ConstantExpr *expr = dyn_cast<ConstantExpr>(value)) {
+        if(expr->getOpcode() == Instruction::AddrSpaceCast && expr->getType()->getPointerAddressSpace() != 0) {
+            return expr->getType()->getPointerAddressSpace();
+        }
+        if(expr->getOpcode() == Instruction::AddrSpaceCast || expr->getOpcode() == Instruction::BitCast
+                || expr->getOpcode() == Instruction::GetElementPtr) {
+            return getValueSpace(expr->getOperand(0));
+        }
+        return CONFLICT;
+    }
+    if(isa<Instruction>(value) || isa<Argument>(value)) {
+        auto it = spaceByValue.find(value);
+        return it == spaceByValue.end() ? UNKNOWN : it->second;
+    }
+    return CONFLICT;
+}
+
+int AddressSpaceInference::evaluate(Instruction *instr) {
+    if(isa<AllocaInst>(instr)) {
+        return 0;
+    } else if(GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(instr)) {
+        return getValueSpace(gep->getPointerOperand());
+    } else if(isa<BitCastInst>(instr)) {
+        return getValueSpace(instr->getOperand(0));
+    } else if(isa<AddrSpaceCastInst>(instr)) {
+        if(instr->getType()->getPointerAddressSpace() != 0) {
+            return instr->getType()->getPointerAddressSpace();
+        }
+        return getValueSpace(instr->getOperand(0));
+    } else if(PHINode *phi = dyn_cast<PHINode>(instr)) {
+        int space = UNKNOWN;
+        for(unsigned i = 0; i < phi->getNumIncomingValues(); i++) {
+            space = join(space, getValueSpace(phi->getIncomingValue(i)));
+        }
+        return space;
+    } else if(SelectInst *select = dyn_cast<SelectInst>(instr)) {
+        return join(getValueSpace(select->getTrueValue()), getValueSpace(select->getFalseValue()));
+    } else if(LoadInst *load = dyn_cast<LoadInst>(instr)) {
+        auto it = allocaByPointer.find(load->getPointerOperand());
+        if(it == allocaByPointer.end() || allocasWithOpaqueContents.find(it->second) != allocasWithOpaqueContents.end()) {
+            return CONFLICT;
+        }
+        return contentSpaceByAlloca[it->second];
+    }
+    return CONFLICT;
+}
+
+void AddressSpaceInference::findTrackedAllocas(Function *F) {
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        for(auto inst_it = block_it->begin(); inst_it != block_it->end(); inst_it++) {
+            AllocaInst *alloca = dyn_cast<AllocaInst>(&*inst_it);
+            if(alloca == 0) {
+                continue;
+            }
+            bool allocaHasPointers = typeContainsPointers(alloca->getAllocatedType());
+            bool escapes = false;
+            bool punning = false;
+            vector<StoreInst *> stores;
+            vector<Value *> derived;
+            // pairs of (pointer into alloca, whether we went through a bitcast to get it)
+            vector<pair<Value *, bool> > toVisit;
+            toVisit.push_back(make_pair((Value *)alloca, false));
+            while(toVisit.size() > 0 && !escapes) {
+                Value *pointer = toVisit.back().first;
+                bool viaBitcast = toVisit.back().second;
+                toVisit.pop_back();
+                derived.push_back(pointer);
+                for(auto use_it = pointer->user_begin(); use_it != pointer->user_end(); use_it++) {
+                    User *user = *use_it;
+                    if(LoadInst *load = dyn_cast<LoadInst>(user)) {
+                        if(viaBitcast && (allocaHasPointers || typeContainsPointers(load->getType()))) {
+                            punning = true;
+                        }
+                    } else if(StoreInst *store = dyn_cast<StoreInst>(user)) {
+                        if(store->getValueOperand() == pointer) {
+                            escapes = true;
+                            break;
+                        }
+                        Type *valueType = store->getValueOperand()->getType();
+                        if(viaBitcast && (allocaHasPointers || typeContainsPointers(valueType))) {
+                            punning = true;
+                        }
+                        if(!isa<PointerType>(valueType) && typeContainsPointers(valueType)) {
+                            punning = true;
+                        }
+                        // pointers to pointers point at memory full of vmem offsets; we leave those to the
+                        // instruction dumper
+                        if(isa<PointerType>(valueType) && typeContainsPointers(cast<PointerType>(valueType)->getElementType())) {
+                            punning = true;
+                        }
+                        stores.push_back(store);
+                    } else if(isa<GetElementPtrInst>(user)) {
+                        toVisit.push_back(make_pair((Value *)user, viaBitcast));
+                    } else if(isa<BitCastInst>(user)) {
+                        toVisit.push_back(make_pair((Value *)user, true));
+                    } else if(isa<ICmpInst>(user) || isa<DbgInfoIntrinsic>(user)) {
+                    } else if(IntrinsicInst *intrinsic = dyn_cast<IntrinsicInst>(user)) {
+                        if(intrinsic->getIntrinsicID() != Intrinsic::lifetime_start
+                                && intrinsic->getIntrinsicID() != Intrinsic::lifetime_end) {
+                            escapes = true;
+                            break;
+                        }
+                    } else {
+                        escapes = true;
+                        break;
+                    }
+                }
+            }
+            if(escapes) {
+                continue;
+            }
+            for(auto it = derived.begin(); it != derived.end(); it++) {
+                allocaByPointer[*it] = alloca;
+            }
+            storesByAlloca[alloca] = stores;
+            if(punning) {
+                allocasWithOpaqueContents.insert(alloca);
+            }
+        }
+    }
+}
+
+bool AddressSpaceInference::sweep() {
+    bool changed = false;
+    for(auto f_it = functions.begin(); f_it != functions.end(); f_it++) {
+        Function *F = *f_it;
+        int argIdx = 0;
+        for(auto arg_it = F->arg_begin(); arg_it != F->arg_end(); arg_it++, argIdx++) {
+            Argument *arg = &*arg_it;
+            if(!isa<PointerType>(arg->getType())) {
+                continue;
+            }
+            int space = UNKNOWN;
+            if(F == kernel) {
+                space = getKernelArgSpace(arg);
+            } else if(conflictedArgs.find(arg) != conflictedArgs.end()) {
+                space = CONFLICT;
+            } else {
+                vector<CallInst *> &calls = callsByFunction[F];
+                for(auto call_it = calls.begin(); call_it != calls.end(); call_it++) {
+                    space = join(space, getValueSpace((*call_it)->getArgOperand(argIdx)));
+                }
+            }
+            if(getValueSpace(arg) != space) {
+                spaceByValue[arg] = space;
+                changed = true;
+            }
+        }
+    }
+    for(auto it = storesByAlloca.begin(); it != storesByAlloca.end(); it++) {
+        int space = UNKNOWN;
+        for(auto store_it = it->second.begin(); store_it != it->second.end(); store_it++) {
+            Value *storedValue = (*store_it)->getValueOperand();
+            if(isa<PointerType>(storedValue->getType())) {
+                space = join(space, getValueSpace(storedValue));
+            }
+        }
+        contentSpaceByAlloca[it->first] = space;
+    }
+    for(auto f_it = functions.begin(); f_it != functions.end(); f_it++) {
+        Function *F = *f_it;
+        for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+            for(auto inst_it = block_it->begin(); inst_it != block_it->end(); inst_it++) {
+                Instruction *instr = &*inst_it;
+                if(!isa<PointerType>(instr->getType())) {
+                    continue;
+                }
+                int space = evaluate(instr);
+                if(getValueSpace(instr) != space) {
+                    spaceByValue[instr] = space;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+void AddressSpaceInference::run(Module *M, Function *kernel) {
+    this->kernel = kernel;
+
+    // find everything the kernel might call, and where from
+    set<Function *> seen;
+    vector<Function *> toVisit;
+    toVisit.push_back(kernel);
+    seen.insert(kernel);
+    while(toVisit.size() > 0) {
+        Function *F = toVisit.back();
+        toVisit.pop_back();
+        functions.push_back(F);
+        for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+            for(auto inst_it = block_it->begin(); inst_it != block_it->end(); inst_it++) {
+                CallInst *call = dyn_cast<CallInst>(&*inst_it);
+                if(call == 0 || call->getCalledFunction() == 0 || call->getCalledFunction()->isDeclaration()) {
+                    continue;
+                }
+                Function *callee = call->getCalledFunction();
+                callsByFunction[callee].push_back(call);
+                if(seen.find(callee) == seen.end()) {
+                    seen.insert(callee);
+                    toVisit.push_back(callee);
+                }
+            }
+        }
+    }
+    for(auto it = functions.begin(); it != functions.end(); it++) {
+        findTrackedAllocas(*it);
+    }
+
+    // The instruction dumper specializes each call on the address spaces of its arguments, so we can only
+    // claim an address space for an argument if every caller passes a pointer we proved to be in that space.
+    // Otherwise, we mark the argument as conflicted, and go round again.
+    bool conflictedMore = true;
+    while(conflictedMore) {
+        while(sweep()) {
+        }
+        conflictedMore = false;
+        for(auto f_it = functions.begin(); f_it != functions.end(); f_it++) {
+            Function *F = *f_it;
+            if(F == kernel) {
+                continue;
+            }
+            int argIdx = 0;
+            for(auto arg_it = F->arg_begin(); arg_it != F->arg_end(); arg_it++, argIdx++) {
+                Argument *arg = &*arg_it;
+                if(!isa<PointerType>(arg->getType()) || getValueSpace(arg) < 0) {
+                    continue;
+                }
+                vector<CallInst *> &calls = callsByFunction[F];
+                for(auto call_it = calls.begin(); call_it != calls.end(); call_it++) {
+                    if(getValueSpace((*call_it)->getArgOperand(argIdx)) < 0) {
+                        conflictedArgs.insert(arg);
+                        conflictedMore = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for(auto it = spaceByValue.begin(); it != spaceByValue.end(); it++) {
+        Value *value = it->first;
+        int space = it->second;
+        if(space < 0 || !isa<PointerType>(value->getType())) {
+            continue;
+        }
+        if(Argument *arg = dyn_cast<Argument>(value)) {
+            if(arg->getParent() == kernel) {
+                continue;
+            }
+        }
+        // pointers into allocas holding pointers we couldnt resolve keep the dumper's old handling, so that
+        // loads through them still get treated as global, or vmem
+        auto alloca_it = allocaByPointer.find(value);
+        if(alloca_it != allocaByPointer.end() && typeContainsPointers(alloca_it->second->getAllocatedType())) {
+            AllocaInst *alloca = alloca_it->second;
+            if(allocasWithOpaqueContents.find(alloca) != allocasWithOpaqueContents.end() || contentSpaceByAlloca[alloca] < 0) {
+                continue;
+            }
+        }
+        int typeSpace = value->getType()->getPointerAddressSpace();
+        if(typeSpace != 0 && typeSpace != space) {
+            continue;
+        }
+        addressSpaceByValue[value] = space;
+        if(isa<Instruction>(value) && typeSpace == 0 && space != 0) {
+            updateAddressSpace(value, space);
+        }
+    }
+}
+
+int AddressSpaceInference::getAddressSpace(Value *value) const {
+    auto it = addressSpaceByValue.find(value);
+    if(it == addressSpaceByValue.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+void AddressSpaceInference::copyToClone(ValueToValueMapTy &valueMap) {
+    for(auto it = valueMap.begin(); it != valueMap.end(); it++) {
+        Value *oldValue = const_cast<Value *>(it->first);
+        Value *newValue = it->second;
+        auto space_it = addressSpaceByValue.find(oldValue);
+        if(newValue != 0 && space_it != addressSpaceByValue.end()) {
+            addressSpaceByValue[newValue] = space_it->second;
+        }
+    }
+}
+
+} // namespace cocl
@@ -38,7 +38,7 @@ bool BasicBlockDumper::checkIfNeedsAssign(Instruction *instruction) {
         use = &*instruction->use_begin();
         use_user = use->getUser();
         useIsAStore = isa<StoreInst>(use_user);
-        useIsExtractValue = isa<ExtractValueInst>(use_user);
+        useIsExtractValue = isa<ExtractValueInst>(use_user) || isa<ExtractElementInst>(use_user);
         useIsAPhi = isa<PHINode>(use_user);
         useIsABitcast = isa<BitCastInst>(use_user);
     }
@@ -90,6 +90,7 @@ bool BasicBlockDumper::runGeneration(const std::map<llvm::Function *, llvm::Type
             }
             if(instructionDumper->usesScratch) {
                 this->usesScratch = true;
+                this->scratchBytesPerWorkItem = std::max(scratchBytesPerWorkItem, instructionDumper->scratchBytesPerWorkItem);
             }
             if(instrInfo->needDependencies) {
                 return false;
@@ -0,0 +1,70 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/cocl_cl20.h"
+
+#include <string>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+
+namespace cocl {
+
+int getDeviceOpenCLMajorVersion(cl_device_id device) {
+    // "OpenCL <major>.<minor> <vendor-specific information>"
+    string version = easycl::getDeviceInfoString(device, CL_DEVICE_VERSION);
+    const string prefix = "OpenCL ";
+    if(version.find(prefix) != 0) {
+        return 0;
+    }
+    return atoi(version.substr(prefix.size()).c_str());
+}
+
+// the same library clew loads, so dlopen just gives us its handle
+static void *getOpenCLLibrary() {
+    #ifdef _WIN32
+    static void *library = (void *)LoadLibraryA("OpenCL.dll");
+    #elif defined(__APPLE__)
+    static void *library = dlopen("/System/Library/Frameworks/OpenCL.framework/OpenCL", RTLD_NOW);
+    #else
+    static void *library = dlopen("libOpenCL.so", RTLD_NOW);
+    if(library == 0) {
+        library = dlopen("libOpenCL.so.1", RTLD_NOW);
+    }
+    #endif
+    return library;
+}
+
+void *getOpenCL20Function(cl_device_id device, const char *name) {
+    if(getDeviceOpenCLMajorVersion(device) < 2) {
+        return 0;
+    }
+    void *library = getOpenCLLibrary();
+    if(library == 0) {
+        return 0;
+    }
+    #ifdef _WIN32
+    return (void *)GetProcAddress((HMODULE)library, name);
+    #else
+    return dlsym(library, name);
+    #endif
+}
+
+} // namespace cocl
@@ -16,6 +16,7 @@
 
 #include "cocl/hostside_opencl_funcs.h"
 #include "cocl/cocl_streams.h"
+#include "cocl/cocl_memory.h"
 
 #include <iostream>
 #include <memory>
@@ -46,6 +47,29 @@ namespace cocl {
     }
     Context::~Context() {
         COCL_PRINT(cout << "~Context() " << this << endl);
+        // stop the callback thread before anything it might touch goes away
+        callbackExecutor.reset();
+        for(auto it=constantsBufferByModule.begin(); it != constantsBufferByModule.end(); it++) {
+            clReleaseMemObject(it->second);
+        }
+    }
+    CallbackExecutor *Context::getCallbackExecutor() {
+        ContextMutex contextMutex(this);
+        if(callbackExecutor == 0) {
+            callbackExecutor.reset(new CallbackExecutor(this));
+        }
+        return callbackExecutor.get();
+    }
+    void Context::synchronize() {
+        default_stream->finish();
+        {
+            std::lock_guard< std::mutex > guard(streamsMutex);
+            for(auto it=streams.begin(); it != streams.end(); it++) {
+                (*it)->finish();
+            }
+        }
+        cl->finish();
+        migrateManagedMemoryToHost(this, 0);
     }
 
     ContextMutex::ContextMutex(Context *context) : context(context) {
@@ -64,6 +88,34 @@ namespace cocl {
         }
     }
     ThreadVars::~ThreadVars() {
+        // the thread is exiting: its per-thread streams must stop being visible to
+        // Context::synchronize and to the managed memory bookkeeping before they go away
+        for(auto it=perThreadStreams.begin(); it != perThreadStreams.end(); it++) {
+            Context *context = it->first;
+            CoclStream *stream = it->second.get();
+            COCL_PRINT(cout << "destroying per-thread default stream " << stream << " for context " << context << endl);
+            stream->finish();
+            migrateManagedMemoryToHost(context, stream);
+            std::lock_guard< std::mutex > guard(context->streamsMutex);
+            context->streams.erase(stream);
+        }
+        perThreadStreams.clear();
+    }
+    CoclStream *ThreadVars::getPerThreadStream() {
+        Context *context = getContext();
+        auto it = perThreadStreams.find(context);
+        if(it != perThreadStreams.end()) {
+            return it->second.get();
+        }
+        COCL_PRINT(cout << "creating per-thread default stream for context " << context << endl);
+        CoclStream *stream = new CoclStream(context->getCl());
+        stream->context = context;
+        {
+            std::lock_guard< std::mutex > guard(context->streamsMutex);
+            context->streams.insert(stream);
+        }
+        perThreadStreams[context].reset(stream);
+        return stream;
     }
     Context *ThreadVars::getContext() {
         if(currentContext == 0) {
@@ -73,12 +125,13 @@ namespace cocl {
         return currentContext;
     }
 
-    thread_local ThreadVars *threadVars = nullptr;
+    // owned per thread, so ~ThreadVars runs, and tears down the per-thread streams, at thread exit
+    thread_local std::unique_ptr<ThreadVars> threadVars;
     ThreadVars *getThreadVars() {
         if(threadVars == nullptr) {
-            threadVars = new ThreadVars();
+            threadVars.reset(new ThreadVars());
         }
-        return threadVars;
+        return threadVars.get();
     }
 }
 
@@ -89,10 +142,10 @@ size_t cuCtxGetDevice(CUdevice *pdevice) {
 }
 
 size_t cuCtxSynchronize(void) {
+    flushFusedLaunches();
     COCL_PRINT(cout << "cuCtxSynchronize" << endl);
     ThreadVars *v = getThreadVars();
-    EasyCL *cl = v->getContext()->getCl();
-    cl->finish();
+    v->getContext()->synchronize();
     return 0;
 }
 
@@ -105,6 +158,7 @@ size_t cuCtxGetCurrent(char **_ppContext) {
 }
 
 size_t cuCtxSetCurrent(char *_pContext) {
+    flushFusedLaunches();
     COCL_PRINT(cout << "cuCtxSetCurrent context=" << (void *)_pContext << endl);
     Context *context = (Context *)_pContext;
     ThreadVars *threadVars = getThreadVars();
@@ -113,6 +167,7 @@ size_t cuCtxSetCurrent(char *_pContext) {
 }
 
 size_t cuCtxCreate (char **_ppContext, unsigned int flags, long long device) {
+    flushFusedLaunches();
     COCL_PRINT(cout << "cuCtxCreate_v2 device=" << device << " flags=" << flags << endl);
     Context **ppContext = (Context **)_ppContext;
     Context *newContext = new Context(device);
@@ -1,6 +1,7 @@
 #include "cocl/cocl_device.h"
 
 #include "cocl/cocl_context.h"
+#include "cocl/hostside_opencl_funcs.h"
 
 #include "EasyCL/EasyCL.h"
 
@@ -78,6 +79,19 @@ namespace cocl {
         COCL_PRINT(cout << "CoclDevice::CoclDevice gpuOrdinal=" << gpuOrdinal << endl);
         // this->platform_id = _platform_id;
         // this->device_id = _device_id;
+        string extensions = easycl::getDeviceInfoString(device_id, CL_DEVICE_EXTENSIONS);
+        if(extensions.find("cl_ext_float_atomics") != string::npos) {
+            // eg "OpenCL C 3.0 "
+            string clCVersion = easycl::getDeviceInfoString(device_id, CL_DEVICE_OPENCL_C_VERSION);
+            if(clCVersion.find("OpenCL C 3.") == 0) {
+                floatAtomicsBuildOptions = "-cl-std=CL3.0";
+            } else if(clCVersion.find("OpenCL C 2.") == 0) {
+                floatAtomicsBuildOptions = "-cl-std=CL2.0";
+            }
+        }
+        COCL_PRINT(cout << "CoclDevice::CoclDevice floatAtomicsBuildOptions=" << floatAtomicsBuildOptions << endl);
+        maxParameterSize = easycl::getDeviceInfoInt64(device_id, CL_DEVICE_MAX_PARAMETER_SIZE);
+        addressBits = easycl::getDeviceInfoInt(device_id, CL_DEVICE_ADDRESS_BITS);
     }
 
     int numGpus = 0;
@@ -164,6 +178,7 @@ size_t cudaGetDeviceCount (int *p_count) {
 }
 
 size_t cudaSetDevice (int gpuOrdinal) {
+    flushFusedLaunches();
     COCL_PRINT(cout << "cudaSetDevice gpuOrdinal=" << gpuOrdinal << endl);
     ThreadVars *v = getThreadVars();
     initDevices();
@@ -193,6 +208,6 @@ size_t cudaDeviceReset() {
 }
 
 size_t cudaDeviceSynchronize() {
-    cout << "ignoring cudaDeviceSynchronize for now" << endl;
-    return 0;
+    COCL_PRINT(cout << "cudaDeviceSynchronize" << endl);
+    return cuCtxSynchronize();
 }
@@ -19,12 +19,14 @@
 #include "cocl/hostside_opencl_funcs.h"
 #include "cocl/cocl_streams.h"
 #include "cocl/cocl_context.h"
+#include "cocl/cocl_pool.h"
 
 #include "EasyCL/EasyCL.h"
 
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 using namespace std;
 using namespace cocl;
@@ -40,16 +42,11 @@ using namespace easycl;
 #define COCL_PRINT(x) 
 #endif
 
-// I guess that events should only be called from a single thread, so there might 
-// be a bug elesewhere, but in the meantime, the events are being called in parallel, from
-// mutliple threads, which crasehs stuff. lets try using a mutex to "fix" this for now
-// static pthread_mutex_t cocl_events_mutex = PTHREAD_MUTEX_INITIALIZER;
-static std::mutex cocl_events_mutex;
-
 namespace cocl {
     CoclEvent::CoclEvent() {
         COCL_PRINT("CoclEvent() this=" << this);
         event = 0;
+        nextFree = 0;
     }
     CoclEvent::~CoclEvent() {
         COCL_PRINT("~CoclEvent() this=" << this);
@@ -59,17 +56,35 @@ namespace cocl {
             EasyCL::checkError(err);
         }
     }
+    cl_event CoclEvent::retainClEvent() {
+        std::lock_guard< std::mutex > guard(mu);
+        if(event != 0) {
+            cl_int err = clRetainEvent(event);
+            EasyCL::checkError(err);
+        }
+        return event;
+    }
+    void CoclEvent::setClEvent(cl_event clevent) {
+        cl_event oldEvent = 0;
+        {
+            std::lock_guard< std::mutex > guard(mu);
+            oldEvent = event;
+            event = clevent;
+        }
+        if(oldEvent != 0) {
+            COCL_PRINT("  releasing previous clevent " << oldEvent);
+            cl_int err = clReleaseEvent(oldEvent);
+            EasyCL::checkError(err);
+        }
+    }
+
+    // so we dont new/delete a CoclEvent for each cuEventCreate/cuEventDestroy
+    static CoclPool<CoclEvent> eventPool("events");
 }
 
 size_t cuStreamWaitEvent(char *_queue, CoclEvent *event, unsigned int flags) {
-    // pthread_mutex_lock(&cocl_events_mutex);
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    CoclStream *stream = (CoclStream *)_queue;
-    CLQueue *queue = stream->clqueue;
-    if(queue == 0) {
-        cout << "cuStreamWaitEvent stream==0 not implemented" << std::endl;
-        throw runtime_error("cuStreamWaitEvent stream==0 not implemented");
-    }
+    flushFusedLaunches();
+    CoclStream *stream = resolveStream(_queue);
 
     // I think what cuStreamWaitEvent does is:
     // - add something to the queue, some marker/barrier
@@ -84,16 +99,16 @@ size_t cuStreamWaitEvent(char *_queue, CoclEvent *event, unsigned int flags) {
     // I think waht we plausibly need is clEnqueueBarrierWithWaitList
     // so lets try that...
 
-    if(event->event == 0) {
+    cl_event clevent = event->retainClEvent();
+    if(clevent == 0) {
         cerr << "cuStreamWaitEvent redirected: Warning: you havent Recorded on the event you passed in" << endl;
     } else {
-        // cl_event clevent;
-        clEnqueueBarrierWithWaitList(queue->queue,
-            1,
-            &event->event,
-            0);
+        // a blocking stream also waits for earlier work on the legacy default stream, and vice versa
+        syncWithLegacyStream(stream);
+        stream->waitForEvents(std::vector<cl_event>(1, clevent));
+        cl_int err = clReleaseEvent(clevent);
+        EasyCL::checkError(err);
     }
-    // pthread_mutex_unlock(&cocl_events_mutex);
     return 0;
 }
 
@@ -116,13 +131,9 @@ size_t cudaStreamWaitEvent(char *_queue, CoclEvent *event, unsigned int flags) {
 }
 
 size_t cuEventCreate(CoclEvent **pevent, unsigned int flags) {
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    // pthread_mutex_lock(&cocl_events_mutex);
-    CoclEvent *event = new CoclEvent();
+    CoclEvent *event = eventPool.get();
     *pevent = event;
     COCL_PRINT("cuEventCreate flags=" << flags << " new CoclEvent=" << event);
-    // throw runtime_error("fake stop");
-    // pthread_mutex_unlock(&cocl_events_mutex);
     return 0;
 }
 
@@ -135,12 +146,18 @@ size_t cudaEventCreate(CoclEvent **pevent) {
 }
 
 size_t cuEventSynchronize(CoclEvent *event) {
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    // pthread_mutex_lock(&cocl_events_mutex);
+    flushFusedLaunches();
     COCL_PRINT("cuEventSynchronize CoclEvent=" << event);
-    cl_int err = clWaitForEvents(1, &event->event);  // 1 is number of events, 2nd parameter is list of events
+    // we hold our own reference whilst waiting, so a concurrent cuEventRecord on the same event
+    // can go ahead, without pulling the cl_event out from under us
+    cl_event clevent = event->retainClEvent();
+    if(clevent == 0) {
+        return 0;  // never recorded => nothing to wait for, same as cuda
+    }
+    cl_int err = clWaitForEvents(1, &clevent);  // 1 is number of events, 2nd parameter is list of events
+    EasyCL::checkError(err);
+    err = clReleaseEvent(clevent);
     EasyCL::checkError(err);
-    // pthread_mutex_unlock(&cocl_events_mutex);
     return 0;
 }
 
@@ -158,42 +175,21 @@ size_t cudaEventSynchronize(cocl::CoclEvent *event) {
 }
 
 size_t cuEventRecord(CoclEvent *event, char *_queue) {
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    // pthread_mutex_lock(&cocl_events_mutex);
+    flushFusedLaunches();
     COCL_PRINT("cuEventRecord CoclEvent=" << (long)event << " _queue=" << (long)_queue);
-    CoclStream *coclStream = (CoclStream *)_queue;
-
-    ThreadVars *v = getThreadVars();
-    // EasyCL *cl = v->getContext()->getCl();
-    if(coclStream == 0) {
-        coclStream = v->currentContext->default_stream.get();
-    }
+    CoclStream *coclStream = resolveStream(_queue);
     CLQueue *queue = coclStream->clqueue;
     COCL_PRINT("  cuEventRecord queue=" << queue);
-    // CLQueue *queue = (CLQueue *)_queue;
-    if(queue == 0) {
-        cout << "cuEventRecord not implemented for stream 0" << endl;
-        throw runtime_error("cuEventRecord not implemented for stream 0");
-    }
-    cl_int err;
-    err = clFlush(queue->queue);
-    EasyCL::checkError(err);
-    if(event->event != 0) {
-        COCL_PRINT("  cuEventRecord releasing existing clevent " << event->event);
-        err = clReleaseEvent(event->event);
-        EasyCL::checkError(err);
-        event->event = 0;
-        // cout << "cuEventRecrd event is already assigned => error" << endl;
-        // throw runtime_error("cuEventRecord: event is already assigned => error");
-    }
-    cl_event clevent;
-    err = clEnqueueMarkerWithWaitList(queue->queue, 0, 0, &clevent);
+    // on the legacy default stream, the event also waits for the blocking streams, and vice versa
+    syncWithLegacyStream(coclStream);
+    // the marker is tracked as a command of the stream, like any other
+    cl_event clevent = coclStream->retainLastCommandEvent();
     COCL_PRINT("cuEventRecord CoclEvent=" << event << " created clevent=" << clevent);
+    // flush so the marker, and everything before it, actually gets submitted, otherwise a
+    // cuEventSynchronize/cuEventQuery from another thread might wait forever
+    cl_int err = clFlush(queue->queue);
     EasyCL::checkError(err);
-    err = clFlush(queue->queue);
-    EasyCL::checkError(err);
-    event->event = clevent;
-    // pthread_mutex_unlock(&cocl_events_mutex);
+    event->setClEvent(clevent);
     return 0;
 }
 
@@ -202,19 +198,23 @@ size_t cudaEventRecord(cocl::CoclEvent *event, char *queue) {
 }
 
 size_t cuEventQuery(CoclEvent *event) {
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    // pthread_mutex_lock(&cocl_events_mutex);
-    COCL_PRINT("cuEventQuery CoclEvent=" << event << " clevent=" << event->event);
+    flushFusedLaunches();
+    cl_event clevent = event->retainClEvent();
+    COCL_PRINT("cuEventQuery CoclEvent=" << event << " clevent=" << clevent);
+    if(clevent == 0) {
+        return 0;  // never recorded => counts as completed, same as cuda
+    }
     cl_int res;
     cl_int err = clGetEventInfo (
-        event->event,
+        clevent,
         CL_EVENT_COMMAND_EXECUTION_STATUS,
         sizeof(cl_int),
         &res,
         0);
     COCL_PRINT("clGetEventInfo: " << res);
     EasyCL::checkError(err);
-    // pthread_mutex_unlock(&cocl_events_mutex);
+    err = clReleaseEvent(clevent);
+    EasyCL::checkError(err);
     if(res == CL_COMPLETE) { // success
         COCL_PRINT("cuEventQuery, event completed");
         return 0;
@@ -227,17 +227,15 @@ size_t cuEventQuery(CoclEvent *event) {
     }
 }
 
+size_t cudaEventQuery(CoclEvent *event) {
+    return cuEventQuery(event);
+}
+
 size_t cuEventDestroy_v2(CoclEvent *event) {
-    std::lock_guard< std::mutex > guard(cocl_events_mutex);
-    // pthread_mutex_lock(&cocl_events_mutex);
     COCL_PRINT("cuEventDestroy CoclEvent=" << event);
-    // if(event->event != 0) {
-    //     COCL_PRINT("cuEventDestory_v2: releasing event " << event->event);
-    //     cu_int err = clReleaseEvent(event->event);
-    //     EasyCL::checkError(err);
-    // }
-    delete event;
-    // pthread_mutex_unlock(&cocl_events_mutex);
+    // release the cl_event now, rather than when the CoclEvent is next handed out
+    event->setClEvent(0);
+    eventPool.put(event);
     return 0;
 }
 
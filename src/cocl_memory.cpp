@@ -20,12 +20,19 @@
 #include "cocl/cocl_device.h"
 
 #include "cocl/fill_buffer.h"
+#include "cocl/cocl_cl20.h"
 
 #include <iostream>
 #include <memory>
 #include <vector>
 #include <map>
 #include <set>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 #include "EasyCL/EasyCL.h"
 
@@ -43,7 +50,74 @@ using namespace easycl;
 #define COCL_PRINT(x) 
 #endif
 
+#ifndef CL_DEVICE_SVM_CAPABILITIES
+#define CL_DEVICE_SVM_CAPABILITIES 0x1053
+#endif
+#ifndef CL_DEVICE_SVM_COARSE_GRAIN_BUFFER
+#define CL_DEVICE_SVM_COARSE_GRAIN_BUFFER (1 << 0)
+#endif
+
+// OpenCL 2.0 entry points, which clew doesnt load for us
+typedef void *(CL_API_CALL *clSVMAllocFn)(
+    cl_context context, cl_bitfield flags, size_t size, cl_uint alignment);
+typedef void (CL_API_CALL *clSVMFreeFn)(cl_context context, void *svm_pointer);
+typedef cl_int (CL_API_CALL *clEnqueueSVMMapFn)(
+    cl_command_queue queue, cl_bool blocking_map, cl_map_flags flags, void *svm_ptr, size_t size,
+    cl_uint num_events_in_wait_list, const cl_event *event_wait_list, cl_event *event);
+typedef cl_int (CL_API_CALL *clEnqueueSVMUnmapFn)(
+    cl_command_queue queue, void *svm_ptr,
+    cl_uint num_events_in_wait_list, const cl_event *event_wait_list, cl_event *event);
+
+// page-aligned, and a whole number of cachelines, so that drivers for integrated gpus can use
+// the host allocation directly, rather than copying it
+#define MANAGED_HOST_ALIGNMENT 4096
+#define MANAGED_SIZE_GRANULARITY 64
+
 namespace cocl {
+    class SvmFunctions {
+    public:
+        clSVMAllocFn alloc = 0;
+        clSVMFreeFn free = 0;
+        clEnqueueSVMMapFn map = 0;
+        clEnqueueSVMUnmapFn unmap = 0;
+    };
+
+    // returns false if the device doesnt do coarse-grained svm buffers, or we cant find the
+    // functions for it
+    static bool loadSvmFunctions(EasyCL *cl, SvmFunctions *fns) {
+        cl_bitfield capabilities = 0;
+        cl_int err = clGetDeviceInfo(cl->device, CL_DEVICE_SVM_CAPABILITIES, sizeof(capabilities), &capabilities, 0);
+        if(err != CL_SUCCESS || (capabilities & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER) == 0) {
+            return false;
+        }
+        fns->alloc = (clSVMAllocFn)getOpenCL20Function(cl->device, "clSVMAlloc");
+        fns->free = (clSVMFreeFn)getOpenCL20Function(cl->device, "clSVMFree");
+        fns->map = (clEnqueueSVMMapFn)getOpenCL20Function(cl->device, "clEnqueueSVMMap");
+        fns->unmap = (clEnqueueSVMUnmapFn)getOpenCL20Function(cl->device, "clEnqueueSVMUnmap");
+        return fns->alloc != 0 && fns->free != 0 && fns->map != 0 && fns->unmap != 0;
+    }
+
+    static char *alignedHostAlloc(size_t bytes) {
+        bytes = ((bytes + MANAGED_SIZE_GRANULARITY - 1) / MANAGED_SIZE_GRANULARITY) * MANAGED_SIZE_GRANULARITY;
+        #ifdef _WIN32
+        return (char *)_aligned_malloc(bytes, MANAGED_HOST_ALIGNMENT);
+        #else
+        void *ptr = 0;
+        if(posix_memalign(&ptr, MANAGED_HOST_ALIGNMENT, bytes) != 0) {
+            return 0;
+        }
+        return (char *)ptr;
+        #endif
+    }
+
+    static void alignedHostFree(char *ptr) {
+        #ifdef _WIN32
+        _aligned_free(ptr);
+        #else
+        free(ptr);
+        #endif
+    }
+
     // we should index these, but a set is ok-ish for now. maybe
 
     Memory::Memory(cl_mem clmem, size_t bytes) :
@@ -57,6 +131,117 @@ namespace cocl {
         v->getContext()->memories.insert(this);
     }
 
+    Memory::Memory(cl_mem clmem, size_t bytes, char *hostPtr, bool svm) :
+            clmem(clmem), bytes(bytes), managed(true), svm(svm), hostPtr(hostPtr) {
+        // the host pointer is the 'virtual' address; it is far away from the fake ones, which
+        // start at 1
+        ThreadVars *v = getThreadVars();
+        fakePos = (size_t)hostPtr;
+        v->getContext()->memoryByAllocPos[fakePos] = this;
+        v->getContext()->memories.insert(this);
+    }
+
+    Memory *Memory::newManagedAlloc(size_t bytes) {
+        ThreadVars *v = getThreadVars();
+        Context *context = v->getContext();
+        EasyCL *cl = context->getCl();
+        SvmFunctions svmFns;
+        bool svm = loadSvmFunctions(cl, &svmFns);
+        char *hostPtr = 0;
+        if(svm) {
+            hostPtr = (char *)svmFns.alloc(*cl->context, CL_MEM_READ_WRITE, bytes, 0);
+        } else {
+            hostPtr = alignedHostAlloc(bytes);
+        }
+        if(hostPtr == 0) {
+            cout << "failed to allocate " << bytes << " bytes of managed memory" << endl;
+            throw runtime_error("failed to allocate managed memory");
+        }
+        COCL_PRINT("newManagedAlloc bytes=" << bytes << " svm=" << svm << " hostPtr=" << (void *)hostPtr);
+        Memory *memory = 0;
+        {
+            ContextMutex contextMutex(context);
+            cl_int err;
+            // for svm pointers too, this wraps the existing allocation, rather than creating a new one
+            cl_mem clmem = clCreateBuffer(*cl->context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, bytes,
+                                                   hostPtr, &err);
+            EasyCL::checkError(err);
+            memory = new Memory(clmem, bytes, hostPtr, svm);
+        }
+        // the host only owns the memory whilst it is mapped
+        memory->migrateToHost(context->default_stream.get());
+        return memory;
+    }
+
+    void Memory::migrateToDevice(CoclStream *stream) {
+        if(!managed) {
+            return;
+        }
+        deviceStream = stream;
+        if(!hostOwned) {
+            return;
+        }
+        COCL_PRINT("migrateToDevice hostPtr=" << (void *)hostPtr << " stream=" << stream);
+        cl_int err;
+        if(svm) {
+            SvmFunctions svmFns;
+            loadSvmFunctions(getThreadVars()->getContext()->getCl(), &svmFns);
+            err = svmFns.unmap(stream->clqueue->queue, hostPtr,
+                stream->waitListSize(), stream->waitList(), stream->eventOut());
+        } else {
+            err = clEnqueueUnmapMemObject(stream->clqueue->queue, clmem, hostPtr,
+                stream->waitListSize(), stream->waitList(), stream->eventOut());
+        }
+        EasyCL::checkError(err);
+        stream->commandEnqueued();
+        hostOwned = false;
+    }
+
+    void Memory::migrateToHost(CoclStream *stream, bool blocking) {
+        if(!managed || hostOwned) {
+            return;
+        }
+        COCL_PRINT("migrateToHost hostPtr=" << (void *)hostPtr << " stream=" << stream << " blocking=" << blocking);
+        cl_int err;
+        cl_bool clBlocking = blocking ? CL_TRUE : CL_FALSE;
+        if(svm) {
+            SvmFunctions svmFns;
+            loadSvmFunctions(getThreadVars()->getContext()->getCl(), &svmFns);
+            err = svmFns.map(stream->clqueue->queue, clBlocking, CL_MAP_READ | CL_MAP_WRITE, hostPtr, bytes,
+                stream->waitListSize(), stream->waitList(), stream->eventOut());
+        } else {
+            // with CL_MEM_USE_HOST_PTR, the mapped pointer is always hostPtr itself
+            void *mapped = clEnqueueMapBuffer(stream->clqueue->queue, clmem, clBlocking, CL_MAP_READ | CL_MAP_WRITE,
+                0, bytes, stream->waitListSize(), stream->waitList(), stream->eventOut(), &err);
+            EasyCL::checkError(err);
+            if(mapped != hostPtr) {
+                cout << "mapped managed memory to " << mapped << " but expected " << (void *)hostPtr << endl;
+                throw runtime_error("mapped managed memory to unexpected address");
+            }
+        }
+        EasyCL::checkError(err);
+        stream->commandEnqueued();
+        hostOwned = true;
+        deviceStream = 0;
+    }
+
+    void migrateManagedMemoryToHost(Context *context, CoclStream *stream) {
+        std::vector<Memory *> toMigrate;
+        {
+            ContextMutex contextMutex(context);
+            for(auto it=context->memories.begin(), e=context->memories.end(); it != e; it++) {
+                Memory *memory = *it;
+                if(memory->managed && !memory->hostOwned && (stream == 0 || memory->deviceStream == stream)) {
+                    toMigrate.push_back(memory);
+                }
+            }
+        }
+        CoclStream *mapStream = stream != 0 ? stream : context->default_stream.get();
+        for(auto it=toMigrate.begin(); it != toMigrate.end(); it++) {
+            (*it)->migrateToHost(mapStream);
+        }
+    }
+
     Memory *Memory::newDeviceAlloc(size_t bytes) {
         ThreadVars *v = getThreadVars();
         Context *context = v->getContext();
@@ -74,8 +259,25 @@ namespace cocl {
         ThreadVars *v = getThreadVars();
         v->getContext()->memoryByAllocPos.erase(fakePos);
         v->getContext()->memories.erase(this);
+        if(managed) {
+            // give it back to the device, and wait, so nothing is using hostPtr once we free it
+            CoclStream *stream = v->getContext()->default_stream.get();
+            migrateToDevice(stream);
+            cl_int err = clFinish(stream->clqueue->queue);
+            EasyCL::checkError(err);
+        }
         cl_int err = clReleaseMemObject(clmem);
         v->getContext()->getCl()->checkError(err);
+        if(managed) {
+            if(svm) {
+                SvmFunctions svmFns;
+                EasyCL *cl = v->getContext()->getCl();
+                loadSvmFunctions(cl, &svmFns);
+                svmFns.free(*cl->context, hostPtr);
+            } else {
+                alignedHostFree(hostPtr);
+            }
+        }
         // TODO: should remove from map and set too
     }
 
@@ -110,6 +312,29 @@ namespace cocl {
     size_t Memory::getOffset(const char *passedInAsCharStar) {
         return (size_t)passedInAsCharStar - fakePos;
     }
+
+    // for memory that a command in stream is about to use
+    static Memory *findMemoryForDevice(const char *passedInAsCharStar, CoclStream *stream) {
+        Memory *memory = findMemory(passedInAsCharStar);
+        if(memory != 0) {
+            memory->migrateToDevice(stream);
+        }
+        return memory;
+    }
+
+    // synchronous calls hand managed memory back to the host once they are done with it, so the host can
+    // read or write it straight away, as it can in cuda
+    static void returnToHost(Memory *memory, CoclStream *stream) {
+        if(memory != 0) {
+            memory->migrateToHost(stream);
+        }
+    }
+
+    static std::atomic<long long> constantSymbolsVersion(0);
+
+    long long getConstantSymbolsVersion() {
+        return constantSymbolsVersion;
+    }
 }
 
 size_t cuMemHostAlloc(void **pHostPointer, unsigned int bytes, int type) {
@@ -135,41 +360,40 @@ size_t cuMemGetInfo(size_t *free, size_t *total) {
 }
 
 size_t cudaMemcpyAsync (void *dst, const void *src, size_t count, size_t cudaMemcpyKind, char *_queue) {
+    flushFusedLaunches();
     ThreadVars *v = getThreadVars();
-    CoclStream *coclStream = (CoclStream *)_queue;
+    CoclStream *coclStream = resolveStream(_queue);
     COCL_PRINT("cudaMemcpyAsync kind=" << cudaMemcpyKind << " ctx=" << (void *)v->currentContext
        << " src=" << src << " dst=" << dst << " count=" << count);
 
-    if(coclStream == 0) {
-        coclStream = v->currentContext->default_stream.get();
-    }
+    syncWithLegacyStream(coclStream);
     CLQueue *queue = coclStream->clqueue;
     cl_int err;
     if(cudaMemcpyKind == cudaMemcpyDeviceToHost) {
-        Memory *srcMemory = findMemory((const char *)src);
+        Memory *srcMemory = findMemoryForDevice((const char *)src, coclStream);
         if(srcMemory == 0) {
             cout << "coudlnt find memory for src " << (const void *)src << endl;
             throw runtime_error("couldnt find memory for src");
         }
         size_t src_offset = srcMemory->getOffset((const char *)src);
         err = clEnqueueReadBuffer(queue->queue, srcMemory->clmem, CL_FALSE, src_offset,
-                                         count, dst, 0, NULL, NULL);
+                                         count, dst, coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
         EasyCL::checkError(err);
     } else if(cudaMemcpyKind == cudaMemcpyHostToDevice) {
-        Memory *dstMemory = findMemory((char *)dst);
+        Memory *dstMemory = findMemoryForDevice((char *)dst, coclStream);
         if(dstMemory == 0) {
             cout << "coudlnt find memory for dst " << (void *)dst << endl;
             throw runtime_error("couldnt find memory for dst");
         }
         size_t dst_offset = dstMemory->getOffset((char *)dst);
         err = clEnqueueWriteBuffer(queue->queue, dstMemory->clmem, CL_FALSE, dst_offset,
-                                          count, src, 0, NULL, NULL);
+                                          count, src, coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
         EasyCL::checkError(err);
     } else if(cudaMemcpyKind == cudaMemcpyDeviceToDevice) {
-        Memory *dstMemory = findMemory((char *)dst);
+        Memory *dstMemory = findMemoryForDevice((char *)dst, coclStream);
         size_t dst_offset = dstMemory->getOffset((char *)dst);
 
-        Memory *srcMemory = findMemory((const char *)src);
+        Memory *srcMemory = findMemoryForDevice((const char *)src, coclStream);
         size_t src_offset = srcMemory->getOffset((const char *)src);
         if(dstMemory == 0) {
             cout << "coudlnt find memory for dst " << (void *)dst << endl;
@@ -187,24 +411,26 @@ size_t cudaMemcpyAsync (void *dst, const void *src, size_t count, size_t cudaMem
             src_offset,
             dst_offset,
             count,
-            0,
-            0,
-            0);
+            coclStream->waitListSize(),
+            coclStream->waitList(),
+            coclStream->eventOut());
         EasyCL::checkError(err);
     } else {
         throw runtime_error("unhandled cudaMemcpyKind");
     }
+    coclStream->commandEnqueued();
 
     return 0;
 }
 
 size_t cudaMemsetAsync(void *location, int value, size_t count, char *_queue) {
+    flushFusedLaunches();
     COCL_PRINT("cudaMemsetAsync value=" << value << " count=" << count << " queue=" << (long)_queue);
 
     // this is not terribly async for now :-P
 
-    Memory *memory = findMemory((char *)location);
-    ThreadVars *v = getThreadVars();
+    CoclStream *stream = resolveStream(_queue);
+    Memory *memory = findMemoryForDevice((char *)location, stream);
     size_t offsetBytes = memory->getOffset((char *)location);
     // std::cout << "memory " << (long)memory << std::endl;
     // std::cout << " memory bytes " << memory->bytes << std::endl;
@@ -212,7 +438,8 @@ size_t cudaMemsetAsync(void *location, int value, size_t count, char *_queue) {
 
     cl_int err;
 
-    err = clFinish(v->currentContext->default_stream.get()->clqueue->queue);
+    syncWithLegacyStream(stream);
+    err = clFinish(stream->clqueue->queue);
     EasyCL::checkError(err);
     // std::cout << "clfinished the queue" << std::endl;
 
@@ -223,39 +450,50 @@ size_t cudaMemsetAsync(void *location, int value, size_t count, char *_queue) {
             fourbytes |= (value & 255);
         }
         int intCount = count >> 2;
+        stream->beginUntrackedCommand();
         myEnqueueFillBuffer(
-            v->currentContext->default_stream.get()->clqueue->queue,
+            stream->clqueue->queue,
             memory->clmem,
             fourbytes,
             offsetBytes, intCount);
+        stream->endUntrackedCommand();
     } else {
         cout << "memset should be multiple of 4 count" << std::endl;
         throw std::runtime_error("cudaMemsetAsync should have count multiple of 4");
     }
-    err = clFinish(v->currentContext->default_stream.get()->clqueue->queue);
+    err = clFinish(stream->clqueue->queue);
     EasyCL::checkError(err);
     // COCL_PRINT("finished cudaMemsetAsync");
     return 0;
 }
 
 size_t cuMemsetD8(CUdeviceptr location, unsigned char value, uint32_t count) {
+    flushFusedLaunches();
     COCL_PRINT("cuMemsetD8 redirected value " << value << " count=" << count);
-    // use default queue??
-    ThreadVars *v = getThreadVars();
-    Memory *memory = findMemory((char *)location);
+    CoclStream *stream = resolveStream(0);
+    Memory *memory = findMemoryForDevice((char *)location, stream);
     size_t offset = memory->getOffset((char *)location);
-    cl_int err = clEnqueueFillBuffer(v->currentContext->default_stream.get()->clqueue->queue, memory->clmem, &value, sizeof(unsigned char), offset, count * sizeof(unsigned char), 0, 0, 0);
+    syncWithLegacyStream(stream);
+    cl_int err = clEnqueueFillBuffer(stream->clqueue->queue, memory->clmem, &value, sizeof(unsigned char), offset, count * sizeof(unsigned char),
+        stream->waitListSize(), stream->waitList(), stream->eventOut());
     EasyCL::checkError(err);
+    stream->commandEnqueued();
+    returnToHost(memory, stream);
     return 0;
 }
 
 size_t cuMemsetD32(CUdeviceptr location, unsigned int value, uint32_t count) {
-    Memory *memory = findMemory((char *)location);
-    ThreadVars *v = getThreadVars();
+    flushFusedLaunches();
+    CoclStream *stream = resolveStream(0);
+    Memory *memory = findMemoryForDevice((char *)location, stream);
     size_t offset = memory->getOffset((char *)location);
     COCL_PRINT("cuMemsetD32 redirected value " << value << " count=" << count << " location=" << location << " memory=" << (void *)memory);
-    cl_int err = clEnqueueFillBuffer(v->currentContext->default_stream.get()->clqueue->queue, memory->clmem, &value, sizeof(int), offset, count * sizeof(int), 0, 0, 0);
+    syncWithLegacyStream(stream);
+    cl_int err = clEnqueueFillBuffer(stream->clqueue->queue, memory->clmem, &value, sizeof(int), offset, count * sizeof(int),
+        stream->waitListSize(), stream->waitList(), stream->eventOut());
     EasyCL::checkError(err);
+    stream->commandEnqueued();
+    returnToHost(memory, stream);
     return 0;
 }
 
@@ -269,55 +507,65 @@ size_t cuDeviceTotalMem(size_t *value, CUdeviceptr device) {
 }
 
 size_t cudaMemcpy(void *dst, const void *src, size_t bytes, cudaMemcpyKind kind) {
+    flushFusedLaunches();
     COCL_PRINT("cudamempcy using opencl cudaMemcpyKind " << kind << " count=" << bytes);
     cl_int err;
-    ThreadVars *v = getThreadVars();
+    CoclStream *stream = resolveStream(0);
+    Memory *srcMemory = 0;
+    Memory *dstMemory = 0;
+    syncWithLegacyStream(stream);
     if(kind == cudaMemcpyDeviceToHost) {
-        Memory *srcMemory = findMemory((const char *)src);
+        srcMemory = findMemoryForDevice((const char *)src, stream);
         size_t offset = srcMemory->getOffset((const char *)src);
-        err = clEnqueueReadBuffer(v->currentContext->default_stream.get()->clqueue->queue, srcMemory->clmem, CL_TRUE, offset,
-                                         bytes, dst, 0, NULL, NULL);
+        err = clEnqueueReadBuffer(stream->clqueue->queue, srcMemory->clmem, CL_TRUE, offset,
+                                         bytes, dst, stream->waitListSize(), stream->waitList(), stream->eventOut());
         EasyCL::checkError(err);
     } else if(kind == cudaMemcpyHostToDevice) {
-        Memory *dstMemory = findMemory((char *)dst);
+        dstMemory = findMemoryForDevice((char *)dst, stream);
         size_t offset = dstMemory->getOffset((char *)dst);
-        err = clEnqueueWriteBuffer(v->currentContext->default_stream.get()->clqueue->queue, dstMemory->clmem, CL_TRUE, offset,
-                                          bytes, src, 0, NULL, NULL);
+        err = clEnqueueWriteBuffer(stream->clqueue->queue, dstMemory->clmem, CL_TRUE, offset,
+                                          bytes, src, stream->waitListSize(), stream->waitList(), stream->eventOut());
         EasyCL::checkError(err);
     } else if(kind == cudaMemcpyDeviceToDevice) {
-        Memory *srcMemory = findMemory((const char *)src);
+        srcMemory = findMemoryForDevice((const char *)src, stream);
         size_t src_offset = srcMemory->getOffset((const char *)src);
-        Memory *dstMemory = findMemory((char *)dst);
+        dstMemory = findMemoryForDevice((char *)dst, stream);
         size_t dst_offset = dstMemory->getOffset((char *)dst);
         err = clEnqueueCopyBuffer(
-            v->currentContext->default_stream.get()->clqueue->queue,
+            stream->clqueue->queue,
             srcMemory->clmem,
             dstMemory->clmem,
             src_offset,
             dst_offset,
             bytes,
-            0,
-            0,
-            0);
+            stream->waitListSize(),
+            stream->waitList(),
+            stream->eventOut());
         EasyCL::checkError(err);
     } else {
         cout << "cudaMemcpy cudaMemcpyKind using opencl " << kind << endl;
         throw runtime_error("unhandled cudaMemcpyKind");
     }
+    stream->commandEnqueued();
+    returnToHost(srcMemory, stream);
+    returnToHost(dstMemory, stream);
     return 0;
 }
 
 size_t cuMemcpyHtoDAsync(CUdeviceptr dst, const void *src, size_t bytes, char *_queue) {
-    CoclStream *coclStream = (CoclStream *)_queue;
+    flushFusedLaunches();
+    CoclStream *coclStream = resolveStream(_queue);
+    syncWithLegacyStream(coclStream);
     CLQueue *queue = coclStream->clqueue;
     COCL_PRINT("cuMemcpyHtoDAsync dst=" << dst << " src=" << src << " bytes=" << bytes);
-    Memory *dstMemory = findMemory((char *)dst);
+    Memory *dstMemory = findMemoryForDevice((char *)dst, coclStream);
     size_t offset = dstMemory->getOffset((char *)dst);
     cl_int err;
 
     err = clEnqueueWriteBuffer(queue->queue, dstMemory->clmem, CL_TRUE, offset,
-                                      bytes, src, 0, NULL, NULL);
+                                      bytes, src, coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
     EasyCL::checkError(err);
+    coclStream->commandEnqueued();
 
     err = clFinish(queue->queue);
     EasyCL::checkError(err);
@@ -326,10 +574,12 @@ size_t cuMemcpyHtoDAsync(CUdeviceptr dst, const void *src, size_t bytes, char *_
 }
 
 size_t  cuMemcpyDtoHAsync(void *dst, CUdeviceptr src, size_t bytes, char *_queue) {
-    CoclStream *coclStream = (CoclStream *)_queue;
+    flushFusedLaunches();
+    CoclStream *coclStream = resolveStream(_queue);
+    syncWithLegacyStream(coclStream);
     CLQueue *queue = coclStream->clqueue;
     COCL_PRINT("cuMemcpyDtoHAsync queue=" << (void *)queue << " dst=" << dst << " src=" << src << " bytes=" << bytes);
-    Memory *srcMemory = findMemory((char *)src);
+    Memory *srcMemory = findMemoryForDevice((char *)src, coclStream);
     size_t offset = srcMemory->getOffset((char *)src);
 
     // adding this because otherwise seems I need to call synchronize, on intel hd beignet, before
@@ -347,8 +597,9 @@ size_t  cuMemcpyDtoHAsync(void *dst, CUdeviceptr src, size_t bytes, char *_queue
     EasyCL::checkError(err);
 
     err = clEnqueueReadBuffer(queue->queue, srcMemory->clmem, CL_TRUE, offset,
-                                     bytes, dst, 0, NULL, NULL);
+                                     bytes, dst, coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
     EasyCL::checkError(err);
+    coclStream->commandEnqueued();
 
     COCL_PRINT("   cuMemcpyDtoHAsync ...enqueued read buffer")
     EasyCL::checkError(err);
@@ -377,6 +628,31 @@ size_t  cuMemcpyDtoH(void *host_dst, CUdeviceptr gpu_src, size_t size) {
     return 0;
 }
 
+// The device cant write __constant__ variables, so the hostside copy of each one is always up to date.  We
+// read and write that, and kernelGo copies it to the device before any kernel that uses it.
+size_t cudaMemcpyToSymbol(const void *symbol, const void *src, size_t count, size_t offset, cudaMemcpyKind kind) {
+    COCL_PRINT("cudaMemcpyToSymbol count=" << count << " offset=" << offset);
+    char *dst = (char *)symbol + offset;
+    if(kind == cudaMemcpyDeviceToDevice) {
+        cudaMemcpy(dst, src, count, cudaMemcpyDeviceToHost);
+    } else {
+        memcpy(dst, src, count);
+    }
+    constantSymbolsVersion++;
+    return 0;
+}
+
+size_t cudaMemcpyFromSymbol(void *dst, const void *symbol, size_t count, size_t offset, cudaMemcpyKind kind) {
+    COCL_PRINT("cudaMemcpyFromSymbol count=" << count << " offset=" << offset);
+    const char *src = (const char *)symbol + offset;
+    if(kind == cudaMemcpyDeviceToDevice) {
+        cudaMemcpy(dst, src, count, cudaMemcpyHostToDevice);
+    } else {
+        memcpy(dst, src, count);
+    }
+    return 0;
+}
+
 size_t cudaMalloc(void **_pMemory, size_t N) {
     if(N==0){
         (*_pMemory)=0;
@@ -397,6 +673,7 @@ size_t cudaMalloc(float **pMemory, size_t N) {
 }
 
 size_t cudaFree(void *_memory) {
+    flushFusedLaunches();
     if(_memory==0){
         return 0;
     }
@@ -409,3 +686,47 @@ size_t cudaFree(void *_memory) {
 size_t cuMemFree(CUdeviceptr memory) {
     return cudaFree((void *)memory);
 }
+
+size_t cudaMallocManaged(void **_pMemory, size_t bytes, unsigned int flags) {
+    // all managed memory behaves as cudaMemAttachGlobal: any stream can take it over
+    if(bytes == 0) {
+        (*_pMemory) = 0;
+        return 0;
+    }
+    Memory *memory = Memory::newManagedAlloc(bytes);
+    COCL_PRINT("cudaMallocManaged size " << bytes << " flags=" << flags << " memory=" << (void *)memory
+        << " hostPtr=" << (void *)memory->hostPtr << " svm=" << memory->svm);
+    *_pMemory = (void *)memory->hostPtr;
+    return 0;
+}
+
+size_t cuMemAllocManaged(CUdeviceptr *_pMemory, size_t bytes, unsigned int flags) {
+    return cudaMallocManaged((void **)_pMemory, bytes, flags);
+}
+
+size_t cudaMemPrefetchAsync(const void *devPtr, size_t count, int dstDevice, char *_queue) {
+    flushFusedLaunches();
+    // we migrate whole allocations, whatever count is
+    CoclStream *stream = resolveStream(_queue);
+    Memory *memory = findMemory((const char *)devPtr);
+    COCL_PRINT("cudaMemPrefetchAsync devPtr=" << devPtr << " count=" << count << " dstDevice=" << dstDevice
+        << " memory=" << (void *)memory);
+    if(memory == 0 || !memory->managed) {
+        cout << "cudaMemPrefetchAsync: " << devPtr << " is not managed memory" << endl;
+        throw runtime_error("cudaMemPrefetchAsync: not managed memory");
+    }
+    syncWithLegacyStream(stream);
+    if(dstDevice == cudaCpuDeviceId) {
+        // host can use it once the stream has got this far
+        memory->migrateToHost(stream, false);
+    } else {
+        memory->migrateToDevice(stream);
+    }
+    cl_int err = clFlush(stream->clqueue->queue);
+    EasyCL::checkError(err);
+    return 0;
+}
+
+size_t cuMemPrefetchAsync(CUdeviceptr devPtr, size_t count, int dstDevice, char *_queue) {
+    return cudaMemPrefetchAsync((const void *)devPtr, count, dstDevice, _queue);
+}
@@ -17,6 +17,10 @@
 #include "cocl/cocl_events.h"
 #include "cocl/hostside_opencl_funcs.h"
 #include "cocl/cocl_context.h"
+#include "cocl/cocl_memory.h"
+#include "cocl/cocl_error.h"
+#include "cocl/cocl_pool.h"
+#include "cocl/cocl_cl20.h"
 
 #include "EasyCL/EasyCL.h"
 
@@ -25,6 +29,9 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
 
 
 using namespace std;
@@ -36,38 +43,353 @@ using namespace easycl;
 // #define COCL_PRINT(stuff) \
 //     stuff ;
 
+#define OUT_OF_ORDER_QUEUES_ENV_VAR "COCL_OUT_OF_ORDER_QUEUES"
+#define DEFAULT_STREAM_ENV_VAR "COCL_DEFAULT_STREAM"
+
+// from cl_khr_priority_hints, in case the opencl headers we build against are too old to have them
+#ifndef CL_QUEUE_PRIORITY_KHR
+#define CL_QUEUE_PRIORITY_KHR 0x1096
+#define CL_QUEUE_PRIORITY_HIGH_KHR (1<<0)
+#define CL_QUEUE_PRIORITY_MED_KHR (1<<1)
+#define CL_QUEUE_PRIORITY_LOW_KHR (1<<2)
+#endif
+
+// cuda priorities are "lower number is higher priority", and the default, 0, is the lowest
+// we map 0 to no hint at all (ie medium, from the point of view of the driver), and -1 to high
+#define COCL_LEAST_STREAM_PRIORITY 0
+#define COCL_GREATEST_STREAM_PRIORITY -1
+
+typedef cl_command_queue (CL_API_CALL *clCreateCommandQueueWithPropertiesFn)(
+    cl_context context, cl_device_id device, const cl_ulong *properties, cl_int *errcode_ret);
+
 namespace cocl {
+    // set by coclSetPerThreadDefaultStream, which may run during static initialization of the client
+    static bool perThreadDefaultStream = false;
+
+    static bool defaultStreamIsPerThread() {
+        static bool fromEnv = getenv(DEFAULT_STREAM_ENV_VAR) != 0 &&
+            string(getenv(DEFAULT_STREAM_ENV_VAR)) == "per-thread";
+        return perThreadDefaultStream || fromEnv;
+    }
+
+    static bool useOutOfOrderQueues() {
+        const char *value = getenv(OUT_OF_ORDER_QUEUES_ENV_VAR);
+        return value != 0 && string(value) == "1";
+    }
+
+    bool deviceSupportsPriorityHints(EasyCL *cl) {
+        string extensions = getDeviceInfoString(cl->device, CL_DEVICE_EXTENSIONS);
+        return extensions.find("cl_khr_priority_hints") != string::npos;
+    }
+
+    static CoclPool<CoclCallbackInfo> callbackInfoPool("host callbacks");
+
     void coclCallback(cl_event event, cl_int status, void *userdata) {
+        // this runs on the opencl driver's thread, so we just hand over to the executor
         // cout << "coclCallback running " << endl;
-        EasyCL::checkError(status);
         CoclCallbackInfo *info = (CoclCallbackInfo *)userdata;
         clReleaseEvent(event);
-        info->callback(info->_queue, 0, info->userdata);
-        delete info;
+        info->status = status;
+        info->executor->enqueue(info);
+    }
+
+    CallbackExecutor::CallbackExecutor(Context *context) :
+            context(context), pending(0), stopping(false) {
+        thread = std::thread(&CallbackExecutor::run, this);
+    }
+    CallbackExecutor::~CallbackExecutor() {
+        {
+            std::lock_guard< std::mutex > guard(wakeMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_one();
+        thread.join();
+    }
+    void CallbackExecutor::enqueue(CoclCallbackInfo *info) {
+        CoclCallbackInfo *oldHead = pending.load();
+        do {
+            info->next = oldHead;
+        } while(!pending.compare_exchange_weak(oldHead, info));
+        {
+            // makes sure the executor is either before its check of pending, or already waiting
+            std::lock_guard< std::mutex > guard(wakeMutex);
+        }
+        wakeCondition.notify_one();
+    }
+    void CallbackExecutor::run() {
+        // so that callbacks calling back into Coriander see the right context
+        ThreadVars *v = getThreadVars();
+        v->currentContext = context;
+        v->currentGpuOrdinal = context->gpuOrdinal;
+        std::vector<CoclCallbackInfo *> batch;
+        while(true) {
+            CoclCallbackInfo *info = pending.exchange(0);
+            if(info == 0) {
+                std::unique_lock< std::mutex > lock(wakeMutex);
+                wakeCondition.wait(lock, [this] { return pending.load() != 0 || stopping.load(); });
+                if(pending.load() == 0) {
+                    return;  // stopping, and nothing left to run
+                }
+                continue;
+            }
+            // the stack is newest first
+            batch.clear();
+            for(; info != 0; info = info->next) {
+                batch.push_back(info);
+            }
+            std::reverse(batch.begin(), batch.end());
+            for(auto it=batch.begin(); it != batch.end(); it++) {
+                execute(*it);
+            }
+        }
+    }
+    void CallbackExecutor::execute(CoclCallbackInfo *info) {
+        try {
+            if(info->callback != 0) {
+                info->callback(info->_queue, info->status == CL_COMPLETE ? cudaSuccess : CUDA_ERROR_UNKNOWN, info->userdata);
+            } else {
+                info->hostFunc(info->userdata);
+            }
+        } catch(runtime_error &e) {
+            cout << "host callback threw exception " << e.what() << endl;
+        }
+        // lets the stream carry on
+        cl_int err = clSetUserEventStatus(info->hostDone, CL_COMPLETE);
+        EasyCL::checkError(err);
+        err = clReleaseEvent(info->hostDone);
+        EasyCL::checkError(err);
+        info->hostDone = 0;
+        callbackInfoPool.put(info);
     }
 
-    CoclStream::CoclStream(EasyCL *cl) {
-        this->clqueue = cl->newQueue();
+    CoclStream::CoclStream(EasyCL *cl, unsigned int flags, int priority) :
+            flags(flags), priority(priority) {
+        outOfOrder = useOutOfOrderQueues();
+        if(priority > COCL_LEAST_STREAM_PRIORITY) {
+            this->priority = COCL_LEAST_STREAM_PRIORITY;
+        } else if(priority < COCL_GREATEST_STREAM_PRIORITY) {
+            this->priority = COCL_GREATEST_STREAM_PRIORITY;
+        }
+        bool highPriority = this->priority != COCL_LEAST_STREAM_PRIORITY && deviceSupportsPriorityHints(cl);
+        if(!outOfOrder && !highPriority) {
+            this->clqueue = cl->newQueue();
+            return;
+        }
+        COCL_PRINT(cout << "CoclStream() outOfOrder=" << outOfOrder << " highPriority=" << highPriority << endl);
+        cl_int err;
+        cl_command_queue queue = 0;
+        if(highPriority) {
+            // core OpenCL 2.0, not an extension function
+            clCreateCommandQueueWithPropertiesFn createWithProperties = (clCreateCommandQueueWithPropertiesFn)
+                getOpenCL20Function(cl->device, "clCreateCommandQueueWithProperties");
+            if(createWithProperties != 0) {
+                cl_ulong properties[] = {
+                    CL_QUEUE_PROPERTIES, (cl_ulong)(outOfOrder ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0),
+                    CL_QUEUE_PRIORITY_KHR, CL_QUEUE_PRIORITY_HIGH_KHR,
+                    0
+                };
+                queue = createWithProperties(*cl->context, cl->device, properties, &err);
+                EasyCL::checkError(err);
+            } else {
+                cout << "Warning: device reports cl_khr_priority_hints, but isnt OpenCL 2.0, or clCreateCommandQueueWithProperties not available => ignoring stream priority" << endl;
+            }
+        }
+        if(queue == 0) {
+            queue = clCreateCommandQueue(*cl->context, cl->device,
+                outOfOrder ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0, &err);
+            EasyCL::checkError(err);
+        }
+        this->clqueue = new CLQueue(cl, queue);
     }
     CoclStream::~CoclStream() {
+        if(lastEvent != 0) {
+            clReleaseEvent(lastEvent);
+        }
+        if(hostEvent != 0) {
+            clReleaseEvent(hostEvent);
+        }
         delete clqueue;
     }
+    cl_uint CoclStream::waitListSize() {
+        return (lastEvent != 0 ? 1 : 0) + (hostEvent != 0 ? 1 : 0);
+    }
+    const cl_event *CoclStream::waitList() {
+        int i = 0;
+        if(lastEvent != 0) {
+            waitListStorage[i++] = lastEvent;
+        }
+        if(hostEvent != 0) {
+            waitListStorage[i++] = hostEvent;
+        }
+        return i > 0 ? waitListStorage : 0;
+    }
+    cl_event *CoclStream::eventOut() {
+        return outOfOrder ? &pendingEvent : 0;
+    }
+    void CoclStream::commandEnqueued() {
+        cl_int err;
+        if(hostEvent != 0) {
+            // the command just enqueued waits on it, and everything after waits on that command
+            err = clReleaseEvent(hostEvent);
+            EasyCL::checkError(err);
+            hostEvent = 0;
+        }
+        if(pendingEvent == 0) {
+            return;
+        }
+        if(lastEvent != 0) {
+            err = clReleaseEvent(lastEvent);
+            EasyCL::checkError(err);
+        }
+        lastEvent = pendingEvent;
+        pendingEvent = 0;
+    }
+    void CoclStream::beginUntrackedCommand() {
+        if(waitListSize() == 0) {
+            return;
+        }
+        // a barrier holds back everything enqueued after it, which is what we want, since we
+        // cant give the command itself a wait list
+        cl_int err = clEnqueueBarrierWithWaitList(clqueue->queue, waitListSize(), waitList(), eventOut());
+        EasyCL::checkError(err);
+        commandEnqueued();
+    }
+    void CoclStream::endUntrackedCommand() {
+        if(!outOfOrder) {
+            return;
+        }
+        // an empty wait list means: wait for everything enqueued so far
+        cl_int err = clEnqueueMarkerWithWaitList(clqueue->queue, 0, 0, eventOut());
+        EasyCL::checkError(err);
+        commandEnqueued();
+    }
+    cl_event CoclStream::enqueueMarker() {
+        cl_event event;
+        cl_int err = clEnqueueMarkerWithWaitList(clqueue->queue, 0, 0, &event);
+        EasyCL::checkError(err);
+        return event;
+    }
+    cl_event CoclStream::retainLastCommandEvent() {
+        cl_int err;
+        if(lastEvent != 0 && hostEvent == 0) {
+            err = clRetainEvent(lastEvent);
+            EasyCL::checkError(err);
+            return lastEvent;
+        }
+        // a marker doesnt hold back later commands, unlike a barrier
+        cl_event event;
+        err = clEnqueueMarkerWithWaitList(clqueue->queue, waitListSize(), waitList(), &event);
+        EasyCL::checkError(err);
+        if(outOfOrder) {
+            err = clRetainEvent(event);
+            EasyCL::checkError(err);
+            pendingEvent = event;
+        }
+        commandEnqueued();
+        return event;
+    }
+    void CoclStream::waitForHostEvent(cl_event event) {
+        if(hostEvent != 0) {
+            // two host events in a row, with no command in between, to carry the first one
+            waitForEvents(std::vector<cl_event>(1, hostEvent));
+        }
+        cl_int err = clRetainEvent(event);
+        EasyCL::checkError(err);
+        hostEvent = event;
+    }
+    void CoclStream::finish() {
+        cl_int err = clFinish(clqueue->queue);
+        EasyCL::checkError(err);
+        if(hostEvent != 0) {
+            err = clWaitForEvents(1, &hostEvent);
+            EasyCL::checkError(err);
+        }
+    }
+    void CoclStream::waitForEvents(const std::vector<cl_event> &events) {
+        if(events.size() == 0) {
+            return;
+        }
+        // on an out-of-order queue, we also need to keep waiting on whatever this stream
+        // did previously
+        std::vector<cl_event> waitEvents(events);
+        const cl_event *ourWaitList = waitList();
+        for(cl_uint i = 0; i < waitListSize(); i++) {
+            waitEvents.push_back(ourWaitList[i]);
+        }
+        cl_int err = clEnqueueBarrierWithWaitList(clqueue->queue, waitEvents.size(), &waitEvents[0], eventOut());
+        EasyCL::checkError(err);
+        commandEnqueued();
+    }
+
+    CoclStream *resolveStream(char *_stream) {
+        ThreadVars *v = getThreadVars();
+        if(_stream == cudaStreamLegacy) {
+            return v->getContext()->default_stream.get();
+        }
+        if(_stream == cudaStreamPerThread || (_stream == 0 && defaultStreamIsPerThread())) {
+            return v->getPerThreadStream();
+        }
+        if(_stream == 0) {
+            return v->getContext()->default_stream.get();
+        }
+        return (CoclStream *)_stream;
+    }
+
+    void syncWithLegacyStream(CoclStream *stream) {
+        Context *context = stream->context != 0 ? stream->context : getThreadVars()->getContext();
+        CoclStream *legacyStream = context->default_stream.get();
+        std::lock_guard< std::mutex > guard(context->streamsMutex);
+        if(stream == legacyStream) {
+            std::vector<cl_event> events;
+            for(auto it=context->streams.begin(); it != context->streams.end(); it++) {
+                CoclStream *other = *it;
+                if((other->flags & cudaStreamNonBlocking) != 0) {
+                    continue;
+                }
+                if(other->numCommands == other->commandsSeenByLegacy) {
+                    continue;
+                }
+                events.push_back(other->enqueueMarker());
+                other->commandsSeenByLegacy = other->numCommands;
+            }
+            COCL_PRINT(cout << "syncWithLegacyStream legacy stream waits on " << events.size() << " streams" << endl);
+            legacyStream->waitForEvents(events);
+            for(auto it=events.begin(); it != events.end(); it++) {
+                cl_int err = clReleaseEvent(*it);
+                EasyCL::checkError(err);
+            }
+        } else if((stream->flags & cudaStreamNonBlocking) == 0 && stream->legacyCommandsSeen != legacyStream->numCommands) {
+            COCL_PRINT(cout << "syncWithLegacyStream stream " << stream << " waits on legacy stream" << endl);
+            std::vector<cl_event> events;
+            events.push_back(legacyStream->enqueueMarker());
+            stream->waitForEvents(events);
+            cl_int err = clReleaseEvent(events[0]);
+            EasyCL::checkError(err);
+            stream->legacyCommandsSeen = legacyStream->numCommands;
+        }
+        stream->numCommands++;
+    }
+}
+
+size_t coclSetPerThreadDefaultStream(int enabled) {
+    COCL_PRINT(cout << "coclSetPerThreadDefaultStream enabled=" << enabled << endl);
+    cocl::perThreadDefaultStream = enabled != 0;
+    return 0;
 }
 
 size_t cudaStreamSynchronize(char *_queue) {
-    CoclStream *stream = (CoclStream *)_queue;
+    flushFusedLaunches();
+    CoclStream *stream = resolveStream(_queue);
     ThreadVars *v = getThreadVars();
     EasyCL *cl = v->getContext()->getCl();
-    if(stream == 0) {
-        stream = v->currentContext->default_stream.get();
-    }
     CLQueue *queue = stream->clqueue;
     COCL_PRINT(cout << "cudaStreamSynchronize queue=" << queue << endl);
     if(queue == 0) {
         cl->finish();
     } else {
-        clFinish(queue->queue);
+        stream->finish();
     }
+    migrateManagedMemoryToHost(v->getContext(), stream);
 
     return 0;
 }
@@ -76,21 +398,85 @@ size_t cuStreamSynchronize(char *_queue) {
     return cudaStreamSynchronize(_queue);
 }
 
-size_t cuStreamCreate(char **_pstream, unsigned int flags) {
+size_t cuStreamCreateWithPriority(char **_pstream, unsigned int flags, int priority) {
     CoclStream **pstream = (CoclStream**)_pstream;
     ThreadVars *v = getThreadVars();
     EasyCL *cl = v->getContext()->getCl();
-    CoclStream *coclStream = new CoclStream(cl);
+    CoclStream *coclStream = new CoclStream(cl, flags, priority);
+    COCL_PRINT(cout << "cuStreamCreateWithPriority flags=" << flags << " priority=" << coclStream->priority << endl);
+    Context *context = v->getContext();
+    coclStream->context = context;
+    {
+        std::lock_guard< std::mutex > guard(context->streamsMutex);
+        context->streams.insert(coclStream);
+    }
     *pstream = coclStream;
     return 0;
 }
 
+size_t cudaStreamCreateWithPriority(char **_pstream, unsigned int flags, int priority) {
+    return cuStreamCreateWithPriority(_pstream, flags, priority);
+}
+
+size_t cuStreamCreate(char **_pstream, unsigned int flags) {
+    return cuStreamCreateWithPriority(_pstream, flags, 0);
+}
+
+size_t cudaStreamCreateWithFlags(char **_pstream, unsigned int flags) {
+    return cuStreamCreateWithPriority(_pstream, flags, 0);
+}
+
 size_t cudaStreamCreate(char **_pstream) {
-    return cuStreamCreate(_pstream, 0);
+    return cuStreamCreateWithPriority(_pstream, cudaStreamDefault, 0);
+}
+
+size_t cuStreamGetFlags(char *_queue, unsigned int *flags) {
+    CoclStream *stream = resolveStream(_queue);
+    *flags = stream->flags;
+    return 0;
+}
+
+size_t cudaStreamGetFlags(char *_queue, unsigned int *flags) {
+    return cuStreamGetFlags(_queue, flags);
+}
+
+size_t cuStreamGetPriority(char *_queue, int *priority) {
+    CoclStream *stream = resolveStream(_queue);
+    *priority = stream->priority;
+    return 0;
+}
+
+size_t cudaStreamGetPriority(char *_queue, int *priority) {
+    return cuStreamGetPriority(_queue, priority);
+}
+
+size_t cuCtxGetStreamPriorityRange(int *leastPriority, int *greatestPriority) {
+    // same as cuda does for devices without priority support: report a range of [0, 0]
+    EasyCL *cl = getThreadVars()->getContext()->getCl();
+    bool supported = deviceSupportsPriorityHints(cl);
+    if(leastPriority != 0) {
+        *leastPriority = COCL_LEAST_STREAM_PRIORITY;
+    }
+    if(greatestPriority != 0) {
+        *greatestPriority = supported ? COCL_GREATEST_STREAM_PRIORITY : COCL_LEAST_STREAM_PRIORITY;
+    }
+    return 0;
+}
+
+size_t cudaDeviceGetStreamPriorityRange(int *leastPriority, int *greatestPriority) {
+    return cuCtxGetStreamPriorityRange(leastPriority, greatestPriority);
 }
 
 size_t cuStreamDestroy_v2(char *_queue) {
+    flushFusedLaunches();
     CoclStream *stream = (CoclStream *)_queue;
+    if(stream->context != 0) {
+        // managed memory mustnt keep pointing at this stream
+        stream->finish();
+        migrateManagedMemoryToHost(stream->context, stream);
+        std::lock_guard< std::mutex > guard(stream->context->streamsMutex);
+        stream->context->streams.erase(stream);
+    }
     delete stream;
     return 0;
 }
@@ -107,23 +493,50 @@ size_t cuStreamQuery(char *_queue) {
     return cuStreamSynchronize(_queue);
 }
 
+namespace cocl {
+    // the callback runs once everything queued so far in the stream has finished, and nothing
+    // queued afterwards runs until the callback has returned
+    static void addHostCallback(CoclStream *stream, CoclCallbackInfo *info) {
+        Context *context = stream->context != 0 ? stream->context : getThreadVars()->getContext();
+        cl_int err;
+        info->executor = context->getCallbackExecutor();
+        info->hostDone = clCreateUserEvent(*context->getCl()->context, &err);
+        EasyCL::checkError(err);
+        cl_event event = stream->retainLastCommandEvent();
+        stream->waitForHostEvent(info->hostDone);
+        err = clSetEventCallback(event, CL_COMPLETE, cocl::coclCallback, info);
+        EasyCL::checkError(err);
+        err = clFlush(stream->clqueue->queue);
+        EasyCL::checkError(err);
+    }
+}
+
 size_t cudaStreamAddCallback(char *_queue, cudacallbacktype callback, void *userdata, int flags) {
-    CoclStream *stream = (CoclStream *)_queue;
-    CLQueue *queue = stream->clqueue;
-    // we need to queue an event, and attach the callback to that;
-    cl_int err;
-    cl_event event;
-    err= clEnqueueBarrierWithWaitList(queue->queue,
-        0,
-        0,
-        &event
-        );
-    EasyCL::checkError(err);
-    CoclCallbackInfo *info = new CoclCallbackInfo();
+    flushFusedLaunches();
+    CoclStream *stream = resolveStream(_queue);
+    COCL_PRINT(cout << "cudaStreamAddCallback stream=" << stream << endl);
+    CoclCallbackInfo *info = callbackInfoPool.get();
     info->callback = callback;
+    info->hostFunc = 0;
     info->userdata = userdata;
     info->_queue = _queue;
-    err = clSetEventCallback(event, CL_COMPLETE, cocl::coclCallback, info);
-    EasyCL::checkError(err);
+    addHostCallback(stream, info);
     return 0;
 }
+
+size_t cudaLaunchHostFunc(char *_queue, cudaHostFn_t fn, void *userdata) {
+    flushFusedLaunches();
+    CoclStream *stream = resolveStream(_queue);
+    COCL_PRINT(cout << "cudaLaunchHostFunc stream=" << stream << endl);
+    CoclCallbackInfo *info = callbackInfoPool.get();
+    info->callback = 0;
+    info->hostFunc = fn;
+    info->userdata = userdata;
+    info->_queue = _queue;
+    addHostCallback(stream, info);
+    return 0;
+}
+
+size_t cuLaunchHostFunc(char *_queue, cudaHostFn_t fn, void *userdata) {
+    return cudaLaunchHostFunc(_queue, fn, userdata);
+}
@@ -0,0 +1,250 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/cocl_texture.h"
+
+#include "cocl/hostside_opencl_funcs.h"
+#include "cocl/cocl_memory.h"
+#include "cocl/cocl_context.h"
+#include "cocl/cocl_streams.h"
+
+#include <iostream>
+#include <memory>
+#include <set>
+#include <mutex>
+#include <stdexcept>
+#include <cstring>
+
+#include "EasyCL/EasyCL.h"
+
+using namespace std;
+using namespace cocl;
+using namespace easycl;
+
+#ifdef COCL_PRINT
+#undef COCL_PRINT
+#endif
+
+#ifdef COCL_SPAM_MEMORY
+#define COCL_PRINT(x) std::cout << "[TEX] " << x << std::endl;
+#else
+#define COCL_PRINT(x)
+#endif
+
+static std::mutex textureMutex;
+static set<CoclTexture *> textures;
+
+static int getChannelBits(const cudaChannelFormatDesc &desc, int *numChannels) {
+    int bits[4] = {desc.x, desc.y, desc.z, desc.w};
+    *numChannels = 0;
+    for(int i = 0; i < 4; i++) {
+        if(bits[i] == 0) {
+            break;
+        }
+        if(bits[i] != bits[0]) {
+            cout << "channel sizes " << desc.x << " " << desc.y << " " << desc.z << " " << desc.w << endl;
+            throw runtime_error("texture channels of different sizes not supported");
+        }
+        (*numChannels)++;
+    }
+    if(*numChannels == 0) {
+        throw runtime_error("texture channel format has no channels");
+    }
+    return bits[0];
+}
+
+static cl_image_format getImageFormat(const cudaChannelFormatDesc &desc, cudaTextureReadMode readMode) {
+    int numChannels = 0;
+    int bits = getChannelBits(desc, &numChannels);
+    bool normalized = readMode == cudaReadModeNormalizedFloat;
+
+    cl_image_format format;
+    switch(numChannels) {
+        case 1:
+            format.image_channel_order = CL_R;
+            break;
+        case 2:
+            format.image_channel_order = CL_RG;
+            break;
+        case 4:
+            format.image_channel_order = CL_RGBA;
+            break;
+        default:
+            cout << "numChannels " << numChannels << endl;
+            throw runtime_error("texture channel count not supported by opencl images");
+    }
+    format.image_channel_data_type = 0;
+    if(desc.f == cudaChannelFormatKindFloat) {
+        if(bits == 32) {
+            format.image_channel_data_type = CL_FLOAT;
+        } else if(bits == 16) {
+            format.image_channel_data_type = CL_HALF_FLOAT;
+        }
+    } else if(desc.f == cudaChannelFormatKindUnsigned) {
+        if(bits == 8) {
+            format.image_channel_data_type = normalized ? CL_UNORM_INT8 : CL_UNSIGNED_INT8;
+        } else if(bits == 16) {
+            format.image_channel_data_type = normalized ? CL_UNORM_INT16 : CL_UNSIGNED_INT16;
+        } else if(bits == 32) {
+            format.image_channel_data_type = CL_UNSIGNED_INT32;
+        }
+    } else if(desc.f == cudaChannelFormatKindSigned) {
+        if(bits == 8) {
+            format.image_channel_data_type = normalized ? CL_SNORM_INT8 : CL_SIGNED_INT8;
+        } else if(bits == 16) {
+            format.image_channel_data_type = normalized ? CL_SNORM_INT16 : CL_SIGNED_INT16;
+        } else if(bits == 32) {
+            format.image_channel_data_type = CL_SIGNED_INT32;
+        }
+    }
+    if(format.image_channel_data_type == 0) {
+        cout << "channel kind " << desc.f << " bits " << bits << endl;
+        throw runtime_error("texture channel format not supported by opencl images");
+    }
+    return format;
+}
+
+static cl_sampler createSampler(cl_context context, const cudaTextureDesc &texDesc) {
+    // opencl has one addressing mode for all dimensions, so we use the first one.  Like cuda, wrap and
+    // mirror only make sense with normalized coordinates, and otherwise fall back to clamp.  opencl
+    // borders are always zero
+    cl_addressing_mode addressMode = CL_ADDRESS_CLAMP_TO_EDGE;
+    switch(texDesc.addressMode[0]) {
+        case cudaAddressModeWrap:
+            addressMode = texDesc.normalizedCoords ? CL_ADDRESS_REPEAT : CL_ADDRESS_CLAMP_TO_EDGE;
+            break;
+        case cudaAddressModeMirror:
+            addressMode = texDesc.normalizedCoords ? CL_ADDRESS_MIRRORED_REPEAT : CL_ADDRESS_CLAMP_TO_EDGE;
+            break;
+        case cudaAddressModeClamp:
+            addressMode = CL_ADDRESS_CLAMP_TO_EDGE;
+            break;
+        case cudaAddressModeBorder:
+            addressMode = CL_ADDRESS_CLAMP;
+            break;
+    }
+    cl_filter_mode filterMode = texDesc.filterMode == cudaFilterModeLinear ? CL_FILTER_LINEAR : CL_FILTER_NEAREST;
+    cl_int err;
+    cl_sampler sampler = clCreateSampler(context, texDesc.normalizedCoords ? CL_TRUE : CL_FALSE,
+        addressMode, filterMode, &err);
+    EasyCL::checkError(err);
+    return sampler;
+}
+
+void CoclTexture::copyToImage(CoclStream *coclStream) {
+    Memory *memory = findMemory(devPtr);
+    if(memory == 0) {
+        throw runtime_error("texture memory has been freed");
+    }
+    syncWithLegacyStream(coclStream);
+    memory->migrateToDevice(coclStream);
+    cl_command_queue queue = coclStream->clqueue->queue;
+    size_t offset = memory->getOffset(devPtr);
+    size_t rowBytes = width * elementSize;
+    cl_int err;
+    if(pitchInBytes == rowBytes) {
+        size_t origin[3] = {0, 0, 0};
+        size_t region[3] = {width, height, 1};
+        err = clEnqueueCopyBufferToImage(queue, memory->clmem, image, offset, origin, region,
+            coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
+        EasyCL::checkError(err);
+        coclStream->commandEnqueued();
+        return;
+    }
+    // opencl 1.2 cant copy from a pitched buffer in one go, so we copy each row
+    for(size_t row = 0; row < height; row++) {
+        size_t origin[3] = {0, row, 0};
+        size_t region[3] = {width, 1, 1};
+        err = clEnqueueCopyBufferToImage(queue, memory->clmem, image, offset + row * pitchInBytes,
+            origin, region, coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
+        EasyCL::checkError(err);
+        coclStream->commandEnqueued();
+    }
+}
+
+namespace cocl {
+    CoclTexture *findTexture(const char *texture_as_charstar) {
+        std::lock_guard< std::mutex > guard(textureMutex);
+        CoclTexture *texture = (CoclTexture *)texture_as_charstar;
+        if(textures.find(texture) == textures.end()) {
+            cout << "texture object " << (void *)texture_as_charstar << " not found" << endl;
+            throw runtime_error("texture object not found, or already destroyed");
+        }
+        return texture;
+    }
+}
+
+size_t cudaCreateTextureObject(cudaTextureObject_t *pTexObject, const cudaResourceDesc *pResDesc,
+        const cudaTextureDesc *pTexDesc, const cudaResourceViewDesc *pResViewDesc) {
+    if(pResViewDesc != 0) {
+        throw runtime_error("cudaCreateTextureObject: resource views not supported");
+    }
+    if(pResDesc->resType != cudaResourceTypeLinear && pResDesc->resType != cudaResourceTypePitch2D) {
+        cout << "resType " << pResDesc->resType << endl;
+        throw runtime_error("cudaCreateTextureObject: only linear and pitch2D resources are supported");
+    }
+    unique_ptr<CoclTexture> texture(new CoclTexture());
+    texture->resType = pResDesc->resType;
+    texture->devPtr = (char *)(pResDesc->resType == cudaResourceTypeLinear ?
+        pResDesc->res.linear.devPtr : pResDesc->res.pitch2D.devPtr);
+    if(findMemory(texture->devPtr) == 0) {
+        throw runtime_error("cudaCreateTextureObject: devPtr is not device memory");
+    }
+    if(pResDesc->resType == cudaResourceTypeLinear) {
+        COCL_PRINT("cudaCreateTextureObject linear bytes=" << pResDesc->res.linear.sizeInBytes);
+    } else {
+        texture->width = pResDesc->res.pitch2D.width;
+        texture->height = pResDesc->res.pitch2D.height;
+        texture->pitchInBytes = pResDesc->res.pitch2D.pitchInBytes;
+        int numChannels = 0;
+        int bits = getChannelBits(pResDesc->res.pitch2D.desc, &numChannels);
+        texture->elementSize = numChannels * bits / 8;
+        COCL_PRINT("cudaCreateTextureObject pitch2D " << texture->width << "x" << texture->height
+            << " pitch=" << texture->pitchInBytes);
+
+        ThreadVars *v = getThreadVars();
+        EasyCL *cl = v->getContext()->getCl();
+        cl_image_format format = getImageFormat(pResDesc->res.pitch2D.desc, pTexDesc->readMode);
+        cl_image_desc imageDesc;
+        memset(&imageDesc, 0, sizeof(imageDesc));
+        imageDesc.image_type = CL_MEM_OBJECT_IMAGE2D;
+        imageDesc.image_width = texture->width;
+        imageDesc.image_height = texture->height;
+        cl_int err;
+        texture->image = clCreateImage(*cl->context, CL_MEM_READ_ONLY, &format, &imageDesc, NULL, &err);
+        EasyCL::checkError(err);
+        texture->sampler = createSampler(*cl->context, *pTexDesc);
+    }
+    std::lock_guard< std::mutex > guard(textureMutex);
+    *pTexObject = texture.get();
+    textures.insert(texture.release());
+    return 0;
+}
+
+size_t cudaDestroyTextureObject(cudaTextureObject_t texObject) {
+    std::lock_guard< std::mutex > guard(textureMutex);
+    if(textures.find(texObject) == textures.end()) {
+        throw runtime_error("cudaDestroyTextureObject: texture object not found");
+    }
+    textures.erase(texObject);
+    // opencl keeps the image and sampler alive until any queued kernels using them have finished
+    if(texObject->image != 0) {
+        EasyCL::checkError(clReleaseMemObject(texObject->image));
+    }
+    if(texObject->sampler != 0) {
+        EasyCL::checkError(clReleaseSampler(texObject->sampler));
+    }
+    delete texObject;
+    return 0;
+}
@@ -21,6 +21,9 @@
 #include "cocl/new_instruction_dumper.h"
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/CFG.h"
 
 #include "cocl/llvm_dump.h"
 
@@ -105,19 +108,24 @@ std::string FunctionDumper::dumpReturn(Type **pReturnType, ReturnInst *retInst)
     return gencode;
 }
 
+// the condition of a conditional branch, in brackets
+std::string FunctionDumper::dumpBranchCondition(llvm::BranchInst *instr) {
+    string conditionstring = localValueInfos.at(instr->getCondition())->getExpr();
+    if(!ExpressionsHelper::isSingleExpression(conditionstring) || conditionstring[0] != '(') {
+        conditionstring = "(" + conditionstring + ")";
+    }
+    return conditionstring;
+}
+
 std::string FunctionDumper::dumpBranch(llvm::BranchInst *instr) {
     string gencode = "";
     if(instr->isConditional()) {
-        string conditionstring = localValueInfos.at(instr->getCondition())->getExpr();
-
         if(_addIRToCl) {
             string originalInstruction = "if(" + localValueInfos.at(instr->getCondition())->name + ")";
             gencode += "    /* " + originalInstruction + " */\n";
         }
 
-        if(!ExpressionsHelper::isSingleExpression(conditionstring) || conditionstring[0] != '(') {
-            conditionstring = "(" + conditionstring + ")";
-        }
+        string conditionstring = dumpBranchCondition(instr);
         string trueSection = "";
         bool needTrueSection = false;
         string phicode = dumpPhi("        ", instr, instr->getSuccessor(0));
@@ -192,27 +200,138 @@ std::string FunctionDumper::dumpSharedDefinitions(std::string indent) {
     return oss.str();
 }
 
+// texture objects are pointers to an opaque struct CoclTexture, see cocl_texture.h
+static bool isTextureType(Type *type) {
+    PointerType *ptrType = dyn_cast<PointerType>(type);
+    if(ptrType == 0) {
+        return false;
+    }
+    StructType *structType = dyn_cast<StructType>(ptrType->getElementType());
+    return structType != 0 && structType->hasName() && structType->getName() == "struct.CoclTexture";
+}
+
+// textures read by tex2D are pitch2D, and we pass them in as an image plus a sampler.  The others are linear
+// memory, which tex1Dfetch just loads from, so we pass them in like any other gpu buffer.  We record which
+// we chose in textureArgIsImage, and kernelGo checks that setKernelArgTexture passed the same
+static bool isImageTexture(Argument *arg) {
+    for(auto it=arg->user_begin(); it != arg->user_end(); it++) {
+        CallInst *call = dyn_cast<CallInst>(*it);
+        if(call != 0 && call->getCalledFunction() != 0
+                && call->getCalledFunction()->getName().str().find("__cocl_tex2D_") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns true if anything might store through pointer, or anything derived from it, including any functions
+// we pass it to.  If the pointer escapes, eg we store it somewhere, we assume the worst
+static bool mightBeWrittenThrough(Value *pointer, set<Value *> *visited) {
+    if(visited->find(pointer) != visited->end()) {
+        return false;
+    }
+    visited->insert(pointer);
+    if(Argument *arg = dyn_cast<Argument>(pointer)) {
+        if(arg->onlyReadsMemory()) {
+            return false;
+        }
+    }
+    for(auto it=pointer->user_begin(); it != pointer->user_end(); it++) {
+        Value *user = *it;
+        if(isa<LoadInst>(user) || isa<ICmpInst>(user) || isa<DbgInfoIntrinsic>(user)) {
+            continue;
+        }
+        if(isa<GetElementPtrInst>(user) || isa<BitCastInst>(user) || isa<AddrSpaceCastInst>(user) ||
+                isa<PHINode>(user) || isa<SelectInst>(user)) {
+            if(mightBeWrittenThrough(user, visited)) {
+                return true;
+            }
+            continue;
+        }
+        if(CallInst *call = dyn_cast<CallInst>(user)) {
+            Function *called = call->getCalledFunction();
+            if(called == 0 || called->isDeclaration() || called->isVarArg()) {
+                if(called != 0 && called->onlyReadsMemory()) {
+                    continue;
+                }
+                return true;
+            }
+            int i = 0;
+            for(auto arg_it=called->arg_begin(); arg_it != called->arg_end(); arg_it++, i++) {
+                if(call->getArgOperand(i) == pointer && mightBeWrittenThrough(&*arg_it, visited)) {
+                    return true;
+                }
+            }
+            continue;
+        }
+        // stores, atomics, ptrtoint, ...
+        return true;
+    }
+    return false;
+}
+
+// each launch arg is one of the parameters that dumpKernelFunctionDeclarationWithoutReturn writes after the clmems,
+// or, for image textures, the image and sampler pair, so this has to count them the same way
+std::map<int, Argument *> FunctionDumper::getKernelArgByLaunchArgIndex(llvm::Function *F) {
+    map<int, Argument *> argByLaunchArgIndex;
+    int launchArgIndex = 0;
+    for(auto it=F->arg_begin(); it != F->arg_end(); it++) {
+        Argument *arg = &*it;
+        argByLaunchArgIndex[launchArgIndex] = arg;
+        launchArgIndex++;
+        if(isTextureType(arg->getType())) {
+            continue;
+        }
+        PointerType *ptrType = dyn_cast<PointerType>(arg->getType());
+        StructType *structType = ptrType != 0 ? dyn_cast<StructType>(ptrType->getElementType()) : 0;
+        if(structType == 0 || structType->getName().str() == "struct.float4") {
+            continue;
+        }
+        // the pointers in a struct are passed as extra offsets, after the struct's own
+        unique_ptr<StructInfo> structInfo(new StructInfo());
+        StructCloner::walkStructType(F->getParent(), structInfo.get(), 0, 0, std::vector<int>(), "", structType);
+        for(auto pointerit=structInfo->pointerInfos.begin(); pointerit != structInfo->pointerInfos.end(); pointerit++) {
+            Type *pointerElementType = cast<PointerType>((*pointerit)->type)->getElementType();
+            if(pointerElementType->getPrimitiveSizeInBits() != 0) {
+                launchArgIndex++;
+            }
+        }
+    }
+    return argByLaunchArgIndex;
+}
+
 std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Function *F) {
     std::ostringstream declaration;
     shimCode = "";
 
-    declaration << shortName;
-    declaration << "(";
-    int i = 0;
-    for(int clmemIdx = 0; clmemIdx < this->kernelNumUniqueClmems; clmemIdx++) {
-        if(clmemIdx > 0) {
-            declaration << ", ";
-        }
-        declaration << "global char* clmem" << clmemIdx;
-        declaration << ", unsigned long clmem_vmem_offset" << clmemIdx;
-        i++;
-    }
+    // we write the clmem params last, once we know which of them we write to
+    std::ostringstream argsDeclaration;
+    writtenClmems.clear();
+    textureArgIsImage.clear();
+    int i = this->kernelNumUniqueClmems;
     int clmemArgIndex = 0;
     for(auto it=F->arg_begin(); it != F->arg_end(); it++) {
         Argument *arg = &*it;
         string argName = localNames.getOrCreateName(arg, arg->getName().str());
         Type *argType = arg->getType();
 
+        bool isTexture = isTextureType(argType);
+        if(isTexture) {
+            textureArgIsImage.push_back(isImageTexture(arg));
+        }
+        if(isTexture && textureArgIsImage.back()) {
+            if(i > 0) {
+                argsDeclaration << ", ";
+            }
+            argsDeclaration << "read_only image2d_t " << argName << ", sampler_t " << argName << "_sampler";
+            i++;
+            continue;
+        }
+        if(isTexture) {
+            argType = PointerType::get(IntegerType::get(F->getContext(), 8), 1);
+            arg->mutateType(argType);
+        }
+
         string argdeclaration = "";
         bool is_struct_needs_cloning = false;
         bool ispointer = isa<PointerType>(argType);
@@ -235,6 +354,7 @@ std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Fun
                         PointerType *noptrTypePointer = PointerType::get(noptrType, 1);
                         int clmemIndex = kernelClmemIndexByArgIndex[clmemArgIndex];
                         clmemArgIndex++;
+                        writtenClmems.insert(clmemIndex);
                         shimCode = 
                             createOffsetShim(noptrTypePointer, argName + "_nopointers", clmemIndex) +
                             shimCode;
@@ -254,10 +374,10 @@ std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Fun
         }
         if(is_struct_needs_cloning || !ispointer) {
             if(i > 0) {
-                declaration << ", ";
+                argsDeclaration << ", ";
             }
         }
-        declaration << argdeclaration;
+        argsDeclaration << argdeclaration;
         // if this is a kernel method, check for any structs containing pointers,
         // and add those pointers t othe argument list, with some appropriate shimcode
         // to copy those pointers into the struct, at the start of the kernel
@@ -266,7 +386,11 @@ std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Fun
             // add offset
             int clmemIndex = kernelClmemIndexByArgIndex[clmemArgIndex];
             clmemArgIndex++;
-            declaration << createOffsetDeclaration(argName);
+            set<Value *> visited;
+            if(!isTexture && mightBeWrittenThrough(arg, &visited)) {
+                writtenClmems.insert(clmemIndex);
+            }
+            argsDeclaration << createOffsetDeclaration(argName);
             shimCode = 
                 createOffsetShim(arg->getType(), argName, clmemIndex) +
                 shimCode;
@@ -288,9 +412,10 @@ std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Fun
                 }
                 pointerInfo->type = PointerType::get(cast<PointerType>(pointerInfo->type)->getElementType(), 1);
                 string pointerArgName = argName + "_ptr" + easycl::toString(j);
-                declaration << createOffsetDeclaration(pointerArgName);
+                argsDeclaration << createOffsetDeclaration(pointerArgName);
                 int clmemIndex = kernelClmemIndexByArgIndex[clmemArgIndex];
                 clmemArgIndex++;
+                writtenClmems.insert(clmemIndex);
                 shimCode = 
                     createOffsetShim(pointerInfo->type, pointerArgName, clmemIndex) +
                     shimCode +
@@ -300,10 +425,33 @@ std::string FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn(llvm::Fun
         }
         i++;
     }
+    declaration << shortName;
+    declaration << "(";
+    // each clmem is a different buffer, so they cant alias each other: configureKernel registers clmem0, so
+    // arguments pointing into it reuse it, rather than being passed again.  They arent const, even when we
+    // only read them, since the offset shims, and the functions we pass the pointers to, dont carry const
+    for(int clmemIdx = 0; clmemIdx < this->kernelNumUniqueClmems; clmemIdx++) {
+        if(clmemIdx > 0) {
+            declaration << ", ";
+        }
+        declaration << "global char* ";
+        if(this->kernelNumUniqueClmems > 1) {
+            declaration << "restrict ";
+        }
+        declaration << "clmem" << clmemIdx;
+        declaration << ", unsigned long clmem_vmem_offset" << clmemIdx;
+    }
+    declaration << argsDeclaration.str();
     if(i > 0) {
         declaration << ", ";
     }
+    if(globalConstants != 0 && !globalConstants->empty()) {
+        declaration << "constant char *constants, ";
+    }
     declaration << "local int *scratch";
+    if(fusedLaunch) {
+        declaration << ", uint groupId0, uint groupId1, uint groupId2, uint numGroups0, uint numGroups1, uint numGroups2";
+    }
     declaration << ")";
     return declaration.str();
 }
@@ -369,10 +517,164 @@ void FunctionDumper::generateBlockIndex() {
     }
 }
 
+static bool isWorkgroupBarrier(Instruction *instr) {
+    CallInst *call = dyn_cast<CallInst>(instr);
+    if(call == 0 || call->getCalledFunction() == 0) {
+        return false;
+    }
+    string name = call->getCalledFunction()->getName().str();
+    return name == "llvm.nvvm.barrier0" || name == "llvm.cuda.syncthreads" || name == "_Z11syncthreadsv";
+}
+
+// a pointer is local (ie not global) if it points into shared memory, or at an alloca
+static bool isLocalPointer(Value *ptr) {
+    if(ptr->getType()->getPointerAddressSpace() == 3) {
+        return true;
+    }
+    while(true) {
+        ptr = ptr->stripPointerCasts();
+        if(GEPOperator *gep = dyn_cast<GEPOperator>(ptr)) {
+            ptr = gep->getPointerOperand();
+            continue;
+        }
+        break;
+    }
+    if(isa<AllocaInst>(ptr)) {
+        return true;
+    }
+    return ptr->getType()->getPointerAddressSpace() == 3;
+}
+
+static bool functionTouchesGlobalMemory(Function *F, map<Function *, bool> *touchesByFunction);
+
+static bool touchesGlobalMemory(Instruction *instr, map<Function *, bool> *touchesByFunction) {
+    if(LoadInst *load = dyn_cast<LoadInst>(instr)) {
+        return !isLocalPointer(load->getPointerOperand());
+    } else if(StoreInst *store = dyn_cast<StoreInst>(instr)) {
+        return !isLocalPointer(store->getPointerOperand());
+    } else if(AtomicRMWInst *rmw = dyn_cast<AtomicRMWInst>(instr)) {
+        return !isLocalPointer(rmw->getPointerOperand());
+    } else if(AtomicCmpXchgInst *cmpxchg = dyn_cast<AtomicCmpXchgInst>(instr)) {
+        return !isLocalPointer(cmpxchg->getPointerOperand());
+    } else if(CallInst *call = dyn_cast<CallInst>(instr)) {
+        if(isWorkgroupBarrier(call) || isa<DbgInfoIntrinsic>(call)) {
+            return false;
+        }
+        Function *called = call->getCalledFunction();
+        if(called == 0) {
+            return true;
+        }
+        if(!called->isDeclaration()) {
+            return functionTouchesGlobalMemory(called, touchesByFunction);
+        }
+        // builtins and atomics: assume they only touch memory through their pointer arguments
+        for(unsigned i = 0; i < called->arg_size(); i++) {
+            Value *arg = call->getArgOperand(i);
+            if(arg->getType()->isPointerTy() && !isLocalPointer(arg)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool functionTouchesGlobalMemory(Function *F, map<Function *, bool> *touchesByFunction) {
+    auto it = touchesByFunction->find(F);
+    if(it != touchesByFunction->end()) {
+        return it->second;
+    }
+    // assume the worst whilst walking, in case of recursion
+    (*touchesByFunction)[F] = true;
+    bool touches = false;
+    for(auto block_it = F->begin(); block_it != F->end() && !touches; block_it++) {
+        for(auto inst_it = block_it->begin(); inst_it != block_it->end(); inst_it++) {
+            if(touchesGlobalMemory(&*inst_it, touchesByFunction)) {
+                touches = true;
+                break;
+            }
+        }
+    }
+    (*touchesByFunction)[F] = touches;
+    return touches;
+}
+
+void FunctionDumper::analyzeBarrierFences() {
+    // A __syncthreads only needs to fence global memory if global memory might have been touched since
+    // the previous __syncthreads.  For each barrier we walk backwards through the CFG, stopping at earlier
+    // barriers; if we find a global load, store, atomic, or a call that might do one, we keep the global
+    // fence, otherwise a local fence is enough.
+    // For non-kernel functions, reaching the function entry means the caller might have touched global
+    // memory, so we keep the global fence.
+    globalFenceBarriers.clear();
+    map<Function *, bool> touchesByFunction;
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *barrierBlock = &*block_it;
+        for(auto inst_it = barrierBlock->begin(); inst_it != barrierBlock->end(); inst_it++) {
+            Instruction *barrier = &*inst_it;
+            if(!isWorkgroupBarrier(barrier)) {
+                continue;
+            }
+            bool needsGlobal = false;
+            set<BasicBlock *> visited;
+            vector<BasicBlock *> toVisit;
+            // first, the instructions preceding the barrier in its own block
+            bool reachedBlockStart = true;
+            for(BasicBlock::iterator prev_it(barrier); prev_it != barrierBlock->begin();) {
+                prev_it--;
+                Instruction *prev = &*prev_it;
+                if(isWorkgroupBarrier(prev)) {
+                    reachedBlockStart = false;
+                    break;
+                }
+                if(touchesGlobalMemory(prev, &touchesByFunction)) {
+                    needsGlobal = true;
+                    break;
+                }
+            }
+            if(reachedBlockStart && !needsGlobal) {
+                if(barrierBlock == &F->getEntryBlock() && !isKernel) {
+                    needsGlobal = true;
+                }
+                toVisit.insert(toVisit.end(), pred_begin(barrierBlock), pred_end(barrierBlock));
+            }
+            while(!needsGlobal && toVisit.size() > 0) {
+                BasicBlock *block = toVisit.back();
+                toVisit.pop_back();
+                if(visited.find(block) != visited.end()) {
+                    continue;
+                }
+                visited.insert(block);
+                bool hitBarrier = false;
+                for(auto prev_it = block->rbegin(); prev_it != block->rend(); prev_it++) {
+                    Instruction *prev = &*prev_it;
+                    if(isWorkgroupBarrier(prev)) {
+                        hitBarrier = true;
+                        break;
+                    }
+                    if(touchesGlobalMemory(prev, &touchesByFunction)) {
+                        needsGlobal = true;
+                        break;
+                    }
+                }
+                if(!hitBarrier && !needsGlobal) {
+                    if(block == &F->getEntryBlock() && !isKernel) {
+                        needsGlobal = true;
+                    }
+                    toVisit.insert(toVisit.end(), pred_begin(block), pred_end(block));
+                }
+            }
+            if(needsGlobal) {
+                globalFenceBarriers.insert(barrier);
+            }
+        }
+    }
+}
+
 bool FunctionDumper::runGeneration(const std::map<llvm::Function *, llvm::Type *> &returnTypeByFunction) {
     // returns true means finished, false means missing some dependnecy, like a sub fucntion walk
 
     generateBlockIndex();
+    analyzeBarrierFences();
 
     // first time initializes the types of hte args and so on
     declaration = dumpFunctionDeclarationWithoutReturn(F);
@@ -388,6 +690,7 @@ bool FunctionDumper::runGeneration(const std::map<llvm::Function *, llvm::Type *
         numBlocks++;
     }
     set<BasicBlock *> blocksDumped;
+    vector<pair<BasicBlock *, string> > gotoBlocks;  // label and goto version of each block, in the order we wrote them
 
     int iteration = 0;
     while(blocksDumped.size() < numBlocks) {
@@ -422,6 +725,11 @@ bool FunctionDumper::runGeneration(const std::map<llvm::Function *, llvm::Type *
             if(_addIRToCl) {
                 basicBlockDumper.addIRToCl();
             }
+            basicBlockDumper.setGlobalFenceBarriers(&globalFenceBarriers);
+            basicBlockDumper.setAddressSpaceInference(addressSpaceInference);
+            basicBlockDumper.setGlobalConstants(globalConstants);
+            basicBlockDumper.setGroupIdsFromGlobalVars(fusedLaunch);
+            basicBlockDumper.setFastMath(fastMath);
             bool finished = false;
             try {
                 finished = basicBlockDumper.runGeneration(returnTypeByFunction);
@@ -445,24 +753,254 @@ bool FunctionDumper::runGeneration(const std::map<llvm::Function *, llvm::Type *
             }
             if(basicBlockDumper.usesScratch) {
                 this->usesScratch = true;
+                this->scratchBytesPerWorkItem = std::max(scratchBytesPerWorkItem, basicBlockDumper.scratchBytesPerWorkItem);
             }
 
+            string terminatorCl = "";
             try {
-                blockstream << dumpTerminator(&returnType, basicBlock->getTerminator());
+                terminatorCl = dumpTerminator(&returnType, basicBlock->getTerminator());
             } catch(NeedValueDependencyException &e) {
                 continue;
             }
+            blockstream << terminatorCl;
 
-            ouros << blockstream.str();
+            if(structuredControlFlow) {
+                StructuredBlock &structuredBlock = structuredBlocks[basicBlock];
+                structuredBlock.label = label;
+                ostringstream codestream;
+                basicBlockDumper.toCl(codestream);
+                structuredBlock.code = codestream.str();
+                Instruction *terminator = basicBlock->getTerminator();
+                if(isa<ReturnInst>(terminator)) {
+                    structuredBlock.returnCode = terminatorCl;
+                } else if(BranchInst *branch = dyn_cast<BranchInst>(terminator)) {
+                    if(branch->isConditional()) {
+                        structuredBlock.condition = dumpBranchCondition(branch);
+                    }
+                    for(unsigned int i = 0; i < branch->getNumSuccessors(); i++) {
+                        BasicBlock *successor = branch->getSuccessor(i);
+                        structuredBlock.edgeCode[successor] = dumpPhi("    ", branch, successor);
+                    }
+                }
+            }
+
+            gotoBlocks.push_back(make_pair(basicBlock, blockstream.str()));
             blocksDumped.insert(basicBlock);
         }
         iteration++;
     }
 
+    unique_ptr<VariableCoalescing> coalescing;
+    map<Value *, string> typeByVariable;
+    set<Value *> inlined;
+    if(coalesceVariables || narrowDeclarations) {
+        findVariables(&typeByVariable, &inlined);
+        coalescing.reset(new VariableCoalescing(F, typeByVariable, inlined));
+        coalescing->run(coalesceVariables, coalesceVariables);
+        renameCoalescedVariables(coalescing.get(), typeByVariable, &gotoBlocks);
+    }
+
+    bool wroteStructured = false;
+    if(structuredControlFlow) {
+        // replaces the labels and gotos with ifs and loops, unless the control flow is irreducible
+        StructuredControlFlow structured(F);
+        if(structured.isReducible()) {
+            structured.analyze(structuredBlocks);
+            map<int, string> declarationsByScope;
+            if(narrowDeclarations && !structured.usesGotos()) {
+                declarationsByScope = narrowVariableDeclarations(structured, coalescing.get(), typeByVariable);
+            }
+            ouros << structured.generateCl(declarationsByScope);
+            wroteStructured = true;
+        }
+    }
+    if(!wroteStructured) {
+        for(auto it = gotoBlocks.begin(); it != gotoBlocks.end(); it++) {
+            ouros << it->second;
+        }
+    }
+
     _generationDone = true;
     return true;
 }
 
+// the variables the generated code assigns to, that we could rename, and the values it writes as an expression
+// wherever they are used
+void FunctionDumper::findVariables(map<Value *, string> *typeByVariable, set<Value *> *inlined) {
+    for(auto it = localValueInfos.begin(); it != localValueInfos.end(); it++) {
+        Instruction *inst = dyn_cast<Instruction>(it->first);
+        LocalValueInfo *info = it->second.get();
+        if(inst == 0 || inst->getType()->isVoidTy()) {
+            continue;
+        }
+        if(!info->toBeDeclared || info->_skip) {
+            inlined->insert(inst);
+            continue;
+        }
+        ClWriter::ClWriterKind kind = info->clWriter->getKind();
+        if(!isa<AllocaInst>(inst) && !isa<CallInst>(inst) && !inst->getType()->isArrayTy() && info->declarationCl.size() == 0
+                && info->inlineCl.size() == 0 && (kind == ClWriter::CLW_Base || kind == ClWriter::CLW_Binary)) {
+            (*typeByVariable)[inst] = typeDumper->dumpType(inst->getType(), true);
+        }
+    }
+}
+
+static bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// whether the identifier at pos is a member, eg the x of v1.x or p->x, rather than a variable
+static bool isMemberName(const string &code, size_t pos) {
+    size_t prev = pos;
+    while(prev > 0 && code[prev - 1] == ' ') {
+        prev--;
+    }
+    if(prev >= 1 && code[prev - 1] == '.') {
+        return true;
+    }
+    return prev >= 2 && code[prev - 2] == '-' && code[prev - 1] == '>';
+}
+
+static string renameIdentifiers(const string &code, const map<string, string> &newNameByName) {
+    string renamed = "";
+    size_t pos = 0;
+    while(pos < code.size()) {
+        if(!isIdentifierChar(code[pos])) {
+            renamed += code[pos];
+            pos++;
+            continue;
+        }
+        size_t end = pos;
+        while(end < code.size() && isIdentifierChar(code[end])) {
+            end++;
+        }
+        string identifier = code.substr(pos, end - pos);
+        auto it = isMemberName(code, pos) ? newNameByName.end() : newNameByName.find(identifier);
+        renamed += it == newNameByName.end() ? identifier : it->second;
+        pos = end;
+    }
+    return renamed;
+}
+
+// drops copies that renaming turned into v = v, along with the phi comment before them, if any
+static string dropSelfCopies(const string &code) {
+    vector<string> lines;
+    istringstream iss(code);
+    string line;
+    while(getline(iss, line)) {
+        string trimmed = line.substr(min(line.find_first_not_of(' '), line.size()));
+        size_t equals = trimmed.find(" = ");
+        if(equals != string::npos && trimmed == trimmed.substr(0, equals) + " = " + trimmed.substr(0, equals) + ";") {
+            if(lines.size() > 0 && lines.back().find("/* ") != string::npos && lines.back().find(" = phi ") != string::npos) {
+                lines.pop_back();
+            }
+            continue;
+        }
+        lines.push_back(line);
+    }
+    string result = "";
+    for(auto it = lines.begin(); it != lines.end(); it++) {
+        result += *it + "\n";
+    }
+    return result;
+}
+
+// gives merged variables the name of their representative, in all the code we generated
+void FunctionDumper::renameCoalescedVariables(
+        VariableCoalescing *coalescing, const map<Value *, string> &typeByVariable,
+        vector<pair<BasicBlock *, string> > *gotoBlocks) {
+    map<string, string> newNameByName;
+    for(auto it = typeByVariable.begin(); it != typeByVariable.end(); it++) {
+        Value *representative = coalescing->getRepresentative(it->first);
+        if(representative != it->first) {
+            newNameByName[localValueInfos.at(it->first)->name] = localValueInfos.at(representative)->name;
+            declaredElsewhere.insert(it->first);
+        }
+    }
+    if(newNameByName.size() == 0) {
+        return;
+    }
+    for(auto it = gotoBlocks->begin(); it != gotoBlocks->end(); it++) {
+        it->second = dropSelfCopies(renameIdentifiers(it->second, newNameByName));
+    }
+    for(auto it = structuredBlocks.begin(); it != structuredBlocks.end(); it++) {
+        StructuredBlock &block = it->second;
+        block.code = dropSelfCopies(renameIdentifiers(block.code, newNameByName));
+        block.returnCode = renameIdentifiers(block.returnCode, newNameByName);
+        block.condition = renameIdentifiers(block.condition, newNameByName);
+        for(auto edge_it = block.edgeCode.begin(); edge_it != block.edgeCode.end(); edge_it++) {
+            edge_it->second = dropSelfCopies(renameIdentifiers(edge_it->second, newNameByName));
+        }
+    }
+}
+
+// declares each variable at the start of the innermost while body, or side of an if, that holds all the code
+// using it, and that it isnt live into.  Returns the declarations for each scope
+std::map<int, std::string> FunctionDumper::narrowVariableDeclarations(
+        const StructuredControlFlow &structured, VariableCoalescing *coalescing,
+        const map<Value *, string> &typeByVariable) {
+    const vector<StructuredScope> &scopes = structured.getScopes();
+    map<int, vector<string> > declarationsListByScope;
+    for(auto it = typeByVariable.begin(); it != typeByVariable.end(); it++) {
+        Value *variable = it->first;
+        if(coalescing->getRepresentative(variable) != variable) {
+            continue;
+        }
+        vector<int> path;
+        bool first = true;
+        auto narrowTo = [&path, &first](const vector<int> &usePath) {
+            if(usePath.size() == 0) {
+                return;  // unreachable, so not written
+            }
+            if(first) {
+                path = usePath;
+                first = false;
+                return;
+            }
+            size_t common = 0;
+            while(common < path.size() && common < usePath.size() && path[common] == usePath[common]) {
+                common++;
+            }
+            path.resize(common);
+        };
+        const set<BasicBlock *> &blocks = coalescing->getBlocksUsing(variable);
+        for(auto block_it = blocks.begin(); block_it != blocks.end(); block_it++) {
+            narrowTo(structured.getScopePath(*block_it));
+        }
+        const set<pair<BasicBlock *, BasicBlock *> > &edges = coalescing->getEdgesUsing(variable);
+        for(auto edge_it = edges.begin(); edge_it != edges.end(); edge_it++) {
+            narrowTo(structured.getScopePath(edge_it->first, edge_it->second));
+        }
+        // a variable still holding a value from the previous loop iteration, or from before the if, has to be
+        // declared further out
+        while(path.size() > 1) {
+            const StructuredScope &scope = scopes[path.back()];
+            bool liveIn = scope.loopHeader != 0 ?
+                coalescing->isLiveIn(scope.loopHeader, variable) :
+                coalescing->isLiveOnEdge(scope.edgeFrom, scope.edgeTo, variable);
+            if(!liveIn) {
+                break;
+            }
+            path.pop_back();
+        }
+        if(path.size() <= 1) {
+            continue;
+        }
+        declarationsListByScope[path.back()].push_back(
+            "    " + it->second + " " + localValueInfos.at(variable)->name + ";\n");
+        declaredElsewhere.insert(variable);
+    }
+    map<int, string> declarationsByScope;
+    for(auto it = declarationsListByScope.begin(); it != declarationsListByScope.end(); it++) {
+        vector<string> &declarations = it->second;
+        std::sort(declarations.begin(), declarations.end());
+        for(auto decl_it = declarations.begin(); decl_it != declarations.end(); decl_it++) {
+            declarationsByScope[it->first] += *decl_it;
+        }
+    }
+    return declarationsByScope;
+}
+
 bool FunctionDumper::generationDone() {
     return _generationDone;
 }
@@ -470,6 +1008,9 @@ bool FunctionDumper::generationDone() {
 void FunctionDumper::writeDeclarations(std::string indent, ostream &os) {
     vector<string> declarations;
     for(auto it = localValueInfos.begin(); it != localValueInfos.end(); it++) {
+        if(declaredElsewhere.find(it->first) != declaredElsewhere.end()) {
+            continue;
+        }
         LocalValueInfo *localValueInfo = it->second.get();
         ostringstream oss;
         localValueInfo->writeDeclaration("    ", typeDumper, oss);
@@ -490,7 +1031,10 @@ void FunctionDumper::toCl(ostream &os) {
     } else {
         declaration = string("void") + " " + declaration;
     }
-    if(isKernel) {
+    if(isKernel && !fusedLaunch) {
+        if(kernelAttributes != "") {
+            declaration = kernelAttributes + " " + declaration;
+        }
         declaration = "kernel " + declaration;
     }
     this->functionDeclaration = declaration;
@@ -501,8 +1045,11 @@ void FunctionDumper::toCl(ostream &os) {
         os << shimCode << "\n";
     }
     if(isKernel) {
-    os << R"(    const struct GlobalVars globalVars = { scratch, clmem0, clmem_vmem_offset0 };
-    const struct GlobalVars* const pGlobalVars = &globalVars;
+    string constantsInit = globalConstants != 0 && !globalConstants->empty() ? ", constants" : "";
+    string groupsInit = fusedLaunch ?
+        ", { groupId0, groupId1, groupId2 }, { numGroups0, numGroups1, numGroups2 }" : "";
+    os << "    const struct GlobalVars globalVars = { scratch, clmem0, clmem_vmem_offset0" << constantsInit << groupsInit << " };\n";
+    os << R"(    const struct GlobalVars* const pGlobalVars = &globalVars;
 
 )";
 }
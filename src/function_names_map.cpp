@@ -22,61 +22,15 @@ using namespace std;
 namespace cocl {
 
 void FunctionNamesMap::populateKnownValues() {
-    knownFunctionsMap["_ZSt4sqrtf"] = "sqrt";
-    knownFunctionsMap["llvm.nvvm.sqrt.rn.d"] = "sqrt";
-    knownFunctionsMap["llvm.nvvm.fabs.f"] = "fabs";
-    knownFunctionsMap["llvm.nvvm.fabs.ftz.f"] = "fabs";
+    // the math functions, eg expf, and __nv_expf, are in math_functions.cpp
     knownFunctionsMap["_Z16our_pretend_tanhf"] = "tanh";
     knownFunctionsMap["_Z15our_pretend_logf"] = "log";
     knownFunctionsMap["_Z15our_pretend_expf"] = "exp";
-    knownFunctionsMap["_Z5__clzi"] = "clz";
 
     knownFunctionsMap["_ZSt16our_pretend_tanhf"] = "tanh";
     knownFunctionsMap["_ZSt15our_pretend_logf"] = "log";
     knownFunctionsMap["_ZSt15our_pretend_expf"] = "exp";
 
-    knownFunctionsMap["_ZSt4tanhf"] = "tanh";
-    knownFunctionsMap["_ZSt3logf"] = "log";
-    knownFunctionsMap["_ZSt3expf"] = "exp";
-    knownFunctionsMap["_ZSt3powff"] = "pow";
-    knownFunctionsMap["_Z3minff"] = "fmin";
-    knownFunctionsMap["_Z3maxff"] = "fmax";
-    knownFunctionsMap["_Z4fabsf"] = "fabs";
-
-    knownFunctionsMap["fminf"] = "fmin";
-    knownFunctionsMap["fmaxf"] = "fmax";
-
-    knownFunctionsMap["tanhf"] = "tanh";
-    knownFunctionsMap["expf"] = "exp";
-    knownFunctionsMap["fabsf"] = "fabs";
-    knownFunctionsMap["fabs"] = "fabs";
-    knownFunctionsMap["acosf"] = "acos";
-    knownFunctionsMap["asinf"] = "asin";
-    knownFunctionsMap["atanf"] = "atan";
-    knownFunctionsMap["cosf"] = "cos";
-    knownFunctionsMap["sinf"] = "sin";
-    knownFunctionsMap["tanf"] = "tan";
-    
-    knownFunctionsMap["floor"] = "floor";
-    knownFunctionsMap["floorf"] = "floor";
-    knownFunctionsMap["_Z5floorf"] = "floor";
-    knownFunctionsMap["_Z5floord"] = "floor";
-    
-    knownFunctionsMap["ceil"] = "ceil";
-    knownFunctionsMap["ceilf"] = "ceil";
-    knownFunctionsMap["_Z4ceilf"] = "ceil";
-    knownFunctionsMap["_Z4ceild"] = "ceil";
-    
-    knownFunctionsMap["logf"] = "log";
-    knownFunctionsMap["sqrtf"] = "sqrt";
-
-    knownFunctionsMap["sqrt"] = "sqrt";
-    knownFunctionsMap["pow"] = "pow";
-    knownFunctionsMap["_Z3powff"] = "pow";
-    knownFunctionsMap["_Z4sqrtf"] = "sqrt";
-    knownFunctionsMap["_Z3logf"] = "log";
-    knownFunctionsMap["_Z5isnanf"] = "isnan";
-
     // CAS
     knownFunctionsMap["_Z9atomicCASIjET_PS0_S0_S0_"] = "atomic_cmpxchg";   // cas int
     knownFunctionsMap["_Z9atomicCASIiET_PS0_S0_S0_"] = "atomic_cmpxchg";   // cas uint
@@ -86,25 +40,9 @@ void FunctionNamesMap::populateKnownValues() {
     knownFunctionsMap["_Z10atomicExchIjET_PS0_S0_"] = "atomic_xchg";  // xchng ints
     knownFunctionsMap["_Z10atomicExchIfET_PS0_S0_"] = "atomic_xchg";   // xchng floats
 
-    // llvm 4.0:
-    knownFunctionsMap["_Z5fminfff"] = "fmin";
-    knownFunctionsMap["_Z5fmaxfff"] = "fmax";
-
-    knownFunctionsMap["_Z5sqrtff"] = "sqrt";
-    knownFunctionsMap["_Z4logff"] = "log";
-    knownFunctionsMap["_Z5sqrtff"] = "sqrt";
-    knownFunctionsMap["_Z5tanhff"] = "tanh";
-    knownFunctionsMap["_Z4expff"] = "exp";
-    knownFunctionsMap["_Z5fabsff"] = "fabs";
-    knownFunctionsMap["_Z5acosff"] = "acos";
-    knownFunctionsMap["_Z5asinff"] = "asin";
-    knownFunctionsMap["_Z5atanff"] = "atan";
-    knownFunctionsMap["_Z4cosff"] = "cos";
-    knownFunctionsMap["_Z4sinff"] = "sin";
-    knownFunctionsMap["_Z4tanff"] = "tan";
-    knownFunctionsMap["_Z5ceilff"] = "ceil";
-    knownFunctionsMap["_Z6floorff"] = "floor";
-    // end llvm 4.0
+    // cuda_fp16.h
+    knownFunctionsMap["_Z6__hfmaDhDhDh"] = "fma";
+    knownFunctionsMap["_Z7__hfma2Dv2_DhS_S_"] = "fma";
 
     ignoredGlobalVariables.insert("blockIdx");
     ignoredGlobalVariables.insert("threadIdx");
@@ -25,6 +25,7 @@
 #include <map>
 #include <set>
 #include <cstdlib>
+#include <cstring>
 #include <mutex>
 
 #include "EasyCL/EasyCL.h"
@@ -37,6 +38,7 @@
 #include "cocl/ir-to-opencl-common.h"
 
 #include "cocl/DebugDumper.h"
+#include "cocl/launch_fusion.h"
 
 using namespace std;
 using namespace easycl;
@@ -81,6 +83,61 @@ using namespace cocl;
 static LaunchConfiguration launchConfiguration;
 static DebugDumper debugDumper(&launchConfiguration);
 
+#define SPECIALIZE_ENV_VAR "COCL_SPECIALIZE"
+#define WORK_GROUP_SIZE_ENV_VAR "COCL_WORK_GROUP_SIZE"
+#define LAUNCH_FUSION_ENV_VAR "COCL_LAUNCH_FUSION"
+
+// only used by kernelGo, under launchMutex
+static KernelSpecializer *getKernelSpecializer() {
+    static KernelSpecializer kernelSpecializer(
+        getenv(SPECIALIZE_ENV_VAR) != 0 ? getenv(SPECIALIZE_ENV_VAR) : "",
+        getenv(WORK_GROUP_SIZE_ENV_VAR) != 0 ? getenv(WORK_GROUP_SIZE_ENV_VAR) : "reqd");
+    return &kernelSpecializer;
+}
+
+static LaunchFuser *getLaunchFuser() {
+    static LaunchFuser launchFuser(getenv(LAUNCH_FUSION_ENV_VAR) != 0 ? getenv(LAUNCH_FUSION_ENV_VAR) : "");
+    return &launchFuser;
+}
+
+namespace {
+    // a launch kernelGo has held back, to run in one dispatch with the ones after it; see launch_fusion.h
+    class PendingLaunch {
+    public:
+        FusableLaunch fusable;
+        CLKernel *kernel = 0;  // for running it on its own
+        std::string kernelName;
+        std::string devicellsourcecode;
+        std::vector<int> clmemIndexByClmemArgIndex;
+        KernelSpecialization specialization;
+        std::string buildOptions;
+        int scratchBytesPerWorkItem = 0;  // see KernelInfo
+        CLQueue *queue = 0;  // NOT owned
+        CoclStream *coclStream = 0;  // NOT owned
+        std::vector<cl_mem> clmems;
+        std::vector<std::unique_ptr<Arg> > args;
+        std::vector<cl_mem> kernelArgsToBeReleased;
+    };
+
+    // per thread, since they are compiled for the thread's context.  They run at the thread's next runtime call
+    // that could see their results, eg a memcpy or synchronize, or when the thread exits; another thread
+    // synchronizing the stream, or the context, doesnt run them
+    class HeldLaunches {
+    public:
+        ~HeldLaunches();
+        std::vector<std::unique_ptr<PendingLaunch> > launches;
+        LaunchBatch batch;
+    };
+}
+
+static HeldLaunches &getHeldLaunches() {
+    // running them at thread exit needs the thread's ThreadVars, so create that first: thread_locals are destroyed
+    // in the reverse order to the one they were created in
+    getThreadVars();
+    static thread_local HeldLaunches heldLaunches;
+    return heldLaunches;
+}
+
 std::unique_ptr< ArgStore_base > g_arg;
 
 size_t cuInit(unsigned int flags) {
@@ -93,11 +150,7 @@ int cudaConfigureCall(
     // pthread_mutex_lock(&launchMutex);
     // std::lock_guard< std::recursive_mutex > guard(launchMutex);
     launchMutex.lock();
-    CoclStream *coclStream = (CoclStream *)queue_as_voidstar;
-    ThreadVars *v = getThreadVars();
-    if(coclStream == 0) {
-        coclStream = v->currentContext->default_stream.get();
-    }
+    CoclStream *coclStream = resolveStream(queue_as_voidstar);
     CLQueue *clqueue = coclStream->clqueue;
     if(sharedMem != 0) {
         COCL_PRINT("cudaConfigureCall: Not implemented: non-zero shared memory");
@@ -149,7 +202,8 @@ CLKernel *compileOpenCLKernel(string originalKernelName, string clSourcecode) {
     return compileOpenCLKernel(originalKernelName, originalKernelName, originalKernelName, clSourcecode);
 }
 
-CLKernel *compileOpenCLKernel(string originalKernelName, string uniqueKernelName, string shortKernelName, string clSourcecode) {
+CLKernel *compileOpenCLKernel(string originalKernelName, string uniqueKernelName, string shortKernelName, string clSourcecode,
+        string buildOptions) {
     // returns already-built kernel if available, based on the name
     // otherwise builds passed-in clsourcecode, caches that, and returns resulting kernel
     // (opencl generation has already happened prior to this function)
@@ -185,7 +239,8 @@ CLKernel *compileOpenCLKernel(string originalKernelName, string uniqueKernelName
 
     CLKernel *kernel = 0;
     try {
-        kernel = cl->buildKernelFromString(clSourcecode, shortKernelName, "", "__internal__", true);
+        COCL_PRINT("compileOpenCLKernel build options: " << buildOptions);
+        kernel = cl->buildKernelFromString(clSourcecode, shortKernelName, buildOptions, "__internal__", true);
         if(getenv("COCL_DUMP_BUILD_LOGS") != 0) {
             if(kernel->buildLog != "") {
                 std::cout << kernel->buildLog << std::endl;
@@ -210,7 +265,8 @@ CLKernel *compileOpenCLKernel(string originalKernelName, string uniqueKernelName
 }
 
 GenerateOpenCLResult generateOpenCL(
-        int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, string origKernelName, string devicellsourcecode) {
+        int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, string origKernelName, string devicellsourcecode,
+        const KernelSpecialization &specialization) {
     // generates OpenCL source-code, based on passed-in bytecode
     // returns cached source-code if available
 
@@ -224,6 +280,7 @@ GenerateOpenCLResult generateOpenCL(
     for(int i = 0; i < clmemIndexByClmemArgIndex.size(); i++) {
         uniqueKernelName_ss << "_" << clmemIndexByClmemArgIndex[i];
     }
+    uniqueKernelName_ss << specialization.getSuffix();
     launchConfiguration.uniqueKernelName = uniqueKernelName_ss.str();
     if(v->getContext()->clSourceCodeCache.find(launchConfiguration.uniqueKernelName) != v->getContext()->clSourceCodeCache.end()) {
         std::string clSourcecode = v->getContext()->clSourceCodeCache[launchConfiguration.uniqueKernelName];
@@ -241,11 +298,26 @@ GenerateOpenCLResult generateOpenCL(
             f.close();
         }
         ModuleClRes res = convertLlStringToCl(
-            uniqueClmemCount, clmemIndexByClmemArgIndex, devicellsourcecode, origKernelName, launchConfiguration.shortKernelName, v->offsets_32bit);
+            uniqueClmemCount, clmemIndexByClmemArgIndex, devicellsourcecode, origKernelName, launchConfiguration.shortKernelName, v->offsets_32bit,
+            specialization);
         std::string clSourcecode = res.clSourcecode;
         KernelInfo kernelInfo;
         kernelInfo.usesVmem = res.usesVmem;
         kernelInfo.usesScratch = res.usesScratch;
+        kernelInfo.scratchBytesPerWorkItem = res.scratchBytesPerWorkItem;
+        kernelInfo.usesConstants = res.usesConstants;
+        kernelInfo.usesSharedMemory = res.usesSharedMemory;
+        kernelInfo.writtenClmems = res.writtenClmems;
+        kernelInfo.textureArgIsImage = res.textureArgIsImage;
+        kernelInfo.constantsImage = res.constantsImage;
+        kernelInfo.constantOffsetByName = res.constantOffsetByName;
+        kernelInfo.buildOptions = res.buildOptions;
+        if(res.usesFloatAtomics) {
+            string floatAtomicsOptions = getCoclDeviceByGpuOrdinal(v->getContext()->gpuOrdinal)->floatAtomicsBuildOptions;
+            if(floatAtomicsOptions != "") {
+                kernelInfo.buildOptions += (kernelInfo.buildOptions != "" ? " " : "") + floatAtomicsOptions;
+            }
+        }
         clSourcecode = "// origKernelName: " + origKernelName + "\n" +
             "// uniqueKernelName: " + launchConfiguration.uniqueKernelName + "\n" +
             "// shortKernelName: " + launchConfiguration.shortKernelName + "\n" +
@@ -276,6 +348,7 @@ void configureKernel(const char *kernelName, const char *devicellsourcecode) {
     COCL_PRINT("=========================================");
     launchConfiguration.kernelName = kernelName;
     launchConfiguration.devicellsourcecode = devicellsourcecode;
+    launchConfiguration.deviceModule = devicellsourcecode;
 
     // in order to handle by-value structs containing pointers to gpu structs, we're first going
     // to add the first Memory object to the clmems, so it is available to the kernel, for
@@ -289,7 +362,9 @@ void configureKernel(const char *kernelName, const char *devicellsourcecode) {
     Memory *firstMem = *v->getContext()->memories.begin();
     // std::cout << "setKernelArgHostsideBuffer firstMem=" << firstMem << std::endl;
     // if its not zero, then pass it into kernel
+    // pointer arguments into it reuse clmem0, rather than getting a second, aliasing, restrict parameter
     if(firstMem != 0) {
+        launchConfiguration.clmemIndexByClmem[firstMem->clmem] = 0;
         launchConfiguration.clmems.push_back(firstMem->clmem);
         // addClmemArg(firstMem->clmem);
     }
@@ -391,6 +466,7 @@ void setKernelArgGpuBuffer(char *memory_as_charstar, int32_t elementSize) {
     } else {
         size_t offset = memory->getOffset(memory_as_charstar);
         cl_mem clmem = memory->clmem;
+        memory->migrateToDevice(launchConfiguration.coclStream);  // if it's managed
         // std::cout << " clmem=" << clmem << std::endl;
 
         size_t offsetElements = offset;
@@ -408,6 +484,24 @@ void setKernelArgGpuBuffer(char *memory_as_charstar, int32_t elementSize) {
     // pthread_mutex_unlock(&launchMutex);
 }
 
+void setKernelArgTexture(char *texture_as_charstar) {
+    // linear memory textures are passed like any other gpu buffer, since tex1Dfetch is just a load
+    // pitch2D textures are passed as their image, then their sampler, see KernelDumper
+    std::lock_guard< std::recursive_mutex > guard(launchMutex);
+    CoclTexture *texture = findTexture(texture_as_charstar);
+    if(texture->resType == cudaResourceTypeLinear) {
+        COCL_PRINT("setKernelArgTexture linear");
+        launchConfiguration.textureArgIsImage.push_back(false);
+        setKernelArgGpuBuffer(texture->devPtr, 0);
+        return;
+    }
+    COCL_PRINT("setKernelArgTexture pitch2D " << texture->width << "x" << texture->height);
+    launchConfiguration.textureArgIsImage.push_back(true);
+    flushFusedLaunches();  // they might write to the memory we copy
+    texture->copyToImage(launchConfiguration.coclStream);
+    launchConfiguration.args.push_back(std::unique_ptr<Arg>(new TextureArg(texture->image, texture->sampler)));
+}
+
 void setKernelArgInt64(int64_t value) {
     std::lock_guard< std::recursive_mutex > guard(launchMutex);
     // pthread_mutex_lock(&launchMutex);
@@ -440,6 +534,276 @@ void setKernelArgFloat(float value) {
     // pthread_mutex_unlock(&launchMutex);
 }
 
+void addConstantSymbol(const char *name, char *hostPtr, int size) {
+    std::lock_guard< std::recursive_mutex > guard(launchMutex);
+    launchConfiguration.constantSymbols.push_back(ConstantSymbol { name, hostPtr, size });
+}
+
+// returns the constants buffer for the module we are launching from, first writing the current values
+// of the __constant__ variables into it, if cudaMemcpyToSymbol might have changed them since last time
+static cl_mem *getConstantsBuffer(Context *context, const KernelInfo &kernelInfo) {
+    ContextMutex contextMutex(context);
+    const char *deviceModule = launchConfiguration.deviceModule;
+    long long version = getConstantSymbolsVersion();
+    auto versionIt = context->constantsVersionByModule.find(deviceModule);
+    if(versionIt != context->constantsVersionByModule.end() && versionIt->second == version) {
+        return &context->constantsBufferByModule[deviceModule];
+    }
+    string image = kernelInfo.constantsImage;
+    for(auto it=launchConfiguration.constantSymbols.begin(); it != launchConfiguration.constantSymbols.end(); it++) {
+        auto offsetIt = kernelInfo.constantOffsetByName.find(it->name);
+        if(offsetIt == kernelInfo.constantOffsetByName.end()) {
+            continue;
+        }
+        int offset = offsetIt->second;
+        int size = min(it->size, (int)image.size() - offset);
+        memcpy(&image[offset], it->hostPtr, size);
+    }
+    cl_int err;
+    if(context->constantsBufferByModule.find(deviceModule) == context->constantsBufferByModule.end()) {
+        cl_mem clmem = clCreateBuffer(*context->getCl()->context, CL_MEM_READ_ONLY, image.size(), NULL, &err);
+        EasyCL::checkError(err);
+        context->constantsBufferByModule[deviceModule] = clmem;
+    }
+    cl_mem *clmem = &context->constantsBufferByModule[deviceModule];
+    // ordered like any other command in the stream; blocking, since image is gone once we return
+    CoclStream *coclStream = launchConfiguration.coclStream;
+    syncWithLegacyStream(coclStream);
+    err = clEnqueueWriteBuffer(coclStream->clqueue->queue, *clmem, CL_TRUE, 0, image.size(), image.data(),
+        coclStream->waitListSize(), coclStream->waitList(), coclStream->eventOut());
+    EasyCL::checkError(err);
+    coclStream->commandEnqueued();
+    context->constantsVersionByModule[deviceModule] = version;
+    return clmem;
+}
+
+// the clmems, each followed by its offset in our virtual memory system, then the args
+static void injectClmemsAndArgs(CLKernel *kernel, std::vector<cl_mem> &clmems, std::vector<std::unique_ptr<Arg> > &args) {
+    ThreadVars *v = getThreadVars();
+    for(int i = 0; i < clmems.size(); i++) {
+        COCL_PRINT("clmem" << i);
+        kernel->inout(&clmems[i]);
+        // we also need to write out the offset of this clmem, in our virtual memory system
+        cl_mem clmem = clmems[i];
+        Memory *memory = findMemoryByClmem(clmem);
+        uint64_t vmemloc = 0;
+        if(memory != 0) {  // hostsidegpu buffers will be 0
+            vmemloc = memory->fakePos;
+        }
+        if(v->offsets_32bit) {
+            kernel->in((uint32_t)vmemloc);
+        } else {
+            kernel->in((int64_t)vmemloc);
+        }
+    }
+    for(int i = 0; i < args.size(); i++) {
+        COCL_PRINT("i=" << i << " " << args[i]->str());
+        args[i]->inject(kernel);
+    }
+}
+
+static void releaseKernelArgs(std::vector<cl_mem> &kernelArgsToBeReleased) {
+    for(auto it=kernelArgsToBeReleased.begin(); it != kernelArgsToBeReleased.end(); it++) {
+        cl_mem memObject = *it;
+        cl_int err = clReleaseMemObject(memObject);
+        EasyCL::checkError(err);
+    }
+    kernelArgsToBeReleased.clear();
+}
+
+static void clearLaunchConfiguration() {
+    launchConfiguration.kernelArgsToBeReleased.clear();
+    launchConfiguration.args.clear();
+    launchConfiguration.constantSymbols.clear();
+    launchConfiguration.textureArgIsImage.clear();
+
+    launchConfiguration.clmemIndexByClmem.clear();
+    launchConfiguration.clmems.clear();
+    launchConfiguration.clmemIndexByClmemArgIndex.clear();
+}
+
+// every kernel has a local int *scratch parameter, but it only needs room for anything when the kernel shuffles
+// or votes through it; scratchBytesPerWorkItem is 0 otherwise.  A shuffle can read any lane of its warp, so the
+// last warp needs all 32 lanes, even when the work-group size isnt a multiple of 32
+static int getScratchInts(int scratchBytesPerWorkItem, int workgroupSize) {
+    if(scratchBytesPerWorkItem == 0) {
+        return 1;
+    }
+    int warpsSize = (workgroupSize + 31) / 32 * 32;
+    return max(4, warpsSize * scratchBytesPerWorkItem / 4);
+}
+
+// we only know what a kernel writes through its pointer arguments, see launch_fusion.h
+static bool isFusable(const KernelInfo &kernelInfo) {
+    if(kernelInfo.usesVmem || kernelInfo.usesConstants || kernelInfo.usesSharedMemory) {
+        return false;
+    }
+    for(int i = 0; i < launchConfiguration.args.size(); i++) {
+        if(llvm::isa<TextureArg>(launchConfiguration.args[i].get())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// how many bytes of the fused kernel's parameters each launch adds: its clmems, each with its vmem offset, its
+// arguments, and its grid size.  Drivers pad small arguments, so we count those as 4 bytes
+static size_t getLaunchParamBytes(int pointerBytes) {
+    ThreadVars *v = getThreadVars();
+    size_t bytes = launchConfiguration.clmems.size() * (pointerBytes + (v->offsets_32bit ? 4 : 8));
+    for(int i = 0; i < launchConfiguration.args.size(); i++) {
+        Arg *arg = launchConfiguration.args[i].get();
+        if(llvm::isa<Int64Arg>(arg)) {
+            bytes += 8;
+        } else if(llvm::isa<Int8Arg>(arg) || llvm::isa<Int32Arg>(arg) || llvm::isa<UInt32Arg>(arg)
+                || llvm::isa<FloatArg>(arg)) {
+            bytes += 4;
+        } else {
+            bytes += pointerBytes;
+        }
+    }
+    return bytes + 3 * sizeof(uint32_t);
+}
+
+namespace cocl {
+
+// runs the held back launches: on their own if there is only one, otherwise as one dispatch of a kernel generated
+// for that many launches, see KernelDumper::writeFusedDispatcher
+void flushFusedLaunches() {
+    HeldLaunches &held = getHeldLaunches();
+    if(held.launches.size() == 0) {
+        return;
+    }
+    std::lock_guard< std::recursive_mutex > guard(launchMutex);
+    std::vector<std::unique_ptr<PendingLaunch> > launches;
+    launches.swap(held.launches);
+    size_t numBlocks = held.batch.getNumBlocks();
+    held.batch.clear();
+    COCL_PRINT("flushFusedLaunches " << launches.size() << " launches, " << numBlocks << " blocks");
+
+    PendingLaunch *first = launches[0].get();
+    CLKernel *kernel = first->kernel;
+    size_t global[3];
+    for(int i = 0; i < 3; i++) {
+        global[i] = first->fusable.grid[i] * first->fusable.block[i];
+    }
+    if(launches.size() > 1) {
+        KernelSpecialization specialization = first->specialization;
+        specialization.fusedLaunches = launches.size();
+        // we might be in the middle of configuring another launch
+        string uniqueKernelName = launchConfiguration.uniqueKernelName;
+        string shortKernelName = launchConfiguration.shortKernelName;
+        GenerateOpenCLResult res = generateOpenCL(
+            first->clmems.size(), first->clmemIndexByClmemArgIndex, first->kernelName, first->devicellsourcecode,
+            specialization);
+        launchConfiguration.uniqueKernelName = uniqueKernelName;
+        launchConfiguration.shortKernelName = shortKernelName;
+        kernel = compileOpenCLKernel(first->kernelName, res.uniqueKernelName, res.shortKernelName, res.clSourcecode,
+            first->buildOptions);
+        global[0] = numBlocks * first->fusable.block[0];
+        global[1] = first->fusable.block[1];
+        global[2] = first->fusable.block[2];
+    }
+    for(auto it = launches.begin(); it != launches.end(); it++) {
+        injectClmemsAndArgs(kernel, (*it)->clmems, (*it)->args);
+    }
+    int workgroupSize = first->fusable.block[0] * first->fusable.block[1] * first->fusable.block[2];
+    kernel->localInts(getScratchInts(first->scratchBytesPerWorkItem, workgroupSize));
+    if(launches.size() > 1) {
+        for(auto it = launches.begin(); it != launches.end(); it++) {
+            for(int i = 0; i < 3; i++) {
+                kernel->in_uint32((uint32_t)(*it)->fusable.grid[i]);
+            }
+        }
+    }
+
+    try {
+        syncWithLegacyStream(first->coclStream);
+        first->coclStream->beginUntrackedCommand();
+        kernel->run(first->queue, 3, global, first->fusable.block);
+        first->coclStream->endUntrackedCommand();
+    } catch(runtime_error &e) {
+        if(kernel->buildLog != "") {
+            std::cout << kernel->buildLog << std::endl;
+        }
+        cout << "fused kernel failed to run" << endl;
+        cout << "kernel name: [" << first->kernelName << "]" << endl;
+        throw e;
+    }
+    cl_int err = clFinish(first->queue->queue);
+    EasyCL::checkError(err);
+    for(auto it = launches.begin(); it != launches.end(); it++) {
+        releaseKernelArgs((*it)->kernelArgsToBeReleased);
+    }
+}
+
+} // namespace cocl
+
+HeldLaunches::~HeldLaunches() {
+    // otherwise they would never run, and their hostside buffers would leak
+    try {
+        flushFusedLaunches();
+    } catch(runtime_error &e) {
+        cout << "held back launches failed to run at thread exit: " << e.what() << endl;
+    }
+}
+
+// moves the launch we are configuring onto the held launches, first running the ones there, if it cant join them
+static void holdLaunch(CLKernel *kernel, const KernelSpecialization &specialization, const KernelInfo &kernelInfo) {
+    std::unique_ptr<PendingLaunch> launch(new PendingLaunch());
+    FusableLaunch &fusable = launch->fusable;
+    fusable.uniqueKernelName = launchConfiguration.uniqueKernelName;
+    fusable.queue = launchConfiguration.queue;
+    for(int i = 0; i < 3; i++) {
+        fusable.grid[i] = launchConfiguration.grid[i];
+        fusable.block[i] = launchConfiguration.block[i];
+    }
+    // clmem0 is only there for vmem, unless an argument uses it too
+    for(int i = 0; i < launchConfiguration.clmemIndexByClmemArgIndex.size(); i++) {
+        int clmemIndex = launchConfiguration.clmemIndexByClmemArgIndex[i];
+        cl_mem clmem = launchConfiguration.clmems[clmemIndex];
+        if(clmem == 0) {
+            continue;
+        }
+        fusable.buffers.insert(clmem);
+        if(kernelInfo.writtenClmems.find(clmemIndex) != kernelInfo.writtenClmems.end()) {
+            fusable.writtenBuffers.insert(clmem);
+        }
+    }
+    // the fused kernel takes every launch's parameters, which have to fit in the device's
+    // CL_DEVICE_MAX_PARAMETER_SIZE, as little as 1024 bytes.  All the launches in a batch are of the same kernel,
+    // so take the same parameters.  None of them are constant, since we dont fuse kernels using __constant__
+    CoclDevice *device = getCoclDeviceByGpuOrdinal(getThreadVars()->getContext()->gpuOrdinal);
+    int pointerBytes = device->addressBits / 8;
+    int maxLaunches = getLaunchFuser()->getMaxLaunches(
+        getLaunchParamBytes(pointerBytes), pointerBytes, device->maxParameterSize);
+    HeldLaunches &held = getHeldLaunches();
+    if(!held.batch.canAdd(fusable, maxLaunches)) {
+        flushFusedLaunches();
+    }
+    held.batch.add(fusable);
+
+    launch->kernel = kernel;
+    launch->kernelName = launchConfiguration.kernelName;
+    launch->devicellsourcecode = launchConfiguration.devicellsourcecode;
+    launch->clmemIndexByClmemArgIndex = launchConfiguration.clmemIndexByClmemArgIndex;
+    launch->specialization = specialization;
+    launch->buildOptions = kernelInfo.buildOptions;
+    launch->scratchBytesPerWorkItem = kernelInfo.usesScratch ? kernelInfo.scratchBytesPerWorkItem : 0;
+    launch->queue = launchConfiguration.queue;
+    launch->coclStream = launchConfiguration.coclStream;
+    launch->clmems = launchConfiguration.clmems;
+    launch->args = std::move(launchConfiguration.args);
+    launch->kernelArgsToBeReleased = launchConfiguration.kernelArgsToBeReleased;
+    held.launches.push_back(std::move(launch));
+    clearLaunchConfiguration();
+    COCL_PRINT("holdLaunch: " << held.batch.size() << " launches held");
+
+    if(held.batch.size() >= maxLaunches) {
+        flushFusedLaunches();
+    }
+}
+
 void kernelGo() {
     try {
     launchMutex.lock();
@@ -448,13 +812,39 @@ void kernelGo() {
 
     ThreadVars *v = getThreadVars();
 
+    map<int, int> int32ValueByArgIndex;
+    for(int i = 0; i < launchConfiguration.args.size(); i++) {
+        if(Int32Arg *arg = llvm::dyn_cast<Int32Arg>(launchConfiguration.args[i].get())) {
+            int32ValueByArgIndex[i] = arg->v;
+        }
+    }
+    KernelSpecialization specialization = getKernelSpecializer()->choose(
+        launchConfiguration.kernelName, int32ValueByArgIndex, launchConfiguration.block);
     GenerateOpenCLResult res = generateOpenCL(
-        launchConfiguration.clmems.size(), launchConfiguration.clmemIndexByClmemArgIndex, launchConfiguration.kernelName, launchConfiguration.devicellsourcecode);
+        launchConfiguration.clmems.size(), launchConfiguration.clmemIndexByClmemArgIndex, launchConfiguration.kernelName, launchConfiguration.devicellsourcecode,
+        specialization);
     COCL_PRINT("kernelGo() kernel: " << launchConfiguration.kernelName);
-    CLKernel *kernel = compileOpenCLKernel(launchConfiguration.kernelName, res.uniqueKernelName, res.shortKernelName, res.clSourcecode);
+    KernelInfo kernelInfo = v->getContext()->kernelInfoByUniqueName[launchConfiguration.uniqueKernelName];
+    CLKernel *kernel = compileOpenCLKernel(launchConfiguration.kernelName, res.uniqueKernelName, res.shortKernelName, res.clSourcecode,
+        kernelInfo.buildOptions);
     COCL_PRINT("kernelGo() uniqueKernelName: " << launchConfiguration.uniqueKernelName);
 
-    KernelInfo kernelInfo = v->getContext()->kernelInfoByUniqueName[launchConfiguration.uniqueKernelName];
+    if(kernelInfo.textureArgIsImage != launchConfiguration.textureArgIsImage) {
+        // eg a pitch2D texture read with tex1Dfetch, or a linear one read with tex2D
+        cout << "kernel " << launchConfiguration.kernelName << " reads its textures as ";
+        for(int i = 0; i < kernelInfo.textureArgIsImage.size(); i++) {
+            cout << (kernelInfo.textureArgIsImage[i] ? "image " : "buffer ");
+        }
+        cout << "but was passed ";
+        for(int i = 0; i < launchConfiguration.textureArgIsImage.size(); i++) {
+            cout << (launchConfiguration.textureArgIsImage[i] ? "pitch2D " : "linear ");
+        }
+        cout << endl;
+        launchMutex.unlock();
+        launchMutex.unlock();
+        throw runtime_error("kernel " + launchConfiguration.kernelName + ": texture resource types dont match how the kernel reads them");
+    }
+
     COCL_PRINT("kernel uses vmem?: " << kernelInfo.usesVmem);
     COCL_PRINT("kernel uses scratch?: " << kernelInfo.usesScratch);
     if(kernelInfo.usesVmem) {
@@ -476,26 +866,19 @@ void kernelGo() {
         }
     }
 
-    // ThreadVars *v = getThreadVars();
-    for(int i = 0; i < launchConfiguration.clmems.size(); i++) {
-        COCL_PRINT("clmem" << i);
-        kernel->inout(&launchConfiguration.clmems[i]);
-        // we also need to write out the offset of this clmem, in our virtual memory system
-        cl_mem clmem = launchConfiguration.clmems[i];
-        Memory *memory = findMemoryByClmem(clmem);
-        uint64_t vmemloc = 0;
-        if(memory != 0) {  // hostsidegpu buffers will be 0
-            vmemloc = memory->fakePos;
-        }
-        if(v->offsets_32bit) {
-            kernel->in((uint32_t)vmemloc);
-        } else {
-            kernel->in((int64_t)vmemloc);
+    if(getLaunchFuser()->enabled()) {
+        if(isFusable(kernelInfo) && getLaunchFuser()->isSmall(launchConfiguration.grid)) {
+            holdLaunch(kernel, specialization, kernelInfo);
+            launchMutex.unlock();
+            launchMutex.unlock();
+            return;
         }
+        flushFusedLaunches();
     }
-    for(int i = 0; i < launchConfiguration.args.size(); i++) {
-        COCL_PRINT("i=" << i << " " << launchConfiguration.args[i]->str());
-        launchConfiguration.args[i]->inject(kernel);
+
+    injectClmemsAndArgs(kernel, launchConfiguration.clmems, launchConfiguration.args);
+    if(kernelInfo.usesConstants) {
+        kernel->inout(getConstantsBuffer(v->getContext(), kernelInfo));
     }
 
     size_t global[3];
@@ -506,10 +889,13 @@ void kernelGo() {
         << " global: " << global);
     int workgroupSize = launchConfiguration.block[0] * launchConfiguration.block[1] * launchConfiguration.block[2];
     COCL_PRINT("workgroupSize=" << workgroupSize);
-    kernel->localInts(max(4, workgroupSize));
+    kernel->localInts(getScratchInts(kernelInfo.usesScratch ? kernelInfo.scratchBytesPerWorkItem : 0, workgroupSize));
 
     try {
+        syncWithLegacyStream(launchConfiguration.coclStream);
+        launchConfiguration.coclStream->beginUntrackedCommand();
         kernel->run(launchConfiguration.queue, 3, global, launchConfiguration.block);
+        launchConfiguration.coclStream->endUntrackedCommand();
     } catch(runtime_error &e) {
         if(kernel->buildLog != "") {
             std::cout << kernel->buildLog << std::endl;
@@ -528,17 +914,8 @@ void kernelGo() {
     EasyCL::checkError(err);
     debugDumper.maybeDump();
 
-    for(auto it=launchConfiguration.kernelArgsToBeReleased.begin(); it != launchConfiguration.kernelArgsToBeReleased.end(); it++) {
-        cl_mem memObject = *it;
-        err = clReleaseMemObject(memObject);
-        EasyCL::checkError(err);
-    }
-    launchConfiguration.kernelArgsToBeReleased.clear();
-    launchConfiguration.args.clear();
-
-    launchConfiguration.clmemIndexByClmem.clear();
-    launchConfiguration.clmems.clear();
-    launchConfiguration.clmemIndexByClmemArgIndex.clear();
+    releaseKernelArgs(launchConfiguration.kernelArgsToBeReleased);
+    clearLaunchConfiguration();
 
     err = clFinish(launchConfiguration.queue->queue);
     EasyCL::checkError(err);
@@ -0,0 +1,391 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/index_demotion.h"
+
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/IR/Constants.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace llvm;
+
+namespace cocl {
+
+IntRange IntRange::full(int bits) {
+    if(bits >= 64) {
+        return IntRange();
+    }
+    int64_t half = (int64_t)1 << (bits - 1);
+    return IntRange(-half, half - 1);
+}
+
+bool IntRange::fitsIn(int bits) const {
+    IntRange typeRange = full(bits);
+    return lo >= typeRange.lo && hi <= typeRange.hi;
+}
+
+IntRange IntRange::intersect(const IntRange &other) const {
+    return IntRange(std::max(lo, other.lo), std::min(hi, other.hi));
+}
+
+IntRange IntRange::unite(const IntRange &other) const {
+    return IntRange(std::min(lo, other.lo), std::max(hi, other.hi));
+}
+
+static IntRange addRanges(const IntRange &a, const IntRange &b) {
+    IntRange res;
+    if(__builtin_add_overflow(a.lo, b.lo, &res.lo) || __builtin_add_overflow(a.hi, b.hi, &res.hi)) {
+        return IntRange();
+    }
+    return res;
+}
+
+static IntRange subRanges(const IntRange &a, const IntRange &b) {
+    IntRange res;
+    if(__builtin_sub_overflow(a.lo, b.hi, &res.lo) || __builtin_sub_overflow(a.hi, b.lo, &res.hi)) {
+        return IntRange();
+    }
+    return res;
+}
+
+static IntRange mulRanges(const IntRange &a, const IntRange &b) {
+    int64_t corners[4];
+    if(__builtin_mul_overflow(a.lo, b.lo, &corners[0]) || __builtin_mul_overflow(a.lo, b.hi, &corners[1])
+            || __builtin_mul_overflow(a.hi, b.lo, &corners[2]) || __builtin_mul_overflow(a.hi, b.hi, &corners[3])) {
+        return IntRange();
+    }
+    return IntRange(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+}
+
+static int getBits(Value *value) {
+    IntegerType *intType = dyn_cast<IntegerType>(value->getType());
+    return intType == 0 ? 64 : (int)intType->getBitWidth();
+}
+
+// eg llvm.nvvm.read.ptx.sreg.tid.x, or llvm.ptx.read.tid.x, for llvm 3.8
+IntRange IndexDemotion::getSpecialRegisterRange(std::string functionName) {
+    const string prefixes[] = {"llvm.nvvm.read.ptx.sreg.", "llvm.ptx.read."};
+    for(const string &prefix : prefixes) {
+        if(functionName.find(prefix) != 0 || functionName.size() < prefix.size() + 2) {
+            continue;
+        }
+        string specialRegister = functionName.substr(prefix.size(), functionName.size() - prefix.size() - 2);
+        char dimension = functionName[functionName.size() - 1];
+        if(functionName[functionName.size() - 2] != '.' || dimension < 'x' || dimension > 'z') {
+            continue;
+        }
+        int d = dimension - 'x';
+        if(specialRegister == "tid") {
+            return IntRange(0, bounds.block[d] - 1);
+        } else if(specialRegister == "ntid") {
+            return IntRange(1, bounds.block[d]);
+        } else if(specialRegister == "ctaid") {
+            return IntRange(0, bounds.grid[d] - 1);
+        } else if(specialRegister == "nctaid") {
+            return IntRange(1, bounds.grid[d]);
+        }
+    }
+    return IntRange();
+}
+
+// the range the definition of value gives, before we look at any comparisons
+IntRange IndexDemotion::getDefinitionRange(llvm::Value *value, llvm::BasicBlock *block, int depth) {
+    int bits = getBits(value);
+    IntRange typeRange = IntRange::full(bits);
+    if(ConstantInt *constant = dyn_cast<ConstantInt>(value)) {
+        if(bits > 64) {
+            return typeRange;
+        }
+        int64_t v = bits == 1 ? (int64_t)constant->getZExtValue() : constant->getSExtValue();
+        return IntRange(v, v);
+    }
+    if(CallInst *call = dyn_cast<CallInst>(value)) {
+        Function *called = call->getCalledFunction();
+        if(called == 0) {
+            return typeRange;
+        }
+        return getSpecialRegisterRange(called->getName().str()).intersect(typeRange);
+    }
+    Instruction *instr = dyn_cast<Instruction>(value);
+    if(instr == 0 || bits > 64) {
+        return typeRange;
+    }
+    IntRange res = typeRange;
+    switch(instr->getOpcode()) {
+        case Instruction::SExt:
+            return getRange(instr->getOperand(0), block, depth + 1);
+        case Instruction::ZExt: {
+            IntRange operand = getRange(instr->getOperand(0), block, depth + 1);
+            if(operand.lo >= 0) {
+                return operand;
+            }
+            int operandBits = getBits(instr->getOperand(0));
+            return operandBits < 63 ? IntRange(0, ((int64_t)1 << operandBits) - 1) : typeRange;
+        }
+        case Instruction::Trunc: {
+            IntRange operand = getRange(instr->getOperand(0), block, depth + 1);
+            return operand.fitsIn(bits) ? operand : typeRange;
+        }
+        case Instruction::Add:
+            res = addRanges(getRange(instr->getOperand(0), block, depth + 1), getRange(instr->getOperand(1), block, depth + 1));
+            break;
+        case Instruction::Sub:
+            res = subRanges(getRange(instr->getOperand(0), block, depth + 1), getRange(instr->getOperand(1), block, depth + 1));
+            break;
+        case Instruction::Mul:
+            res = mulRanges(getRange(instr->getOperand(0), block, depth + 1), getRange(instr->getOperand(1), block, depth + 1));
+            break;
+        case Instruction::Shl: {
+            ConstantInt *shift = dyn_cast<ConstantInt>(instr->getOperand(1));
+            if(shift == 0 || shift->getZExtValue() >= 62) {
+                return typeRange;
+            }
+            int64_t factor = (int64_t)1 << shift->getZExtValue();
+            res = mulRanges(getRange(instr->getOperand(0), block, depth + 1), IntRange(factor, factor));
+            break;
+        }
+        case Instruction::LShr:
+        case Instruction::AShr: {
+            ConstantInt *shift = dyn_cast<ConstantInt>(instr->getOperand(1));
+            IntRange operand = getRange(instr->getOperand(0), block, depth + 1);
+            if(shift == 0 || shift->getZExtValue() >= 64 || (instr->getOpcode() == Instruction::LShr && operand.lo < 0)) {
+                return typeRange;
+            }
+            int shiftBits = (int)shift->getZExtValue();
+            res = IntRange(operand.lo >> shiftBits, operand.hi >> shiftBits);
+            break;
+        }
+        case Instruction::UDiv:
+        case Instruction::SDiv: {
+            ConstantInt *divisor = dyn_cast<ConstantInt>(instr->getOperand(1));
+            IntRange operand = getRange(instr->getOperand(0), block, depth + 1);
+            if(divisor == 0 || divisor->getSExtValue() <= 0 || operand.lo < 0) {
+                return typeRange;
+            }
+            res = IntRange(operand.lo / divisor->getSExtValue(), operand.hi / divisor->getSExtValue());
+            break;
+        }
+        case Instruction::URem:
+        case Instruction::SRem: {
+            ConstantInt *divisor = dyn_cast<ConstantInt>(instr->getOperand(1));
+            IntRange operand = getRange(instr->getOperand(0), block, depth + 1);
+            if(divisor == 0 || divisor->getSExtValue() <= 0 || operand.lo < 0) {
+                return typeRange;
+            }
+            res = IntRange(0, std::min(operand.hi, divisor->getSExtValue() - 1));
+            break;
+        }
+        case Instruction::And: {
+            IntRange a = getRange(instr->getOperand(0), block, depth + 1);
+            IntRange b = getRange(instr->getOperand(1), block, depth + 1);
+            if(a.lo >= 0 && b.lo >= 0) {
+                res = IntRange(0, std::min(a.hi, b.hi));
+            } else if(a.lo >= 0) {
+                res = IntRange(0, a.hi);
+            } else if(b.lo >= 0) {
+                res = IntRange(0, b.hi);
+            }
+            break;
+        }
+        case Instruction::Select:
+            res = getRange(instr->getOperand(1), block, depth + 1).unite(getRange(instr->getOperand(2), block, depth + 1));
+            break;
+        default:
+            return typeRange;
+    }
+    // wrapped, or, with nsw, poison, either way we know nothing
+    return res.fitsIn(bits) ? res : typeRange;
+}
+
+// the range of value if "value predicate other" holds
+IntRange IndexDemotion::getConditionRange(llvm::CmpInst::Predicate predicate, llvm::Value *other,
+        llvm::BasicBlock *block, int depth) {
+    IntRange otherRange = getRange(other, block, depth + 1);
+    switch(predicate) {
+        case CmpInst::ICMP_EQ:
+            return otherRange;
+        case CmpInst::ICMP_SLT:
+            return otherRange.hi == INT64_MIN ? IntRange() : IntRange(INT64_MIN, otherRange.hi - 1);
+        case CmpInst::ICMP_SLE:
+            return IntRange(INT64_MIN, otherRange.hi);
+        case CmpInst::ICMP_SGT:
+            return otherRange.lo == INT64_MAX ? IntRange() : IntRange(otherRange.lo + 1, INT64_MAX);
+        case CmpInst::ICMP_SGE:
+            return IntRange(otherRange.lo, INT64_MAX);
+        // below a non-negative value, unsigned, means non-negative, signed
+        case CmpInst::ICMP_ULT:
+            return otherRange.lo >= 0 && otherRange.hi > 0 ? IntRange(0, otherRange.hi - 1) : IntRange();
+        case CmpInst::ICMP_ULE:
+            return otherRange.lo >= 0 ? IntRange(0, otherRange.hi) : IntRange();
+        default:
+            return IntRange();
+    }
+}
+
+// whether compared is value, or the same number in a different width
+static bool isSameNumber(Value *compared, Value *value) {
+    if(compared == value) {
+        return true;
+    }
+    if(SExtInst *sext = dyn_cast<SExtInst>(compared)) {
+        if(sext->getOperand(0) == value) {
+            return true;
+        }
+    }
+    if(SExtInst *sext = dyn_cast<SExtInst>(value)) {
+        if(sext->getOperand(0) == compared) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// narrows range by the comparisons on the branches that every path to block goes through
+IntRange IndexDemotion::applyConditions(llvm::Value *value, llvm::BasicBlock *block, IntRange range, int depth) {
+    for(DomTreeNode *node = domTree->getNode(block); node != 0; node = node->getIDom()) {
+        BasicBlock *dominator = node->getBlock();
+        BasicBlock *predecessor = dominator->getSinglePredecessor();
+        if(predecessor == 0) {
+            continue;
+        }
+        BranchInst *branch = dyn_cast<BranchInst>(predecessor->getTerminator());
+        if(branch == 0 || !branch->isConditional() || branch->getSuccessor(0) == branch->getSuccessor(1)) {
+            continue;
+        }
+        ICmpInst *compare = dyn_cast<ICmpInst>(branch->getCondition());
+        if(compare == 0) {
+            continue;
+        }
+        CmpInst::Predicate predicate = compare->getPredicate();
+        if(branch->getSuccessor(1) == dominator) {
+            predicate = CmpInst::getInversePredicate(predicate);
+        }
+        if(isSameNumber(compare->getOperand(0), value)) {
+            range = range.intersect(getConditionRange(predicate, compare->getOperand(1), predecessor, depth));
+        } else if(isSameNumber(compare->getOperand(1), value)) {
+            range = range.intersect(getConditionRange(CmpInst::getSwappedPredicate(predicate), compare->getOperand(0),
+                predecessor, depth));
+        }
+    }
+    return range;
+}
+
+IntRange IndexDemotion::getRange(llvm::Value *value, llvm::BasicBlock *block, int depth) {
+    if(!value->getType()->isIntegerTy()) {
+        return IntRange();
+    }
+    if(depth > MaxDepth) {
+        return IntRange::full(getBits(value));
+    }
+    IntRange range = getDefinitionRange(value, block, depth);
+    return applyConditions(value, block, range, depth);
+}
+
+// the 32-bit value that value is the sign extension of, or 0
+llvm::Value *IndexDemotion::get32BitValue(llvm::Value *value, llvm::BasicBlock *block) {
+    Type *int32Type = Type::getInt32Ty(value->getContext());
+    if(ConstantInt *constant = dyn_cast<ConstantInt>(value)) {
+        if(constant->getBitWidth() > 64 || !IntRange(constant->getSExtValue(), constant->getSExtValue()).fitsIn(32)) {
+            return 0;
+        }
+        return ConstantInt::get(int32Type, constant->getSExtValue(), true);
+    }
+    if(SExtInst *sext = dyn_cast<SExtInst>(value)) {
+        if(sext->getOperand(0)->getType()->isIntegerTy(32)) {
+            return sext->getOperand(0);
+        }
+    }
+    // same as the sign extension, if the top bit isnt set
+    if(ZExtInst *zext = dyn_cast<ZExtInst>(value)) {
+        if(zext->getOperand(0)->getType()->isIntegerTy(32) && getRange(zext->getOperand(0), block).lo >= 0) {
+            return zext->getOperand(0);
+        }
+    }
+    return 0;
+}
+
+static void eraseIfUnused(Value *value) {
+    Instruction *instr = dyn_cast<Instruction>(value);
+    if(instr != 0 && instr->use_empty() && (isa<SExtInst>(instr) || isa<ZExtInst>(instr))) {
+        instr->eraseFromParent();
+    }
+}
+
+bool IndexDemotion::demote(llvm::Instruction *instr) {
+    if(instr->getNumOperands() != 2 || !instr->getOperand(0)->getType()->isIntegerTy(64)) {
+        return false;
+    }
+    unsigned int opcode = instr->getOpcode();
+    bool isArithmetic = opcode == Instruction::Add || opcode == Instruction::Sub || opcode == Instruction::Mul
+        || opcode == Instruction::Shl;
+    if(!isArithmetic && !isa<ICmpInst>(instr)) {
+        return false;
+    }
+    if(opcode == Instruction::Shl) {
+        ConstantInt *shift = dyn_cast<ConstantInt>(instr->getOperand(1));
+        if(shift == 0 || shift->getZExtValue() >= 31) {
+            return false;
+        }
+    }
+    BasicBlock *block = instr->getParent();
+    Value *a = get32BitValue(instr->getOperand(0), block);
+    Value *b = get32BitValue(instr->getOperand(1), block);
+    if(a == 0 || b == 0 || (isa<Constant>(a) && isa<Constant>(b))) {
+        return false;
+    }
+    Value *demoted = 0;
+    if(ICmpInst *compare = dyn_cast<ICmpInst>(instr)) {
+        // sign extension keeps both the signed and the unsigned order
+        demoted = new ICmpInst(instr, compare->getPredicate(), a, b, "");
+    } else {
+        if(!getRange(instr, block).fitsIn(32)) {
+            return false;
+        }
+        Instruction *demotedOp = BinaryOperator::Create((Instruction::BinaryOps)opcode, a, b, "", instr);
+        demoted = new SExtInst(demotedOp, instr->getType(), "", instr);
+    }
+    Value *oldA = instr->getOperand(0);
+    Value *oldB = instr->getOperand(1);
+    instr->replaceAllUsesWith(demoted);
+    demoted->takeName(instr);
+    instr->eraseFromParent();
+    eraseIfUnused(oldA);
+    if(oldB != oldA) {
+        eraseIfUnused(oldB);
+    }
+    return true;
+}
+
+int IndexDemotion::run(llvm::Function *F) {
+    domTree.reset(new DominatorTree(*F));
+    // dominators first, so we demote operands before their users
+    vector<Instruction *> instructions;
+    for(DomTreeNode *node : depth_first(domTree->getRootNode())) {
+        for(auto it = node->getBlock()->begin(); it != node->getBlock()->end(); it++) {
+            instructions.push_back(&*it);
+        }
+    }
+    int numDemoted = 0;
+    for(Instruction *instr : instructions) {
+        if(demote(instr)) {
+            numDemoted++;
+        }
+    }
+    return numDemoted;
+}
+
+} // namespace cocl
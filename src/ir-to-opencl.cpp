@@ -21,29 +21,79 @@
 
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/SourceMgr.h"
 
+#include <cstdlib>
+
+#define GOTO_CONTROL_FLOW_ENV_VAR "COCL_GOTO_CONTROL_FLOW"
+#define NARROW_DECLARATIONS_ENV_VAR "COCL_NARROW_DECLARATIONS"
+#define DEMOTE_INDICES_ENV_VAR "COCL_DEMOTE_INDICES"
 
 namespace cocl {
 
+std::string getBuildOptions(llvm::Module *M) {
+    std::string buildOptions = "";
+    llvm::NamedMDNode *metadata = M->getNamedMetadata(COCL_BUILD_OPTIONS_METADATA);
+    if(metadata == 0) {
+        return buildOptions;
+    }
+    for(unsigned int i = 0; i < metadata->getNumOperands(); i++) {
+        llvm::MDNode *node = metadata->getOperand(i);
+        for(unsigned int j = 0; j < node->getNumOperands(); j++) {
+            if(llvm::MDString *option = llvm::dyn_cast<llvm::MDString>(node->getOperand(j))) {
+                if(buildOptions != "") {
+                    buildOptions += " ";
+                }
+                buildOptions += option->getString().str();
+            }
+        }
+    }
+    return buildOptions;
+}
+
 ModuleClRes convertModuleToCl(
         int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, llvm::Module *M, std::string specificFunction, std::string generatedName,
-        bool offsets_32bit) {
+        bool offsets_32bit, const KernelSpecialization &specialization) {
     cocl::KernelDumper kernelDumper(M, specificFunction, generatedName, offsets_32bit);
     kernelDumper.addIRToCl();
+    kernelDumper.setSpecialization(specialization);
+    if(getenv(GOTO_CONTROL_FLOW_ENV_VAR) != 0 && std::string(getenv(GOTO_CONTROL_FLOW_ENV_VAR)) == "1") {
+        kernelDumper.setStructuredControlFlow(false);
+    }
+    if(getenv(NARROW_DECLARATIONS_ENV_VAR) != 0 && std::string(getenv(NARROW_DECLARATIONS_ENV_VAR)) == "1") {
+        kernelDumper.setNarrowDeclarations(true);
+    }
+    if(getenv(DEMOTE_INDICES_ENV_VAR) != 0 && std::string(getenv(DEMOTE_INDICES_ENV_VAR)) == "0") {
+        kernelDumper.setDemoteIndices(false);
+    }
+    std::string buildOptions = getBuildOptions(M);
+    // cocl -use_fast_math
+    kernelDumper.setFastMath(buildOptions.find("-cl-fast-relaxed-math") != std::string::npos);
     std::string cl = kernelDumper.toCl(uniqueClmemCount, clmemIndexByClmemArgIndex);
     ModuleClRes res;
     res.clSourcecode = cl;
     res.usesVmem = kernelDumper.usesVmem;
     res.usesScratch = kernelDumper.usesScratch;
+    res.scratchBytesPerWorkItem = kernelDumper.scratchBytesPerWorkItem;
+    res.usesSharedMemory = kernelDumper.usesSharedMemory;
+    res.usesFloatAtomics = kernelDumper.usesFloatAtomics;
+    res.writtenClmems = kernelDumper.writtenClmems;
+    res.textureArgIsImage = kernelDumper.textureArgIsImage;
+    if(!kernelDumper.globalConstants->empty()) {
+        res.usesConstants = true;
+        res.constantsImage = kernelDumper.globalConstants->getImage();
+        res.constantOffsetByName = kernelDumper.globalConstants->getOffsetByName();
+    }
+    res.buildOptions = buildOptions;
     return res;
 }
 
 ModuleClRes convertLlStringToCl(
         int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex, std::string llString, std::string specificFunction, std::string generatedName,
-        bool offsets_32bit) {
+        bool offsets_32bit, const KernelSpecialization &specialization) {
     llvm::StringRef llStringRef(llString);
     std::unique_ptr<llvm::MemoryBuffer> llMemoryBuffer = llvm::MemoryBuffer::getMemBuffer(llStringRef);
     llvm::LLVMContext context;
@@ -54,7 +104,8 @@ ModuleClRes convertLlStringToCl(
         smDiagnostic.print("irtopencl", llvm::errs());
         throw std::runtime_error("failed to parse IR");
     }
-    ModuleClRes res = convertModuleToCl(uniqueClmemCount, clmemIndexByClmemArgIndex, M.get(), specificFunction, generatedName, offsets_32bit);
+    ModuleClRes res = convertModuleToCl(uniqueClmemCount, clmemIndexByClmemArgIndex, M.get(), specificFunction, generatedName, offsets_32bit,
+        specialization);
     return res;
 }
 
@@ -20,9 +20,12 @@
 #include "cocl/type_dumper.h"
 #include "cocl/function_dumper.h"
 #include "cocl/mutations.h"
+#include "cocl/vector_accesses.h"
+#include "cocl/index_demotion.h"
 #include "EasyCL/util/easycl_stringhelper.h"
 
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
 
 #include <stdexcept>
 #include <iostream>
@@ -49,6 +52,146 @@ static std::string createShortKernelName(string origName, std::set<std::string>
     return name;
 }
 
+// whether any of functions reads or writes a __shared__ variable
+static bool referencesSharedMemory(Module *M, const map<Function *, Type *> &functions) {
+    for(auto it = M->global_begin(); it != M->global_end(); it++) {
+        GlobalVariable *global = &*it;
+        if(global->getType()->getAddressSpace() != 3) {
+            continue;
+        }
+        vector<User *> users(global->user_begin(), global->user_end());
+        while(users.size() > 0) {
+            User *user = users.back();
+            users.pop_back();
+            if(Instruction *instr = dyn_cast<Instruction>(user)) {
+                if(functions.find(instr->getFunction()) != functions.end()) {
+                    return true;
+                }
+            } else {
+                // eg a constant getelementptr
+                users.insert(users.end(), user->user_begin(), user->user_end());
+            }
+        }
+    }
+    return false;
+}
+
+void KernelDumper::applySpecialization(Function *F) {
+    map<int, Argument *> argByLaunchArgIndex = FunctionDumper::getKernelArgByLaunchArgIndex(F);
+    for(auto it = specialization.int32ValueByArgIndex.begin(); it != specialization.int32ValueByArgIndex.end(); it++) {
+        auto argIt = argByLaunchArgIndex.find(it->first);
+        if(argIt == argByLaunchArgIndex.end() || !argIt->second->getType()->isIntegerTy(32)) {
+            cout << "kernel " << kernelName << " launch arg " << it->first << " isnt an int argument" << endl;
+            throw runtime_error("kernel " + kernelName + " launch arg " + easycl::toString(it->first) + " isnt an int argument");
+        }
+        Argument *arg = argIt->second;
+        arg->replaceAllUsesWith(ConstantInt::get(arg->getType(), it->second, true));
+    }
+    kernelAttributes = specialization.getKernelAttributes();
+    if(!specialization.specializeBlock) {
+        return;
+    }
+    // blockDim, in any function, since this module only has to run this kernel
+    const string dims[] = {"x", "y", "z"};
+    const string prefixes[] = {"llvm.nvvm.read.ptx.sreg.ntid.", "llvm.ptx.read.ntid."};
+    for(int d = 0; d < 3; d++) {
+        for(const string &prefix : prefixes) {
+            Function *ntid = M->getFunction(prefix + dims[d]);
+            if(ntid == 0) {
+                continue;
+            }
+            vector<CallInst *> calls;
+            for(auto user_it = ntid->user_begin(); user_it != ntid->user_end(); user_it++) {
+                if(CallInst *call = dyn_cast<CallInst>(*user_it)) {
+                    calls.push_back(call);
+                }
+            }
+            for(auto call_it = calls.begin(); call_it != calls.end(); call_it++) {
+                CallInst *call = *call_it;
+                call->replaceAllUsesWith(ConstantInt::get(call->getType(), specialization.block[d]));
+                call->eraseFromParent();
+            }
+        }
+    }
+}
+
+// The kernel for specialization.fusedLaunches launches of this kernel, as one dispatch.  Each launch has its own
+// copy of the parameters, prefixed l0_, l1_, ..., then its grid size.  The dispatch's work-groups are the launches'
+// blocks, in order, so each work-group works out which launch, and which block of it, it is, and calls the kernel,
+// written as a plain function, for that.
+//
+// launchDeclaration is the kernel function's declaration, eg
+// "void foo_launch(global char* restrict clmem0, unsigned long clmem_vmem_offset0, int n, local int *scratch,
+//     uint groupId0, ...)"
+std::string KernelDumper::writeFusedDispatcher(std::string launchDeclaration) {
+    size_t paramsStart = launchDeclaration.find('(');
+    size_t paramsEnd = launchDeclaration.rfind(')');
+    string params = launchDeclaration.substr(paramsStart + 1, paramsEnd - paramsStart - 1);
+    // type, eg "global char* restrict ", and name, of each parameter up to, but not including, scratch
+    vector<pair<string, string> > typeAndNames;
+    size_t pos = 0;
+    while(pos < params.size()) {
+        size_t end = params.find(", ", pos);
+        if(end == string::npos) {
+            end = params.size();
+        }
+        string param = params.substr(pos, end - pos);
+        pos = end + 2;
+        if(param == "local int *scratch") {
+            break;
+        }
+        size_t nameStart = param.find_last_of(" *") + 1;
+        string type = param.substr(0, nameStart);
+        // a buffer can be passed to more than one of the launches
+        size_t restrictPos = type.find("restrict ");
+        if(restrictPos != string::npos) {
+            type.erase(restrictPos, string("restrict ").size());
+        }
+        typeAndNames.push_back(make_pair(type, param.substr(nameStart)));
+    }
+
+    int numLaunches = specialization.fusedLaunches;
+    ostringstream oss;
+    oss << "kernel ";
+    if(kernelAttributes != "") {
+        oss << kernelAttributes << " ";
+    }
+    oss << "void " << generatedName << "(";
+    for(int launch = 0; launch < numLaunches; launch++) {
+        for(auto it = typeAndNames.begin(); it != typeAndNames.end(); it++) {
+            oss << it->first << "l" << launch << "_" << it->second << ", ";
+        }
+    }
+    oss << "local int *scratch";
+    for(int launch = 0; launch < numLaunches; launch++) {
+        oss << ", uint l" << launch << "_grid0, uint l" << launch << "_grid1, uint l" << launch << "_grid2";
+    }
+    oss << ") {\n";
+    oss << "    uint group = get_group_id(0);\n";
+    oss << "    uint groups;\n";
+    for(int launch = 0; launch < numLaunches; launch++) {
+        string prefix = "l" + easycl::toString(launch) + "_";
+        string grid0 = prefix + "grid0";
+        string grid1 = prefix + "grid1";
+        string grid2 = prefix + "grid2";
+        oss << "    groups = " << grid0 << " * " << grid1 << " * " << grid2 << ";\n";
+        oss << "    if(group < groups) {\n";
+        oss << "        " << generatedName << "_launch(";
+        for(auto it = typeAndNames.begin(); it != typeAndNames.end(); it++) {
+            oss << prefix << it->second << ", ";
+        }
+        oss << "scratch, group % " << grid0 << ", group / " << grid0 << " % " << grid1 << ", group / (" << grid0
+            << " * " << grid1 << "), " << grid0 << ", " << grid1 << ", " << grid2 << ");\n";
+        oss << "        return;\n";
+        oss << "    }\n";
+        if(launch + 1 < numLaunches) {
+            oss << "    group -= groups;\n";
+        }
+    }
+    oss << "}\n";
+    return oss.str();
+}
+
 std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemIndexByClmemArgIndex) {
     Function *F = M->getFunction(kernelName);
     if(F == 0) {
@@ -57,10 +200,42 @@ std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemInde
     // kernel name will simply be truncated to 32 characters
     // other names will fit around it
 
-    F->setName(generatedName);
+    bool fused = specialization.fusedLaunches > 0;
+    F->setName(fused ? generatedName + "_launch" : generatedName);
+    applySpecialization(F);
+
+    // turn field-by-field float4 etc accesses into vector loads and stores, before we start writing anything.
+    // Only for pointers proved to be global, local or constant; the inference updates their types.  We infer
+    // again below, since combining replaces some of the instructions
+    AddressSpaceInference().run(M, F);
+    for(auto it = M->begin(); it != M->end(); it++) {
+        Function *thisF = &*it;
+        if(!thisF->isDeclaration()) {
+            combineVectorAccesses(thisF);
+        }
+    }
+    if(demoteIndices) {
+        // the block size is only a bound when the kernel is built for it
+        LaunchBounds bounds;
+        if(specialization.specializeBlock || specialization.workGroupSizeAttribute == "reqd_work_group_size") {
+            for(int d = 0; d < 3; d++) {
+                bounds.block[d] = specialization.block[d];
+            }
+        }
+        IndexDemotion indexDemotion(bounds);
+        for(auto it = M->begin(); it != M->end(); it++) {
+            Function *thisF = &*it;
+            if(!thisF->isDeclaration()) {
+                indexDemotion.run(thisF);
+            }
+        }
+    }
+    addressSpaceInference.run(M, F);
+    globalConstants.reset(new GlobalConstants(M));
 
     std::set<std::string> usedShortNames;
     usedShortNames.insert(generatedName);
+    usedShortNames.insert(F->getName().str());
     for(auto it = M->begin(); it != M->end(); it++) {
         Function *thisF = &*it;
         if(thisF == F) {
@@ -122,6 +297,16 @@ std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemInde
             if(_addIRToCl) {
                 childFunctionDumper.addIRToCl();
             }
+            childFunctionDumper.setStructuredControlFlow(structuredControlFlow);
+            childFunctionDumper.setCoalesceVariables(coalesceVariables);
+            childFunctionDumper.setNarrowDeclarations(narrowDeclarations);
+            childFunctionDumper.setAddressSpaceInference(&addressSpaceInference);
+            childFunctionDumper.setGlobalConstants(globalConstants.get());
+            childFunctionDumper.setFusedLaunch(fused);
+            childFunctionDumper.setFastMath(fastMath);
+            if(_isKernel) {
+                childFunctionDumper.setKernelAttributes(kernelAttributes);
+            }
             if(!childFunctionDumper.runGeneration(returnTypeByFunction)) {
                 neededFunctions.insert(childFunctionDumper.neededFunctions.begin(), childFunctionDumper.neededFunctions.end());
                 continue;
@@ -131,6 +316,7 @@ std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemInde
             }
             if(childFunctionDumper.usesScratch) {
                 this->usesScratch = true;
+                this->scratchBytesPerWorkItem = std::max(scratchBytesPerWorkItem, childFunctionDumper.scratchBytesPerWorkItem);
             }
 
             returnTypeByFunction[childF] = childFunctionDumper.returnType;
@@ -138,6 +324,11 @@ std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemInde
             ostringstream os;
             childFunctionDumper.toCl(os);
             string childFunctionCl = os.str();
+            if(_isKernel) {
+                writtenClmems = childFunctionDumper.writtenClmems;
+                textureArgIsImage = childFunctionDumper.textureArgIsImage;
+                kernelDeclaration = childFunctionDumper.getDeclaration();
+            }
 
             structsToDefine.insert(childFunctionDumper.structsToDefine.begin(), childFunctionDumper.structsToDefine.end());
             functionDeclarations.insert(childFunctionDumper.getDeclaration());
@@ -158,6 +349,15 @@ std::string KernelDumper::toCl(int uniqueClmemCount, std::vector<int> &clmemInde
         }
     }
 
+    usesSharedMemory = referencesSharedMemory(M, returnTypeByFunction);
+    if(fused && (usesSharedMemory || !globalConstants->empty())) {
+        cout << "kernel " << kernelName << " uses __shared__ or __constant__ memory, so cant be fused" << endl;
+        throw runtime_error("kernel " + kernelName + " uses __shared__ or __constant__ memory, so cant be fused");
+    }
+    if(fused) {
+        moduleClStream << "\n" << writeFusedDispatcher(kernelDeclaration);
+    }
+
     // get all shim names
     // for(auto it=shimFunctionsNeeded.begin(); it != shimFunctionsNeeded.end(); it++) {
     //     string shimName = *it;
@@ -181,7 +381,15 @@ struct GlobalVars {
     local int *scratch;
     global char *clmem0;
     unsigned long clmem_vmem_offset0;
-};
+)";
+    if(!globalConstants->empty()) {
+        functionDeclarationsStream << "    constant char *constants;\n";
+    }
+    if(fused) {
+        functionDeclarationsStream << "    unsigned int groupId[3];\n";
+        functionDeclarationsStream << "    unsigned int numGroups[3];\n";
+    }
+    functionDeclarationsStream << R"(};
 
 inline global float *getGlobalPointer(__vmem__ unsigned long vmemloc, const struct GlobalVars* const globalVars) {
     return (global float *)(globalVars->clmem0 + vmemloc - globalVars->clmem_vmem_offset0);
@@ -189,9 +397,13 @@ inline global float *getGlobalPointer(__vmem__ unsigned long vmemloc, const stru
 
 )";
 
-    functionDeclarationsStream << typeDumper->dumpStructDefinitions() << "\n";
+    // struct definitions can mark halfs as used, so do them first
+    string structDefinitions = typeDumper->dumpStructDefinitions();
+    functionDeclarationsStream << typeDumper->dumpHalfDefinitions();
+    functionDeclarationsStream << structDefinitions << "\n";
 
     shims.writeCl(functionDeclarationsStream);
+    usesFloatAtomics = shims.isUsed("__atomic_add_float") || shims.isUsed("__atomic_add_double");
 
     // for(auto it=shimFunctionsNeeded.begin(); it != shimFunctionsNeeded.end(); it++) {
     //     string shimName = *it;
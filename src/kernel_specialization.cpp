@@ -0,0 +1,152 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/kernel_specialization.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+
+using namespace std;
+
+namespace cocl {
+
+std::string KernelSpecialization::getSuffix() const {
+    ostringstream oss;
+    for(auto it = int32ValueByArgIndex.begin(); it != int32ValueByArgIndex.end(); it++) {
+        oss << "_s" << it->first << "x" << it->second;
+    }
+    if(specializeBlock) {
+        oss << "_b" << block[0] << "x" << block[1] << "x" << block[2];
+    } else if(workGroupSizeAttribute != "") {
+        oss << (workGroupSizeAttribute == "work_group_size_hint" ? "_h" : "_w");
+        oss << block[0] << "x" << block[1] << "x" << block[2];
+    }
+    if(fusedLaunches > 0) {
+        oss << "_f" << fusedLaunches;
+    }
+    return oss.str();
+}
+
+std::string KernelSpecialization::getKernelAttributes() const {
+    string attribute = specializeBlock ? "reqd_work_group_size" : workGroupSizeAttribute;
+    if(attribute == "") {
+        return "";
+    }
+    ostringstream oss;
+    oss << "__attribute__((" << attribute << "(" << block[0] << ", " << block[1] << ", " << block[2] << ")))";
+    return oss.str();
+}
+
+KernelSpecializer::KernelSpecializer(std::string mode, std::string workGroupSizeMode) {
+    if(workGroupSizeMode == "reqd") {
+        workGroupSizeAttribute = "reqd_work_group_size";
+    } else if(workGroupSizeMode == "hint") {
+        workGroupSizeAttribute = "work_group_size_hint";
+    } else if(workGroupSizeMode != "" && workGroupSizeMode != "0") {
+        cout << "COCL_WORK_GROUP_SIZE should be reqd, hint or 0, not " << workGroupSizeMode << endl;
+        throw runtime_error("COCL_WORK_GROUP_SIZE should be reqd, hint or 0, not " + workGroupSizeMode);
+    }
+    if(mode == "" || mode == "0") {
+        this->mode = Never;
+    } else if(mode == "all") {
+        this->mode = All;
+    } else if(mode == "auto") {
+        this->mode = Auto;
+    } else {
+        this->mode = Listed;
+        istringstream iss(mode);
+        string kernelName;
+        while(getline(iss, kernelName, ',')) {
+            if(kernelName != "") {
+                kernelNames.insert(kernelName);
+            }
+        }
+    }
+}
+
+// matches either the mangled name, or, for a kernel that isnt in a namespace, its plain name, eg "myKernel" for
+// "_Z8myKernelPfi"
+bool KernelSpecializer::isListed(std::string kernelName) {
+    if(kernelNames.find(kernelName) != kernelNames.end()) {
+        return true;
+    }
+    if(kernelName.substr(0, 2) != "_Z") {
+        return false;
+    }
+    size_t nameStart = 2;
+    while(nameStart < kernelName.size() && kernelName[nameStart] >= '0' && kernelName[nameStart] <= '9') {
+        nameStart++;
+    }
+    int nameLength = atoi(kernelName.substr(2, nameStart - 2).c_str());
+    if(nameLength <= 0 || nameStart + nameLength > kernelName.size()) {
+        return false;
+    }
+    return kernelNames.find(kernelName.substr(nameStart, nameLength)) != kernelNames.end();
+}
+
+KernelSpecialization KernelSpecializer::chooseWorkGroupSize(std::string kernelName, const size_t block[3]) {
+    KernelSpecialization specialization;
+    if(workGroupSizeAttribute == "") {
+        return specialization;
+    }
+    specialization.workGroupSizeAttribute = workGroupSizeAttribute;
+    for(int i = 0; i < 3; i++) {
+        specialization.block[i] = (int)block[i];
+    }
+    string suffix = specialization.getSuffix();
+    KernelHistory &history = historyByKernelName[kernelName];
+    if(history.workGroupSizeSuffixes.find(suffix) != history.workGroupSizeSuffixes.end()) {
+        return specialization;
+    }
+    if((int)history.workGroupSizeSuffixes.size() >= MaxWorkGroupSizesPerKernel) {
+        return KernelSpecialization();
+    }
+    history.workGroupSizeSuffixes.insert(suffix);
+    return specialization;
+}
+
+KernelSpecialization KernelSpecializer::choose(std::string kernelName, const std::map<int, int> &int32ValueByArgIndex,
+        const size_t block[3]) {
+    KernelSpecialization specialization;
+    if(mode == Never || (mode == Listed && !isListed(kernelName))) {
+        return chooseWorkGroupSize(kernelName, block);
+    }
+    specialization.int32ValueByArgIndex = int32ValueByArgIndex;
+    specialization.specializeBlock = true;
+    for(int i = 0; i < 3; i++) {
+        specialization.block[i] = (int)block[i];
+    }
+    string suffix = specialization.getSuffix();
+
+    KernelHistory &history = historyByKernelName[kernelName];
+    if(suffix == history.lastSuffix) {
+        history.stableLaunches++;
+    } else {
+        history.lastSuffix = suffix;
+        history.stableLaunches = 1;
+    }
+    if(history.specializedSuffixes.find(suffix) != history.specializedSuffixes.end()) {
+        return specialization;
+    }
+    bool wanted = mode != Auto || history.stableLaunches >= AutoStableLaunches;
+    if(!wanted || (int)history.specializedSuffixes.size() >= MaxSpecializationsPerKernel) {
+        return chooseWorkGroupSize(kernelName, block);
+    }
+    history.specializedSuffixes.insert(suffix);
+    return specialization;
+}
+
+} // namespace cocl
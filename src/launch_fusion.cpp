@@ -0,0 +1,100 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/launch_fusion.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+namespace cocl {
+
+static bool intersects(const set<const void *> &a, const set<const void *> &b) {
+    for(auto it = a.begin(); it != a.end(); it++) {
+        if(b.find(*it) != b.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LaunchBatch::canAdd(const FusableLaunch &launch, int maxLaunches) const {
+    if(numLaunches == 0) {
+        return maxLaunches > 0;
+    }
+    if(numLaunches >= maxLaunches || launch.uniqueKernelName != uniqueKernelName || launch.queue != queue) {
+        return false;
+    }
+    for(int i = 0; i < 3; i++) {
+        if(launch.block[i] != block[i]) {
+            return false;
+        }
+    }
+    return !intersects(launch.writtenBuffers, buffers) && !intersects(launch.buffers, writtenBuffers);
+}
+
+void LaunchBatch::add(const FusableLaunch &launch) {
+    if(numLaunches == 0) {
+        uniqueKernelName = launch.uniqueKernelName;
+        queue = launch.queue;
+        for(int i = 0; i < 3; i++) {
+            block[i] = launch.block[i];
+        }
+    }
+    numLaunches++;
+    numBlocks += launch.grid[0] * launch.grid[1] * launch.grid[2];
+    buffers.insert(launch.buffers.begin(), launch.buffers.end());
+    writtenBuffers.insert(launch.writtenBuffers.begin(), launch.writtenBuffers.end());
+}
+
+void LaunchBatch::clear() {
+    numLaunches = 0;
+    numBlocks = 0;
+    uniqueKernelName = "";
+    queue = 0;
+    buffers.clear();
+    writtenBuffers.clear();
+}
+
+LaunchFuser::LaunchFuser(std::string mode) {
+    if(mode == "" || mode == "0") {
+        maxLaunches = 0;
+    } else if(mode == "1") {
+        maxLaunches = DefaultMaxLaunches;
+    } else {
+        maxLaunches = atoi(mode.c_str());
+        if(maxLaunches <= 1) {
+            cout << "COCL_LAUNCH_FUSION should be 0, 1, or the most launches to fuse, not " << mode << endl;
+            throw runtime_error("COCL_LAUNCH_FUSION should be 0, 1, or the most launches to fuse, not " + mode);
+        }
+    }
+}
+
+int LaunchFuser::getMaxLaunches(size_t launchParamBytes, size_t sharedParamBytes, size_t maxParameterSize) const {
+    int launches = maxLaunches;
+    if(launchParamBytes > 0) {
+        size_t available = maxParameterSize > sharedParamBytes ? maxParameterSize - sharedParamBytes : 0;
+        launches = (int)min((size_t)launches, available / launchParamBytes);
+    }
+    return max(1, launches);
+}
+
+bool LaunchFuser::isSmall(const size_t grid[3]) const {
+    return grid[0] * grid[1] * grid[2] <= (size_t)MaxBlocksPerLaunch;
+}
+
+} // namespace cocl
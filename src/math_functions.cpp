@@ -0,0 +1,488 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/math_functions.h"
+
+#include <unordered_map>
+#include <cctype>
+#include <sstream>
+
+using namespace std;
+
+namespace cocl {
+
+namespace {
+
+// a libm function, with single and double precision versions, eg expf and exp
+struct MathFamily {
+    const char *name;  // the double precision C name, eg "exp"
+    // one letter per argument: x the floating point type, i int, p pointer to the floating point type, q int pointer
+    const char *params;
+    const char *expression;
+    MathFunction::Precision precision;
+    const char *fastExpression;  // for the single precision version, or 0
+    bool hasIntrinsic;  // llvm.<name>.f32 and .f64
+};
+
+const MathFamily families[] = {
+    // CUDA uses its fast intrinsics for these under -use_fast_math
+    {"sin", "x", "sin", MathFunction::Accurate, "native_sin", true},
+    {"cos", "x", "cos", MathFunction::Accurate, "native_cos", true},
+    {"tan", "x", "tan", MathFunction::Accurate, "native_tan", false},
+    {"sincos", "xpp", "*$1 = sincos($0, $2)", MathFunction::Accurate, "*$1 = native_sin($0); *$2 = native_cos($0)", false},
+    {"exp", "x", "exp", MathFunction::Accurate, "native_exp", true},
+    {"exp2", "x", "exp2", MathFunction::Accurate, "native_exp2", true},
+    {"exp10", "x", "exp10", MathFunction::Accurate, "native_exp10", false},
+    {"log", "x", "log", MathFunction::Accurate, "native_log", true},
+    {"log2", "x", "log2", MathFunction::Accurate, "native_log2", true},
+    {"log10", "x", "log10", MathFunction::Accurate, "native_log10", true},
+    {"pow", "xx", "pow", MathFunction::Accurate, "native_powr", true},
+    // and these, since -use_fast_math implies -prec-sqrt=false
+    {"sqrt", "x", "sqrt", MathFunction::Accurate, "native_sqrt", true},
+    {"rsqrt", "x", "rsqrt", MathFunction::Accurate, "native_rsqrt", false},
+
+    {"acos", "x", "acos", MathFunction::Accurate, 0, false},
+    {"acosh", "x", "acosh", MathFunction::Accurate, 0, false},
+    {"asin", "x", "asin", MathFunction::Accurate, 0, false},
+    {"asinh", "x", "asinh", MathFunction::Accurate, 0, false},
+    {"atan", "x", "atan", MathFunction::Accurate, 0, false},
+    {"atanh", "x", "atanh", MathFunction::Accurate, 0, false},
+    {"atan2", "xx", "atan2", MathFunction::Accurate, 0, false},
+    {"cbrt", "x", "cbrt", MathFunction::Accurate, 0, false},
+    {"cosh", "x", "cosh", MathFunction::Accurate, 0, false},
+    {"sinh", "x", "sinh", MathFunction::Accurate, 0, false},
+    {"tanh", "x", "tanh", MathFunction::Accurate, 0, false},
+    {"cospi", "x", "cospi", MathFunction::Accurate, 0, false},
+    {"sinpi", "x", "sinpi", MathFunction::Accurate, 0, false},
+    {"sincospi", "xpp", "*$1 = sinpi($0); *$2 = cospi($0)", MathFunction::Accurate, 0, false},
+    {"erf", "x", "erf", MathFunction::Accurate, 0, false},
+    {"erfc", "x", "erfc", MathFunction::Accurate, 0, false},
+    {"expm1", "x", "expm1", MathFunction::Accurate, 0, false},
+    {"log1p", "x", "log1p", MathFunction::Accurate, 0, false},
+    {"lgamma", "x", "lgamma", MathFunction::Accurate, 0, false},
+    {"tgamma", "x", "tgamma", MathFunction::Accurate, 0, false},
+    {"hypot", "xx", "hypot", MathFunction::Accurate, 0, false},
+    {"logb", "x", "logb", MathFunction::Accurate, 0, false},
+    {"normcdf", "x", "(0.5$L * erfc(-M_SQRT1_2$F * $0))", MathFunction::Accurate, 0, false},
+
+    {"rcbrt", "x", "(1.0$L / cbrt($0))", MathFunction::Approximate, 0, false},
+    {"rhypot", "xx", "(1.0$L / hypot($0, $1))", MathFunction::Approximate, 0, false},
+    {"norm3d", "xxx", "sqrt($0 * $0 + $1 * $1 + $2 * $2)", MathFunction::Approximate, 0, false},
+    {"rnorm3d", "xxx", "rsqrt($0 * $0 + $1 * $1 + $2 * $2)", MathFunction::Approximate, 0, false},
+    {"norm4d", "xxxx", "sqrt($0 * $0 + $1 * $1 + $2 * $2 + $3 * $3)", MathFunction::Approximate, 0, false},
+    {"rnorm4d", "xxxx", "rsqrt($0 * $0 + $1 * $1 + $2 * $2 + $3 * $3)", MathFunction::Approximate, 0, false},
+    {"erfcx", "x", "(exp($0 * $0) * erfc($0))", MathFunction::Approximate, 0, false},
+
+    {"fabs", "x", "fabs", MathFunction::Exact, 0, true},
+    {"floor", "x", "floor", MathFunction::Exact, 0, true},
+    {"ceil", "x", "ceil", MathFunction::Exact, 0, true},
+    {"trunc", "x", "trunc", MathFunction::Exact, 0, true},
+    {"round", "x", "round", MathFunction::Exact, 0, true},
+    {"rint", "x", "rint", MathFunction::Exact, 0, true},
+    {"nearbyint", "x", "rint", MathFunction::Exact, 0, true},
+    {"lrint", "x", "convert_long(rint($0))", MathFunction::Exact, 0, false},
+    {"llrint", "x", "convert_long(rint($0))", MathFunction::Exact, 0, false},
+    {"lround", "x", "convert_long(round($0))", MathFunction::Exact, 0, false},
+    {"llround", "x", "convert_long(round($0))", MathFunction::Exact, 0, false},
+    {"fmin", "xx", "fmin", MathFunction::Exact, 0, false},
+    {"fmax", "xx", "fmax", MathFunction::Exact, 0, false},
+    {"fdim", "xx", "fdim", MathFunction::Exact, 0, false},
+    {"fmod", "xx", "fmod", MathFunction::Exact, 0, false},
+    {"remainder", "xx", "remainder", MathFunction::Exact, 0, false},
+    {"remquo", "xxq", "remquo", MathFunction::Exact, 0, false},
+    {"copysign", "xx", "copysign", MathFunction::Exact, 0, true},
+    {"nextafter", "xx", "nextafter", MathFunction::Exact, 0, false},
+    {"fma", "xxx", "fma", MathFunction::Exact, 0, true},
+    {"ldexp", "xi", "ldexp", MathFunction::Exact, 0, false},
+    {"scalbn", "xi", "ldexp", MathFunction::Exact, 0, false},
+    {"frexp", "xq", "frexp", MathFunction::Exact, 0, false},
+    {"modf", "xp", "modf", MathFunction::Exact, 0, false},
+    {"ilogb", "x", "ilogb", MathFunction::Exact, 0, false},
+    {"isnan", "x", "isnan", MathFunction::Exact, 0, false},
+    {"isinf", "x", "isinf", MathFunction::Exact, 0, false},
+    {"isfinite", "x", "isfinite", MathFunction::Exact, 0, false},
+    {"signbit", "x", "signbit", MathFunction::Exact, 0, false},
+
+    {"j0", "x", "", MathFunction::Unsupported, 0, false},
+    {"j1", "x", "", MathFunction::Unsupported, 0, false},
+    {"jn", "ix", "", MathFunction::Unsupported, 0, false},
+    {"y0", "x", "", MathFunction::Unsupported, 0, false},
+    {"y1", "x", "", MathFunction::Unsupported, 0, false},
+    {"yn", "ix", "", MathFunction::Unsupported, 0, false},
+    {"cyl_bessel_i0", "x", "", MathFunction::Unsupported, 0, false},
+    {"cyl_bessel_i1", "x", "", MathFunction::Unsupported, 0, false},
+    {"erfinv", "x", "", MathFunction::Unsupported, 0, false},
+    {"erfcinv", "x", "", MathFunction::Unsupported, 0, false},
+    {"normcdfinv", "x", "", MathFunction::Unsupported, 0, false},
+};
+
+// names that dont follow a family's pattern: CUDA's intrinsics, libdevice's integer and conversion functions, ...
+struct MathAlias {
+    const char *name;
+    const char *expression;
+    MathFunction::Precision precision;
+    bool isFloat;
+    const char *fastExpression;
+};
+
+const MathAlias aliases[] = {
+    // CUDA's fast intrinsics, eg __expf, and libdevice's versions of them
+    {"_Z10__fdividefff", "native_divide", MathFunction::Fast, true, 0},
+    {"__nv_fast_fdividef", "native_divide", MathFunction::Fast, true, 0},
+    {"__nv_fdividef", "native_divide", MathFunction::Fast, true, 0},
+    {"_Z6__expff", "native_exp", MathFunction::Fast, true, 0},
+    {"__nv_fast_expf", "native_exp", MathFunction::Fast, true, 0},
+    {"_Z8__exp10ff", "native_exp10", MathFunction::Fast, true, 0},
+    {"__nv_fast_exp10f", "native_exp10", MathFunction::Fast, true, 0},
+    {"_Z6__logff", "native_log", MathFunction::Fast, true, 0},
+    {"__nv_fast_logf", "native_log", MathFunction::Fast, true, 0},
+    {"_Z7__log2ff", "native_log2", MathFunction::Fast, true, 0},
+    {"__nv_fast_log2f", "native_log2", MathFunction::Fast, true, 0},
+    {"_Z8__log10ff", "native_log10", MathFunction::Fast, true, 0},
+    {"__nv_fast_log10f", "native_log10", MathFunction::Fast, true, 0},
+    {"_Z6__powfff", "native_powr", MathFunction::Fast, true, 0},
+    {"__nv_fast_powf", "native_powr", MathFunction::Fast, true, 0},
+    {"_Z6__sinff", "native_sin", MathFunction::Fast, true, 0},
+    {"__nv_fast_sinf", "native_sin", MathFunction::Fast, true, 0},
+    {"_Z6__cosff", "native_cos", MathFunction::Fast, true, 0},
+    {"__nv_fast_cosf", "native_cos", MathFunction::Fast, true, 0},
+    {"_Z6__tanff", "native_tan", MathFunction::Fast, true, 0},
+    {"__nv_fast_tanf", "native_tan", MathFunction::Fast, true, 0},
+    {"_Z9__sincosffPfS_", "*$1 = native_sin($0); *$2 = native_cos($0)", MathFunction::Fast, true, 0},
+    {"__nv_fast_sincosf", "*$1 = native_sin($0); *$2 = native_cos($0)", MathFunction::Fast, true, 0},
+    {"_Z10__saturatef", "clamp($0, 0.0f, 1.0f)", MathFunction::Exact, true, 0},
+    {"__nv_saturatef", "clamp($0, 0.0f, 1.0f)", MathFunction::Exact, true, 0},
+
+    // libdevice names that arent the double name with an f on the end
+    {"__nv_isnand", "isnan", MathFunction::Exact, false, 0},
+    {"__nv_isinfd", "isinf", MathFunction::Exact, false, 0},
+    {"__nv_finitef", "isfinite", MathFunction::Exact, true, 0},
+    {"__nv_isfinited", "isfinite", MathFunction::Exact, false, 0},
+    {"__nv_signbitd", "signbit", MathFunction::Exact, false, 0},
+
+    // CUDA's min and max overloads
+    {"_Z3minff", "fmin", MathFunction::Exact, true, 0},
+    {"_Z3maxff", "fmax", MathFunction::Exact, true, 0},
+    {"_Z3mindd", "fmin", MathFunction::Exact, false, 0},
+    {"_Z3maxdd", "fmax", MathFunction::Exact, false, 0},
+    {"_Z3minii", "min", MathFunction::Exact, false, 0},
+    {"_Z3maxii", "max", MathFunction::Exact, false, 0},
+    {"_Z3minjj", "min", MathFunction::Exact, false, 0},
+    {"_Z3maxjj", "max", MathFunction::Exact, false, 0},
+
+    // llvm and nvvm intrinsics
+    {"llvm.minnum.f32", "fmin", MathFunction::Exact, true, 0},
+    {"llvm.minnum.f64", "fmin", MathFunction::Exact, false, 0},
+    {"llvm.maxnum.f32", "fmax", MathFunction::Exact, true, 0},
+    {"llvm.maxnum.f64", "fmax", MathFunction::Exact, false, 0},
+    {"llvm.powi.f32", "pown", MathFunction::Accurate, true, 0},
+    {"llvm.powi.f64", "pown", MathFunction::Accurate, false, 0},
+    {"llvm.fmuladd.f32", "($0 * $1 + $2)", MathFunction::Exact, true, "mad($0, $1, $2)"},
+    {"llvm.fmuladd.f64", "($0 * $1 + $2)", MathFunction::Exact, false, 0},
+    {"llvm.nvvm.sqrt.f", "sqrt", MathFunction::Accurate, true, "native_sqrt"},
+    {"llvm.nvvm.sqrt.rn.f", "sqrt", MathFunction::Accurate, true, 0},
+    {"llvm.nvvm.sqrt.rn.d", "sqrt", MathFunction::Accurate, false, 0},
+    {"llvm.nvvm.rsqrt.approx.f", "native_rsqrt", MathFunction::Fast, true, 0},
+    {"llvm.nvvm.ex2.approx.f", "native_exp2", MathFunction::Fast, true, 0},
+    {"llvm.nvvm.lg2.approx.f", "native_log2", MathFunction::Fast, true, 0},
+    {"llvm.nvvm.sin.approx.f", "native_sin", MathFunction::Fast, true, 0},
+    {"llvm.nvvm.cos.approx.f", "native_cos", MathFunction::Fast, true, 0},
+    {"llvm.nvvm.fabs.f", "fabs", MathFunction::Exact, true, 0},
+    {"llvm.nvvm.fabs.ftz.f", "fabs", MathFunction::Exact, true, 0},
+    {"llvm.nvvm.fabs.d", "fabs", MathFunction::Exact, false, 0},
+    {"llvm.nvvm.fmin.f", "fmin", MathFunction::Exact, true, 0},
+    {"llvm.nvvm.fmax.f", "fmax", MathFunction::Exact, true, 0},
+    {"llvm.nvvm.fmin.d", "fmin", MathFunction::Exact, false, 0},
+    {"llvm.nvvm.fmax.d", "fmax", MathFunction::Exact, false, 0},
+
+    // libdevice's round to nearest arithmetic.  OpenCL rounds double division and sqrt correctly, but, without
+    // -cl-fp32-correctly-rounded-divide-sqrt, single precision ones only to within a few ulp
+    {"__nv_fadd_rn", "($0 + $1)", MathFunction::Exact, true, 0},
+    {"__nv_dadd_rn", "($0 + $1)", MathFunction::Exact, false, 0},
+    {"__nv_fsub_rn", "($0 - $1)", MathFunction::Exact, true, 0},
+    {"__nv_dsub_rn", "($0 - $1)", MathFunction::Exact, false, 0},
+    {"__nv_fmul_rn", "($0 * $1)", MathFunction::Exact, true, 0},
+    {"__nv_dmul_rn", "($0 * $1)", MathFunction::Exact, false, 0},
+    {"__nv_fdiv_rn", "($0 / $1)", MathFunction::Accurate, true, 0},
+    {"__nv_ddiv_rn", "($0 / $1)", MathFunction::Exact, false, 0},
+    {"__nv_frcp_rn", "(1.0f / $0)", MathFunction::Accurate, true, 0},
+    {"__nv_drcp_rn", "(1.0 / $0)", MathFunction::Exact, false, 0},
+    {"__nv_fsqrt_rn", "sqrt", MathFunction::Accurate, true, 0},
+    {"__nv_dsqrt_rn", "sqrt", MathFunction::Exact, false, 0},
+    {"__nv_fmaf_rn", "fma", MathFunction::Exact, true, 0},
+    {"__nv_fma_rn", "fma", MathFunction::Exact, false, 0},
+
+    // integer functions, as libdevice, and as CUDA's intrinsics
+    {"__nv_abs", "abs", MathFunction::Exact, false, 0},
+    {"__nv_llabs", "abs", MathFunction::Exact, false, 0},
+    {"__nv_min", "min", MathFunction::Exact, false, 0},
+    {"__nv_max", "max", MathFunction::Exact, false, 0},
+    {"__nv_umin", "min", MathFunction::Exact, false, 0},
+    {"__nv_umax", "max", MathFunction::Exact, false, 0},
+    {"__nv_llmin", "min", MathFunction::Exact, false, 0},
+    {"__nv_llmax", "max", MathFunction::Exact, false, 0},
+    {"__nv_ullmin", "min", MathFunction::Exact, false, 0},
+    {"__nv_ullmax", "max", MathFunction::Exact, false, 0},
+    {"__nv_clz", "clz", MathFunction::Exact, false, 0},
+    {"_Z5__clzi", "clz", MathFunction::Exact, false, 0},
+    {"__nv_clzll", "convert_int(clz($0))", MathFunction::Exact, false, 0},
+    {"_Z7__clzllx", "convert_int(clz($0))", MathFunction::Exact, false, 0},
+    {"__nv_popc", "popcount", MathFunction::Exact, false, 0},
+    {"_Z6__popci", "popcount", MathFunction::Exact, false, 0},
+    {"__nv_popcll", "convert_int(popcount($0))", MathFunction::Exact, false, 0},
+    {"_Z8__popclly", "convert_int(popcount($0))", MathFunction::Exact, false, 0},
+    {"__nv_ffs", "(32 - clz($0 & -$0))", MathFunction::Exact, false, 0},
+    {"_Z5__ffsi", "(32 - clz($0 & -$0))", MathFunction::Exact, false, 0},
+    {"__nv_ffsll", "convert_int(64 - clz($0 & -$0))", MathFunction::Exact, false, 0},
+    {"_Z7__ffsllx", "convert_int(64 - clz($0 & -$0))", MathFunction::Exact, false, 0},
+    {"__nv_mulhi", "mul_hi", MathFunction::Exact, false, 0},
+    {"_Z7__mulhiii", "mul_hi", MathFunction::Exact, false, 0},
+    {"__nv_umulhi", "mul_hi", MathFunction::Exact, false, 0},
+    {"__nv_mul64hi", "mul_hi", MathFunction::Exact, false, 0},
+    {"__nv_umul64hi", "mul_hi", MathFunction::Exact, false, 0},
+    {"__nv_mul24", "mul24", MathFunction::Exact, false, 0},
+    {"_Z7__mul24ii", "mul24", MathFunction::Exact, false, 0},
+    {"__nv_umul24", "mul24", MathFunction::Exact, false, 0},
+    {"_Z8__umul24jj", "mul24", MathFunction::Exact, false, 0},
+    {"__nv_hadd", "hadd", MathFunction::Exact, false, 0},
+    {"_Z6__haddii", "hadd", MathFunction::Exact, false, 0},
+    {"__nv_uhadd", "hadd", MathFunction::Exact, false, 0},
+    {"_Z7__uhaddjj", "hadd", MathFunction::Exact, false, 0},
+    {"__nv_rhadd", "rhadd", MathFunction::Exact, false, 0},
+    {"_Z7__rhaddii", "rhadd", MathFunction::Exact, false, 0},
+    {"__nv_urhadd", "rhadd", MathFunction::Exact, false, 0},
+    {"_Z8__urhaddjj", "rhadd", MathFunction::Exact, false, 0},
+    {"__nv_sad", "(abs_diff($0, $1) + $2)", MathFunction::Exact, false, 0},
+    {"_Z5__sadiij", "(abs_diff($0, $1) + $2)", MathFunction::Exact, false, 0},
+    {"__nv_usad", "(abs_diff($0, $1) + $2)", MathFunction::Exact, false, 0},
+    {"_Z6__usadjjj", "(abs_diff($0, $1) + $2)", MathFunction::Exact, false, 0},
+    {"__nv_brev", "", MathFunction::Unsupported, false, 0},
+    {"__nv_brevll", "", MathFunction::Unsupported, false, 0},
+    {"__nv_byte_perm", "", MathFunction::Unsupported, false, 0},
+
+    // reinterpreting bits
+    {"__nv_float_as_int", "as_int", MathFunction::Exact, false, 0},
+    {"__nv_float_as_uint", "as_uint", MathFunction::Exact, false, 0},
+    {"__nv_int_as_float", "as_float", MathFunction::Exact, true, 0},
+    {"__nv_uint_as_float", "as_float", MathFunction::Exact, true, 0},
+    {"__nv_double_as_longlong", "as_long", MathFunction::Exact, false, 0},
+    {"__nv_longlong_as_double", "as_double", MathFunction::Exact, false, 0},
+    {"__nv_double2hiint", "as_int2($0).y", MathFunction::Exact, false, 0},
+    {"__nv_double2loint", "as_int2($0).x", MathFunction::Exact, false, 0},
+    {"__nv_hiloint2double", "as_double((int2)($1, $0))", MathFunction::Exact, false, 0},
+};
+
+// libdevice's conversions, eg __nv_float2int_rz, are named <from>2<to>_<rounding>
+struct ConversionType {
+    const char *cudaName;
+    const char *clType;
+    bool isInteger;
+};
+
+const ConversionType conversionTypes[] = {
+    {"float", "float", false},
+    {"double", "double", false},
+    {"int", "int", true},
+    {"uint", "uint", true},
+    {"ll", "long", true},
+    {"ull", "ulong", true},
+};
+
+const char *roundings[][2] = {
+    {"rn", "rte"},
+    {"rz", "rtz"},
+    {"ru", "rtp"},
+    {"rd", "rtn"},
+};
+
+// Itanium mangling of the parameters, eg "fPfS_" for sincosf
+string mangleParams(string params, bool isFloat) {
+    string scalar = isFloat ? "f" : "d";
+    string mangled = "";
+    bool seenPointer = false;
+    for(char param : params) {
+        if(param == 'x') {
+            mangled += scalar;
+        } else if(param == 'i') {
+            mangled += "i";
+        } else if(param == 'q') {
+            mangled += "Pi";
+        } else if(seenPointer) {
+            mangled += "S_";
+        } else {
+            mangled += "P" + scalar;
+            seenPointer = true;
+        }
+    }
+    return mangled;
+}
+
+string mangle(string prefix, string name, string params, bool isFloat) {
+    ostringstream oss;
+    oss << prefix << name.size() << name << mangleParams(params, isFloat);
+    return oss.str();
+}
+
+void addFamily(unordered_map<string, MathFunction> &functions, const MathFamily &family, bool isFloat) {
+    MathFunction function;
+    function.expression = family.expression;
+    function.precision = family.precision;
+    function.isFloat = isFloat;
+    if(isFloat && family.fastExpression != 0) {
+        function.fastExpression = family.fastExpression;
+    }
+    string name = family.name;
+    string cName = isFloat ? name + "f" : name;
+    // C++ overloads, eg exp(float), from std, or the global namespace, can be mangled with either C name
+    for(string mangledName : {name, cName}) {
+        functions[mangle("_Z", mangledName, family.params, isFloat)] = function;
+        functions[mangle("_ZSt", mangledName, family.params, isFloat)] = function;
+    }
+    functions["__nv_" + cName] = function;
+    functions[cName] = function;
+    if(family.hasIntrinsic) {
+        functions["llvm." + name + (isFloat ? ".f32" : ".f64")] = function;
+    }
+}
+
+unordered_map<string, MathFunction> buildMathFunctions() {
+    unordered_map<string, MathFunction> functions;
+    for(const MathFamily &family : families) {
+        addFamily(functions, family, true);
+        addFamily(functions, family, false);
+    }
+    for(const ConversionType &from : conversionTypes) {
+        for(const ConversionType &to : conversionTypes) {
+            // floating point to integer, integer to floating point, or double2float
+            bool isDouble2Float = string(from.cudaName) == "double" && string(to.cudaName) == "float";
+            if(from.isInteger == to.isInteger && !isDouble2Float) {
+                continue;
+            }
+            for(auto rounding : roundings) {
+                MathFunction function;
+                // cuda saturates float to int conversions, and gives 0 for NaN, like OpenCL's _sat
+                function.expression = string("convert_") + to.clType + (to.isInteger ? "_sat_" : "_") + rounding[1];
+                function.precision = MathFunction::Exact;
+                function.isFloat = string(to.clType) == "float";
+                functions[string("__nv_") + from.cudaName + "2" + to.cudaName + "_" + rounding[0]] = function;
+            }
+        }
+    }
+    for(const MathAlias &alias : aliases) {
+        MathFunction function;
+        function.expression = alias.expression;
+        function.precision = alias.precision;
+        function.isFloat = alias.isFloat;
+        if(alias.fastExpression != 0) {
+            function.fastExpression = alias.fastExpression;
+        }
+        functions[alias.name] = function;
+    }
+    return functions;
+}
+
+const unordered_map<string, MathFunction> &getMathFunctions() {
+    static const unordered_map<string, MathFunction> functions = buildMathFunctions();
+    return functions;
+}
+
+// whether the first character is a parenthesis that closes at the last one, eg "(a + b)", but not "(a) + (b)"
+bool isParenthesized(const string &arg) {
+    if(arg.size() < 2 || arg[0] != '(') {
+        return false;
+    }
+    int depth = 0;
+    for(int i = 0; i < (int)arg.size(); i++) {
+        if(arg[i] == '(') {
+            depth++;
+        } else if(arg[i] == ')') {
+            depth--;
+            if(depth == 0) {
+                return i == (int)arg.size() - 1;
+            }
+        }
+    }
+    return false;
+}
+
+// leaves things like "v1", "0.5f", "(a + b)" as they are, and puts anything else in parentheses
+string asOperand(const string &arg) {
+    bool simple = arg.size() > 0;
+    for(char c : arg) {
+        if(!isalnum(c) && c != '_' && c != '.') {
+            simple = false;
+        }
+    }
+    if(simple || isParenthesized(arg)) {
+        return arg;
+    }
+    return "(" + arg + ")";
+}
+
+} // namespace
+
+std::string MathFunction::write(const std::vector<std::string> &args, bool fastMath) const {
+    string template_ = fastMath && fastExpression != "" ? fastExpression : expression;
+    if(template_.find('$') == string::npos) {
+        ostringstream oss;
+        oss << template_ << "(";
+        for(int i = 0; i < (int)args.size(); i++) {
+            if(i > 0) {
+                oss << ", ";
+            }
+            oss << args[i];
+        }
+        oss << ")";
+        return oss.str();
+    }
+    ostringstream oss;
+    for(int i = 0; i < (int)template_.size(); i++) {
+        char c = template_[i];
+        char next = i + 1 < (int)template_.size() ? template_[i + 1] : 0;
+        if(c != '$') {
+            oss << c;
+        } else if(next == 'L') {
+            oss << (isFloat ? "f" : "");
+            i++;
+        } else if(next == 'F') {
+            oss << (isFloat ? "_F" : "");
+            i++;
+        } else if(next >= '0' && next <= '9' && next - '0' < (int)args.size()) {
+            oss << asOperand(args[next - '0']);
+            i++;
+        } else {
+            oss << c;
+        }
+    }
+    return oss.str();
+}
+
+const MathFunction *findMathFunction(const std::string &name) {
+    const unordered_map<string, MathFunction> &functions = getMathFunctions();
+    auto it = functions.find(name);
+    if(it == functions.end()) {
+        return 0;
+    }
+    return &it->second;
+}
+
+bool isUnsupportedMathFunction(const std::string &name) {
+    const MathFunction *function = findMathFunction(name);
+    if(function != 0) {
+        return function->precision == MathFunction::Unsupported;
+    }
+    return name.find("__nv_") == 0;
+}
+
+} // namespace cocl
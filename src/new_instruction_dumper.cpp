@@ -35,6 +35,8 @@
 #include <string>
 #include <memory>
 #include <iostream>
+#include <cctype>
+#include <unordered_map>
 
 using namespace std;
 using namespace llvm;
@@ -100,6 +102,17 @@ LocalValueInfo *NewInstructionDumper::dumpConstant(llvm::Constant *constant) {
                 return constantInfo;
             }
         }
+        if(globalConstants != 0 && globalConstants->hasVariable(global)) {
+            // __constant__ variables live at a fixed offset in the constants buffer
+            Type *valueType = cast<GlobalVariable>(global)->getValueType();
+            string typeString = typeDumper->dumpType(PointerType::get(valueType, 4));
+            updateAddressSpace(constant, 4);
+            constantInfo->setAddressSpace(4);
+            constantInfo->clWriter.reset(new ClWriter(constantInfo));
+            constantInfo->setExpression("((" + typeString + ")(pGlobalVars->constants + " +
+                easycl::toString(globalConstants->getOffset(global)) + "))");
+            return constantInfo;
+        }
         // at about this point we should pehaps swap to come global-specific class to handle this?
         if(globalNames->hasName(constant)) {
             // hmmmm, shouldwe be handling global values too???
@@ -292,7 +305,12 @@ void NewInstructionDumper::dumpExt(cocl::LocalValueInfo *localValueInfo) {
 
     ostringstream gencode;
     LocalValueInfo *op0info = getOperand(instr->getOperand(0));
-    gencode << "(" << typeDumper->dumpType(instr->getType()) << ")" << op0info->getExpr();
+    if(isa<FPExtInst>(instr) && isa<VectorType>(instr->getType())) {
+        // opencl doesnt allow casts between vector types, eg cocl_half2 to float2
+        gencode << "convert_" << typeDumper->dumpType(instr->getType()) << "(" << op0info->getExpr() << ")";
+    } else {
+        gencode << "(" << typeDumper->dumpType(instr->getType()) << ")" << op0info->getExpr();
+    }
 
     localValueInfo->setExpression("(" + gencode.str() + ")");
     localValueInfo->setAddressSpace(0);
@@ -308,6 +326,11 @@ void NewInstructionDumper::dumpTrunc(cocl::LocalValueInfo *localValueInfo) {
     // since this is float point trunc, lets just assume we're going from double to float
     // fix any exceptiosn to this rule later
     string typestr = typeDumper->dumpType(instr->getType());
+    if(isa<FPTruncInst>(instr) && isa<VectorType>(instr->getType())) {
+        // eg float2 to cocl_half2, for which the half definitions provide convert_cocl_half2
+        localValueInfo->setExpression("convert_" + typestr + "(" + op0 + ")");
+        return;
+    }
     localValueInfo->setExpression("(" + typestr + ")" + op0);
 }
 
@@ -394,6 +417,8 @@ void NewInstructionDumper::dumpGetElementPtr(cocl::LocalValueInfo *localValueInf
     Type *currentType = instr->getOperand(0)->getType();
     PointerType *op0typeptr = cast<PointerType>(instr->getOperand(0)->getType());
     int addressspace = op0typeptr->getAddressSpace();
+    // if AddressSpaceInference proved the address space, we dont need to guess for pointers inside structs
+    int inferredAddressSpace = addressSpaceInference != 0 ? addressSpaceInference->getAddressSpace(instr) : -1;
     if(addressspace == 3) { // local/shared memory
         // pointer into shared memory.
         // so, this isnt a local value in llvm, its a global one
@@ -424,7 +449,7 @@ void NewInstructionDumper::dumpGetElementPtr(cocl::LocalValueInfo *localValueInf
             // it is an array of virtual mem offsets
             // we should check the parent type
             // also, this should be an array of *pointers*, not just primitive elements
-            if(prevType != nullptr &&
+            if(inferredAddressSpace < 0 && prevType != nullptr &&
                     isa<StructType>(prevType) &&
                     isa<PointerType>(seqType->getElementType())
                     ) {
@@ -459,7 +484,8 @@ void NewInstructionDumper::dumpGetElementPtr(cocl::LocalValueInfo *localValueInf
                 Type *elementType = structtype->getElementType(idx);
                 rhs += string(".f") + easycl::toString(idx);
                 newType = elementType;
-                if(PointerType *newTypeAsPointer = dyn_cast<PointerType>(newType)) {
+                PointerType *newTypeAsPointer = dyn_cast<PointerType>(newType);
+                if(newTypeAsPointer != 0 && inferredAddressSpace < 0) {
                     // if its a pointer in a struct, hackily assume gloal for now
                     addressspace = 1;
                     // ~~assume addressspace 5, which we define to mean: virtual memory~~
@@ -491,6 +517,9 @@ void NewInstructionDumper::dumpGetElementPtr(cocl::LocalValueInfo *localValueInf
         prevType = currentType;
         currentType = newType;
     }
+    if(inferredAddressSpace >= 0) {
+        addressspace = inferredAddressSpace;
+    }
     updateAddressSpace(instr, addressspace);
     localValueInfo->setAddressSpace(addressspace);
     rhs = "(" + ExpressionsHelper::stripOuterParams(rhs) + ")";
@@ -499,6 +528,40 @@ void NewInstructionDumper::dumpGetElementPtr(cocl::LocalValueInfo *localValueInf
     localValueInfo->setExpression(rhs);
 }
 
+// llvm vectors, and float4, are written as native opencl vectors, and loaded and stored using vloadN/vstoreN,
+// which only need the alignment of a single element. returns the number of elements, or 0 if not a vector
+static int getNativeVectorWidth(Type *type, Type **pElementType) {
+    if(VectorType *vectorType = dyn_cast<VectorType>(type)) {
+        *pElementType = vectorType->getElementType();
+        return vectorType->getNumElements();
+    }
+    if(StructType *structType = dyn_cast<StructType>(type)) {
+        if(structType->hasName() && ReadIR::getName(structType) == "struct.float4") {
+            *pElementType = structType->getElementType(0);
+            return 4;
+        }
+    }
+    return 0;
+}
+
+// halfs are 16 bits in memory, but might be floats once loaded, so they go through vload_half and vstore_half,
+// or their cl_khr_fp16 equivalents; see TypeDumper::dumpHalfDefinitions
+static string dumpHalfLoad(TypeDumper *typeDumper, int halfWidth, unsigned int addressSpace, string pointerExpr) {
+    string suffix = halfWidth > 1 ? easycl::toString(halfWidth) : "";
+    return "cocl_vload_half" + suffix + "(0, (" + typeDumper->dumpHalfPointerType(addressSpace) + ")" + pointerExpr + ")";
+}
+
+static string dumpHalfStore(
+        TypeDumper *typeDumper, int halfWidth, unsigned int addressSpace, string pointerExpr, string valueExpr) {
+    string suffix = halfWidth > 1 ? easycl::toString(halfWidth) : "";
+    return "cocl_vstore_half" + suffix + "(" + valueExpr + ", 0, (" + typeDumper->dumpHalfPointerType(addressSpace) + ")" +
+        pointerExpr + ")";
+}
+
+static string getVectorComponent(int idx) {
+    return string(".s") + "0123456789abcdef"[idx];
+}
+
 void NewInstructionDumper::dumpLoad(cocl::LocalValueInfo *localValueInfo) {
     localValueInfo->clWriter.reset(new ClWriter(localValueInfo));
     Instruction *instr = cast<Instruction>(localValueInfo->value);
@@ -512,7 +575,21 @@ void NewInstructionDumper::dumpLoad(cocl::LocalValueInfo *localValueInfo) {
             destIsSinglePointer = true;
         }
     }
-    if(cast<PointerType>(instr->getOperand(0)->getType())->getAddressSpace() == 5 && destIsSinglePointer) {
+    int inferredAddressSpace = addressSpaceInference != 0 ? addressSpaceInference->getAddressSpace(instr) : -1;
+    int halfWidth = TypeDumper::getHalfWidth(instr->getType());
+    // a pointer stored in vmem is a vmem offset, however well we know where it points, so it still
+    // needs getGlobalPointer
+    bool loadsFromVmem = cast<PointerType>(instr->getOperand(0)->getType())->getAddressSpace() == 5 && destIsSinglePointer;
+    if(inferredAddressSpace >= 0 && !loadsFromVmem) {
+        // we know where the pointer came from, so no need for vmem
+        if(halfWidth > 0) {
+            rhs = dumpHalfLoad(typeDumper, halfWidth, inferredAddressSpace, getOperand(instr->getOperand(0))->getExpr());
+        } else {
+            rhs = getOperand(instr->getOperand(0))->getExpr() + "[0]";
+        }
+        updateAddressSpace(instr, inferredAddressSpace);
+        localValueInfo->setAddressSpace(inferredAddressSpace);
+    } else if(loadsFromVmem) {
         localValueInfo->inlineCl.push_back(
             "global " + typeDumper->dumpType(instr->getType()) + " " + localValueInfo->name + "_gptrstep = getGlobalPointer(" +
                 getOperand(instr->getOperand(0))->getExpr() + "[0], pGlobalVars" +
@@ -523,7 +600,18 @@ void NewInstructionDumper::dumpLoad(cocl::LocalValueInfo *localValueInfo) {
         updateAddressSpace(instr, 1);
         localValueInfo->addressSpace = 1;
     } else {
-        rhs = getOperand(instr->getOperand(0))->getExpr() + "[0]";
+        Type *elementType = 0;
+        int vectorWidth = getNativeVectorWidth(instr->getType(), &elementType);
+        unsigned srcAddressSpace = cast<PointerType>(instr->getOperand(0)->getType())->getAddressSpace();
+        if(halfWidth > 0 && srcAddressSpace != 5) {
+            rhs = dumpHalfLoad(typeDumper, halfWidth, srcAddressSpace, getOperand(instr->getOperand(0))->getExpr());
+        } else if(vectorWidth > 0 && srcAddressSpace != 5) {
+            Type *elementPointerType = PointerType::get(elementType, srcAddressSpace);
+            rhs = "vload" + easycl::toString(vectorWidth) + "(0, (" + typeDumper->dumpType(elementPointerType) + ")" +
+                getOperand(instr->getOperand(0))->getExpr() + ")";
+        } else {
+            rhs = getOperand(instr->getOperand(0))->getExpr() + "[0]";
+        }
         copyAddressSpace(instr->getOperand(0), instr);
         localValueInfo->setAddressSpaceFrom(instr->getOperand(0));
     }
@@ -556,7 +644,19 @@ void NewInstructionDumper::dumpStore(cocl::LocalValueInfo *localValueInfo) {
 
     string rhs = op0info->getExpr();
     rhs = ExpressionsHelper::stripOuterParams(rhs);
-    string inlinecode = lhs + "[0] = " + rhs;
+    Type *elementType = 0;
+    int vectorWidth = getNativeVectorWidth(instr->getOperand(0)->getType(), &elementType);
+    int halfWidth = TypeDumper::getHalfWidth(instr->getOperand(0)->getType());
+    string inlinecode = "";
+    if(halfWidth > 0 && destAddressSpace != 5) {
+        inlinecode = dumpHalfStore(typeDumper, halfWidth, destAddressSpace, lhs, rhs);
+    } else if(vectorWidth > 0 && destAddressSpace != 5) {
+        Type *elementPointerType = PointerType::get(elementType, destAddressSpace);
+        inlinecode = "vstore" + easycl::toString(vectorWidth) + "(" + rhs + ", 0, (" +
+            typeDumper->dumpType(elementPointerType) + ")" + lhs + ")";
+    } else {
+        inlinecode = lhs + "[0] = " + rhs;
+    }
     localValueInfo->inlineCl.push_back(inlinecode);
 }
 
@@ -607,13 +707,8 @@ void NewInstructionDumper::dumpExtractValue(cocl::LocalValueInfo *localValueInfo
         } else if(StructType *structtype = dyn_cast<StructType>(currentType)) {
             string structName = ReadIR::getName(structtype);
             if(structName == "struct.float4") {
-                Type *elementType = structtype->getElementType(idx);
-                Type *castType = PointerType::get(elementType, 0);
-                newType = elementType;
-                string oldRhs = rhs.str();
-                rhs.str("");
-                rhs << "((" << typeDumper->dumpType(castType) << ")&" << oldRhs << ")";
-                rhs << "[" << idx << "]";
+                newType = structtype->getElementType(idx);
+                rhs << getVectorComponent(idx);
             } else {
                 // generic struct
                 Type *elementType = structtype->getElementType(idx);
@@ -673,11 +768,8 @@ void NewInstructionDumper::dumpInsertValue(cocl::LocalValueInfo *localValueInfo)
         } else if(StructType *structtype = dyn_cast<StructType>(currentType)) {
             string structName = ReadIR::getName(structtype);
             if(structName == "struct.float4") {
-                Type *elementType = structtype->getElementType(idx);
-                Type *castType = PointerType::get(elementType, 0);
-                newType = elementType;
-                lhs = "((" + typeDumper->dumpType(castType) + ")&" + lhs + ")";
-                lhs += string("[") + easycl::toString(idx) + "]";
+                newType = structtype->getElementType(idx);
+                lhs += getVectorComponent(idx);
             } else {
                 Type *elementType = structtype->getElementType(idx);
                 lhs += string(".f") + easycl::toString(idx);
@@ -694,6 +786,48 @@ void NewInstructionDumper::dumpInsertValue(cocl::LocalValueInfo *localValueInfo)
     localValueInfo->setExpression(incomingOperand);
 }
 
+void NewInstructionDumper::dumpExtractElement(cocl::LocalValueInfo *localValueInfo) {
+    localValueInfo->clWriter.reset(new ClWriter(localValueInfo));
+    ExtractElementInst *instr = cast<ExtractElementInst>(localValueInfo->value);
+
+    LocalValueInfo *vectorInfo = getOperand(instr->getVectorOperand());
+    ConstantInt *idx = dyn_cast<ConstantInt>(instr->getIndexOperand());
+    if(idx == 0) {
+        COCL_LLVM_DUMP(instr);
+        throw runtime_error("not implemented: extractelement with non-constant index");
+    }
+    string vectorExpr = ExpressionsHelper::stripOuterParams(vectorInfo->getExpr());
+    localValueInfo->setExpression("(" + vectorExpr + ")" + getVectorComponent(idx->getZExtValue()));
+}
+
+void NewInstructionDumper::dumpInsertElement(cocl::LocalValueInfo *localValueInfo) {
+    localValueInfo->clWriter.reset(new InsertValueClWriter(localValueInfo));
+    InsertValueClWriter *clWriter = cast<InsertValueClWriter>(localValueInfo->clWriter.get());
+    InsertElementInst *instr = cast<InsertElementInst>(localValueInfo->value);
+
+    ConstantInt *idx = dyn_cast<ConstantInt>(instr->getOperand(2));
+    if(idx == 0) {
+        COCL_LLVM_DUMP(instr);
+        throw runtime_error("not implemented: insertelement with non-constant index");
+    }
+    LocalValueInfo *elementInfo = getOperand(instr->getOperand(1));
+
+    // same approach as insertvalue: declare a variable if we start from undef, otherwise update
+    // the incoming vector in place
+    string incomingOperand = "";
+    if(isa<UndefValue>(instr->getOperand(0))) {
+        clWriter->fromUndef = true;
+        localValueInfo->toBeDeclared = true;
+        localValueInfo->setExpression(localValueInfo->name);
+        incomingOperand = localValueInfo->getExpr();
+    } else {
+        incomingOperand = getOperand(instr->getOperand(0))->getExpr();
+    }
+    string lhs = incomingOperand + getVectorComponent(idx->getZExtValue());
+    localValueInfo->inlineCl.push_back(lhs + " = " + ExpressionsHelper::stripOuterParams(elementInfo->getExpr()));
+    localValueInfo->setExpression(incomingOperand);
+}
+
 // this will be slowtastic, but at least it gets things working...
 void NewInstructionDumper::dumpMemcpy(LocalValueInfo *localValueInfo, int align) {
     localValueInfo->clWriter.reset(new NoExpressionClWriter(localValueInfo));
@@ -725,7 +859,17 @@ void NewInstructionDumper::dumpMemcpy(LocalValueInfo *localValueInfo, int align)
     }
 }
 
-void NewInstructionDumper::writeShimCall(LocalValueInfo *localValueInfo, std::string shimName, std::string extraArgs, CallInst *instr) {
+// shimName goes through pGlobalVars->scratch: a value per work-item for shuffles and tile reductions, eg
+// __shfl_down_double, a bit per work-item for votes
+void NewInstructionDumper::useScratch(const std::string &shimName) {
+    string suffix = "_double";
+    bool isDouble = shimName.size() > suffix.size() && shimName.substr(shimName.size() - suffix.size()) == suffix;
+    this->usesScratch = true;
+    this->scratchBytesPerWorkItem = std::max(scratchBytesPerWorkItem, isDouble ? 8 : 4);
+}
+
+void NewInstructionDumper::writeShimCall(LocalValueInfo *localValueInfo, std::string shimName, std::string extraArgs, CallInst *instr,
+        std::string trailingArgs) {
     // this probalby assumes:
     // - returns a primitive
     // - parameters are all primitives (no pointers)
@@ -741,13 +885,285 @@ void NewInstructionDumper::writeShimCall(LocalValueInfo *localValueInfo, std::st
         gencode_ss << ExpressionsHelper::stripOuterParams(getOperand(op)->getExpr());
         i++;
     }
-    gencode_ss << ")";
+    gencode_ss << trailingArgs << ")";
     // shimFunctionsNeeded->insert(shimName);
     shims->use(shimName);
     localValueInfo->setAddressSpace(0);
     localValueInfo->setExpression(gencode_ss.str());
 }
 
+// eg _Z11__shfl_downIfET_S0_ii => __shfl_down_float, with width.  The non-template overloads,
+// eg _Z10__shfl_xorii, work too.  Returns false if mangledName isnt a shuffle
+static bool getShuffleShim(const string &mangledName, string *shimName, bool *hasWidth) {
+    const char *ops[] = {"__shfl", "__shfl_up", "__shfl_down", "__shfl_xor"};
+    for(int i = 0; i < 4; i++) {
+        string op = ops[i];
+        string prefix = "_Z" + easycl::toString(op.size()) + op;
+        if(mangledName.find(prefix) != 0) {
+            continue;
+        }
+        string rest = mangledName.substr(prefix.size());
+        char typeCode = 0;
+        string args = "";
+        if(rest.size() >= 5 && rest[0] == 'I' && rest.substr(2, 3) == "ET_") {
+            typeCode = rest[1];
+            args = rest.substr(5);
+            if(args.find("S0_") != 0) {
+                return false;
+            }
+            args = args.substr(3);
+        } else if(rest.size() >= 1) {
+            typeCode = rest[0];
+            args = rest.substr(1);
+        }
+        if(args != "i" && args != "ii") {
+            return false;
+        }
+        string type = "";
+        switch(typeCode) {
+            case 'i': type = "int"; break;
+            case 'j': type = "uint"; break;
+            case 'f': type = "float"; break;
+            case 'd': type = "double"; break;
+            default: return false;
+        }
+        *shimName = op + "_" + type;
+        *hasWidth = args == "ii";
+        return true;
+    }
+    return false;
+}
+
+// eg _Z22__cocl_tile_reduce_addfi => __tile_reduce_add_float.  These are declared in cooperative_groups.h.
+// Returns "" if mangledName isnt a tile reduction
+static string getTileReduceShim(const string &mangledName) {
+    const char *ops[] = {"add", "min", "max"};
+    for(int i = 0; i < 3; i++) {
+        string name = string("__cocl_tile_reduce_") + ops[i];
+        string prefix = "_Z" + easycl::toString(name.size()) + name;
+        if(mangledName.find(prefix) != 0 || mangledName.size() != prefix.size() + 2
+                || mangledName[prefix.size() + 1] != 'i') {
+            continue;
+        }
+        switch(mangledName[prefix.size()]) {
+            case 'i': return string("__tile_reduce_") + ops[i] + "_int";
+            case 'j': return string("__tile_reduce_") + ops[i] + "_uint";
+            case 'f': return string("__tile_reduce_") + ops[i] + "_float";
+            case 'd': return string("__tile_reduce_") + ops[i] + "_double";
+            default: return "";
+        }
+    }
+    return "";
+}
+
+// warp votes, and the shims that implement them.  The llvm.nvvm ones are what clang's own
+// cuda headers produce
+static string getVoteShim(const string &functionName) {
+    static map<string, string> shimByName;
+    if(shimByName.size() == 0) {
+        shimByName["_Z5__alli"] = "__all";
+        shimByName["_Z5__anyi"] = "__any";
+        shimByName["_Z8__balloti"] = "__ballot";
+        shimByName["_Z10__all_syncji"] = "__all_sync";
+        shimByName["_Z10__any_syncji"] = "__any_sync";
+        shimByName["_Z13__ballot_syncji"] = "__ballot_sync";
+        shimByName["llvm.nvvm.vote.all"] = "__all";
+        shimByName["llvm.nvvm.vote.any"] = "__any";
+        shimByName["llvm.nvvm.vote.ballot"] = "__ballot";
+        shimByName["llvm.nvvm.vote.all.sync"] = "__all_sync";
+        shimByName["llvm.nvvm.vote.any.sync"] = "__any_sync";
+        shimByName["llvm.nvvm.vote.ballot.sync"] = "__ballot_sync";
+    }
+    auto it = shimByName.find(functionName);
+    return it == shimByName.end() ? "" : it->second;
+}
+
+// eg _Z9atomicMaxIiET_PS0_S0_ => op "Max", typeCode 'i'.  Also the non-template overloads,
+// eg _Z9atomicCASPjjj, _Z10atomicExchPVyy
+static bool parseAtomicName(const string &mangledName, string *op, char *typeCode) {
+    if(mangledName.find("_Z") != 0) {
+        return false;
+    }
+    size_t pos = 2;
+    int nameLength = 0;
+    while(pos < mangledName.size() && isdigit(mangledName[pos])) {
+        nameLength = nameLength * 10 + (mangledName[pos] - '0');
+        pos++;
+    }
+    string name = mangledName.substr(pos, nameLength);
+    if(name.find("atomic") != 0 || name.size() <= 6) {
+        return false;
+    }
+    *op = name.substr(6);
+    int numArgs = *op == "CAS" ? 3 : 2;
+    string rest = mangledName.substr(pos + nameLength);
+    if(rest.size() >= 5 && rest[0] == 'I' && rest.substr(2, 3) == "ET_") {
+        *typeCode = rest[1];
+        string expected = "PS0_S0_";
+        if(numArgs == 3) {
+            expected += "S0_";
+        }
+        return rest.substr(5) == expected;
+    }
+    if(rest.find("PV") == 0) {
+        rest = rest.substr(2);
+    } else if(rest.find("P") == 0) {
+        rest = rest.substr(1);
+    } else {
+        return false;
+    }
+    if(rest.size() != (size_t)numArgs) {
+        return false;
+    }
+    *typeCode = rest[0];
+    return rest == string(numArgs, rest[0]);
+}
+
+// the opencl function for a cuda atomic, eg atomicMax on an int => atomic_max.  64-bit integers
+// need the __int64_atomics shim.  Returns "" if we dont handle it here
+static string getAtomicClFunction(const string &op, char typeCode, bool *is64bit) {
+    static map<string, string> clOpByCudaOp;
+    if(clOpByCudaOp.size() == 0) {
+        clOpByCudaOp["Add"] = "add";
+        clOpByCudaOp["Sub"] = "sub";
+        clOpByCudaOp["Max"] = "max";
+        clOpByCudaOp["Min"] = "min";
+        clOpByCudaOp["Exch"] = "xchg";
+        clOpByCudaOp["CAS"] = "cmpxchg";
+        clOpByCudaOp["And"] = "and";
+        clOpByCudaOp["Or"] = "or";
+        clOpByCudaOp["Xor"] = "xor";
+    }
+    if(clOpByCudaOp.find(op) == clOpByCudaOp.end()) {
+        return "";
+    }
+    string clOp = clOpByCudaOp[op];
+    *is64bit = false;
+    switch(typeCode) {
+        case 'i':
+        case 'j':
+            return "atomic_" + clOp;
+        case 'x':
+        case 'y':
+            *is64bit = true;
+            return "atom_" + clOp;
+        case 'f':
+            // add is a shim, see below
+            return op == "Exch" ? "atomic_xchg" : "";
+        default:
+            return "";
+    }
+}
+
+// the device side texture functions, declared in cocl_texture.h.  Returns false if functionName isnt a tex2D
+static bool getTex2DRead(const string &functionName, string *readFunction, string *component) {
+    if(functionName == "__cocl_tex2D_float") {
+        *readFunction = "read_imagef";
+        *component = ".x";
+    } else if(functionName == "__cocl_tex2D_int") {
+        *readFunction = "read_imagei";
+        *component = ".x";
+    } else if(functionName == "__cocl_tex2D_uint") {
+        *readFunction = "read_imageui";
+        *component = ".x";
+    } else if(functionName == "__cocl_tex2D_float4") {
+        *readFunction = "read_imagef";
+        *component = "";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// texture objects become kernel parameters of types that opencl wont let us pass around, see
+// FunctionDumper::dumpKernelFunctionDeclarationWithoutReturn, so we can only read them in the kernel itself
+static Value *getKernelTexture(Value *texture) {
+    if(!isa<Argument>(texture)) {
+        COCL_LLVM_DUMP(texture);
+        throw runtime_error("texture objects can only be read in the kernel they are passed to");
+    }
+    return texture;
+}
+
+void NewInstructionDumper::dumpTex2D(LocalValueInfo *localValueInfo, std::string readFunction, std::string component) {
+    CallInst *instr = cast<CallInst>(localValueInfo->value);
+    // float4 comes back through a pointer, the first argument
+    bool hasOutPointer = instr->getType()->isVoidTy();
+    int textureArgIdx = hasOutPointer ? 1 : 0;
+    Value *texture = getKernelTexture(instr->getArgOperand(textureArgIdx));
+    string textureName = localNames->getName(texture);
+
+    ostringstream gencode;
+    if(hasOutPointer) {
+        gencode << "*" << getOperand(instr->getArgOperand(0))->getExpr() << " = ";
+    }
+    gencode << readFunction << "(" << textureName << ", " << textureName << "_sampler, (float2)(";
+    gencode << ExpressionsHelper::stripOuterParams(getOperand(instr->getArgOperand(textureArgIdx + 1))->getExpr()) << ", ";
+    gencode << ExpressionsHelper::stripOuterParams(getOperand(instr->getArgOperand(textureArgIdx + 2))->getExpr()) << "))";
+    gencode << component;
+    localValueInfo->setAddressSpace(0);
+    localValueInfo->setExpression(gencode.str());
+}
+
+// the threadIdx, blockIdx, blockDim and gridDim reads, by their intrinsic, eg llvm.nvvm.read.ptx.sreg.tid.x, or
+// llvm.ptx.read.tid.x, for llvm 3.8.  register is the ptx name, eg "tid"
+static bool getSpecialRegister(const std::string &functionName, std::string *specialRegister, int *dimension) {
+    static const std::unordered_map<std::string, std::pair<std::string, int> > registers = []() {
+        std::unordered_map<std::string, std::pair<std::string, int> > registers;
+        for(std::string name : {"tid", "ntid", "ctaid", "nctaid"}) {
+            for(int d = 0; d < 3; d++) {
+                std::string suffix = name + "." + "xyz"[d];
+                registers["llvm.nvvm.read.ptx.sreg." + suffix] = std::make_pair(name, d);
+                registers["llvm.ptx.read." + suffix] = std::make_pair(name, d);
+            }
+        }
+        return registers;
+    }();
+    auto it = registers.find(functionName);
+    if(it == registers.end()) {
+        return false;
+    }
+    *specialRegister = it->second.first;
+    *dimension = it->second.second;
+    return true;
+}
+
+std::string NewInstructionDumper::getSpecialRegisterExpression(std::string specialRegister, int dimension) {
+    ostringstream oss;
+    if(specialRegister == "tid") {
+        oss << "get_local_id(" << dimension << ")";
+    } else if(specialRegister == "ntid") {
+        oss << "get_local_size(" << dimension << ")";
+    } else if(specialRegister == "ctaid") {
+        if(groupIdsFromGlobalVars) {
+            oss << "pGlobalVars->groupId[" << dimension << "]";
+        } else {
+            oss << "get_group_id(" << dimension << ")";
+        }
+    } else if(groupIdsFromGlobalVars) {
+        oss << "pGlobalVars->numGroups[" << dimension << "]";
+    } else {
+        oss << "get_num_groups(" << dimension << ")";
+    }
+    return oss.str();
+}
+
+void NewInstructionDumper::dumpMathCall(LocalValueInfo *localValueInfo, const MathFunction *mathFunction) {
+    CallInst *instr = cast<CallInst>(localValueInfo->value);
+    string functionName = instr->getCalledValue()->getName().str();
+    if(mathFunction->precision == MathFunction::Unsupported) {
+        cout << functionName << " has no OpenCL equivalent" << endl;
+        throw runtime_error(functionName + " has no OpenCL equivalent, so kernels calling it cannot run");
+    }
+    vector<string> args;
+    for(auto it=instr->arg_begin(); it != instr->arg_end(); it++) {
+        Value *op = &*it->get();
+        args.push_back(ExpressionsHelper::stripOuterParams(getOperand(op)->getExpr()));
+    }
+    localValueInfo->setAddressSpace(0);
+    localValueInfo->setExpression(mathFunction->write(args, fastMath));
+}
+
 void NewInstructionDumper::dumpCall(LocalValueInfo *localValueInfo, const std::map<llvm::Function *, llvm::Type *> &returnTypeByFunction) {
     localValueInfo->clWriter.reset(new CallClWriter(localValueInfo));
     CallInst *instr = cast<CallInst>(localValueInfo->value);
@@ -757,77 +1173,54 @@ void NewInstructionDumper::dumpCall(LocalValueInfo *localValueInfo, const std::m
 
     string functionName = instr->getCalledValue()->getName().str();
     bool internalfunc = false;
-    if(functionName == "llvm.ptx.read.tid.x" || functionName == "llvm.nvvm.read.ptx.sreg.tid.x") { // second on is llvm 4.0, first is 3.8
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_id(0)");
-        return;
-    } else if(functionName == "llvm.ptx.read.tid.y" || functionName == "llvm.nvvm.read.ptx.sreg.tid.y") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_id(1)");
-        return;
-    } else if(functionName == "llvm.ptx.read.tid.z" || functionName == "llvm.nvvm.read.ptx.sreg.tid.z") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_id(2)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ctaid.x" || functionName == "llvm.nvvm.read.ptx.sreg.ctaid.x") {  // second is for llvm4.0
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_group_id(0)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ctaid.y" || functionName == "llvm.nvvm.read.ptx.sreg.ctaid.y") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_group_id(1)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ctaid.z" || functionName == "llvm.nvvm.read.ptx.sreg.ctaid.z") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_group_id(2)");
-        return;
-    } else if(functionName == "llvm.ptx.read.nctaid.x" || functionName == "llvm.nvvm.read.ptx.sreg.nctaid.x") {  // second is for llvm 4.0
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_num_groups(0)");
-        return;
-    } else if(functionName == "llvm.ptx.read.nctaid.y" || functionName == "llvm.nvvm.read.ptx.sreg.nctaid.y") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_num_groups(1)");
-        return;
-    } else if(functionName == "llvm.ptx.read.nctaid.z" || functionName == "llvm.nvvm.read.ptx.sreg.nctaid.z") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_num_groups(2)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ntid.x" || functionName == "llvm.nvvm.read.ptx.sreg.ntid.x") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_size(0)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ntid.y" || functionName == "llvm.nvvm.read.ptx.sreg.ntid.y") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_size(1)");
-        return;
-    } else if(functionName == "llvm.ptx.read.ntid.z" || functionName == "llvm.nvvm.read.ptx.sreg.ntid.z") {
+    string shuffleShimName = "";
+    bool shuffleHasWidth = false;
+    string atomicOp = "";
+    char atomicTypeCode = 0;
+    bool atomicIs64bit = false;
+    string texReadFunction = "";
+    string texComponent = "";
+    string specialRegister = "";
+    int dimension = 0;
+    // math functions the .cu defines itself, eg a device function called erf, are called like any other
+    const MathFunction *mathFunction = findMathFunction(functionName);
+    Function *calledFunction = instr->getCalledFunction();
+    if(calledFunction != 0 && !calledFunction->isDeclaration()) {
+        mathFunction = 0;
+    }
+    if(getSpecialRegister(functionName, &specialRegister, &dimension)) {
         localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("get_local_size(2)");
+        localValueInfo->setExpression(getSpecialRegisterExpression(specialRegister, dimension));
         return;
-    } else if(functionName == "llvm.cuda.syncthreads" || functionName == "_Z11syncthreadsv") {
-        localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("barrier(CLK_GLOBAL_MEM_FENCE)");
+    } else if(mathFunction != 0) {
+        dumpMathCall(localValueInfo, mathFunction);
         return;
-    } else if(functionName == "llvm.nvvm.barrier0") {
+    } else if(functionName == "llvm.cuda.syncthreads" || functionName == "_Z11syncthreadsv" || functionName == "llvm.nvvm.barrier0") {
+        // only fence global memory if FunctionDumper::analyzeBarrierFences found global memory accesses
+        // since the previous barrier
         localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("barrier(CLK_LOCAL_MEM_FENCE)");
+        if(globalFenceBarriers != 0 && globalFenceBarriers->find(instr) == globalFenceBarriers->end()) {
+            localValueInfo->setExpression("barrier(CLK_LOCAL_MEM_FENCE)");
+        } else {
+            localValueInfo->setExpression("barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE)");
+        }
         return;
-    } else if(functionName == "_Z13__threadfencev") {
-        // Not sure if this is correct?
-        // seems to be correct-ish???
-        // what I understand:
-        // (from https://stackoverflow.com/questions/5232689/cuda-threadfence/5233737#5233737 )
-        // threadfence orders writes to memory, so if you do:
+    } else if(functionName == "_Z13__threadfencev" || functionName == "llvm.nvvm.membar.gl" || functionName == "llvm.nvvm.membar.sys"
+            || functionName == "_Z20__threadfence_systemv") {
+        // threadfence orders this thread's memory accesses, so if you do:
         // - write data
         // - threadfence
         // - write flag
         // => then if another thread sees the flag, the data that was written is guaranteed to be visible
         // to it too
-        // I *think* that barrier(CLK_GLOBAL_MEM_FENCE) achieves the same thing, though it might be
-        // a bit too "strong" (ie slow)?
+        // It doesnt wait for other threads, so it must not be a barrier: under divergence a barrier would
+        // deadlock.  mem_fence is the closest thing OpenCL 1.2 has.
         localValueInfo->setAddressSpace(0);
-        localValueInfo->setExpression("barrier(CLK_GLOBAL_MEM_FENCE)");
+        localValueInfo->setExpression("mem_fence(CLK_GLOBAL_MEM_FENCE)");
+        return;
+    } else if(functionName == "_Z19__threadfence_blockv" || functionName == "llvm.nvvm.membar.cta") {
+        localValueInfo->setAddressSpace(0);
+        localValueInfo->setExpression("mem_fence(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE)");
         return;
     } else if(functionName == "llvm.dbg.value") {
         // ignore
@@ -840,27 +1233,48 @@ void NewInstructionDumper::dumpCall(LocalValueInfo *localValueInfo, const std::m
     } else if(functionName == "_Z8__umulhiii") {
         writeShimCall(localValueInfo, "__umulhi", "", instr);
         return;
-    } else if(functionName == "_Z7sincosffPfS_") {
-        localValueInfo->setAddressSpace(0);
-        std::ostringstream gencode;
-        gencode << "*" << getOperand(instr->getOperand(1))->getExpr() << " = sincos(";
-        gencode << getOperand(instr->getOperand(0))->getExpr() << ", ";
-        gencode << getOperand(instr->getOperand(2))->getExpr() << ");";
-        localValueInfo->setExpression(gencode.str());
-        return;
     } else if(functionName == "_Z9atomicAddIfET_PS0_S0_") {
         writeShimCall(localValueInfo, "__atomic_add_float", "", instr);
         return;
+    } else if(functionName == "_Z9atomicAddIdET_PS0_S0_") {
+        writeShimCall(localValueInfo, "__atomic_add_double", "", instr);
+        return;
+    } else if(parseAtomicName(functionName, &atomicOp, &atomicTypeCode)
+            && getAtomicClFunction(atomicOp, atomicTypeCode, &atomicIs64bit) != "") {
+        if(atomicIs64bit) {
+            shims->use("__int64_atomics");
+        }
+        functionName = getAtomicClFunction(atomicOp, atomicTypeCode, &atomicIs64bit);
+        internalfunc = true;
     } else if(functionName == "_Z9atomicIncPjj") {
         writeShimCall(localValueInfo, "__atomic_inc_uint", "", instr);
         return;
-    } else if(functionName == "_Z11__shfl_downIfET_S0_ii") {
-        writeShimCall(localValueInfo, "__shfl_down_3", "pGlobalVars->scratch, ", instr);
-        this->usesScratch = true;
+    } else if(getVoteShim(functionName) != "") {
+        writeShimCall(localValueInfo, getVoteShim(functionName), "pGlobalVars->scratch, ", instr);
+        useScratch(getVoteShim(functionName));
+        return;
+    } else if(functionName == "_Z10__syncwarpj" || functionName == "llvm.nvvm.bar.warp.sync") {
+        writeShimCall(localValueInfo, "__syncwarp", "", instr);
+        return;
+    } else if(getShuffleShim(functionName, &shuffleShimName, &shuffleHasWidth)) {
+        // the scratch is only needed on devices without sub-group shuffles, but we dont know
+        // yet which device we'll run on
+        writeShimCall(localValueInfo, shuffleShimName, "pGlobalVars->scratch, ", instr, shuffleHasWidth ? "" : ", 32");
+        useScratch(shuffleShimName);
+        return;
+    } else if(getTileReduceShim(functionName) != "") {
+        writeShimCall(localValueInfo, getTileReduceShim(functionName), "pGlobalVars->scratch, ", instr);
+        useScratch(getTileReduceShim(functionName));
         return;
-    } else if(functionName == "_Z11__shfl_downIfET_S0_i") {
-        writeShimCall(localValueInfo, "__shfl_down_2", "pGlobalVars->scratch, ", instr);
-        this->usesScratch = true;
+    } else if(functionName == "__cocl_texture_linear") {
+        // linear memory textures are passed in as global buffers, so tex1Dfetch is just a load
+        Value *texture = getKernelTexture(instr->getArgOperand(0));
+        updateAddressSpace(instr, 1);
+        localValueInfo->setAddressSpace(1);
+        localValueInfo->setExpression(getOperand(texture)->getExpr());
+        return;
+    } else if(getTex2DRead(functionName, &texReadFunction, &texComponent)) {
+        dumpTex2D(localValueInfo, texReadFunction, texComponent);
         return;
     } else if(functionName == "llvm.lifetime.start") {
         // just ignore for now
@@ -961,6 +1375,9 @@ void NewInstructionDumper::dumpCall(LocalValueInfo *localValueInfo, const std::m
                     newFunc = CloneFunction(F,
                                    valueMap);
                     newFunc->setName(newName);
+                    if(addressSpaceInference != 0) {
+                        addressSpaceInference->copyToClone(valueMap);
+                    }
                     i = 0;
                     for(auto it=newFunc->arg_begin(); it != newFunc->arg_end(); it++) {
                         Value *callArg = instr->getArgOperand(i);
@@ -1143,6 +1560,12 @@ void NewInstructionDumper::runGeneration(LocalValueInfo *localValueInfo, const s
         case Instruction::ExtractValue:
             dumpExtractValue(localValueInfo);
             break;
+        case Instruction::InsertElement:
+            dumpInsertElement(localValueInfo);
+            break;
+        case Instruction::ExtractElement:
+            dumpExtractElement(localValueInfo);
+            break;
         case Instruction::Store:
             dumpStore(localValueInfo);
             break;
@@ -20,6 +20,8 @@
 #include "cocl/llvm_dump.h"
 
 #include "cocl/mutations.h"
+#include "cocl/ir-to-opencl.h"
+#include "cocl/math_functions.h"
 #include "argparsecpp/argparsecpp.h"
 #include "EasyCL/util/easycl_stringhelper.h"
 
@@ -27,6 +29,7 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/Metadata.h"
 
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -47,6 +50,11 @@ namespace cocl {
 static llvm::LLVMContext context;
 static std::string devicellcode_stringname;
 static string devicellfilename;
+static string clBuildOptions;
+
+// hostside copies of the device module's __constant__ variables; we tell the runtime about them at each
+// launch, so it can copy them into the constants buffer, see GlobalConstants
+static std::vector<llvm::GlobalVariable *> constantSymbols;
 
 static GlobalNames globalNames;
 static TypeDumper typeDumper(&globalNames);
@@ -203,6 +211,24 @@ llvm::Instruction *PatchHostside::addSetKernelArgInst_pointer(llvm::Instruction
     return lastInst;
 }
 
+llvm::Instruction *PatchHostside::addSetKernelArgInst_texture(llvm::Instruction *lastInst, llvm::Value *value) {
+    Module *M = lastInst->getModule();
+
+    BitCastInst *bitcast = new BitCastInst(value, PointerType::get(IntegerType::get(context, 8), 0));
+    bitcast->insertAfter(lastInst);
+    lastInst = bitcast;
+
+    Function *setKernelArgTexture = cast<Function>(getOrInsertFunction(
+        M,
+        "setKernelArgTexture",
+        Type::getVoidTy(context),
+        PointerType::get(IntegerType::get(context, 8), 0)));
+
+    CallInst *call = CallInst::Create(setKernelArgTexture, bitcast);
+    call->insertAfter(lastInst);
+    return call;
+}
+
 llvm::Instruction *PatchHostside::addSetKernelArgInst_pointerstruct(llvm::Instruction *lastInst, llvm::Value *structPointer) {
     // what this will need to do is:
     // - create a call to pass the gpu buffer, that contains the struct, to hostside_opencl_funcs, at runtime
@@ -403,7 +429,10 @@ llvm::Instruction *PatchHostside::addSetKernelArgInst(llvm::Instruction *lastIns
         lastInst = PatchHostside::addSetKernelArgInst_float(lastInst, value);
     } else if(value->getType()->isPointerTy()) {
         Type *elementType = dyn_cast<PointerType>(value->getType())->getElementType();
-        if(isa<StructType>(elementType)) {
+        if(isa<StructType>(elementType) && cast<StructType>(elementType)->hasName()
+                && cast<StructType>(elementType)->getName() == "struct.CoclTexture") {
+            lastInst = PatchHostside::addSetKernelArgInst_texture(lastInst, value);
+        } else if(isa<StructType>(elementType)) {
             lastInst = PatchHostside::addSetKernelArgInst_pointerstruct(lastInst, value);
         } else {
             lastInst = PatchHostside::addSetKernelArgInst_pointer(lastInst, value);
@@ -551,6 +580,30 @@ void PatchHostside::patchCudaLaunch(
     callConfigureKernel->insertBefore(inst->getInst());
     Instruction *lastInst = callConfigureKernel;
 
+    if(constantSymbols.size() > 0) {
+        Function *addConstantSymbol = cast<Function>(getOrInsertFunction(
+            F->getParent(),
+            "addConstantSymbol",
+            Type::getVoidTy(context),
+            PointerType::get(IntegerType::get(context, 8), 0),
+            PointerType::get(IntegerType::get(context, 8), 0),
+            IntegerType::get(context, 32)
+            ));
+        for(auto it=constantSymbols.begin(); it != constantSymbols.end(); it++) {
+            GlobalVariable *hostVar = *it;
+            string name = hostVar->getName().str();
+            Instruction *nameValue = addStringInstr(M, "s_" + ::devicellcode_stringname + "_constant_" + name, name);
+            nameValue->insertAfter(lastInst);
+            BitCastInst *bitcast = new BitCastInst(hostVar, PointerType::get(IntegerType::get(context, 8), 0));
+            bitcast->insertAfter(nameValue);
+            int size = M->getDataLayout().getTypeAllocSize(hostVar->getValueType());
+            Value *args[] = {nameValue, bitcast, createInt32Constant(&context, size)};
+            CallInst *call = CallInst::Create(addConstantSymbol, ArrayRef<Value *>(args));
+            call->insertAfter(bitcast);
+            lastInst = call;
+        }
+    }
+
     // pass args now
     int i = 0;
     for(auto argit=launchCallInfo->params.begin(); argit != launchCallInfo->params.end(); argit++) {
@@ -647,14 +700,26 @@ void PatchHostside::patchModule(Module *M, const Module *MDevice) {
 
     // MDevice is only for information, so we can see the declaration of kernels on the device-side
 
-    ifstream f_inll(::devicellfilename);
-    string devicell_sourcecode(
-        (std::istreambuf_iterator<char>(f_inll)),
-        (std::istreambuf_iterator<char>()));
+    // printed from MDevice, rather than read from the file, so it has the build options metadata
+    string devicell_sourcecode;
+    raw_string_ostream devicell_stream(devicell_sourcecode);
+    MDevice->print(devicell_stream, 0);
+    devicell_stream.flush();
 
     ::devicellcode_stringname = "__devicell_sourcecode" + ::devicellfilename;
     addGlobalVariable(M, devicellcode_stringname, devicell_sourcecode);
 
+    for(auto it = MDevice->global_begin(); it != MDevice->global_end(); it++) {
+        const GlobalVariable *deviceVar = &*it;
+        if(deviceVar->getType()->getAddressSpace() != 4 || !deviceVar->hasInitializer()) {
+            continue;
+        }
+        GlobalVariable *hostVar = M->getNamedGlobal(deviceVar->getName());
+        if(hostVar != 0) {
+            constantSymbols.push_back(hostVar);
+        }
+    }
+
     for(auto it = M->begin(); it != M->end(); it++) {
         Function *F = &*it;
         PatchHostside::patchFunction(M, MDevice, F);
@@ -662,6 +727,21 @@ void PatchHostside::patchModule(Module *M, const Module *MDevice) {
     }
 }
 
+// so that a kernel calling, eg, __nv_j0f, fails when we build the .cu, rather than when it is first launched
+static void reportUnsupportedMathFunctions(llvm::Module *deviceModule) {
+    for(auto it = deviceModule->begin(); it != deviceModule->end(); it++) {
+        Function *F = &*it;
+        if(!F->isDeclaration() || F->use_empty()) {
+            continue;
+        }
+        string name = F->getName().str();
+        if(isUnsupportedMathFunction(name)) {
+            cout << "warning: " << name << " has no OpenCL equivalent in Coriander, so kernels calling it will fail when "
+                "they are launched" << endl;
+        }
+    }
+}
+
 } // namespace cocl
 
 int main(int argc, char *argv[]) {
@@ -674,6 +754,7 @@ int main(int argc, char *argv[]) {
     parser.add_string_argument("--hostrawfile", &rawhostfilename)->required()->help("input file");
     parser.add_string_argument("--devicellfile", &::devicellfilename)->required()->help("input file");
     parser.add_string_argument("--hostpatchedfile", &patchedhostfilename)->required()->help("output file");
+    parser.add_string_argument("--clbuildoptions", &::clBuildOptions)->help("options for clBuildProgram, eg -cl-fast-relaxed-math");
     if(!parser.parse_args(argc, argv)) {
         return -1;
     }
@@ -688,6 +769,11 @@ int main(int argc, char *argv[]) {
         smDiagnostic.print(argv[0], errs());
         return 1;
     }
+    if(::clBuildOptions != "") {
+        NamedMDNode *buildOptions = deviceModule->getOrInsertNamedMetadata(COCL_BUILD_OPTIONS_METADATA);
+        buildOptions->addOperand(MDNode::get(context, MDString::get(context, ::clBuildOptions)));
+    }
+    reportUnsupportedMathFunctions(deviceModule.get());
 
     try {
         PatchHostside::patchModule(module.get(), deviceModule.get());
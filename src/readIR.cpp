@@ -71,6 +71,7 @@ string ReadIR::dumpFloatConstant(bool forceSingle, ConstantFP *constantFP) {
     double doubleValue;
     float floatValue;
     bool isDouble = false;
+    bool isHalf = false;
     ostringstream oss;
     const APFloat *apf = &constantFP->getValueAPF();
     switch(constantFP->getType()->getTypeID()) {
@@ -78,6 +79,11 @@ string ReadIR::dumpFloatConstant(bool forceSingle, ConstantFP *constantFP) {
             floatValue = apf->convertToFloat();
             oss << floatValue;
             break;
+        case Type::HalfTyID:
+            isHalf = true;
+            floatValue = readFloatConstant(constantFP);
+            oss << floatValue;
+            break;
         case Type::DoubleTyID:
             isDouble = true;
             doubleValue = apf->convertToDouble();
@@ -110,6 +116,10 @@ string ReadIR::dumpFloatConstant(bool forceSingle, ConstantFP *constantFP) {
     if(!isDouble || forceSingle) {
         valuestr += "f";
     }
+    if(isHalf) {
+        // every half is exactly representable as a float
+        return "((cocl_half)" + valuestr + ")";
+    }
     return valuestr;
 }
 
@@ -135,6 +145,13 @@ float ReadIR::readFloatConstant(Value *value) {
         case Type::DoubleTyID:
             res = (float)apf->convertToDouble();
             break;
+        case Type::HalfTyID: {
+            APFloat asSingle = *apf;
+            bool losesInfo = false;
+            asSingle.convert(APFloat::IEEEsingle(), APFloat::rmNearestTiesToEven, &losesInfo);
+            res = asSingle.convertToFloat();
+            break;
+        }
         default:
             throw runtime_error("unrecognized type");
     }
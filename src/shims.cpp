@@ -21,28 +21,259 @@
 
 namespace cocl {
 
+static std::string replacePlaceholder(std::string cl, const std::string &placeholder, const std::string &value) {
+    size_t pos = 0;
+    while((pos = cl.find(placeholder, pos)) != std::string::npos) {
+        cl.replace(pos, placeholder.size(), value);
+        pos += value.size();
+    }
+    return cl;
+}
+
+static std::string replaceType(std::string cl, const std::string &type) {
+    return replacePlaceholder(cl, "TYPE", type);
+}
+
 Shims::Shims() {
-    _shimClByName["__shfl_down_3"] = R"(
-inline float __shfl_down_3(local int *scratch, float v0, int v1, int v2) {
-    // local float mem[1024];
-    local float *mem = (local float *)scratch;
-    int tid = get_local_id(0);
-    int warpid = tid % 32;
-    int warpstart = tid - warpid;
-    mem[tid] = v0;
-    //barrier(CLK_LOCAL_MEM_FENCE);
-    int warpsrc = warpid + v1;
-    warpsrc = warpsrc >= 32 ? warpid : warpsrc;
-    return mem[warpstart + warpsrc];
+    // things that all the warp-level shims need.  CUDA warps are 32 consecutive work-items, in
+    // the work-group's linear order
+    _shimClByName["__warp_common"] = R"(
+#if defined(cl_khr_subgroups)
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#define __COCL_SUB_GROUPS
+#elif defined(cl_intel_subgroups)
+#pragma OPENCL EXTENSION cl_intel_subgroups : enable
+#define __COCL_SUB_GROUPS
+#endif
+
+inline int __warp_linear_local_id() {
+    return get_local_id(0) + get_local_size(0) * (get_local_id(1) + get_local_size(1) * get_local_id(2));
 }
 )";
 
-    _shimClByName["__shfl_down_2"] = R"(
-inline float __shfl_down_2(local int *scratch, float v0, int v1) {
-    return __shfl_down_3(scratch, v0, v1, 32);
+    // warp shuffles.  If the device has sub-group shuffles, and its sub-groups are a multiple of
+    // the shuffle width, we use those.  Otherwise we go through local memory, which means that
+    // every work-item in the work-group has to reach the shuffle, since we need a barrier
+    _shimClByName["__shfl_common"] = R"(
+#if defined(cl_khr_subgroup_shuffle)
+#pragma OPENCL EXTENSION cl_khr_subgroup_shuffle : enable
+#define __COCL_SUB_GROUP_SHUFFLE(v, lane) sub_group_shuffle(v, lane)
+#elif defined(cl_intel_subgroups)
+#define __COCL_SUB_GROUP_SHUFFLE(v, lane) intel_sub_group_shuffle(v, lane)
+#endif
+
+inline bool __shfl_native(int width) {
+#ifdef __COCL_SUB_GROUP_SHUFFLE
+    return get_max_sub_group_size() % width == 0;
+#else
+    return false;
+#endif
+}
+
+// the lane numbering that __shfl_index_* expects
+inline int __shfl_lane(int width) {
+#ifdef __COCL_SUB_GROUP_SHUFFLE
+    if(__shfl_native(width)) {
+        return get_sub_group_local_id();
+    }
+#endif
+    return __warp_linear_local_id() % 32;
 }
 )";
-    _dependenciesByName["__shfl_down_2"].insert("__shfl_down_3");
+    _dependenciesByName["__shfl_common"].insert("__warp_common");
+
+    // TYPE is replaced by each of the types we can shuffle
+    const char *shflIndexCl = R"(
+inline TYPE __shfl_index_TYPE(local int *scratch, TYPE v, int srcLane, int width) {
+#ifdef __COCL_SUB_GROUP_SHUFFLE
+    if(__shfl_native(width)) {
+        return __COCL_SUB_GROUP_SHUFFLE(v, (uint)srcLane);
+    }
+#endif
+    local TYPE *mem = (local TYPE *)scratch;
+    int tid = __warp_linear_local_id();
+    mem[tid] = v;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    TYPE res = mem[tid - tid % 32 + srcLane];
+    // so no-one overwrites mem before everyone has read it
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return res;
+}
+)";
+    const char *shflCl = R"(
+inline TYPE __shfl_TYPE(local int *scratch, TYPE v, int srcLane, int width) {
+    int lane = __shfl_lane(width);
+    return __shfl_index_TYPE(scratch, v, lane - lane % width + (srcLane & (width - 1)), width);
+}
+)";
+    const char *shflUpCl = R"(
+inline TYPE __shfl_up_TYPE(local int *scratch, TYPE v, int delta, int width) {
+    int lane = __shfl_lane(width);
+    return __shfl_index_TYPE(scratch, v, lane % width >= delta ? lane - delta : lane, width);
+}
+)";
+    const char *shflDownCl = R"(
+inline TYPE __shfl_down_TYPE(local int *scratch, TYPE v, int delta, int width) {
+    int lane = __shfl_lane(width);
+    return __shfl_index_TYPE(scratch, v, lane % width + delta < width ? lane + delta : lane, width);
+}
+)";
+    const char *shflXorCl = R"(
+inline TYPE __shfl_xor_TYPE(local int *scratch, TYPE v, int laneMask, int width) {
+    // lanes in later segments are out of bounds, but earlier ones are ok
+    int lane = __shfl_lane(width);
+    int src = lane ^ laneMask;
+    return __shfl_index_TYPE(scratch, v, src < lane - lane % width + width ? src : lane, width);
+}
+)";
+    const char *shflTypes[] = {"int", "uint", "float", "double"};
+    for(int i = 0; i < 4; i++) {
+        std::string type = shflTypes[i];
+        std::string indexName = "__shfl_index_" + type;
+        _shimClByName[indexName] = replaceType(shflIndexCl, type);
+        _dependenciesByName[indexName].insert("__shfl_common");
+        _shimClByName["__shfl_" + type] = replaceType(shflCl, type);
+        _shimClByName["__shfl_up_" + type] = replaceType(shflUpCl, type);
+        _shimClByName["__shfl_down_" + type] = replaceType(shflDownCl, type);
+        _shimClByName["__shfl_xor_" + type] = replaceType(shflXorCl, type);
+        const char *ops[] = {"__shfl_", "__shfl_up_", "__shfl_down_", "__shfl_xor_"};
+        for(int j = 0; j < 4; j++) {
+            std::string name = ops[j] + type;
+            _dependenciesByName[name].insert("__shfl_common");
+            _dependenciesByName[name].insert(indexName);
+        }
+    }
+
+    // reductions over a tile of a warp, for cooperative_groups::reduce, where every lane of the tile gets the
+    // result.  Native if the sub-groups are exactly as wide as the tile, otherwise a butterfly of shuffles.
+    // OP is add, min or max, and COMBINE how we do it by hand
+    const char *tileReduceCl = R"(
+inline TYPE __tile_reduce_OP_TYPE(local int *scratch, TYPE v, int width) {
+#ifdef __COCL_SUB_GROUPS
+    if(get_max_sub_group_size() == width) {
+        return sub_group_reduce_OP(v);
+    }
+#endif
+    for(int laneMask = width / 2; laneMask > 0; laneMask /= 2) {
+        TYPE other = __shfl_xor_TYPE(scratch, v, laneMask, width);
+        v = COMBINE;
+    }
+    return v;
+}
+)";
+    const char *tileReduceOps[] = {"add", "min", "max"};
+    const char *tileReduceCombines[] = {"v + other", "min(v, other)", "max(v, other)"};
+    for(int i = 0; i < 4; i++) {
+        std::string type = shflTypes[i];
+        for(int j = 0; j < 3; j++) {
+            std::string name = std::string("__tile_reduce_") + tileReduceOps[j] + "_" + type;
+            std::string cl = replacePlaceholder(tileReduceCl, "COMBINE", tileReduceCombines[j]);
+            cl = replacePlaceholder(cl, "OP", tileReduceOps[j]);
+            _shimClByName[name] = replaceType(cl, type);
+            _dependenciesByName[name].insert("__shfl_xor_" + type);
+        }
+    }
+
+    // warp votes.  Native any/all only line up with cuda warps when sub-groups are exactly 32
+    // wide, but a native ballot works for any multiple of 32.  The local memory fallback needs
+    // every work-item in the work-group to get there, and all assume the whole warp is active
+    _shimClByName["__ballot"] = R"(
+#if defined(cl_khr_subgroup_ballot) && defined(__COCL_SUB_GROUPS)
+#pragma OPENCL EXTENSION cl_khr_subgroup_ballot : enable
+#define __COCL_SUB_GROUP_BALLOT
+#endif
+
+inline uint __ballot(local int *scratch, int predicate) {
+#ifdef __COCL_SUB_GROUP_BALLOT
+    if(get_max_sub_group_size() % 32 == 0) {
+        uint4 bits = sub_group_ballot(predicate);
+        uint lane = get_sub_group_local_id();
+        return lane < 32 ? bits.x : lane < 64 ? bits.y : lane < 96 ? bits.z : bits.w;
+    }
+#endif
+    local uint *bits = (local uint *)scratch;
+    int tid = __warp_linear_local_id();
+    int warp = tid / 32;
+    if(tid % 32 == 0) {
+        bits[warp] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if(predicate) {
+        atomic_or(&bits[warp], 1u << (tid % 32));
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    uint res = bits[warp];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return res;
+}
+
+// the lanes that exist in our warp: the last warp might not be full
+inline uint __warp_lanes() {
+    int tid = __warp_linear_local_id();
+    int lanes = min(32, (int)(get_local_size(0) * get_local_size(1) * get_local_size(2)) - (tid - tid % 32));
+    return lanes == 32 ? 0xffffffffu : (1u << lanes) - 1;
+}
+)";
+    _dependenciesByName["__ballot"].insert("__warp_common");
+
+    _shimClByName["__any"] = R"(
+inline int __any(local int *scratch, int predicate) {
+#ifdef __COCL_SUB_GROUPS
+    if(get_max_sub_group_size() == 32) {
+        return sub_group_any(predicate);
+    }
+#endif
+    return __ballot(scratch, predicate) != 0;
+}
+)";
+    _dependenciesByName["__any"].insert("__ballot");
+
+    _shimClByName["__all"] = R"(
+inline int __all(local int *scratch, int predicate) {
+#ifdef __COCL_SUB_GROUPS
+    if(get_max_sub_group_size() == 32) {
+        return sub_group_all(predicate);
+    }
+#endif
+    return __ballot(scratch, predicate) == __warp_lanes();
+}
+)";
+    _dependenciesByName["__all"].insert("__ballot");
+
+    // we ignore the masks, and treat them as the whole warp
+    _shimClByName["__ballot_sync"] = R"(
+inline uint __ballot_sync(local int *scratch, uint mask, int predicate) {
+    return __ballot(scratch, predicate);
+}
+)";
+    _dependenciesByName["__ballot_sync"].insert("__ballot");
+    _shimClByName["__any_sync"] = R"(
+inline int __any_sync(local int *scratch, uint mask, int predicate) {
+    return __any(scratch, predicate);
+}
+)";
+    _dependenciesByName["__any_sync"].insert("__any");
+    _shimClByName["__all_sync"] = R"(
+inline int __all_sync(local int *scratch, uint mask, int predicate) {
+    return __all(scratch, predicate);
+}
+)";
+    _dependenciesByName["__all_sync"].insert("__all");
+
+    // a sub-group barrier covers the warp if sub-groups are whole warps; otherwise we need
+    // the whole work-group
+    _shimClByName["__syncwarp"] = R"(
+inline void __syncwarp(uint mask) {
+#ifdef __COCL_SUB_GROUPS
+    if(get_max_sub_group_size() % 32 == 0) {
+        sub_group_barrier(CLK_LOCAL_MEM_FENCE);
+        return;
+    }
+#endif
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+)";
+    _dependenciesByName["__syncwarp"].insert("__warp_common");
 
     // note to self: just realized, umulhi is actually available in opencl 1.2 :-)
     // so, we should migrate this to use that, probably
@@ -54,9 +285,14 @@ inline unsigned int __umulhi(unsigned int v0, unsigned int v1) {
 }
 )";
 
-// this code is from http://suhorukov.blogspot.co.uk/2011/12/opencl-11-atomic-operations-on-floating.html
+    // native where we can: cl_ext_float_atomics (kernels using this build as OpenCL C 2.0 or later if the
+    // device has it, see CoclDevice).  Otherwise a compare-and-swap loop, based on
+    // http://suhorukov.blogspot.co.uk/2011/12/opencl-11-atomic-operations-on-floating.html
     _shimClByName["__atomic_add_float"] = R"(
 inline float __atomic_add_float(volatile __global float *source, const float operand) {
+#if defined(__opencl_c_ext_fp32_global_atomic_add)
+    return atomic_fetch_add_explicit((volatile __global atomic_float *)source, operand, memory_order_relaxed);
+#else
     union {
         unsigned int intVal;
         float floatVal;
@@ -65,13 +301,46 @@ inline float __atomic_add_float(volatile __global float *source, const float ope
         unsigned int intVal;
         float floatVal;
     } prevVal;
-    do {
-        prevVal.floatVal = *source;
+    prevVal.floatVal = *source;
+    while(true) {
         newVal.floatVal = prevVal.floatVal + operand;
-    } while (atomic_cmpxchg((volatile __global unsigned int *)source, prevVal.intVal, newVal.intVal) != prevVal.intVal);
+        unsigned int seen = atomic_cmpxchg((volatile __global unsigned int *)source, prevVal.intVal, newVal.intVal);
+        if(seen == prevVal.intVal) {
+            break;
+        }
+        // someone else got in first; try again from what they wrote, without reloading
+        prevVal.intVal = seen;
+    }
     return prevVal.floatVal;
+#endif
+}
+)";
+
+    // 64-bit integer atomics are the OpenCL 1.0 style atom_* functions, which need these
+    _shimClByName["__int64_atomics"] = R"(
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+)";
+
+    _shimClByName["__atomic_add_double"] = R"(
+inline double __atomic_add_double(volatile __global double *source, const double operand) {
+#if defined(__opencl_c_ext_fp64_global_atomic_add)
+    return atomic_fetch_add_explicit((volatile __global atomic_double *)source, operand, memory_order_relaxed);
+#else
+    ulong prevVal = as_ulong(*source);
+    while(true) {
+        ulong newVal = as_ulong(as_double(prevVal) + operand);
+        ulong seen = atom_cmpxchg((volatile __global ulong *)source, prevVal, newVal);
+        if(seen == prevVal) {
+            break;
+        }
+        prevVal = seen;
+    }
+    return as_double(prevVal);
+#endif
 }
 )";
+    _dependenciesByName["__atomic_add_double"].insert("__int64_atomics");
 
     _shimClByName["__atomic_inc_uint"] = R"(
 inline unsigned int __atomic_inc_uint(volatile __global int *data, const unsigned int old) {
@@ -95,11 +364,15 @@ void Shims::use(std::string name) {
         std::cout << "shim " << name << " does not exist.  This is a bug in Coriander" << std::endl;
         throw std::runtime_error("shim " + name + " does not exist. This is a bug in Coriander");
     }
+    if(shimsToBeUsed.find(name) != shimsToBeUsed.end()) {
+        return;
+    }
     shimsToBeUsed.insert(name);
     if(_dependenciesByName.find(name) != _dependenciesByName.end()) {
-        const std::set<std::string> &deps = _dependenciesByName[name];
+        // dependencies can have dependencies of their own
+        const std::set<std::string> deps = _dependenciesByName[name];
         for(auto it=deps.begin(); it != deps.end(); it++) {
-            shimsToBeUsed.insert(*it);
+            use(*it);
         }
     }
 }
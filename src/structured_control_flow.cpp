@@ -0,0 +1,334 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/structured_control_flow.h"
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace llvm;
+
+namespace cocl {
+
+// block code comes indented by four spaces; moves it to indent
+static string reindent(string code, string indent) {
+    if(indent.size() <= 4) {
+        return code;
+    }
+    string extra = indent.substr(4);
+    istringstream iss(code);
+    ostringstream oss;
+    string line;
+    while(getline(iss, line)) {
+        if(line != "") {
+            oss << extra;
+        }
+        oss << line << "\n";
+    }
+    return oss.str();
+}
+
+StructuredControlFlow::StructuredControlFlow(Function *F) :
+        F(F), domTree(*F), loopInfo(domTree) {
+    ReversePostOrderTraversal<Function *> rpot(F);
+    for(auto it = rpot.begin(); it != rpot.end(); it++) {
+        BasicBlock *block = *it;
+        orderIndex[block] = blockOrder.size();
+        blockOrder.push_back(block);
+    }
+    // reducible means every retreating edge goes back to a block that dominates its source, ie to a loop header
+    for(auto it = blockOrder.begin(); it != blockOrder.end(); it++) {
+        BasicBlock *block = *it;
+        for(auto succ_it = succ_begin(block); succ_it != succ_end(block); succ_it++) {
+            BasicBlock *succ = *succ_it;
+            if(orderIndex[succ] <= orderIndex[block] && !domTree.dominates(succ, block)) {
+                reducible = false;
+            }
+        }
+    }
+}
+
+bool StructuredControlFlow::isLoopHeader(BasicBlock *block) {
+    for(auto it = pred_begin(block); it != pred_end(block); it++) {
+        BasicBlock *pred = *it;
+        if(orderIndex.find(pred) != orderIndex.end() && orderIndex[pred] >= orderIndex[block]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StructuredControlFlow::isMergeBlock(BasicBlock *block) {
+    set<BasicBlock *> forwardPreds;
+    for(auto it = pred_begin(block); it != pred_end(block); it++) {
+        BasicBlock *pred = *it;
+        if(orderIndex.find(pred) != orderIndex.end() && orderIndex[pred] < orderIndex[block]) {
+            forwardPreds.insert(pred);
+        }
+    }
+    return forwardPreds.size() >= 2;
+}
+
+// the merge blocks that block immediately dominates, in reverse postorder
+std::vector<BasicBlock *> StructuredControlFlow::getMergeChildren(BasicBlock *block) {
+    vector<BasicBlock *> children;
+    DomTreeNode *node = domTree.getNode(block);
+    for(auto it = node->begin(); it != node->end(); it++) {
+        BasicBlock *child = (*it)->getBlock();
+        if(isMergeBlock(child)) {
+            children.push_back(child);
+        }
+    }
+    std::sort(children.begin(), children.end(), [this](BasicBlock *a, BasicBlock *b) {
+        return orderIndex[a] < orderIndex[b];
+    });
+    return children;
+}
+
+const StructuredBlock &StructuredControlFlow::getBlock(BasicBlock *block) {
+    auto it = blocks->find(block);
+    if(it == blocks->end()) {
+        throw runtime_error("StructuredControlFlow: no code generated for block " + block->getName().str());
+    }
+    return it->second;
+}
+
+// writes inner, followed by each of the merge children, the earliest first.  inner, and each merge child,
+// can reach the later merge children by falling through
+std::string StructuredControlFlow::withMergeChildren(
+        vector<BasicBlock *> children, const Context &context, string indent,
+        std::function<string(const Context &)> inner) {
+    if(children.size() == 0) {
+        return inner(context);
+    }
+    BasicBlock *last = children.back();
+    children.pop_back();
+    Context innerContext = context;
+    innerContext.push_back(Frame(MergeFrame, last));
+    string gencode = withMergeChildren(children, innerContext, indent, inner);
+    gencode += doBlock(last, context, indent);
+    return gencode;
+}
+
+std::string StructuredControlFlow::doBlock(BasicBlock *block, const Context &context, string indent) {
+    string gencode = "";
+    if(gotoTargets.find(block) != gotoTargets.end()) {
+        gencode += getBlock(block).label + ":;\n";
+    }
+    vector<BasicBlock *> mergeChildren = getMergeChildren(block);
+    if(!isLoopHeader(block)) {
+        gencode += withMergeChildren(mergeChildren, context, indent, [this, block, indent](const Context &context) {
+            return doBlockCode(block, context, indent);
+        });
+        return gencode;
+    }
+    // merge children outside the loop go after the loop, so we leave the loop with a break
+    Loop *loop = loopInfo.getLoopFor(block);
+    vector<BasicBlock *> inLoop;
+    vector<BasicBlock *> outLoop;
+    for(auto it = mergeChildren.begin(); it != mergeChildren.end(); it++) {
+        if(loop != 0 && loop->contains(*it)) {
+            inLoop.push_back(*it);
+        } else {
+            outLoop.push_back(*it);
+        }
+    }
+    gencode += withMergeChildren(outLoop, context, indent, [this, block, indent, &inLoop](const Context &context) {
+        Context loopContext = context;
+        loopContext.push_back(Frame(LoopFrame, block));
+        string loopIndent = indent + "    ";
+        string loopcode = indent + "while(1) {\n";
+        StructuredScope scope;
+        scope.loopHeader = block;
+        loopcode += openScope(scope, loopIndent);
+        loopcode += withMergeChildren(inLoop, loopContext, loopIndent, [this, block, loopIndent](const Context &context) {
+            return doBlockCode(block, context, loopIndent);
+        });
+        closeScope();
+        loopcode += indent + "}\n";
+        return loopcode;
+    });
+    return gencode;
+}
+
+std::string StructuredControlFlow::doBlockCode(BasicBlock *block, const Context &context, string indent) {
+    const StructuredBlock &structuredBlock = getBlock(block);
+    scopePathByBlock[block] = scopePath;
+    string gencode = reindent(structuredBlock.code, indent);
+    Instruction *terminator = block->getTerminator();
+    if(isa<ReturnInst>(terminator)) {
+        gencode += reindent(structuredBlock.returnCode, indent);
+        return gencode;
+    }
+    BranchInst *branch = dyn_cast<BranchInst>(terminator);
+    if(branch == 0) {
+        throw runtime_error("StructuredControlFlow: unhandled terminator type");
+    }
+    BasicBlock *trueBlock = branch->getSuccessor(0);
+    if(branch->isUnconditional() || branch->getSuccessor(1) == trueBlock) {
+        scopePathByEdge[make_pair(block, trueBlock)] = scopePath;
+        gencode += reindent(structuredBlock.edgeCode.at(trueBlock), indent);
+        gencode += doBranch(block, trueBlock, context, indent);
+        return gencode;
+    }
+    BasicBlock *falseBlock = branch->getSuccessor(1);
+    Context ifContext = context;
+    ifContext.push_back(Frame(IfFrame, block));
+    string innerIndent = indent + "    ";
+    StructuredScope trueScope;
+    trueScope.edgeFrom = block;
+    trueScope.edgeTo = trueBlock;
+    string trueSection = openScope(trueScope, innerIndent);
+    scopePathByEdge[make_pair(block, trueBlock)] = scopePath;
+    trueSection += reindent(structuredBlock.edgeCode.at(trueBlock), innerIndent);
+    trueSection += doBranch(block, trueBlock, ifContext, innerIndent);
+    closeScope();
+    StructuredScope falseScope;
+    falseScope.edgeFrom = block;
+    falseScope.edgeTo = falseBlock;
+    string falseSection = openScope(falseScope, innerIndent);
+    scopePathByEdge[make_pair(block, falseBlock)] = scopePath;
+    falseSection += reindent(structuredBlock.edgeCode.at(falseBlock), innerIndent);
+    falseSection += doBranch(block, falseBlock, ifContext, innerIndent);
+    closeScope();
+    if(trueSection != "") {
+        gencode += indent + "if " + structuredBlock.condition + " {\n";
+        gencode += trueSection;
+        if(falseSection != "") {
+            gencode += indent + "} else {\n";
+            gencode += falseSection;
+        }
+        gencode += indent + "}\n";
+    } else if(falseSection != "") {
+        gencode += indent + "if(!" + structuredBlock.condition + ") {\n";
+        gencode += falseSection;
+        gencode += indent + "}\n";
+    }
+    return gencode;
+}
+
+// returns the declarations for the new scope
+std::string StructuredControlFlow::openScope(const StructuredScope &scope, string indent) {
+    int id = scopes.size();
+    scopes.push_back(scope);
+    scopes[id].parent = scopePath.back();
+    scopePath.push_back(id);
+    if(declarationsByScope != 0 && declarationsByScope->find(id) != declarationsByScope->end()) {
+        return reindent(declarationsByScope->at(id), indent);
+    }
+    return "";
+}
+
+void StructuredControlFlow::closeScope() {
+    scopePath.pop_back();
+}
+
+std::string StructuredControlFlow::writeGoto(BasicBlock *to, string indent) {
+    gotoTargets.insert(to);
+    return indent + "goto " + getBlock(to).label + ";\n";
+}
+
+// phi assignments for the edge have already been written
+std::string StructuredControlFlow::doBranch(BasicBlock *from, BasicBlock *to, const Context &context, string indent) {
+    if(orderIndex[to] <= orderIndex[from]) {
+        // back edge: continue, if to heads the innermost loop we are in
+        for(int i = (int)context.size() - 1; i >= 0; i--) {
+            if(context[i].kind == LoopFrame) {
+                if(context[i].block == to) {
+                    return indent + "continue;\n";
+                }
+                break;
+            }
+        }
+        // going to the label in front of the while(1) starts the next iteration of the outer loop
+        return writeGoto(to, indent);
+    }
+    if(!isMergeBlock(to)) {
+        return doBlock(to, context, indent);
+    }
+    // to follows one of our enclosing frames.  We can fall through to it if only ifs are in between, or break
+    // out of a loop if only that loop, and ifs, are in between
+    int numLoops = 0;
+    bool mergeSinceLoop = false;
+    for(int i = (int)context.size() - 1; i >= 0; i--) {
+        const Frame &frame = context[i];
+        if(frame.kind == MergeFrame && frame.block == to) {
+            if(numLoops == 0 && !mergeSinceLoop) {
+                return "";
+            }
+            if(numLoops == 1 && !mergeSinceLoop) {
+                return indent + "break;\n";
+            }
+            break;
+        }
+        if(frame.kind == LoopFrame) {
+            numLoops++;
+            mergeSinceLoop = false;
+        } else if(frame.kind == MergeFrame) {
+            mergeSinceLoop = true;
+        }
+    }
+    return writeGoto(to, indent);
+}
+
+void StructuredControlFlow::analyze(const std::map<BasicBlock *, StructuredBlock> &blocks) {
+    if(!reducible) {
+        throw runtime_error("StructuredControlFlow: cannot structure irreducible control flow");
+    }
+    this->blocks = &blocks;
+    gotoTargets.clear();
+    scopes.clear();
+    scopes.push_back(StructuredScope());
+    scopePath.assign(1, 0);
+    // this pass finds which blocks we goto, so generateCl can label them
+    doBlock(&F->getEntryBlock(), Context(), "    ");
+}
+
+std::string StructuredControlFlow::generateCl(const std::map<int, std::string> &declarationsByScope) {
+    if(blocks == 0) {
+        throw runtime_error("StructuredControlFlow: call analyze() before generateCl()");
+    }
+    this->declarationsByScope = &declarationsByScope;
+    scopes.clear();
+    scopes.push_back(StructuredScope());
+    scopePath.assign(1, 0);
+    string cl = doBlock(&F->getEntryBlock(), Context(), "    ");
+    this->declarationsByScope = 0;
+    return cl;
+}
+
+std::vector<int> StructuredControlFlow::getScopePath(BasicBlock *block) const {
+    auto it = scopePathByBlock.find(block);
+    if(it == scopePathByBlock.end()) {
+        return vector<int>();
+    }
+    return it->second;
+}
+
+std::vector<int> StructuredControlFlow::getScopePath(BasicBlock *from, BasicBlock *to) const {
+    auto it = scopePathByEdge.find(make_pair(from, to));
+    if(it == scopePathByEdge.end()) {
+        return vector<int>();
+    }
+    return it->second;
+}
+
+} // namespace cocl
@@ -23,6 +23,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <iostream>
+#include <sstream>
 #include <set>
 
 using namespace std;
@@ -52,6 +53,8 @@ std::string TypeDumper::dumpAddressSpace(llvm::Type *type) {
                 return "global";
             case 3:
                 return "local";
+            case 4:
+                return "constant";
             case 5:
                 return "__vmem__";
             default:
@@ -66,7 +69,7 @@ std::string TypeDumper::dumpPointerType(PointerType *ptr, bool decayArraysToPoin
     // std::cout << "dumpPointerType" << std::endl;
     string gencode = "";
     Type *elementType = ptr->getElementType();
-    string elementTypeString = dumpType(elementType, decayArraysToPointer);
+    string elementTypeString = dumpStorageType(elementType, decayArraysToPointer);
     int addressspace = ptr->getAddressSpace();
     if(addressspace == 5) {
         int depth = getPointerDepth(elementType);
@@ -206,31 +209,32 @@ std::string TypeDumper::dumpArrayType(ArrayType *type, bool decayArraysToPointer
     Type *elementType = type->getElementType();
 
     if(decayArraysToPointer) {
-        oss << dumpType(elementType, decayArraysToPointer) + "*";
+        oss << dumpStorageType(elementType, decayArraysToPointer) + "*";
     } else {
-        oss << dumpType(elementType, decayArraysToPointer) + "[" + easycl::toString(length) + "]";
+        oss << dumpStorageType(elementType, decayArraysToPointer) + "[" + easycl::toString(length) + "]";
     }
     return oss.str();
 }
 
 std::string TypeDumper::dumpVectorType(VectorType *vectorType, bool decayArraysToPointer) {
     // std::cout << "TypeDumper::dumpVectorType" << std::endl;
+    // written as native opencl vectors, eg float4, so that loads and stores can use vloadN/vstoreN
     int elementCount = vectorType->getNumElements();
     Type *elementType = vectorType->getElementType();
-    if(elementType->getPrimitiveSizeInBits() == 0) {
+    if(elementType->getPrimitiveSizeInBits() == 0 || elementType->isIntegerTy(1)) {
         cout << endl;
         COCL_LLVM_DUMP(vectorType);
         cout << endl;
         throw runtime_error("TypeDumper::dumpVectorType: not implemented for non-primitive types");
     }
-    ostringstream oss;
-    oss << dumpType(elementType);
-    if(decayArraysToPointer) {
-        oss << "*";
-    } else {
-        oss << "[" << elementCount << "]";
+    if(elementCount != 2 && elementCount != 3 && elementCount != 4 && elementCount != 8 && elementCount != 16) {
+        cout << endl;
+        COCL_LLVM_DUMP(vectorType);
+        cout << endl;
+        throw runtime_error("TypeDumper::dumpVectorType: opencl has no vectors of length " + easycl::toString(elementCount));
     }
-    cout << oss.str();
+    ostringstream oss;
+    oss << dumpType(elementType) << elementCount;
     return oss.str();
 }
 
@@ -258,6 +262,10 @@ std::string TypeDumper::dumpType(Type *type, bool decayArraysToPointer) {
         case Type::FloatTyID:
             return "float";
 
+        case Type::HalfTyID:
+            usesHalf = true;
+            return "cocl_half";
+
         // case Type::UnionTyID:
         //     throw runtime_error("not implemented: union type");
 
@@ -294,6 +302,47 @@ std::string TypeDumper::dumpType(Type *type, bool decayArraysToPointer) {
     }
 }
 
+int TypeDumper::getHalfWidth(Type *type) {
+    if(type->isHalfTy()) {
+        return 1;
+    }
+    if(VectorType *vectorType = dyn_cast<VectorType>(type)) {
+        if(vectorType->getElementType()->isHalfTy()) {
+            return vectorType->getNumElements();
+        }
+    }
+    return 0;
+}
+
+std::string TypeDumper::dumpStorageType(Type *type, bool decayArraysToPointer) {
+    int halfWidth = getHalfWidth(type);
+    if(halfWidth == 0) {
+        return dumpType(type, decayArraysToPointer);
+    }
+    usesHalf = true;
+    if(halfWidth == 1) {
+        return "cocl_half_storage";
+    }
+    // checks the width
+    dumpVectorType(cast<VectorType>(type));
+    return "cocl_half" + easycl::toString(halfWidth) + "_storage";
+}
+
+std::string TypeDumper::dumpHalfPointerType(unsigned int addressSpace) {
+    switch(addressSpace) {
+        case 0:
+            return "half*";
+        case 1:
+            return "global half*";
+        case 3:
+            return "local half*";
+        case 4:
+            return "constant half*";
+        default:
+            throw runtime_error("TypeDumper::dumpHalfPointerType: not implemented, addressspace " + easycl::toString(addressSpace));
+    }
+}
+
 int TypeDumper::getPointerDepth(Type *type) {
     // std::cout << " getPointerDepth()" << std::endl;
     if(PointerType *nextLevel = dyn_cast<PointerType>(type)) {
@@ -334,7 +383,7 @@ std::string TypeDumper::dumpStructDefinition(StructType *type, string name) {
             if(isa<PointerType>(arrayelementtype)) {
                 declaration << "__vmem__ unsigned long ";
             } else {
-                declaration << dumpType(arrayelementtype) << " ";
+                declaration << dumpStorageType(arrayelementtype) << " ";
             }
             declaration << memberName << "[" << numElements << "];\n";
         } else {
@@ -350,7 +399,7 @@ std::string TypeDumper::dumpStructDefinition(StructType *type, string name) {
                     declaration << "global " << dumpType(elementType) << " " << memberName << ";\n";
                 }
             } else {
-                declaration << dumpType(elementType) << " " << memberName << ";\n";
+                declaration << dumpStorageType(elementType) << " " << memberName << ";\n";
             }
         }
         i++;
@@ -396,4 +445,46 @@ std::string TypeDumper::dumpStructDefinitions() {
     return gencode;
 }
 
+// half values are written as cocl_half, which is a native half if the device has cl_khr_fp16, and a float
+// otherwise, since without the extension opencl only allows half pointers.  In memory they are always 16 bits,
+// cocl_half_storage, which is a ushort without the extension, and we load and store them using vload_half and
+// vstore_half, or their cl_khr_fp16 equivalents
+std::string TypeDumper::dumpHalfDefinitions() {
+    if(!usesHalf) {
+        return "";
+    }
+    const int widths[] = {2, 3, 4, 8, 16};
+    ostringstream fp16;
+    ostringstream noFp16;
+    for(int width : widths) {
+        string n = easycl::toString(width);
+        fp16 << "typedef half" << n << " cocl_half" << n << ";\n";
+        fp16 << "typedef half" << n << " cocl_half" << n << "_storage;\n";
+        fp16 << "#define cocl_vload_half" << n << " vload" << n << "\n";
+        fp16 << "#define cocl_vstore_half" << n << " vstore" << n << "\n";
+        fp16 << "#define convert_cocl_half" << n << " convert_half" << n << "\n";
+        noFp16 << "typedef float" << n << " cocl_half" << n << ";\n";
+        noFp16 << "typedef ushort" << n << " cocl_half" << n << "_storage;\n";
+        noFp16 << "#define cocl_vload_half" << n << " vload_half" << n << "\n";
+        noFp16 << "#define cocl_vstore_half" << n << " vstore_half" << n << "\n";
+        noFp16 << "#define convert_cocl_half" << n << " convert_float" << n << "\n";
+    }
+    ostringstream oss;
+    oss << "#if defined(cl_khr_fp16)\n";
+    oss << "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n";
+    oss << "typedef half cocl_half;\n";
+    oss << "typedef half cocl_half_storage;\n";
+    oss << "#define cocl_vload_half(offset, p) ((p)[offset])\n";
+    oss << "#define cocl_vstore_half(data, offset, p) ((p)[offset] = (data))\n";
+    oss << fp16.str();
+    oss << "#else\n";
+    oss << "typedef float cocl_half;\n";
+    oss << "typedef ushort cocl_half_storage;\n";
+    oss << "#define cocl_vload_half vload_half\n";
+    oss << "#define cocl_vstore_half vstore_half\n";
+    oss << noFp16.str();
+    oss << "#endif\n";
+    return oss.str();
+}
+
 } // namespace cocl;
@@ -0,0 +1,329 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/variable_coalescing.h"
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+
+#include <stdexcept>
+
+using namespace std;
+using namespace llvm;
+
+namespace cocl {
+
+VariableCoalescing::VariableCoalescing(Function *F, const std::map<Value *, std::string> &typeByVariable,
+        const std::set<Value *> &inlined) :
+        F(F), typeByVariable(typeByVariable), inlined(inlined) {
+}
+
+// the variables that writing value out reads: itself, if its a variable, or the variables read by its operands,
+// if its inlined
+const VariableCoalescing::ValueSet &VariableCoalescing::getReads(Value *value) {
+    auto it = readsByValue.find(value);
+    if(it != readsByValue.end()) {
+        return it->second;
+    }
+    ValueSet &reads = readsByValue[value];
+    if(typeByVariable.find(value) != typeByVariable.end()) {
+        reads.insert(value);
+    } else if(inlined.find(value) != inlined.end()) {
+        Instruction *inst = cast<Instruction>(value);
+        ValueSet operandReads;
+        for(auto op_it = inst->op_begin(); op_it != inst->op_end(); op_it++) {
+            const ValueSet &opReads = getReads(op_it->get());
+            operandReads.insert(opReads.begin(), opReads.end());
+        }
+        readsByValue[value] = operandReads;
+    }
+    return readsByValue[value];
+}
+
+void VariableCoalescing::buildStatements() {
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *block = &*block_it;
+        for(auto it = block->begin(); it != block->end(); it++) {
+            Instruction *inst = &*it;
+            if(typeByVariable.find(inst) != typeByVariable.end()) {
+                variableIndex[inst] = variables.size();
+                variables.push_back(inst);
+            }
+        }
+    }
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *block = &*block_it;
+        Statements &statements = statementsByBlock[block];
+        for(auto it = block->begin(); it != block->end(); it++) {
+            Instruction *inst = &*it;
+            if(isa<PHINode>(inst)) {
+                continue;
+            }
+            // inlined instructions are counted as read both here and where they are used, in case they also
+            // write something out here
+            Statement statement;
+            for(auto op_it = inst->op_begin(); op_it != inst->op_end(); op_it++) {
+                const ValueSet &reads = getReads(op_it->get());
+                statement.reads.insert(reads.begin(), reads.end());
+            }
+            if(typeByVariable.find(inst) != typeByVariable.end()) {
+                statement.write = inst;
+            }
+            statements.push_back(statement);
+        }
+        // the phi copies, in the order dumpPhi writes them
+        for(auto succ_it = succ_begin(block); succ_it != succ_end(block); succ_it++) {
+            BasicBlock *succ = *succ_it;
+            pair<BasicBlock *, BasicBlock *> edge(block, succ);
+            if(copiesByEdge.find(edge) != copiesByEdge.end()) {
+                continue;
+            }
+            Statements &copies = copiesByEdge[edge];
+            for(auto it = succ->begin(); it != succ->end(); it++) {
+                PHINode *phi = dyn_cast<PHINode>(&*it);
+                if(phi == 0) {
+                    break;
+                }
+                Value *incoming = phi->getIncomingValueForBlock(block);
+                if(isa<UndefValue>(incoming)) {
+                    continue;
+                }
+                Statement copy;
+                copy.reads = getReads(incoming);
+                if(typeByVariable.find(phi) != typeByVariable.end()) {
+                    copy.write = phi;
+                }
+                if(typeByVariable.find(incoming) != typeByVariable.end()) {
+                    copy.copiedFrom = incoming;
+                }
+                copies.push_back(copy);
+            }
+        }
+    }
+}
+
+VariableCoalescing::ValueSet VariableCoalescing::liveBefore(const Statements &statements, ValueSet live) {
+    for(auto it = statements.rbegin(); it != statements.rend(); it++) {
+        if(it->write != 0) {
+            live.erase(it->write);
+        }
+        live.insert(it->reads.begin(), it->reads.end());
+    }
+    return live;
+}
+
+void VariableCoalescing::computeLiveness() {
+    // backwards converges faster
+    vector<BasicBlock *> blocks;
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        blocks.push_back(&*block_it);
+    }
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(auto block_it = blocks.rbegin(); block_it != blocks.rend(); block_it++) {
+            BasicBlock *block = *block_it;
+            ValueSet liveOut;
+            for(auto succ_it = succ_begin(block); succ_it != succ_end(block); succ_it++) {
+                BasicBlock *succ = *succ_it;
+                pair<BasicBlock *, BasicBlock *> edge(block, succ);
+                ValueSet liveOnEdge = liveBefore(copiesByEdge[edge], liveInByBlock[succ]);
+                liveOut.insert(liveOnEdge.begin(), liveOnEdge.end());
+                liveByEdge[edge] = liveOnEdge;
+            }
+            ValueSet liveIn = liveBefore(statementsByBlock[block], liveOut);
+            if(liveIn != liveInByBlock[block]) {
+                liveInByBlock[block] = liveIn;
+                changed = true;
+            }
+        }
+    }
+}
+
+// a variable interferes with everything live just after it is written, except the variable it is a copy of
+void VariableCoalescing::addInterference(const Statements &statements, ValueSet live) {
+    for(auto it = statements.rbegin(); it != statements.rend(); it++) {
+        if(it->write != 0) {
+            for(auto live_it = live.begin(); live_it != live.end(); live_it++) {
+                Value *other = *live_it;
+                if(other != it->write && other != it->copiedFrom) {
+                    interference[it->write].insert(other);
+                    interference[other].insert(it->write);
+                }
+            }
+            live.erase(it->write);
+        }
+        live.insert(it->reads.begin(), it->reads.end());
+    }
+}
+
+Value *VariableCoalescing::find(Value *value) {
+    Value *representative = value;
+    while(parent[representative] != representative) {
+        representative = parent[representative];
+    }
+    parent[value] = representative;
+    return representative;
+}
+
+bool VariableCoalescing::interferes(Value *a, Value *b) {
+    // interference[representative] holds everything that interferes with any member
+    const ValueSet &aInterference = interference[a];
+    const ValueSet &bMembers = membersByRepresentative[b];
+    for(auto it = bMembers.begin(); it != bMembers.end(); it++) {
+        if(aInterference.find(*it) != aInterference.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VariableCoalescing::tryMerge(Value *a, Value *b) {
+    a = find(a);
+    b = find(b);
+    if(a == b) {
+        return true;
+    }
+    if(typeByVariable.at(a) != typeByVariable.at(b) || interferes(a, b)) {
+        return false;
+    }
+    // the earliest variable names the merged one
+    if(variableIndex[b] < variableIndex[a]) {
+        std::swap(a, b);
+    }
+    parent[b] = a;
+    membersByRepresentative[a].insert(membersByRepresentative[b].begin(), membersByRepresentative[b].end());
+    membersByRepresentative.erase(b);
+    interference[a].insert(interference[b].begin(), interference[b].end());
+    return true;
+}
+
+void VariableCoalescing::run(bool mergePhis, bool reuseVariables) {
+    buildStatements();
+    computeLiveness();
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *block = &*block_it;
+        ValueSet liveOut;
+        for(auto succ_it = succ_begin(block); succ_it != succ_end(block); succ_it++) {
+            BasicBlock *succ = *succ_it;
+            pair<BasicBlock *, BasicBlock *> edge(block, succ);
+            const ValueSet &liveOnEdge = liveByEdge[edge];
+            liveOut.insert(liveOnEdge.begin(), liveOnEdge.end());
+            addInterference(copiesByEdge[edge], liveInByBlock[succ]);
+        }
+        addInterference(statementsByBlock[block], liveOut);
+    }
+    // from here on, interference[representative] is everything that interferes with any of its members
+    for(auto it = variables.begin(); it != variables.end(); it++) {
+        parent[*it] = *it;
+        membersByRepresentative[*it].insert(*it);
+    }
+
+    // merge each phi with its incoming values, so that the phi copies disappear
+    for(auto it = variables.begin(); it != variables.end(); it++) {
+        PHINode *phi = dyn_cast<PHINode>(*it);
+        if(!mergePhis || phi == 0) {
+            continue;
+        }
+        for(unsigned int i = 0; i < phi->getNumIncomingValues(); i++) {
+            Value *incoming = phi->getIncomingValue(i);
+            if(typeByVariable.find(incoming) != typeByVariable.end()) {
+                tryMerge(phi, incoming);
+            }
+        }
+    }
+
+    // first fit: give each variable the name of the first earlier variable of the same type that it doesnt
+    // interfere with
+    if(reuseVariables) {
+        vector<Value *> representatives;
+        for(auto it = variables.begin(); it != variables.end(); it++) {
+            Value *representative = find(*it);
+            if(representative != *it) {
+                continue;
+            }
+            bool merged = false;
+            for(auto rep_it = representatives.begin(); rep_it != representatives.end(); rep_it++) {
+                if(tryMerge(*rep_it, representative)) {
+                    merged = true;
+                    break;
+                }
+            }
+            if(!merged) {
+                representatives.push_back(representative);
+            }
+        }
+    }
+
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *block = &*block_it;
+        const Statements &statements = statementsByBlock[block];
+        for(auto it = statements.begin(); it != statements.end(); it++) {
+            for(auto read_it = it->reads.begin(); read_it != it->reads.end(); read_it++) {
+                blocksUsing[find(*read_it)].insert(block);
+            }
+            if(it->write != 0) {
+                blocksUsing[find(it->write)].insert(block);
+            }
+        }
+    }
+    for(auto edge_it = copiesByEdge.begin(); edge_it != copiesByEdge.end(); edge_it++) {
+        for(auto it = edge_it->second.begin(); it != edge_it->second.end(); it++) {
+            for(auto read_it = it->reads.begin(); read_it != it->reads.end(); read_it++) {
+                edgesUsing[find(*read_it)].insert(edge_it->first);
+            }
+            if(it->write != 0) {
+                edgesUsing[find(it->write)].insert(edge_it->first);
+            }
+        }
+    }
+}
+
+Value *VariableCoalescing::getRepresentative(Value *value) {
+    if(parent.find(value) == parent.end()) {
+        return value;
+    }
+    return find(value);
+}
+
+bool VariableCoalescing::isLiveIn(BasicBlock *block, Value *representative) {
+    const ValueSet &live = liveInByBlock[block];
+    for(auto it = live.begin(); it != live.end(); it++) {
+        if(find(*it) == representative) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VariableCoalescing::isLiveOnEdge(BasicBlock *from, BasicBlock *to, Value *representative) {
+    const ValueSet &live = liveByEdge[make_pair(from, to)];
+    for(auto it = live.begin(); it != live.end(); it++) {
+        if(find(*it) == representative) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::set<BasicBlock *> &VariableCoalescing::getBlocksUsing(Value *representative) {
+    return blocksUsing[representative];
+}
+
+const std::set<std::pair<BasicBlock *, BasicBlock *> > &VariableCoalescing::getEdgesUsing(Value *representative) {
+    return edgesUsing[representative];
+}
+
+} // namespace cocl
@@ -0,0 +1,248 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/vector_accesses.h"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace llvm;
+
+namespace cocl {
+
+llvm::Type *getVectorLikeStructElementType(llvm::StructType *structType) {
+    int numElements = structType->getNumElements();
+    if(numElements < 2 || numElements > 4) {
+        return 0;
+    }
+    Type *elementType = structType->getElementType(0);
+    if(!elementType->isFloatTy() && !elementType->isDoubleTy() && !elementType->isIntegerTy()) {
+        return 0;
+    }
+    if(elementType->isIntegerTy(1)) {
+        return 0;
+    }
+    for(int i = 1; i < numElements; i++) {
+        if(structType->getElementType(i) != elementType) {
+            return 0;
+        }
+    }
+    return elementType;
+}
+
+// global, local and constant memory.  Pointers still in address space 0 might turn out to be vmem
+// (address space 5), which the instruction dumper resolves one scalar access at a time
+static bool isVectorizableAddressSpace(unsigned addressSpace) {
+    return addressSpace == 1 || addressSpace == 3 || addressSpace == 4;
+}
+
+// if ptr is a gep to a field of a vector-like struct, returns the field index, and the struct type,
+// otherwise returns -1
+static int getVectorFieldIndex(Value *ptr, StructType **pStructType) {
+    GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(ptr);
+    if(gep == 0 || gep->getNumIndices() < 2) {
+        return -1;
+    }
+    if(!isVectorizableAddressSpace(gep->getType()->getPointerAddressSpace())) {
+        return -1;
+    }
+    // the struct is whatever the last index but one points to
+    vector<Value *> indices(gep->idx_begin(), gep->idx_end() - 1);
+    Type *parentType = GetElementPtrInst::getIndexedType(gep->getSourceElementType(), indices);
+    StructType *structType = dyn_cast_or_null<StructType>(parentType);
+    if(structType == 0 || getVectorLikeStructElementType(structType) == 0) {
+        return -1;
+    }
+    ConstantInt *fieldIndex = dyn_cast<ConstantInt>(*(gep->idx_end() - 1));
+    if(fieldIndex == 0) {
+        return -1;
+    }
+    *pStructType = structType;
+    return fieldIndex->getZExtValue();
+}
+
+// two geps refer to the same struct if they have the same pointer operand, and the same indices,
+// apart from the last one
+static bool sameStruct(GetElementPtrInst *one, GetElementPtrInst *two) {
+    if(one->getNumOperands() != two->getNumOperands()) {
+        return false;
+    }
+    for(unsigned i = 0; i + 1 < one->getNumOperands(); i++) {
+        if(one->getOperand(i) != two->getOperand(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Type *getVectorType(Type *elementType, int numElements) {
+#if LLVM_VERSION_MAJOR >= 11
+    return FixedVectorType::get(elementType, numElements);
+#else
+    return VectorType::get(elementType, numElements);
+#endif
+}
+
+// creates a pointer to the whole struct, as a pointer to a vector, just before insertBefore
+static Value *createVectorPointer(GetElementPtrInst *fieldGep, Type *vectorType, Instruction *insertBefore) {
+    GetElementPtrInst *field0Gep = cast<GetElementPtrInst>(fieldGep->clone());
+    field0Gep->setOperand(field0Gep->getNumOperands() - 1, ConstantInt::get(Type::getInt32Ty(fieldGep->getContext()), 0));
+    field0Gep->insertBefore(insertBefore);
+    unsigned addressSpace = fieldGep->getType()->getPointerAddressSpace();
+    return new BitCastInst(field0Gep, PointerType::get(vectorType, addressSpace), "", insertBefore);
+}
+
+static void eraseIfDead(Value *value) {
+    if(Instruction *instr = dyn_cast<Instruction>(value)) {
+        if(instr->use_empty()) {
+            instr->eraseFromParent();
+        }
+    }
+}
+
+// looks for numElements simple loads (or stores) of fields of the same struct, after start, with nothing
+// in between that could read or write the same memory. returns the accesses ordered by field, or an
+// empty vector
+template<typename AccessType>
+static vector<AccessType *> findGroup(AccessType *start, int numElements) {
+    StructType *structType = 0;
+    int startField = getVectorFieldIndex(start->getPointerOperand(), &structType);
+    GetElementPtrInst *startGep = cast<GetElementPtrInst>(start->getPointerOperand());
+    vector<AccessType *> group(numElements, (AccessType *)0);
+    group[startField] = start;
+    int found = 1;
+    BasicBlock::iterator it(start);
+    for(it++; it != start->getParent()->end() && found < numElements; it++) {
+        Instruction *instr = &*it;
+        AccessType *access = dyn_cast<AccessType>(instr);
+        if(access != 0 && access->isSimple()) {
+            StructType *otherStructType = 0;
+            int field = getVectorFieldIndex(access->getPointerOperand(), &otherStructType);
+            if(field >= 0 && otherStructType == structType && group[field] == 0
+                    && sameStruct(startGep, cast<GetElementPtrInst>(access->getPointerOperand()))) {
+                group[field] = access;
+                found++;
+                continue;
+            }
+        }
+        if(isa<LoadInst>(start) ? instr->mayWriteToMemory() : instr->mayReadOrWriteMemory()) {
+            break;
+        }
+    }
+    if(found < numElements) {
+        return vector<AccessType *>();
+    }
+    return group;
+}
+
+static bool combineLoads(LoadInst *start) {
+    StructType *structType = 0;
+    if(getVectorFieldIndex(start->getPointerOperand(), &structType) < 0) {
+        return false;
+    }
+    Type *elementType = getVectorLikeStructElementType(structType);
+    int numElements = structType->getNumElements();
+    vector<LoadInst *> group = findGroup(start, numElements);
+    if(group.size() == 0) {
+        return false;
+    }
+    Type *vectorType = getVectorType(elementType, numElements);
+    Value *vectorPtr = createVectorPointer(cast<GetElementPtrInst>(start->getPointerOperand()), vectorType, start);
+    IRBuilder<> builder(start);
+#if LLVM_VERSION_MAJOR > 4
+    Value *vectorValue = builder.CreateLoad(vectorType, vectorPtr);
+#else
+    Value *vectorValue = builder.CreateLoad(vectorPtr);
+#endif
+    vector<Value *> elements;
+    for(int i = 0; i < numElements; i++) {
+        elements.push_back(builder.CreateExtractElement(vectorValue, builder.getInt32(i)));
+    }
+    for(int i = 0; i < numElements; i++) {
+        LoadInst *load = group[i];
+        Value *gep = load->getPointerOperand();
+        load->replaceAllUsesWith(elements[i]);
+        load->eraseFromParent();
+        eraseIfDead(gep);
+    }
+    return true;
+}
+
+static bool combineStores(StoreInst *start) {
+    StructType *structType = 0;
+    if(getVectorFieldIndex(start->getPointerOperand(), &structType) < 0) {
+        return false;
+    }
+    Type *elementType = getVectorLikeStructElementType(structType);
+    int numElements = structType->getNumElements();
+    vector<StoreInst *> group = findGroup(start, numElements);
+    if(group.size() == 0) {
+        return false;
+    }
+    // the combined store goes where the last of the group was, since all the stored values exist by then
+    Instruction *last = start;
+    int seen = 0;
+    for(BasicBlock::iterator it(start); seen < numElements; it++) {
+        if(std::find(group.begin(), group.end(), &*it) != group.end()) {
+            last = &*it;
+            seen++;
+        }
+    }
+    Type *vectorType = getVectorType(elementType, numElements);
+    Value *vectorPtr = createVectorPointer(cast<GetElementPtrInst>(start->getPointerOperand()), vectorType, last);
+    IRBuilder<> builder(last);
+    Value *vectorValue = UndefValue::get(vectorType);
+    for(int i = 0; i < numElements; i++) {
+        vectorValue = builder.CreateInsertElement(vectorValue, group[i]->getValueOperand(), builder.getInt32(i));
+    }
+    builder.CreateStore(vectorValue, vectorPtr);
+    for(int i = 0; i < numElements; i++) {
+        StoreInst *store = group[i];
+        Value *gep = store->getPointerOperand();
+        store->eraseFromParent();
+        eraseIfDead(gep);
+    }
+    return true;
+}
+
+bool combineVectorAccesses(llvm::Function *F) {
+    bool changed = false;
+    for(auto block_it = F->begin(); block_it != F->end(); block_it++) {
+        BasicBlock *block = &*block_it;
+        bool blockChanged = true;
+        while(blockChanged) {
+            blockChanged = false;
+            for(auto it = block->begin(); it != block->end(); it++) {
+                Instruction *instr = &*it;
+                LoadInst *load = dyn_cast<LoadInst>(instr);
+                StoreInst *store = dyn_cast<StoreInst>(instr);
+                if((load != 0 && load->isSimple() && combineLoads(load))
+                        || (store != 0 && store->isSimple() && combineStores(store))) {
+                    // our iterator is invalid now, so start the block again
+                    blockChanged = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+} // namespace cocl
@@ -0,0 +1,70 @@
+// tests atomicAdd on float and double, and atomicMax/Min/Exch/CAS on 32-bit and 64-bit integers
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void atomics(float *floats, double *doubles, int *ints, unsigned long long *ulls) {
+    int tid = threadIdx.x + blockIdx.x * blockDim.x;
+    atomicAdd(&floats[0], 1.0f);
+    atomicAdd(&doubles[0], 0.5);
+    atomicMax(&ints[0], tid);
+    atomicMin(&ints[1], tid);
+    atomicCAS(&ints[2], 0, tid + 1);  // only the first one wins
+    atomicExch(&ints[3], 7);
+    atomicAdd(&ulls[0], (unsigned long long)tid);
+    atomicMax(&ulls[1], (unsigned long long)tid << 32);
+    atomicCAS(&ulls[2], 0ull, 1ull << 40);
+}
+
+int main(int argc, char *argv[]) {
+    const int numThreads = 1024;
+
+    float hostFloats[1] = {0.0f};
+    double hostDoubles[1] = {0.0};
+    int hostInts[4] = {-1, numThreads, 0, 0};
+    unsigned long long hostUlls[3] = {0, 0, 0};
+
+    float *gpuFloats;
+    double *gpuDoubles;
+    int *gpuInts;
+    unsigned long long *gpuUlls;
+    cudaMalloc((void **)&gpuFloats, sizeof(hostFloats));
+    cudaMalloc((void **)&gpuDoubles, sizeof(hostDoubles));
+    cudaMalloc((void **)&gpuInts, sizeof(hostInts));
+    cudaMalloc((void **)&gpuUlls, sizeof(hostUlls));
+    cudaMemcpy(gpuFloats, hostFloats, sizeof(hostFloats), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuDoubles, hostDoubles, sizeof(hostDoubles), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuInts, hostInts, sizeof(hostInts), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuUlls, hostUlls, sizeof(hostUlls), cudaMemcpyHostToDevice);
+
+    atomics<<<dim3(numThreads / 128, 1, 1), dim3(128, 1, 1)>>>(gpuFloats, gpuDoubles, gpuInts, gpuUlls);
+
+    cudaMemcpy(hostFloats, gpuFloats, sizeof(hostFloats), cudaMemcpyDeviceToHost);
+    cudaMemcpy(hostDoubles, gpuDoubles, sizeof(hostDoubles), cudaMemcpyDeviceToHost);
+    cudaMemcpy(hostInts, gpuInts, sizeof(hostInts), cudaMemcpyDeviceToHost);
+    cudaMemcpy(hostUlls, gpuUlls, sizeof(hostUlls), cudaMemcpyDeviceToHost);
+
+    cout << "float sum " << hostFloats[0] << " double sum " << hostDoubles[0] << endl;
+    assert(hostFloats[0] == (float)numThreads);
+    assert(hostDoubles[0] == numThreads * 0.5);
+    assert(hostInts[0] == numThreads - 1);
+    assert(hostInts[1] == 0);
+    assert(hostInts[2] >= 1 && hostInts[2] <= numThreads);
+    assert(hostInts[3] == 7);
+    assert(hostUlls[0] == (unsigned long long)numThreads * (numThreads - 1) / 2);
+    assert(hostUlls[1] == (unsigned long long)(numThreads - 1) << 32);
+    assert(hostUlls[2] == 1ull << 40);
+
+    cudaFree(gpuFloats);
+    cudaFree(gpuDoubles);
+    cudaFree(gpuInts);
+    cudaFree(gpuUlls);
+
+    cout << "finished" << endl;
+    return 0;
+}
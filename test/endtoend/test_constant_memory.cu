@@ -0,0 +1,54 @@
+// tests __constant__ variables, with initializers, and written by cudaMemcpyToSymbol
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__constant__ float weights[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+__constant__ float scale = 1.0f;
+
+__global__ void applyWeights(float *out) {
+    int tid = threadIdx.x;
+    out[tid] = weights[tid % 4] * scale;
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 16;
+    float hostOut[N];
+
+    float *gpuOut;
+    cudaMalloc((void **)&gpuOut, N * sizeof(float));
+
+    applyWeights<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuOut);
+    cudaMemcpy(hostOut, gpuOut, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        assert(hostOut[i] == (float)(i % 4 + 1));
+    }
+
+    float newScale = 0.5f;
+    cudaMemcpyToSymbol(scale, &newScale, sizeof(float));
+    float newWeights[2] = {10.0f, 20.0f};
+    cudaMemcpyToSymbol(weights, newWeights, sizeof(newWeights), 2 * sizeof(float));
+
+    applyWeights<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuOut);
+    cudaMemcpy(hostOut, gpuOut, N * sizeof(float), cudaMemcpyDeviceToHost);
+    float expected[4] = {0.5f, 1.0f, 5.0f, 10.0f};
+    for(int i = 0; i < N; i++) {
+        cout << "out[" << i << "]=" << hostOut[i] << endl;
+        assert(hostOut[i] == expected[i % 4]);
+    }
+
+    float readBack[4];
+    cudaMemcpyFromSymbol(readBack, weights, sizeof(readBack));
+    assert(readBack[0] == 1.0f);
+    assert(readBack[3] == 20.0f);
+
+    cudaFree(gpuOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+// tests the thread_block and tiled_partition subset of cooperative groups: ranks, sync, tile shuffles, votes
+// and reductions
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+template<typename T>
+struct times {
+    __device__ T operator()(const T a, const T b) const {
+        return a * b;
+    }
+};
+
+__global__ void groups(int *in, int *out) {
+    cg::thread_block block = cg::this_thread_block();
+    cg::thread_block_tile<16> tile = cg::tiled_partition<16>(block);
+    int rank = block.thread_rank();
+    int me = in[rank];
+
+    out[rank] = tile.thread_rank() + 100 * tile.meta_group_rank();
+    out[128 + rank] = tile.shfl(me, 3);
+    out[256 + rank] = tile.shfl_down(me, 1);
+    out[384 + rank] = (int)tile.ballot(me % 2 == 0);
+    out[512 + rank] = cg::reduce(tile, me, cg::plus<int>());
+    out[640 + rank] = cg::reduce(tile, me, cg::greater<int>());
+    tile.sync();
+    block.sync();
+    // goes through shfl_xor
+    out[768 + rank] = cg::reduce(tile, me % 3 + 1, times<int>());
+}
+
+__global__ void floatSums(float *in, float *out) {
+    cg::thread_block_tile<32> tile = cg::tiled_partition<32>(cg::this_thread_block());
+    float me = in[cg::this_thread_block().thread_rank()];
+    out[cg::this_thread_block().thread_rank()] = cg::reduce(tile, me, cg::plus<float>());
+    cg::sync(cg::this_thread_block());
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 128;
+    int hostIn[N];
+    int hostOut[7 * N];
+    for(int i = 0; i < N; i++) {
+        hostIn[i] = (i * 7) % 19;
+    }
+
+    int *gpuIn;
+    int *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(int));
+    cudaMalloc((void **)&gpuOut, 7 * N * sizeof(int));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(int), cudaMemcpyHostToDevice);
+
+    groups<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuIn, gpuOut);
+
+    cudaMemcpy(hostOut, gpuOut, 7 * N * sizeof(int), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        int lane = i % 16;
+        int tileStart = i - lane;
+        int sum = 0;
+        int max = 0;
+        int product = 1;
+        unsigned int evens = 0;
+        for(int j = 0; j < 16; j++) {
+            int v = hostIn[tileStart + j];
+            sum += v;
+            max = v > max ? v : max;
+            product *= v % 3 + 1;
+            evens |= (v % 2 == 0 ? 1u : 0u) << j;
+        }
+        assert(hostOut[i] == lane + 100 * (i / 16));
+        assert(hostOut[128 + i] == hostIn[tileStart + 3]);
+        assert(hostOut[256 + i] == (lane + 1 < 16 ? hostIn[i + 1] : hostIn[i]));
+        assert((unsigned int)hostOut[384 + i] == evens);
+        assert(hostOut[512 + i] == sum);
+        assert(hostOut[640 + i] == max);
+        assert(hostOut[768 + i] == product);
+    }
+    cudaFree(gpuIn);
+    cudaFree(gpuOut);
+
+    float hostFloatIn[N];
+    float hostFloatOut[N];
+    for(int i = 0; i < N; i++) {
+        hostFloatIn[i] = i * 0.5f;
+    }
+    float *gpuFloatIn;
+    float *gpuFloatOut;
+    cudaMalloc((void **)&gpuFloatIn, N * sizeof(float));
+    cudaMalloc((void **)&gpuFloatOut, N * sizeof(float));
+    cudaMemcpy(gpuFloatIn, hostFloatIn, N * sizeof(float), cudaMemcpyHostToDevice);
+
+    floatSums<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuFloatIn, gpuFloatOut);
+
+    cudaMemcpy(hostFloatOut, gpuFloatOut, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        int warpStart = i - i % 32;
+        float sum = 0;
+        for(int j = 0; j < 32; j++) {
+            sum += hostFloatIn[warpStart + j];
+        }
+        // halves, so exact
+        assert(hostFloatOut[i] == sum);
+    }
+    cudaFree(gpuFloatIn);
+    cudaFree(gpuFloatOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,54 @@
+// tests legacy default stream semantics: work on stream 0 waits for blocking streams, and vice versa
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void addValue(float *data, int N, float value) {
+    int tid = threadIdx.x + blockIdx.x * blockDim.x;
+    if(tid < N) {
+        for(int i = 0; i < 1000; i++) {
+            data[tid] += value;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 1024;
+
+    cudaStream_t stream;
+    cudaStreamCreate(&stream);
+
+    float hostFloats[N];
+    for(int i = 0; i < N; i++) {
+        hostFloats[i] = i;
+    }
+    float *gpuFloats;
+    cudaMalloc((void **)&gpuFloats, N * sizeof(float));
+    cudaMemcpy(gpuFloats, hostFloats, N * sizeof(float), cudaMemcpyHostToDevice);
+
+    // stream waits on the copy above, in the legacy stream...
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, stream>>>(gpuFloats, N, 1.0f);
+    // ... and this launch, on the legacy stream, waits on stream
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1)>>>(gpuFloats, N, 2.0f);
+    // as does this one, on stream, wait on the legacy stream
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, stream>>>(gpuFloats, N, 4.0f);
+
+    float result[N];
+    cudaMemcpyAsync(result, gpuFloats, N * sizeof(float), cudaMemcpyDeviceToHost, 0);
+    cudaDeviceSynchronize();
+
+    for(int i = 0; i < N; i++) {
+        assert(result[i] == i + 7000.0f);
+    }
+
+    cudaFree(gpuFloats);
+    cudaStreamDestroy(stream);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+// tests the fast intrinsics, which become OpenCL native_ functions; this test is built with -use_fast_math, so
+// the OpenCL is built with -cl-fast-relaxed-math too
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void intrinsics(const float *in, float *out) {
+    int i = threadIdx.x;
+    float x = in[i];
+    out[i * 8 + 0] = __expf(x);
+    out[i * 8 + 1] = __logf(x);
+    out[i * 8 + 2] = __log2f(x);
+    out[i * 8 + 3] = __sinf(x);
+    out[i * 8 + 4] = __cosf(x);
+    out[i * 8 + 5] = __fdividef(1.0f, x);
+    out[i * 8 + 6] = __powf(x, 1.5f);
+    out[i * 8 + 7] = expf(x) * x + 1.0f;
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 32;
+    float hostIn[N];
+    float hostOut[N * 8];
+    for(int i = 0; i < N; i++) {
+        hostIn[i] = 0.25f + i * 0.1f;
+    }
+
+    float *gpuIn;
+    float *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(float));
+    cudaMalloc((void **)&gpuOut, N * 8 * sizeof(float));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(float), cudaMemcpyHostToDevice);
+
+    intrinsics<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuIn, gpuOut);
+    cudaMemcpy(hostOut, gpuOut, N * 8 * sizeof(float), cudaMemcpyDeviceToHost);
+
+    for(int i = 0; i < N; i++) {
+        float x = hostIn[i];
+        float expected[8] = {
+            exp(x), log(x), log2(x), sin(x), cos(x), 1.0f / x, pow(x, 1.5f), exp(x) * x + 1.0f
+        };
+        for(int j = 0; j < 8; j++) {
+            float actual = hostOut[i * 8 + j];
+            // native_ functions have implementation-defined accuracy, so just check they are roughly right
+            float tolerance = 1e-3f * fmax(1.0f, fabs(expected[j]));
+            if(fabs(actual - expected[j]) > tolerance) {
+                cout << "x=" << x << " j=" << j << " expected=" << expected[j] << " actual=" << actual << endl;
+            }
+            assert(fabs(actual - expected[j]) <= tolerance);
+        }
+    }
+
+    cudaFree(gpuIn);
+    cudaFree(gpuOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
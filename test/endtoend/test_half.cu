@@ -0,0 +1,107 @@
+// tests __half and __half2, which are written as OpenCL half and half2 if the device has cl_khr_fp16, and
+// otherwise stored as halfs but computed in float
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+#include <cuda.h>
+#include <cuda_fp16.h>
+
+__global__ void halfAxpy(float a, const __half *x, __half *y, int n) {
+    int i = threadIdx.x;
+    if(i < n) {
+        y[i] = __hfma(__float2half(a), x[i], y[i]);
+    }
+}
+
+__global__ void half2Add(const __half2 *a, const __half2 *b, __half2 *out) {
+    int i = threadIdx.x;
+    out[i] = __hadd2(a[i], b[i]);
+}
+
+__global__ void halfToFloat(const __half *in, float *out) {
+    int i = threadIdx.x;
+    out[i] = __half2float(in[i]) + 0.5f;
+}
+
+// host-side conversions, for values that are exactly representable as halfs, so we dont need any half support
+// on the host
+unsigned short floatToHalfBits(float value) {
+    if(value == 0.0f) {
+        return 0;
+    }
+    unsigned short sign = value < 0 ? 0x8000 : 0;
+    int exponent;
+    float mantissa = frexp(fabs(value), &exponent);  // in [0.5, 1)
+    return sign | ((exponent + 14) << 10) | ((int)(mantissa * 2048.0f) & 0x3ff);
+}
+
+float halfBitsToFloat(unsigned short bits) {
+    int exponent = (bits >> 10) & 0x1f;
+    int mantissa = bits & 0x3ff;
+    float value = exponent == 0 ? 0.0f : ldexp((float)(mantissa | 0x400), exponent - 25);
+    return (bits & 0x8000) ? - value : value;
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 32;
+    unsigned short hostX[N];
+    unsigned short hostY[N];
+    unsigned short hostOut[N];
+    float hostFloats[N];
+    for(int i = 0; i < N; i++) {
+        hostX[i] = floatToHalfBits(i);
+        hostY[i] = floatToHalfBits(- i * 0.5f);
+    }
+    for(int i = 0; i < N; i++) {
+        assert(halfBitsToFloat(floatToHalfBits(i * 0.25f)) == i * 0.25f);
+    }
+
+    __half *gpuX;
+    __half *gpuY;
+    __half *gpuOut;
+    float *gpuFloats;
+    cudaMalloc((void **)&gpuX, N * sizeof(__half));
+    cudaMalloc((void **)&gpuY, N * sizeof(__half));
+    cudaMalloc((void **)&gpuOut, N * sizeof(__half));
+    cudaMalloc((void **)&gpuFloats, N * sizeof(float));
+    cudaMemcpy(gpuX, hostX, N * sizeof(__half), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuY, hostY, N * sizeof(__half), cudaMemcpyHostToDevice);
+
+    // a and the values are small enough that the results are exact, even in half
+    halfAxpy<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(2.0f, gpuX, gpuY, N - 1);
+    cudaMemcpy(hostOut, gpuY, N * sizeof(__half), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        float expected = i < N - 1 ? 2.0f * i - i * 0.5f : - i * 0.5f;
+        cout << "y[" << i << "]=" << halfBitsToFloat(hostOut[i]) << endl;
+        assert(halfBitsToFloat(hostOut[i]) == expected);
+    }
+
+    half2Add<<<dim3(1, 1, 1), dim3(N / 2, 1, 1)>>>((__half2 *)gpuX, (__half2 *)gpuY, (__half2 *)gpuOut);
+    unsigned short hostY2[N];
+    memcpy(hostY2, hostOut, sizeof(hostOut));
+    cudaMemcpy(hostOut, gpuOut, N * sizeof(__half), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        float expected = halfBitsToFloat(hostX[i]) + halfBitsToFloat(hostY2[i]);
+        assert(halfBitsToFloat(hostOut[i]) == expected);
+    }
+
+    halfToFloat<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuX, gpuFloats);
+    cudaMemcpy(hostFloats, gpuFloats, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        assert(hostFloats[i] == i + 0.5f);
+    }
+
+    cudaFree(gpuX);
+    cudaFree(gpuY);
+    cudaFree(gpuOut);
+    cudaFree(gpuFloats);
+
+    cout << "finished" << endl;
+    return 0;
+}
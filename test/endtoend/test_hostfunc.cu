@@ -0,0 +1,83 @@
+// tests cudaLaunchHostFunc: host functions run in stream order, and later work in the stream
+// waits for them to return
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void addValue(float *data, int N, float value) {
+    int tid = threadIdx.x + blockIdx.x * blockDim.x;
+    if(tid < N) {
+        data[tid] += value;
+    }
+}
+
+struct HostData {
+    float *hostFloats;
+    int N;
+    int calls;
+};
+
+void addOnHost(void *userdata) {
+    HostData *data = (HostData *)userdata;
+    for(int i = 0; i < data->N; i++) {
+        data->hostFloats[i] += 100.0f;
+    }
+    data->calls++;
+}
+
+void checkStatus(cudaStream_t stream, cudaError_t status, void *userdata) {
+    assert(status == cudaSuccess);
+    HostData *data = (HostData *)userdata;
+    data->calls++;
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 1024;
+
+    cudaStream_t stream;
+    cudaStreamCreate(&stream);
+
+    float *hostFloats = new float[N];
+    for(int i = 0; i < N; i++) {
+        hostFloats[i] = i;
+    }
+    float *gpuFloats;
+    cudaMalloc((void **)&gpuFloats, N * sizeof(float));
+
+    HostData data;
+    data.hostFloats = hostFloats;
+    data.N = N;
+    data.calls = 0;
+
+    // device +1, host +100, device +1, host +100, all in the one stream
+    cudaMemcpyAsync(gpuFloats, hostFloats, N * sizeof(float), cudaMemcpyHostToDevice, stream);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, stream>>>(gpuFloats, N, 1.0f);
+    cudaMemcpyAsync(hostFloats, gpuFloats, N * sizeof(float), cudaMemcpyDeviceToHost, stream);
+    cudaLaunchHostFunc(stream, addOnHost, &data);
+    cudaMemcpyAsync(gpuFloats, hostFloats, N * sizeof(float), cudaMemcpyHostToDevice, stream);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, stream>>>(gpuFloats, N, 1.0f);
+    cudaMemcpyAsync(hostFloats, gpuFloats, N * sizeof(float), cudaMemcpyDeviceToHost, stream);
+    cudaLaunchHostFunc(stream, addOnHost, &data);
+    cudaStreamAddCallback(stream, checkStatus, &data, 0);
+    cudaStreamSynchronize(stream);
+
+    assert(data.calls == 3);
+    for(int i = 0; i < N; i++) {
+        if(hostFloats[i] != i + 202.0f) {
+            cout << "mismatch at " << i << ": " << hostFloats[i] << endl;
+            assert(false);
+        }
+    }
+
+    cudaFree(gpuFloats);
+    delete[] hostFloats;
+    cudaStreamDestroy(stream);
+
+    cout << "finished" << endl;
+    return 0;
+}
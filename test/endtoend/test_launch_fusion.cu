@@ -0,0 +1,74 @@
+// tests COCL_LAUNCH_FUSION: tiny launches writing separate buffers run as one dispatch, and launches depending on
+// each other, or on a memcpy, still see each other's results
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+#include <cstdlib>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void fill(float *out, float value) {
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    out[i] = value + blockIdx.x * 1000 + gridDim.x * 100000;
+}
+
+__global__ void increment(float *data) {
+    data[blockIdx.x * blockDim.x + threadIdx.x] += 1.0f;
+}
+
+int main(int argc, char *argv[]) {
+    // read at the first launch
+    setenv("COCL_LAUNCH_FUSION", "1", 1);
+
+    const int N = 8;
+    const int block = 32;
+    const int grid = 2;
+    const int size = grid * block;
+    float *gpuBuffers[N];
+    for(int i = 0; i < N; i++) {
+        cudaMalloc((void **)&gpuBuffers[i], size * sizeof(float));
+    }
+
+    // independent, so fused
+    for(int i = 0; i < N; i++) {
+        fill<<<dim3(grid, 1, 1), dim3(block, 1, 1)>>>(gpuBuffers[i], (float)i);
+    }
+    // each depends on the one before
+    for(int i = 0; i < 3; i++) {
+        increment<<<dim3(grid, 1, 1), dim3(block, 1, 1)>>>(gpuBuffers[0]);
+    }
+
+    float hostBuffer[size];
+    for(int i = 0; i < N; i++) {
+        cudaMemcpy(hostBuffer, gpuBuffers[i], size * sizeof(float), cudaMemcpyDeviceToHost);
+        for(int j = 0; j < size; j++) {
+            float expected = i + (j / block) * 1000 + grid * 100000 + (i == 0 ? 3 : 0);
+            if(hostBuffer[j] != expected) {
+                cout << "buffer " << i << " [" << j << "] " << hostBuffer[j] << " expected " << expected << endl;
+            }
+            assert(hostBuffer[j] == expected);
+        }
+    }
+
+    // the launches after a memcpy see what it wrote
+    for(int j = 0; j < size; j++) {
+        hostBuffer[j] = j;
+    }
+    cudaMemcpy(gpuBuffers[1], hostBuffer, size * sizeof(float), cudaMemcpyHostToDevice);
+    increment<<<dim3(grid, 1, 1), dim3(block, 1, 1)>>>(gpuBuffers[1]);
+    increment<<<dim3(grid, 1, 1), dim3(block, 1, 1)>>>(gpuBuffers[2]);
+    cudaDeviceSynchronize();
+    cudaMemcpy(hostBuffer, gpuBuffers[1], size * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int j = 0; j < size; j++) {
+        assert(hostBuffer[j] == j + 1);
+    }
+
+    for(int i = 0; i < N; i++) {
+        cudaFree(gpuBuffers[i]);
+    }
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,65 @@
+// tests cudaMallocManaged: host and device both use the same pointer, with the host touching it
+// only after synchronizing
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void addValue(float *data, int N, float value) {
+    int tid = threadIdx.x + blockIdx.x * blockDim.x;
+    if(tid < N) {
+        data[tid] += value;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 1024;
+
+    float *managed;
+    cudaMallocManaged((void **)&managed, N * sizeof(float));
+    for(int i = 0; i < N; i++) {
+        managed[i] = i;
+    }
+
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1)>>>(managed, N, 1.0f);
+    cudaDeviceSynchronize();
+    for(int i = 0; i < N; i++) {
+        assert(managed[i] == i + 1.0f);
+        managed[i] += 10.0f;
+    }
+
+    // a stream, with explicit prefetches either side
+    cudaStream_t stream;
+    cudaStreamCreate(&stream);
+    cudaMemPrefetchAsync(managed, N * sizeof(float), 0, stream);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, stream>>>(managed, N, 100.0f);
+    cudaMemPrefetchAsync(managed, N * sizeof(float), cudaCpuDeviceId, stream);
+    cudaStreamSynchronize(stream);
+    for(int i = 0; i < N; i++) {
+        assert(managed[i] == i + 111.0f);
+    }
+
+    // explicit copies to and from managed memory work too
+    float *gpuFloats;
+    cudaMalloc((void **)&gpuFloats, N * sizeof(float));
+    cudaMemcpy(gpuFloats, managed, N * sizeof(float), cudaMemcpyDeviceToDevice);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1)>>>(gpuFloats, N, 1000.0f);
+    cudaMemcpy(managed, gpuFloats, N * sizeof(float), cudaMemcpyDeviceToDevice);
+    for(int i = 0; i < N; i++) {
+        if(managed[i] != i + 1111.0f) {
+            cout << "mismatch at " << i << ": " << managed[i] << endl;
+            assert(false);
+        }
+    }
+
+    cudaFree(gpuFloats);
+    cudaFree(managed);
+    cudaStreamDestroy(stream);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,69 @@
+// tests __shfl, __shfl_up, __shfl_down and __shfl_xor, for int, float and double
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+template<typename T>
+__global__ void shuffles(T *in, T *out) {
+    int tid = threadIdx.x;
+    T me = in[tid];
+    out[tid] = __shfl(me, 3, 32);
+    out[128 + tid] = __shfl_up(me, 2, 32);
+    out[256 + tid] = __shfl_down(me, 1, 16);
+    out[384 + tid] = __shfl_xor(me, 1, 32);
+}
+
+// what cuda would give
+template<typename T>
+void expected(const T *in, T *out) {
+    for(int tid = 0; tid < 128; tid++) {
+        int lane = tid % 32;
+        int warpStart = tid - lane;
+        out[tid] = in[warpStart + 3];
+        out[128 + tid] = lane >= 2 ? in[tid - 2] : in[tid];
+        out[256 + tid] = tid % 16 + 1 < 16 ? in[tid + 1] : in[tid];
+        out[384 + tid] = in[warpStart + (lane ^ 1)];
+    }
+}
+
+template<typename T>
+void check(string name) {
+    const int N = 128;
+    T hostIn[N];
+    T hostOut[4 * N];
+    T hostExpected[4 * N];
+    for(int i = 0; i < N; i++) {
+        hostIn[i] = (T)(1000 + i);
+    }
+    T *gpuIn;
+    T *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(T));
+    cudaMalloc((void **)&gpuOut, 4 * N * sizeof(T));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(T), cudaMemcpyHostToDevice);
+
+    shuffles<T><<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuIn, gpuOut);
+
+    cudaMemcpy(hostOut, gpuOut, 4 * N * sizeof(T), cudaMemcpyDeviceToHost);
+    expected(hostIn, hostExpected);
+    for(int i = 0; i < 4 * N; i++) {
+        if(hostOut[i] != hostExpected[i]) {
+            cout << name << " mismatch at " << i << ": " << hostOut[i] << " expected " << hostExpected[i] << endl;
+            assert(false);
+        }
+    }
+    cudaFree(gpuIn);
+    cudaFree(gpuOut);
+    cout << name << " ok" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    check<int>("int");
+    check<float>("float");
+    check<double>("double");
+    return 0;
+}
@@ -0,0 +1,73 @@
+// tests cudaStreamCreateWithFlags, cudaStreamCreateWithPriority
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void addValue(float *data, int N, float value) {
+    int tid = threadIdx.x + blockIdx.x * blockDim.x;
+    if(tid < N) {
+        data[tid] += value;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 1024;
+
+    int leastPriority = 123;
+    int greatestPriority = 123;
+    cudaDeviceGetStreamPriorityRange(&leastPriority, &greatestPriority);
+    cout << "priority range least=" << leastPriority << " greatest=" << greatestPriority << endl;
+    assert(leastPriority == 0);
+    assert(greatestPriority <= leastPriority);
+
+    cudaStream_t bulkStream;
+    cudaStreamCreateWithFlags(&bulkStream, cudaStreamNonBlocking);
+    unsigned int flags = 0;
+    cudaStreamGetFlags(bulkStream, &flags);
+    assert(flags == cudaStreamNonBlocking);
+
+    cudaStream_t urgentStream;
+    cudaStreamCreateWithPriority(&urgentStream, cudaStreamNonBlocking, greatestPriority);
+    int priority = 123;
+    cudaStreamGetPriority(urgentStream, &priority);
+    assert(priority == greatestPriority);
+
+    float hostFloats[N];
+    for(int i = 0; i < N; i++) {
+        hostFloats[i] = i;
+    }
+    float *bulkFloats;
+    float *urgentFloats;
+    cudaMalloc((void **)&bulkFloats, N * sizeof(float));
+    cudaMalloc((void **)&urgentFloats, N * sizeof(float));
+
+    cudaMemcpyAsync(bulkFloats, hostFloats, N * sizeof(float), cudaMemcpyHostToDevice, bulkStream);
+    cudaMemcpyAsync(urgentFloats, hostFloats, N * sizeof(float), cudaMemcpyHostToDevice, urgentStream);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, bulkStream>>>(bulkFloats, N, 3.0f);
+    addValue<<<dim3(N / 32, 1, 1), dim3(32, 1, 1), 0, urgentStream>>>(urgentFloats, N, 5.0f);
+
+    float bulkResult[N];
+    float urgentResult[N];
+    cudaMemcpyAsync(bulkResult, bulkFloats, N * sizeof(float), cudaMemcpyDeviceToHost, bulkStream);
+    cudaMemcpyAsync(urgentResult, urgentFloats, N * sizeof(float), cudaMemcpyDeviceToHost, urgentStream);
+    cudaStreamSynchronize(urgentStream);
+    cudaStreamSynchronize(bulkStream);
+
+    for(int i = 0; i < N; i++) {
+        assert(bulkResult[i] == i + 3.0f);
+        assert(urgentResult[i] == i + 5.0f);
+    }
+
+    cudaFree(bulkFloats);
+    cudaFree(urgentFloats);
+    cudaStreamDestroy(bulkStream);
+    cudaStreamDestroy(urgentStream);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,116 @@
+// tests texture objects: tex1Dfetch on linear memory, and tex2D on pitch2D memory, with and without
+// bilinear filtering
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void fetchLinear(cudaTextureObject_t tex, float *out) {
+    int tid = threadIdx.x;
+    out[tid] = tex1Dfetch<float>(tex, tid) * 2.0f;
+}
+
+__global__ void fetch2D(cudaTextureObject_t tex, float *out, int width) {
+    int x = threadIdx.x;
+    int y = threadIdx.y;
+    // texel centers are at +0.5
+    out[y * width + x] = tex2D<float>(tex, x + 0.5f, y + 0.5f);
+}
+
+__global__ void fetchBetween(cudaTextureObject_t tex, float *out) {
+    out[0] = tex2D<float>(tex, 1.0f, 0.5f);  // halfway between texels 0 and 1 of row 0
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 32;
+    float hostIn[N];
+    float hostOut[N];
+    for(int i = 0; i < N; i++) {
+        hostIn[i] = i + 1;
+    }
+
+    float *gpuIn;
+    float *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(float));
+    cudaMalloc((void **)&gpuOut, N * sizeof(float));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(float), cudaMemcpyHostToDevice);
+
+    cudaResourceDesc resDesc;
+    memset(&resDesc, 0, sizeof(resDesc));
+    resDesc.resType = cudaResourceTypeLinear;
+    resDesc.res.linear.devPtr = gpuIn;
+    resDesc.res.linear.desc = cudaCreateChannelDesc<float>();
+    resDesc.res.linear.sizeInBytes = N * sizeof(float);
+    cudaTextureDesc texDesc;
+    memset(&texDesc, 0, sizeof(texDesc));
+    texDesc.readMode = cudaReadModeElementType;
+    cudaTextureObject_t linearTex = 0;
+    cudaCreateTextureObject(&linearTex, &resDesc, &texDesc, 0);
+
+    fetchLinear<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(linearTex, gpuOut);
+    cudaMemcpy(hostOut, gpuOut, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        assert(hostOut[i] == 2.0f * (i + 1));
+    }
+    cudaDestroyTextureObject(linearTex);
+
+    // 4 x 4 image, with a pitch of 8 floats
+    const int width = 4;
+    const int height = 4;
+    const int pitch = 8;
+    float hostImage[height * pitch];
+    for(int i = 0; i < height * pitch; i++) {
+        hostImage[i] = -1.0f;
+    }
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            hostImage[y * pitch + x] = y * 10 + x;
+        }
+    }
+    cudaMemcpy(gpuIn, hostImage, height * pitch * sizeof(float), cudaMemcpyHostToDevice);
+
+    memset(&resDesc, 0, sizeof(resDesc));
+    resDesc.resType = cudaResourceTypePitch2D;
+    resDesc.res.pitch2D.devPtr = gpuIn;
+    resDesc.res.pitch2D.desc = cudaCreateChannelDesc<float>();
+    resDesc.res.pitch2D.width = width;
+    resDesc.res.pitch2D.height = height;
+    resDesc.res.pitch2D.pitchInBytes = pitch * sizeof(float);
+    memset(&texDesc, 0, sizeof(texDesc));
+    texDesc.addressMode[0] = cudaAddressModeClamp;
+    texDesc.addressMode[1] = cudaAddressModeClamp;
+    texDesc.filterMode = cudaFilterModePoint;
+    texDesc.readMode = cudaReadModeElementType;
+    cudaTextureObject_t imageTex = 0;
+    cudaCreateTextureObject(&imageTex, &resDesc, &texDesc, 0);
+
+    fetch2D<<<dim3(1, 1, 1), dim3(width, height, 1)>>>(imageTex, gpuOut, width);
+    cudaMemcpy(hostOut, gpuOut, width * height * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            cout << "out[" << y << "][" << x << "]=" << hostOut[y * width + x] << endl;
+            assert(hostOut[y * width + x] == y * 10 + x);
+        }
+    }
+    cudaDestroyTextureObject(imageTex);
+
+    texDesc.filterMode = cudaFilterModeLinear;
+    cudaCreateTextureObject(&imageTex, &resDesc, &texDesc, 0);
+    fetchBetween<<<dim3(1, 1, 1), dim3(1, 1, 1)>>>(imageTex, gpuOut);
+    cudaMemcpy(hostOut, gpuOut, sizeof(float), cudaMemcpyDeviceToHost);
+    cout << "between=" << hostOut[0] << endl;
+    assert(fabs(hostOut[0] - 0.5f) < 0.01f);
+    cudaDestroyTextureObject(imageTex);
+
+    cudaFree(gpuIn);
+    cudaFree(gpuOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
@@ -0,0 +1,87 @@
+// tests kernels with `#pragma unroll` loops, which loop-unroll unrolls before we generate the OpenCL
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void convolve3x3(const float *in, const float *taps, float *out, int width) {
+    int x = threadIdx.x + 1;
+    int y = threadIdx.y + 1;
+    float sum = 0.0f;
+    #pragma unroll
+    for(int dy = -1; dy <= 1; dy++) {
+        #pragma unroll
+        for(int dx = -1; dx <= 1; dx++) {
+            sum += taps[(dy + 1) * 3 + dx + 1] * in[(y + dy) * width + x + dx];
+        }
+    }
+    out[y * width + x] = sum;
+}
+
+__global__ void partialUnroll(float *data, int n) {
+    #pragma unroll 4
+    for(int i = 0; i < n; i++) {
+        data[i] = data[i] * 2.0f + i;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int width = 6;
+    const int height = 6;
+    const int N = width * height;
+    float hostIn[N];
+    float hostOut[N];
+    float hostTaps[9];
+    for(int i = 0; i < N; i++) {
+        hostIn[i] = i % 7;
+        hostOut[i] = 0.0f;
+    }
+    for(int i = 0; i < 9; i++) {
+        hostTaps[i] = i + 1;
+    }
+
+    float *gpuIn;
+    float *gpuTaps;
+    float *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(float));
+    cudaMalloc((void **)&gpuTaps, 9 * sizeof(float));
+    cudaMalloc((void **)&gpuOut, N * sizeof(float));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(float), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuTaps, hostTaps, 9 * sizeof(float), cudaMemcpyHostToDevice);
+    cudaMemcpy(gpuOut, hostOut, N * sizeof(float), cudaMemcpyHostToDevice);
+
+    convolve3x3<<<dim3(1, 1, 1), dim3(width - 2, height - 2, 1)>>>(gpuIn, gpuTaps, gpuOut, width);
+    cudaMemcpy(hostOut, gpuOut, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int y = 1; y < height - 1; y++) {
+        for(int x = 1; x < width - 1; x++) {
+            float expected = 0.0f;
+            for(int dy = -1; dy <= 1; dy++) {
+                for(int dx = -1; dx <= 1; dx++) {
+                    expected += hostTaps[(dy + 1) * 3 + dx + 1] * hostIn[(y + dy) * width + x + dx];
+                }
+            }
+            cout << "out[" << y << "][" << x << "]=" << hostOut[y * width + x] << endl;
+            assert(hostOut[y * width + x] == expected);
+        }
+    }
+
+    // n isnt a multiple of the unroll count, so this needs the remainder loop too
+    const int n = 11;
+    partialUnroll<<<dim3(1, 1, 1), dim3(1, 1, 1)>>>(gpuIn, n);
+    cudaMemcpy(hostOut, gpuIn, N * sizeof(float), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        float expected = i < n ? hostIn[i] * 2.0f + i : hostIn[i];
+        assert(hostOut[i] == expected);
+    }
+
+    cudaFree(gpuIn);
+    cudaFree(gpuTaps);
+    cudaFree(gpuOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
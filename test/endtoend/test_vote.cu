@@ -0,0 +1,55 @@
+// tests __any, __all, __ballot, and counting with __popc(__ballot(...))
+
+#include <iostream>
+#include <memory>
+#include <cassert>
+
+using namespace std;
+
+#include <cuda.h>
+
+__global__ void votes(int *in, int *out) {
+    int tid = threadIdx.x;
+    int pred = in[tid];
+    out[tid] = __any(pred);
+    out[128 + tid] = __all(pred);
+    out[256 + tid] = (int)__ballot(pred);
+    __syncwarp();
+    out[384 + tid] = __popc(__ballot(pred));
+}
+
+int main(int argc, char *argv[]) {
+    const int N = 128;
+    int hostIn[N];
+    int hostOut[4 * N];
+    // warp 0: all set; warp 1: none set; warp 2: even lanes; warp 3: just lane 5
+    for(int i = 0; i < N; i++) {
+        int warp = i / 32;
+        int lane = i % 32;
+        hostIn[i] = warp == 0 ? 1 : warp == 1 ? 0 : warp == 2 ? (lane % 2 == 0) : lane == 5;
+    }
+    unsigned int expectedBallot[] = {0xffffffffu, 0u, 0x55555555u, 1u << 5};
+    int expectedCount[] = {32, 0, 16, 1};
+
+    int *gpuIn;
+    int *gpuOut;
+    cudaMalloc((void **)&gpuIn, N * sizeof(int));
+    cudaMalloc((void **)&gpuOut, 4 * N * sizeof(int));
+    cudaMemcpy(gpuIn, hostIn, N * sizeof(int), cudaMemcpyHostToDevice);
+
+    votes<<<dim3(1, 1, 1), dim3(N, 1, 1)>>>(gpuIn, gpuOut);
+
+    cudaMemcpy(hostOut, gpuOut, 4 * N * sizeof(int), cudaMemcpyDeviceToHost);
+    for(int i = 0; i < N; i++) {
+        int warp = i / 32;
+        assert((hostOut[i] != 0) == (warp != 1));
+        assert((hostOut[128 + i] != 0) == (warp == 0));
+        assert((unsigned int)hostOut[256 + i] == expectedBallot[warp]);
+        assert(hostOut[384 + i] == expectedCount[warp]);
+    }
+    cudaFree(gpuIn);
+    cudaFree(gpuOut);
+
+    cout << "finished" << endl;
+    return 0;
+}
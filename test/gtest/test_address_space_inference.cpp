@@ -0,0 +1,112 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/address_space_inference.h"
+
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace cocl;
+using namespace llvm;
+
+namespace test_address_space_inference {
+
+LLVMContext context;
+unique_ptr<Module>M;
+
+string ll_path = CMAKE_CURRENT_SOURCE_DIR "/test_address_space_inference.ll";
+
+Module *getM() {
+    if(M == nullptr) {
+        SMDiagnostic smDiagnostic;
+        M = parseIRFile(StringRef(ll_path), smDiagnostic, context);
+        if(!M) {
+            smDiagnostic.print("irtopencl", errs());
+            throw runtime_error("failed to parse IR");
+        }
+    }
+    return M.get();
+}
+
+Function *getFunction(string name) {
+    Function *F = getM()->getFunction(StringRef(name));
+    if(F == 0) {
+        throw runtime_error("Function " + name + " not found");
+    }
+    return F;
+}
+
+Value *getValue(Function *F, string name) {
+    for(auto &arg : F->args()) {
+        if(arg.getName() == name) {
+            return &arg;
+        }
+    }
+    for(auto &block : *F) {
+        for(auto &instr : block) {
+            if(instr.getName() == name) {
+                return &instr;
+            }
+        }
+    }
+    throw runtime_error("Value " + name + " not found");
+}
+
+TEST(test_address_space_inference, basic) {
+    Function *kernel = getFunction("k");
+    Function *helper = getFunction("helper");
+    AddressSpaceInference inference;
+    inference.run(getM(), kernel);
+
+    // pointers through a private array of pointers, and phis
+    EXPECT_EQ(0, inference.getAddressSpace(getValue(kernel, "arr")));
+    EXPECT_EQ(1, inference.getAddressSpace(getValue(kernel, "x")));
+    EXPECT_EQ(1, inference.getAddressSpace(getValue(kernel, "p")));
+    EXPECT_EQ(3, inference.getAddressSpace(getValue(kernel, "sh0")));
+
+    // pointers to pointers are left for the instruction dumper, which uses vmem for them
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(kernel, "f1")));
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(kernel, "y")));
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(kernel, "z")));
+
+    // helper is called with global and local pointers for p, but always global for q
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(helper, "p")));
+    EXPECT_EQ(1, inference.getAddressSpace(getValue(helper, "q")));
+
+    // we updated the type of x to match
+    EXPECT_EQ(1, (int)cast<PointerType>(getValue(kernel, "x")->getType())->getAddressSpace());
+}
+
+TEST(test_address_space_inference, globals) {
+    Function *kernel = getFunction("globals");
+    AddressSpaceInference inference;
+    inference.run(getM(), kernel);
+
+    // only __constant__ variables with initializers go in the constants buffer
+    EXPECT_EQ(4, inference.getAddressSpace(getValue(kernel, "c1")));
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(kernel, "e1")));
+    EXPECT_EQ(-1, inference.getAddressSpace(getValue(kernel, "d1")));
+}
+
+} // namespace test_address_space_inference
@@ -0,0 +1,50 @@
+%struct.S = type { float*, float** }
+@sh = internal addrspace(3) global [8 x float] zeroinitializer, align 4
+@cst = internal addrspace(4) global [4 x float] [float 1.0, float 2.0, float 3.0, float 4.0], align 4
+@ext = external addrspace(4) global [4 x float], align 4
+@dev = internal addrspace(1) global [4 x float] zeroinitializer, align 4
+
+define float @helper(float* %p, float* %q) {
+  %1 = load float, float* %p
+  %2 = getelementptr float, float* %q, i32 1
+  %3 = load float, float* %2
+  %4 = fadd float %1, %3
+  ret float %4
+}
+
+define void @k(float* %a, float** %pp, i1 %c) {
+entry:
+  %arr = alloca [2 x float*]
+  %s = alloca %struct.S
+  %e0 = getelementptr [2 x float*], [2 x float*]* %arr, i32 0, i32 0
+  store float* %a, float** %e0
+  %sh0 = getelementptr [8 x float], [8 x float]* addrspacecast ([8 x float] addrspace(3)* @sh to [8 x float]*), i32 0, i32 0
+  %f0 = getelementptr %struct.S, %struct.S* %s, i32 0, i32 0
+  store float* %a, float** %f0
+  %f1 = getelementptr %struct.S, %struct.S* %s, i32 0, i32 1
+  store float** %pp, float*** %f1
+  br i1 %c, label %l1, label %l2
+l1:
+  %x = load float*, float** %e0
+  br label %l2
+l2:
+  %p = phi float* [ %a, %entry ], [ %x, %l1 ]
+  %y = load float**, float*** %f1
+  %z = load float*, float** %y
+  %r = call float @helper(float* %p, float* %a)
+  %r2 = call float @helper(float* %sh0, float* %a)
+  ret void
+}
+
+define void @globals(float* %out) {
+  %c1 = getelementptr [4 x float], [4 x float]* addrspacecast ([4 x float] addrspace(4)* @cst to [4 x float]*), i32 0, i32 1
+  %e1 = getelementptr [4 x float], [4 x float]* addrspacecast ([4 x float] addrspace(4)* @ext to [4 x float]*), i32 0, i32 1
+  %d1 = getelementptr [4 x float], [4 x float]* addrspacecast ([4 x float] addrspace(1)* @dev to [4 x float]*), i32 0, i32 1
+  %1 = load float, float* %c1
+  %2 = load float, float* %e1
+  %3 = load float, float* %d1
+  %4 = fadd float %1, %2
+  %5 = fadd float %4, %3
+  store float %5, float* %out
+  ret void
+}
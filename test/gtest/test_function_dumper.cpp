@@ -17,6 +17,8 @@
 #include "cocl/type_dumper.h"
 #include "cocl/GlobalNames.h"
 #include "cocl/LocalNames.h"
+#include "cocl/vector_accesses.h"
+#include "cocl/address_space_inference.h"
 
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/IR/Module.h"
@@ -130,7 +132,7 @@ TEST(test_function_dumper, basic1) {
     os.str("");
     functionDumper->toCl(os);
     cout << "cl: [" << os.str() << "]" << endl;
-    EXPECT_EQ(R"(kernel void someKernel(global char* clmem0, unsigned long clmem_vmem_offset0, global char* clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
+    EXPECT_EQ(R"(kernel void someKernel(global char* restrict clmem0, unsigned long clmem_vmem_offset0, global char* restrict clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
     global float* d2 = (global float*)(clmem1 + d2_offset);
     global float* d1 = (global float*)(clmem0 + d1_offset);
 
@@ -173,7 +175,7 @@ TEST(test_function_dumper, basic1Ints) {
     os.str("");
     functionDumper->toCl(os);
     cout << "cl: [" << os.str() << "]" << endl;
-    EXPECT_EQ(R"(kernel void someKernelInts(global char* clmem0, unsigned long clmem_vmem_offset0, global char* clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
+    EXPECT_EQ(R"(kernel void someKernelInts(global char* restrict clmem0, unsigned long clmem_vmem_offset0, global char* restrict clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
     global int* d2 = (global int*)(clmem1 + d2_offset);
     global int* d1 = (global int*)(clmem0 + d1_offset);
 
@@ -663,4 +665,255 @@ v2:;
 )", os.str());
 }
 
+TEST(test_function_dumper, structuredLoop) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    LocalWrapper wrapper(G, "multigpu_Z8getValuePf", 1, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+    functionDumper->setStructuredControlFlow(true);
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    cout << "cl [" << os.str() << "]" << endl;
+    EXPECT_EQ(R"(kernel void multigpu_Z8getValuePf(global char* clmem0, unsigned long clmem_vmem_offset0, uint outdata_offset, local int *scratch) {
+    global float* outdata = (global float*)(clmem0 + outdata_offset);
+
+    const struct GlobalVars globalVars = { scratch, clmem0, clmem_vmem_offset0 };
+    const struct GlobalVars* const pGlobalVars = &globalVars;
+
+    float v10;
+    float v15;
+    float v21;
+    float v22;
+    float v27;
+    float v7;
+    int v23;
+    int v5;
+
+    v5 = 1;
+    v7 = 0.0f;
+    while(1) {
+        v10 = (&(outdata[(long)v5]))[0];
+        v15 = (&(outdata[(long)(v5 + 1)]))[0];
+        v21 = (&(outdata[(long)(v5 + 2)]))[0];
+        v22 = ((v7 + v10) + v15) + v21;
+        v23 = v5 + 3;
+        if ((v23) == (1024)) {
+            v27 = v22;
+            outdata[0] = v27;
+            return;
+        } else {
+            v5 = v23;
+            v7 = v22;
+            continue;
+        }
+    }
+}
+)", os.str());
+}
+
+TEST(test_function_dumper, structuredLoopCoalesced) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    LocalWrapper wrapper(G, "multigpu_Z8getValuePf", 1, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+    functionDumper->setStructuredControlFlow(true);
+    functionDumper->setCoalesceVariables(true);
+    functionDumper->setNarrowDeclarations(true);
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    cout << "cl [" << os.str() << "]" << endl;
+    // the phis share a variable with their incoming values, so there are no copies left, and the loads, which
+    // arent needed from one iteration to the next, are declared inside the loop
+    EXPECT_EQ(R"(kernel void multigpu_Z8getValuePf(global char* clmem0, unsigned long clmem_vmem_offset0, uint outdata_offset, local int *scratch) {
+    global float* outdata = (global float*)(clmem0 + outdata_offset);
+
+    const struct GlobalVars globalVars = { scratch, clmem0, clmem_vmem_offset0 };
+    const struct GlobalVars* const pGlobalVars = &globalVars;
+
+    float v27;
+    int v5;
+
+    v5 = 1;
+    v27 = 0.0f;
+    while(1) {
+        float v10;
+        float v15;
+        float v21;
+        v10 = (&(outdata[(long)v5]))[0];
+        v15 = (&(outdata[(long)(v5 + 1)]))[0];
+        v21 = (&(outdata[(long)(v5 + 2)]))[0];
+        v27 = ((v27 + v10) + v15) + v21;
+        v5 = v5 + 3;
+        if ((v5) == (1024)) {
+            outdata[0] = v27;
+            return;
+        } else {
+            continue;
+        }
+    }
+}
+)", os.str());
+}
+
+TEST(test_function_dumper, structuredIfElse) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    LocalWrapper wrapper(G, "testBranches_ifelse", 1, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+    functionDumper->setStructuredControlFlow(true);
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    string cl = os.str();
+    cout << "cl [" << cl << "]" << endl;
+    // both sides of the if fall through to the merge block, which is written once, after the if
+    EXPECT_EQ(string::npos, cl.find("goto"));
+    EXPECT_EQ(string::npos, cl.find(":;"));
+    EXPECT_NE(string::npos, cl.find("    } else {\n"));
+    size_t endIf = cl.find("    }\n");
+    size_t store = cl.find("d1[0] = ");
+    EXPECT_NE(string::npos, store);
+    EXPECT_LT(endIf, store);
+    EXPECT_EQ(store, cl.rfind("d1[0] = "));
+}
+
+TEST(test_function_dumper, barrierSharedOnly) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    LocalWrapper wrapper(G, "barrierSharedOnly", 1, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    cout << "cl: [" << os.str() << "]" << endl;
+    EXPECT_NE(string::npos, os.str().find("barrier(CLK_LOCAL_MEM_FENCE);"));
+    EXPECT_EQ(string::npos, os.str().find("CLK_GLOBAL_MEM_FENCE"));
+}
+
+TEST(test_function_dumper, barrierAfterGlobal) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    LocalWrapper wrapper(G, "barrierAfterGlobal", 1, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    cout << "cl: [" << os.str() << "]" << endl;
+    // the first barrier follows a global store, the second only follows a shared load
+    string cl = os.str();
+    size_t globalFence = cl.find("barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);");
+    size_t localFence = cl.find("barrier(CLK_LOCAL_MEM_FENCE);");
+    EXPECT_NE(string::npos, globalFence);
+    EXPECT_NE(string::npos, localFence);
+    EXPECT_LT(globalFence, localFence);
+}
+
+TEST(test_function_dumper, readOnlyParams) {
+    GlobalWrapper G;
+    vector<int> c;
+    // out is in clmem1; the other clmems are only read
+    c.push_back(1);
+    c.push_back(2);
+    c.push_back(0);
+    LocalWrapper wrapper(G, "readOnlyParams", 3, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    cout << "cl: [" << os.str() << "]" << endl;
+    EXPECT_NE(string::npos, os.str().find("kernel void readOnlyParams(global char* restrict clmem0, unsigned long clmem_vmem_offset0, "
+        "global char* restrict clmem1, unsigned long clmem_vmem_offset1, "
+        "global char* restrict clmem2, unsigned long clmem_vmem_offset2, "));
+    // launch fusion relies on knowing which clmems the kernel writes
+    EXPECT_EQ(1u, functionDumper->writtenClmems.count(1));
+    EXPECT_EQ(0u, functionDumper->writtenClmems.count(2));
+    EXPECT_EQ(0u, functionDumper->writtenClmems.count(0));
+}
+
+TEST(test_function_dumper, float4Fields) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    c.push_back(1);
+    LocalWrapper wrapper(G, "float4Fields", 2, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+
+    // the four scalar loads and four scalar stores should become one vload4, and one vstore4, once we
+    // know in and out are global
+    AddressSpaceInference().run(G.M.get(), wrapper.F);
+    EXPECT_TRUE(combineVectorAccesses(wrapper.F));
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    string cl = os.str();
+    cout << "cl: [" << cl << "]" << endl;
+    EXPECT_NE(string::npos, cl.find("vload4(0, (global float*)"));
+    EXPECT_NE(string::npos, cl.find("vstore4("));
+    EXPECT_EQ(string::npos, cl.find("[0] = "));
+}
+
+TEST(test_function_dumper, float4FieldsUnknownSpace) {
+    GlobalWrapper G;
+    vector<int> c;
+    c.push_back(0);
+    c.push_back(1);
+    LocalWrapper wrapper(G, "float4Fields", 2, c);
+
+    // without address spaces, the pointers might be vmem, so leave the accesses alone
+    EXPECT_FALSE(combineVectorAccesses(wrapper.F));
+}
+
+TEST(test_function_dumper, textures) {
+    GlobalWrapper G;
+    vector<int> c;
+    // the linear texture is in clmem1, and out in clmem0.  The image texture doesnt use a clmem
+    c.push_back(1);
+    c.push_back(0);
+    LocalWrapper wrapper(G, "textures", 2, c);
+    FunctionDumper *functionDumper = &wrapper.functionDumper;
+
+    bool res = wrapper.runGeneration();
+    EXPECT_TRUE(res);
+
+    ostringstream os;
+    functionDumper->toCl(os);
+    string cl = os.str();
+    cout << "cl: [" << cl << "]" << endl;
+    EXPECT_NE(string::npos, cl.find("global char* restrict clmem1, unsigned long clmem_vmem_offset1, "));
+    EXPECT_NE(string::npos, cl.find("linear_offset, read_only image2d_t image, sampler_t image_sampler, "));
+    EXPECT_NE(string::npos, cl.find("(global char*)(clmem1 + linear_offset)"));
+    EXPECT_NE(string::npos, cl.find("read_imagef(image, image_sampler, (float2)(1.5f, "));
+    // which the host checks it passed the textures as
+    ASSERT_EQ(2u, functionDumper->textureArgIsImage.size());
+    EXPECT_FALSE(functionDumper->textureArgIsImage[0]);
+    EXPECT_TRUE(functionDumper->textureArgIsImage[1]);
+}
+
 } // namespace
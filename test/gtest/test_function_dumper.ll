@@ -113,6 +113,26 @@ label3:
     br label %label2
 }
 
+define void @testBranches_ifelse(float *%d1) {
+entry:
+    %0 = load float, float *%d1
+    %1 = fcmp ogt float %0, 0.0
+    br i1 %1, label %iftrue, label %iffalse
+
+iftrue:
+    %2 = fmul float %0, 2.0
+    br label %merge
+
+iffalse:
+    %3 = fadd float %0, 1.0
+    br label %merge
+
+merge:
+    %4 = phi float [%2, %iftrue], [%3, %iffalse]
+    store float %4, float *%d1
+    ret void
+}
+
 ; from test/cocl/multigpu.cu
 define void @multigpu_Z8getValuePf(float* nocapture %outdata) {
   br label %2
@@ -143,3 +163,69 @@ define void @multigpu_Z8getValuePf(float* nocapture %outdata) {
   %exitcond.2 = icmp eq i32 %17, 1024
   br i1 %exitcond.2, label %1, label %2
 }
+
+declare void @llvm.nvvm.barrier0()
+
+define void @barrierSharedOnly(float *%d1) {
+    %1 = getelementptr inbounds [8 x float], [8 x float]* addrspacecast ([8 x float] addrspace(3) *@mysharedmem to [8 x float]*), i32 0, i32 3
+    store float 1.0, float *%1
+    call void @llvm.nvvm.barrier0()
+    %2 = load float, float *%1
+    store float %2, float *%d1
+    ret void
+}
+
+define void @barrierAfterGlobal(float *%d1) {
+    %1 = getelementptr inbounds [8 x float], [8 x float]* addrspacecast ([8 x float] addrspace(3) *@mysharedmem to [8 x float]*), i32 0, i32 3
+    store float 1.0, float *%d1
+    call void @llvm.nvvm.barrier0()
+    %2 = load float, float *%1
+    call void @llvm.nvvm.barrier0()
+    store float %2, float *%1
+    ret void
+}
+
+%struct.float4 = type { float, float, float, float }
+
+define void @float4Fields(%struct.float4 *%in, %struct.float4 *%out) {
+    %1 = getelementptr inbounds %struct.float4, %struct.float4* %in, i64 3, i32 0
+    %2 = load float, float* %1, align 16
+    %3 = getelementptr inbounds %struct.float4, %struct.float4* %in, i64 3, i32 1
+    %4 = load float, float* %3, align 4
+    %5 = getelementptr inbounds %struct.float4, %struct.float4* %in, i64 3, i32 2
+    %6 = load float, float* %5, align 8
+    %7 = getelementptr inbounds %struct.float4, %struct.float4* %in, i64 3, i32 3
+    %8 = load float, float* %7, align 4
+    %9 = fadd float %2, %8
+    %10 = getelementptr inbounds %struct.float4, %struct.float4* %out, i64 2, i32 0
+    store float %9, float* %10, align 16
+    %11 = getelementptr inbounds %struct.float4, %struct.float4* %out, i64 2, i32 1
+    store float %4, float* %11, align 4
+    %12 = getelementptr inbounds %struct.float4, %struct.float4* %out, i64 2, i32 2
+    store float %6, float* %12, align 8
+    %13 = getelementptr inbounds %struct.float4, %struct.float4* %out, i64 2, i32 3
+    store float %8, float* %13, align 4
+    ret void
+}
+
+define void @readOnlyParams(float *%out, float *%in, float *%alsoIn) {
+    %1 = load float, float *%in
+    %2 = load float, float *%alsoIn
+    %3 = fadd float %1, %2
+    store float %3, float *%out
+    ret void
+}
+
+%struct.CoclTexture = type opaque
+
+declare i8* @__cocl_texture_linear(%struct.CoclTexture *)
+declare float @__cocl_tex2D_float(%struct.CoclTexture *, float, float)
+
+define void @textures(%struct.CoclTexture *%linear, %struct.CoclTexture *%image, float *%out) {
+    %1 = call i8* @__cocl_texture_linear(%struct.CoclTexture *%linear)
+    %2 = bitcast i8* %1 to float*
+    %3 = load float, float *%2
+    %4 = call float @__cocl_tex2D_float(%struct.CoclTexture *%image, float 1.5, float %3)
+    store float %4, float *%out
+    ret void
+}
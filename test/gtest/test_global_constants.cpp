@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include "cocl/basicblockdumper.h"
+#include "cocl/GlobalConstants.h"
+#include "cocl/kernel_dumper.h"
 
 #include "cocl/type_dumper.h"
 #include "cocl/GlobalNames.h"
@@ -26,6 +28,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <iostream>
+#include <cstring>
 
 #include "gtest/gtest.h"
 
@@ -35,6 +38,57 @@ using namespace llvm;
 
 namespace {
 
+string constants_ll_path = CMAKE_CURRENT_SOURCE_DIR "/test_global_constants.ll";
+
+unique_ptr<Module> readConstantsModule(LLVMContext *context) {
+    SMDiagnostic smDiagnostic;
+    unique_ptr<Module> M = parseIRFile(constants_ll_path, smDiagnostic, *context);
+    if(!M) {
+        smDiagnostic.print("irtopencl", errs());
+        throw runtime_error("failed to parse IR");
+    }
+    return M;
+}
+
+TEST(test_global_constants, layout) {
+    LLVMContext context;
+    unique_ptr<Module> M = readConstantsModule(&context);
+    GlobalConstants globalConstants(M.get());
+
+    EXPECT_FALSE(globalConstants.empty());
+    EXPECT_EQ(0, globalConstants.getOffset(M->getNamedGlobal("myglobal")));
+    EXPECT_EQ(4, globalConstants.getOffset(M->getNamedGlobal("weights")));
+    EXPECT_EQ(20, globalConstants.getOffset(M->getNamedGlobal("scale")));
+    EXPECT_EQ(24, globalConstants.getSize());
+    EXPECT_EQ(20, globalConstants.getOffsetByName()["scale"]);
+
+    string image = globalConstants.getImage();
+    ASSERT_EQ(24u, image.size());
+    int32_t myint;
+    memcpy(&myint, &image[0], 4);
+    EXPECT_EQ(1234, myint);
+    float weights[4];
+    memcpy(weights, &image[4], 16);
+    EXPECT_EQ(3.0f, weights[2]);
+    float scale;
+    memcpy(&scale, &image[20], 4);
+    EXPECT_EQ(0.5f, scale);
+}
+
+TEST(test_global_constants, kernelReadsConstantsBuffer) {
+    LLVMContext context;
+    unique_ptr<Module> M = readConstantsModule(&context);
+    KernelDumper kernelDumper(M.get(), "useScale", "useScale", true);
+    vector<int> clmemIndexByClmemArgIndex;
+    clmemIndexByClmemArgIndex.push_back(0);
+    string cl = kernelDumper.toCl(1, clmemIndexByClmemArgIndex);
+    cout << "cl: [" << cl << "]" << endl;
+    EXPECT_NE(string::npos, cl.find("    constant char *constants;\n"));
+    EXPECT_NE(string::npos, cl.find("uint out_offset, constant char *constants, local int *scratch)"));
+    EXPECT_NE(string::npos, cl.find("globalVars = { scratch, clmem0, clmem_vmem_offset0, constants };"));
+    EXPECT_NE(string::npos, cl.find("((constant float*)(pGlobalVars->constants + 20))[0]"));
+}
+
 // LLVMContext context;
 // unique_ptr<Module>M;
 
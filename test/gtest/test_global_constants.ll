@@ -11,3 +11,12 @@ define void @test_union(float* nocapture %data) {
   %1 = load float, float* addrspacecast (float addrspace(4)* bitcast (%"struct.firsttype" addrspace(4)* @myglobal to float addrspace(4)*) to float*)
   ret void
 }
+
+@weights = addrspace(4) externally_initialized global [4 x float] [float 1.0, float 2.0, float 3.0, float 4.0], align 4
+@scale = addrspace(4) externally_initialized global float 5.0e-01, align 4
+
+define void @useScale(float* %out) {
+  %1 = load float, float addrspace(4)* @scale
+  store float %1, float* %out
+  ret void
+}
@@ -0,0 +1,147 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/index_demotion.h"
+
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace cocl;
+using namespace llvm;
+
+namespace test_index_demotion {
+
+LLVMContext context;
+unique_ptr<Module>M;
+
+string ll_path = CMAKE_CURRENT_SOURCE_DIR "/test_index_demotion.ll";
+
+Module *getM() {
+    if(M == nullptr) {
+        SMDiagnostic smDiagnostic;
+        M = parseIRFile(StringRef(ll_path), smDiagnostic, context);
+        if(!M) {
+            smDiagnostic.print("irtopencl", errs());
+            throw runtime_error("failed to parse IR");
+        }
+    }
+    return M.get();
+}
+
+Function *getFunction(string name) {
+    Function *F = getM()->getFunction(StringRef(name));
+    if(F == 0) {
+        throw runtime_error("Function " + name + " not found");
+    }
+    return F;
+}
+
+Instruction *getInstruction(Function *F, string name) {
+    for(auto &block : *F) {
+        for(auto &instr : block) {
+            if(instr.getName() == name) {
+                return &instr;
+            }
+        }
+    }
+    throw runtime_error("Instruction " + name + " not found");
+}
+
+// the 32-bit instruction that name is now the sign extension of, or 0 if it wasnt demoted
+Instruction *getDemoted(Function *F, string name) {
+    SExtInst *sext = dyn_cast<SExtInst>(getInstruction(F, name));
+    if(sext == 0) {
+        return 0;
+    }
+    return dyn_cast<Instruction>(sext->getOperand(0));
+}
+
+TEST(test_index_demotion, ranges) {
+    IntRange full32 = IntRange::full(32);
+    EXPECT_EQ(-2147483648LL, full32.lo);
+    EXPECT_EQ(2147483647LL, full32.hi);
+    EXPECT_TRUE(IntRange(-5, 1000).fitsIn(32));
+    EXPECT_FALSE(IntRange(0, 2147483648LL).fitsIn(32));
+    EXPECT_EQ(3, IntRange(0, 3).intersect(IntRange(-1, 10)).hi);
+    EXPECT_EQ(-1, IntRange(0, 3).unite(IntRange(-1, 10)).lo);
+}
+
+TEST(test_index_demotion, guarded) {
+    Function *F = getFunction("guarded");
+    IndexDemotion demotion;
+    EXPECT_EQ(1, demotion.run(F));
+    Instruction *next = getDemoted(F, "next");
+    ASSERT_TRUE(next != 0);
+    EXPECT_EQ(Instruction::Add, (int)next->getOpcode());
+    EXPECT_TRUE(next->getType()->isIntegerTy(32));
+    EXPECT_EQ("i", next->getOperand(0)->getName().str());
+}
+
+TEST(test_index_demotion, unguarded) {
+    Function *F = getFunction("unguarded");
+    IndexDemotion demotion;
+    EXPECT_EQ(0, demotion.run(F));
+    EXPECT_TRUE(getInstruction(F, "next")->getType()->isIntegerTy(64));
+    EXPECT_EQ(Instruction::Add, (int)getInstruction(F, "next")->getOpcode());
+}
+
+TEST(test_index_demotion, threadIndex) {
+    Function *F = getFunction("threadIndex");
+    IndexDemotion demotion;
+    EXPECT_EQ(3, demotion.run(F));
+    // the shl is demoted first, then the add of it
+    Instruction *offset = getDemoted(F, "offset");
+    ASSERT_TRUE(offset != 0);
+    EXPECT_EQ(Instruction::Add, (int)offset->getOpcode());
+    EXPECT_EQ(Instruction::Shl, (int)cast<Instruction>(offset->getOperand(0))->getOpcode());
+    EXPECT_EQ("tid", cast<Instruction>(offset->getOperand(0))->getOperand(0)->getName().str());
+    ICmpInst *less = cast<ICmpInst>(getInstruction(F, "less"));
+    EXPECT_TRUE(less->getOperand(0)->getType()->isIntegerTy(32));
+    EXPECT_EQ("a", less->getOperand(0)->getName().str());
+    EXPECT_EQ(4095, demotion.getRange(getInstruction(F, "offset"), &F->getEntryBlock()).hi);
+}
+
+TEST(test_index_demotion, launchBounds) {
+    Function *F = getFunction("guarded");
+    LaunchBounds bounds;
+    bounds.block[0] = 64;
+    IndexDemotion demotion(bounds);
+    demotion.run(F);
+    Instruction *tid = getInstruction(F, "tid");
+    EXPECT_EQ(0, demotion.getRange(tid, tid->getParent()).lo);
+    EXPECT_EQ(63, demotion.getRange(tid, tid->getParent()).hi);
+}
+
+TEST(test_index_demotion, product) {
+    Function *F = getFunction("product");
+    IndexDemotion demotion;
+    EXPECT_EQ(1, demotion.run(F));
+    Instruction *offset = getDemoted(F, "offset");
+    ASSERT_TRUE(offset != 0);
+    EXPECT_EQ(Instruction::Mul, (int)offset->getOpcode());
+    IntRange range = demotion.getRange(getInstruction(F, "offset"), offset->getParent());
+    EXPECT_EQ(1000 * 4095, range.hi);
+}
+
+} // namespace test_index_demotion
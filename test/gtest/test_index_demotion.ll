@@ -0,0 +1,70 @@
+declare i32 @llvm.nvvm.read.ptx.sreg.tid.x()
+declare i32 @llvm.nvvm.read.ptx.sreg.ctaid.x()
+declare i32 @llvm.nvvm.read.ptx.sreg.ntid.x()
+
+; out[i + 1] = in[i + 1], guarded by i < n
+define void @guarded(float* %in, float* %out, i32 %n) {
+entry:
+  %tid = call i32 @llvm.nvvm.read.ptx.sreg.tid.x()
+  %ctaid = call i32 @llvm.nvvm.read.ptx.sreg.ctaid.x()
+  %ntid = call i32 @llvm.nvvm.read.ptx.sreg.ntid.x()
+  %mul = mul i32 %ctaid, %ntid
+  %i = add i32 %mul, %tid
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %then, label %end
+then:
+  %idx = sext i32 %i to i64
+  %next = add nsw i64 %idx, 1
+  %p = getelementptr inbounds float, float* %in, i64 %next
+  %v = load float, float* %p
+  %q = getelementptr inbounds float, float* %out, i64 %next
+  store float %v, float* %q
+  br label %end
+end:
+  ret void
+}
+
+; the same, without the guard, so i + 1 might overflow
+define void @unguarded(float* %in, i32 %i) {
+entry:
+  %idx = sext i32 %i to i64
+  %next = add nsw i64 %idx, 1
+  %p = getelementptr inbounds float, float* %in, i64 %next
+  store float 0.0, float* %p
+  ret void
+}
+
+; threadIdx.x * 4 + 3, and a compare of sign extended values
+define void @threadIndex(float* %in, i32 %a, i32 %b) {
+entry:
+  %tid = call i32 @llvm.nvvm.read.ptx.sreg.tid.x()
+  %tid64 = zext i32 %tid to i64
+  %scaled = shl i64 %tid64, 2
+  %offset = add i64 %scaled, 3
+  %p = getelementptr inbounds float, float* %in, i64 %offset
+  %a64 = sext i32 %a to i64
+  %b64 = sext i32 %b to i64
+  %less = icmp slt i64 %a64, %b64
+  %v = select i1 %less, float 1.0, float 2.0
+  store float %v, float* %p
+  ret void
+}
+
+; row * width, with both bounded by the else branch of a compare
+define void @product(float* %in, i32 %row, i32 %width) {
+entry:
+  %badRow = icmp ugt i32 %row, 1000
+  br i1 %badRow, label %end, label %checkWidth
+checkWidth:
+  %badWidth = icmp uge i32 %width, 4096
+  br i1 %badWidth, label %end, label %body
+body:
+  %row64 = sext i32 %row to i64
+  %width64 = sext i32 %width to i64
+  %offset = mul nsw i64 %row64, %width64
+  %p = getelementptr inbounds float, float* %in, i64 %offset
+  store float 0.0, float* %p
+  br label %end
+end:
+  ret void
+}
@@ -101,9 +101,9 @@ inline global float *getGlobalPointer(__vmem__ unsigned long vmemloc, const stru
 float someFunc_gg(global float* d1, global float* v11, const struct GlobalVars *const pGlobalVars);
 float someFunc_gp(global float* d1, float* v11, const struct GlobalVars *const pGlobalVars);
 float someFunc_pg(float* d1, global float* v11, const struct GlobalVars *const pGlobalVars);
-kernel void someKernel(global char* clmem0, unsigned long clmem_vmem_offset0, global char* clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch);
+kernel void someKernel(global char* restrict clmem0, unsigned long clmem_vmem_offset0, global char* restrict clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch);
 
-kernel void someKernel(global char* clmem0, unsigned long clmem_vmem_offset0, global char* clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
+kernel void someKernel(global char* restrict clmem0, unsigned long clmem_vmem_offset0, global char* restrict clmem1, unsigned long clmem_vmem_offset1, uint d1_offset, uint d2_offset, local int *scratch) {
     global float* d2 = (global float*)(clmem1 + d2_offset);
     global float* d1 = (global float*)(clmem0 + d1_offset);
 
@@ -116,7 +116,6 @@ kernel void someKernel(global char* clmem0, unsigned long clmem_vmem_offset0, gl
     float* v2[1];
     float* v3;
 
-v1:;
     v3 = v2[0];
     v4 = someFunc_gp(d1, v3, pGlobalVars);
     v5 = someFunc_pg(v3, d1, pGlobalVars);
@@ -127,7 +126,6 @@ float someFunc_gg(global float* d1, global float* v11, const struct GlobalVars *
     float v5;
     global float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -137,7 +135,6 @@ float someFunc_gp(global float* d1, float* v11, const struct GlobalVars *const p
     float v5;
     global float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -147,7 +144,6 @@ float someFunc_pg(float* d1, global float* v11, const struct GlobalVars *const p
     float v5;
     float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -202,7 +198,6 @@ kernel void someKernel(global char* clmem0, unsigned long clmem_vmem_offset0, ui
     float* v2[1];
     float* v3;
 
-v1:;
     v3 = v2[0];
     v4 = someFunc_gp(d1, v3, pGlobalVars);
     v5 = someFunc_pg(v3, d1, pGlobalVars);
@@ -213,7 +208,6 @@ float someFunc_gg(global float* d1, global float* v11, const struct GlobalVars *
     float v5;
     global float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -223,7 +217,6 @@ float someFunc_gp(global float* d1, float* v11, const struct GlobalVars *const p
     float v5;
     global float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -233,7 +226,6 @@ float someFunc_pg(float* d1, global float* v11, const struct GlobalVars *const p
     float v5;
     float* v6;
 
-v1:;
     v5 = d1[0];
     v6 = (&(d1[3]));
     v6[0] = v5;
@@ -276,27 +268,20 @@ kernel void testBranches_phifromfuture(global char* clmem0, unsigned long clmem_
     const struct GlobalVars globalVars = { scratch, clmem0, clmem_vmem_offset0 };
     const struct GlobalVars* const pGlobalVars = &globalVars;
 
-    float v12;
     float v4;
-    float v7;
-    float v8;
 
 v1:;
-    v4 = 3.0f + 4.0f;
-    v7 = v4;
-    goto v2;
-v2:;
-    v8 = v7 + 7.0f;
-    if (v8 > 6.0f) {
-        goto v1;
-    } else {
-        v7 = v8;
-        goto v2;
+    while(1) {
+        v4 = 3.0f + 4.0f;
+        while(1) {
+            v4 = v4 + 7.0f;
+            if (v4 > 6.0f) {
+                goto v1;
+            } else {
+                continue;
+            }
+        }
     }
-v3:;
-    v12 = 8.0f + 2.0f;
-    v7 = v12;
-    goto v2;
 }
 )", cl);
 
@@ -334,12 +319,10 @@ kernel void usesPointerFunction(global char* clmem0, unsigned long clmem_vmem_of
 
 global float* returnsPointer_g(global float* in, const struct GlobalVars *const pGlobalVars) {
 
-v1:;
     return in;
 }
 float* returnsPointer(float* in, const struct GlobalVars *const pGlobalVars) {
 
-v1:;
     return in;
 }
 kernel void usesPointerFunction(global char* clmem0, unsigned long clmem_vmem_offset0, uint in_offset, local int *scratch) {
@@ -352,7 +335,6 @@ kernel void usesPointerFunction(global char* clmem0, unsigned long clmem_vmem_of
     float* v4;
     global float* v2;
 
-v1:;
     v2 = returnsPointer_g(in, pGlobalVars);
     v4 = returnsPointer(v3, pGlobalVars);
     return;
@@ -399,13 +381,11 @@ kernel void usesFunctionReturningVoid(global char* clmem0, unsigned long clmem_v
     const struct GlobalVars* const pGlobalVars = &globalVars;
 
 
-v1:;
     returnsVoid_g(in, pGlobalVars);
     return;
 }
 void returnsVoid_g(global float* in, const struct GlobalVars *const pGlobalVars) {
 
-v1:;
     in[0] = 3.0f;
     return;
 }
@@ -456,7 +436,6 @@ kernel void test_randomintarray(global char* clmem0, unsigned long clmem_vmem_of
     struct class_tensorflow__random__Array v2[1];
     struct class_tensorflow__random__Array v3;
 
-v1:;
     v3 = v2[0];
     v4 = v3.f0;
     v9 = (v4[0] + v4[1]) + v4[2];
@@ -468,6 +447,107 @@ v1:;
     EXPECT_FALSE(cl.find(" = returnsVoid") != string::npos);
 }
 
+TEST(test_kernel_dumper, test_half) {
+    GlobalWrapper G("test_half");
+    KernelDumper *kernelDumper = G.kernelDumper.get();
+
+    string cl = runKernelDumper(kernelDumper, 3);
+    cout << "kernel cl: [" << cl << "]" << endl;
+
+    // halfs are only stored as halfs if the device doesnt have cl_khr_fp16, so they go via vload_half
+    EXPECT_TRUE(cl.find("#if defined(cl_khr_fp16)") != string::npos);
+    EXPECT_TRUE(cl.find("typedef half cocl_half;") != string::npos);
+    EXPECT_TRUE(cl.find("typedef float cocl_half;") != string::npos);
+    EXPECT_TRUE(cl.find("cocl_vload_half(0, (global half*)") != string::npos);
+    EXPECT_TRUE(cl.find("cocl_vstore_half(") != string::npos);
+    EXPECT_TRUE(cl.find("cocl_vload_half2(0, (global half*)") != string::npos);
+    EXPECT_TRUE(cl.find("cocl_vstore_half2(") != string::npos);
+    EXPECT_TRUE(cl.find("((cocl_half)1.0f)") != string::npos);
+}
+
+TEST(test_kernel_dumper, test_specialize) {
+    GlobalWrapper G("test_specialize");
+    KernelDumper *kernelDumper = G.kernelDumper.get();
+    // launch arg 0 is the offset for data, and 1 is n
+    KernelSpecialization specialization;
+    specialization.int32ValueByArgIndex[1] = 100;
+    specialization.specializeBlock = true;
+    specialization.block[0] = 64;
+    specialization.block[1] = 1;
+    specialization.block[2] = 1;
+    kernelDumper->setSpecialization(specialization);
+
+    string cl = runKernelDumper(kernelDumper, 1);
+    cout << "kernel cl: [" << cl << "]" << endl;
+
+    EXPECT_TRUE(cl.find("kernel __attribute__((reqd_work_group_size(64, 1, 1))) void test_specialize(") != string::npos);
+    // n is still declared, so the launch args stay the same, but isnt used
+    EXPECT_TRUE(cl.find(", int n, ") != string::npos);
+    EXPECT_TRUE(cl.find(" * 100") != string::npos);
+    EXPECT_FALSE(cl.find(" * n") != string::npos);
+    EXPECT_FALSE(cl.find("get_local_size") != string::npos);
+}
+
+TEST(test_kernel_dumper, test_work_group_size) {
+    GlobalWrapper G("test_specialize");
+    KernelDumper *kernelDumper = G.kernelDumper.get();
+    KernelSpecialization specialization;
+    specialization.workGroupSizeAttribute = "reqd_work_group_size";
+    specialization.block[0] = 64;
+    specialization.block[1] = 1;
+    specialization.block[2] = 1;
+    kernelDumper->setSpecialization(specialization);
+
+    string cl = runKernelDumper(kernelDumper, 1);
+    cout << "kernel cl: [" << cl << "]" << endl;
+
+    EXPECT_TRUE(cl.find("kernel __attribute__((reqd_work_group_size(64, 1, 1))) void test_specialize(") != string::npos);
+    // only the attribute; n and blockDim are still read at runtime
+    EXPECT_TRUE(cl.find(" * n") != string::npos);
+    EXPECT_TRUE(cl.find("get_local_size(0)") != string::npos);
+}
+
+TEST(test_kernel_dumper, test_fused) {
+    GlobalWrapper G("test_fused");
+    KernelDumper *kernelDumper = G.kernelDumper.get();
+    KernelSpecialization specialization;
+    specialization.workGroupSizeAttribute = "reqd_work_group_size";
+    specialization.block[0] = 64;
+    specialization.block[1] = 1;
+    specialization.block[2] = 1;
+    specialization.fusedLaunches = 2;
+    kernelDumper->setSpecialization(specialization);
+
+    string cl = runKernelDumper(kernelDumper, 1);
+    cout << "kernel cl: [" << cl << "]" << endl;
+
+    // the kernel itself becomes a plain function, reading its group ids from GlobalVars
+    EXPECT_TRUE(cl.find("\nvoid test_fused_launch(") != string::npos);
+    EXPECT_TRUE(cl.find("pGlobalVars->groupId[0]") != string::npos);
+    EXPECT_TRUE(cl.find("pGlobalVars->numGroups[0]") != string::npos);
+    // only the dispatcher calls get_group_id
+    EXPECT_EQ(cl.find("get_group_id("), cl.rfind("get_group_id("));
+    // ... and the dispatcher takes the arguments for both launches
+    EXPECT_TRUE(cl.find("kernel __attribute__((reqd_work_group_size(64, 1, 1))) void test_fused(global char* l0_clmem0, ") != string::npos);
+    EXPECT_TRUE(cl.find("int l1_n, local int *scratch, uint l0_grid0, ") != string::npos);
+    EXPECT_TRUE(cl.find("test_fused_launch(l1_clmem0, ") != string::npos);
+    EXPECT_EQ(1u, kernelDumper->writtenClmems.size());
+}
+
+TEST(test_kernel_dumper, test_member_names) {
+    GlobalWrapper G("test_member_names");
+    KernelDumper *kernelDumper = G.kernelDumper.get();
+
+    string cl = runKernelDumper(kernelDumper, 2);
+    cout << "kernel cl: [" << cl << "]" << endl;
+
+    // s0 is coalesced into a, but the .s0 component of v is not a variable, and keeps its name
+    EXPECT_EQ(string::npos, cl.find("float s0"));
+    EXPECT_TRUE(cl.find("(v).s0") != string::npos);
+    EXPECT_TRUE(cl.find("(v).s1") != string::npos);
+    EXPECT_EQ(string::npos, cl.find("(v).a"));
+}
+
 // TEST(test_kernel_dumper, test_long_conflicting_names) {
 //     GlobalWrapper G("mysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamemysuperlongfunctionnamec");
 //     KernelDumper *kernelDumper = G.kernelDumper.get();
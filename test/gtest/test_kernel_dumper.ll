@@ -82,3 +82,52 @@ define void @test_randomintarray(i32 *%data) {
   store i32 %8, i32* %data
   ret void
 }
+
+define void @test_half(half* %in, <2 x half>* %in2, float* %out) {
+  %1 = load half, half* %in
+  %2 = fadd half %1, 0xH3C00
+  store half %2, half* %in
+  %3 = load <2 x half>, <2 x half>* %in2
+  %4 = fmul <2 x half> %3, %3
+  store <2 x half> %4, <2 x half>* %in2
+  %5 = fpext half %2 to float
+  store float %5, float* %out
+  ret void
+}
+
+declare i32 @llvm.nvvm.read.ptx.sreg.ntid.x()
+declare i32 @llvm.nvvm.read.ptx.sreg.tid.x()
+
+define void @test_specialize(float* %data, i32 %n) {
+  %1 = call i32 @llvm.nvvm.read.ptx.sreg.ntid.x()
+  %2 = call i32 @llvm.nvvm.read.ptx.sreg.tid.x()
+  %3 = mul i32 %2, %n
+  %4 = add i32 %3, %1
+  %5 = getelementptr float, float* %data, i32 %4
+  store float 1.0, float* %5
+  ret void
+}
+
+declare i32 @llvm.nvvm.read.ptx.sreg.ctaid.x()
+declare i32 @llvm.nvvm.read.ptx.sreg.nctaid.x()
+
+define void @test_fused(float* %data, i32 %n) {
+  %1 = call i32 @llvm.nvvm.read.ptx.sreg.ctaid.x()
+  %2 = call i32 @llvm.nvvm.read.ptx.sreg.nctaid.x()
+  %3 = mul i32 %1, %n
+  %4 = add i32 %3, %2
+  %5 = getelementptr float, float* %data, i32 %4
+  store float 1.0, float* %5
+  ret void
+}
+
+define void @test_member_names(<4 x float>* %in, float* %out) {
+  %v = load <4 x float>, <4 x float>* %in
+  %a = extractelement <4 x float> %v, i32 0
+  %1 = fmul float %a, %a
+  store float %1, float* %out
+  %s0 = extractelement <4 x float> %v, i32 1
+  %2 = fadd float %s0, %s0
+  store float %2, float* %out
+  ret void
+}
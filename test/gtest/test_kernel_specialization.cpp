@@ -0,0 +1,161 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/kernel_specialization.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace cocl;
+
+namespace {
+
+const size_t block64[3] = {64, 1, 1};
+const size_t block128[3] = {128, 1, 1};
+
+map<int, int> args(int n) {
+    map<int, int> int32ValueByArgIndex;
+    int32ValueByArgIndex[1] = n;
+    return int32ValueByArgIndex;
+}
+
+TEST(test_kernel_specialization, suffix) {
+    KernelSpecialization specialization;
+    EXPECT_TRUE(specialization.empty());
+    EXPECT_EQ("", specialization.getSuffix());
+    specialization.int32ValueByArgIndex[1] = 128;
+    specialization.int32ValueByArgIndex[3] = -2;
+    specialization.specializeBlock = true;
+    specialization.block[0] = 64;
+    specialization.block[1] = 2;
+    specialization.block[2] = 1;
+    EXPECT_FALSE(specialization.empty());
+    EXPECT_EQ("_s1x128_s3x-2_b64x2x1", specialization.getSuffix());
+}
+
+TEST(test_kernel_specialization, never) {
+    KernelSpecializer specializer("");
+    EXPECT_TRUE(specializer.choose("_Z6kernelPfi", args(10), block64).empty());
+    KernelSpecializer specializer0("0");
+    EXPECT_TRUE(specializer0.choose("_Z6kernelPfi", args(10), block64).empty());
+}
+
+TEST(test_kernel_specialization, all) {
+    KernelSpecializer specializer("all");
+    KernelSpecialization specialization = specializer.choose("_Z6kernelPfi", args(10), block64);
+    EXPECT_EQ("_s1x10_b64x1x1", specialization.getSuffix());
+}
+
+TEST(test_kernel_specialization, listed) {
+    KernelSpecializer specializer("other,kernel");
+    EXPECT_EQ("_s1x10_b64x1x1", specializer.choose("_Z6kernelPfi", args(10), block64).getSuffix());
+    EXPECT_TRUE(specializer.choose("_Z7kernel2Pfi", args(10), block64).empty());
+    EXPECT_TRUE(specializer.choose("_Z3fooPfi", args(10), block64).empty());
+
+    KernelSpecializer mangled("_Z3fooPfi");
+    EXPECT_FALSE(mangled.choose("_Z3fooPfi", args(10), block64).empty());
+    EXPECT_TRUE(mangled.choose("_Z6kernelPfi", args(10), block64).empty());
+}
+
+TEST(test_kernel_specialization, autoStable) {
+    KernelSpecializer specializer("auto");
+    for(int i = 1; i < KernelSpecializer::AutoStableLaunches; i++) {
+        EXPECT_TRUE(specializer.choose("_Z6kernelPfi", args(10), block64).empty());
+    }
+    EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(10), block64).empty());
+
+    // a different block size starts again, but values we already specialised on stay specialised
+    EXPECT_TRUE(specializer.choose("_Z6kernelPfi", args(10), block128).empty());
+    EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(10), block64).empty());
+
+    // kernels are counted separately
+    EXPECT_TRUE(specializer.choose("_Z7kernel2Pfi", args(10), block64).empty());
+}
+
+TEST(test_kernel_specialization, maxSpecializations) {
+    KernelSpecializer specializer("all");
+    for(int i = 0; i < KernelSpecializer::MaxSpecializationsPerKernel; i++) {
+        EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(i), block64).empty());
+    }
+    EXPECT_TRUE(specializer.choose("_Z6kernelPfi", args(1000), block64).empty());
+    EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(0), block64).empty());
+}
+
+TEST(test_kernel_specialization, kernelAttributes) {
+    KernelSpecialization specialization;
+    EXPECT_EQ("", specialization.getKernelAttributes());
+    specialization.block[0] = 32;
+    specialization.block[1] = 4;
+    specialization.block[2] = 1;
+    specialization.workGroupSizeAttribute = "work_group_size_hint";
+    EXPECT_EQ("_h32x4x1", specialization.getSuffix());
+    EXPECT_EQ("__attribute__((work_group_size_hint(32, 4, 1)))", specialization.getKernelAttributes());
+    specialization.specializeBlock = true;
+    EXPECT_EQ("_b32x4x1", specialization.getSuffix());
+    EXPECT_EQ("__attribute__((reqd_work_group_size(32, 4, 1)))", specialization.getKernelAttributes());
+}
+
+TEST(test_kernel_specialization, fusedLaunches) {
+    KernelSpecialization specialization;
+    specialization.fusedLaunches = 3;
+    EXPECT_FALSE(specialization.empty());
+    EXPECT_EQ("_f3", specialization.getSuffix());
+    specialization.block[0] = 64;
+    specialization.block[1] = 1;
+    specialization.block[2] = 1;
+    specialization.workGroupSizeAttribute = "reqd_work_group_size";
+    EXPECT_EQ("_w64x1x1_f3", specialization.getSuffix());
+}
+
+TEST(test_kernel_specialization, workGroupSize) {
+    KernelSpecializer specializer("", "reqd");
+    KernelSpecialization specialization = specializer.choose("_Z6kernelPfi", args(10), block64);
+    EXPECT_EQ("_w64x1x1", specialization.getSuffix());
+    EXPECT_EQ("__attribute__((reqd_work_group_size(64, 1, 1)))", specialization.getKernelAttributes());
+    EXPECT_TRUE(specialization.int32ValueByArgIndex.empty());
+
+    // a new block size gets its own kernel
+    EXPECT_EQ("_w128x1x1", specializer.choose("_Z6kernelPfi", args(10), block128).getSuffix());
+    EXPECT_EQ("_w64x1x1", specializer.choose("_Z6kernelPfi", args(11), block64).getSuffix());
+
+    KernelSpecializer hint("", "hint");
+    EXPECT_EQ("_h64x1x1", hint.choose("_Z6kernelPfi", args(10), block64).getSuffix());
+
+    EXPECT_THROW(KernelSpecializer("", "foo"), runtime_error);
+}
+
+TEST(test_kernel_specialization, workGroupSizeWhileAuto) {
+    KernelSpecializer specializer("auto", "reqd");
+    for(int i = 1; i < KernelSpecializer::AutoStableLaunches; i++) {
+        EXPECT_EQ("_w64x1x1", specializer.choose("_Z6kernelPfi", args(10), block64).getSuffix());
+    }
+    EXPECT_EQ("_s1x10_b64x1x1", specializer.choose("_Z6kernelPfi", args(10), block64).getSuffix());
+}
+
+TEST(test_kernel_specialization, maxWorkGroupSizes) {
+    KernelSpecializer specializer("", "reqd");
+    size_t block[3] = {1, 1, 1};
+    for(int i = 0; i < KernelSpecializer::MaxWorkGroupSizesPerKernel; i++) {
+        block[0] = 32 * (i + 1);
+        EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(10), block).empty());
+    }
+    block[0] = 1024;
+    EXPECT_TRUE(specializer.choose("_Z6kernelPfi", args(10), block).empty());
+    EXPECT_FALSE(specializer.choose("_Z6kernelPfi", args(10), block64).empty());
+}
+
+} // namespace
@@ -0,0 +1,126 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/launch_fusion.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace cocl;
+
+namespace {
+
+// stand-ins for cl_mems, and a queue
+int bufferA;
+int bufferB;
+int bufferC;
+int queue1;
+int queue2;
+
+FusableLaunch launch(const void *read, const void *written) {
+    FusableLaunch launch;
+    launch.uniqueKernelName = "_Z3fooPfS__1_2";
+    launch.queue = &queue1;
+    launch.grid[0] = 2;
+    launch.block[0] = 64;
+    launch.buffers.insert(read);
+    launch.buffers.insert(written);
+    launch.writtenBuffers.insert(written);
+    return launch;
+}
+
+TEST(test_launch_fusion, mode) {
+    EXPECT_FALSE(LaunchFuser("").enabled());
+    EXPECT_FALSE(LaunchFuser("0").enabled());
+    EXPECT_TRUE(LaunchFuser("1").enabled());
+    EXPECT_EQ(16, LaunchFuser("1").getMaxLaunches());
+    EXPECT_EQ(5, LaunchFuser("5").getMaxLaunches());
+    EXPECT_THROW(LaunchFuser("-3"), runtime_error);
+    EXPECT_THROW(LaunchFuser("lots"), runtime_error);
+}
+
+TEST(test_launch_fusion, isSmall) {
+    LaunchFuser fuser("1");
+    size_t grid[3] = {4, 1, 1};
+    EXPECT_TRUE(fuser.isSmall(grid));
+    grid[1] = 2;
+    EXPECT_FALSE(fuser.isSmall(grid));
+}
+
+TEST(test_launch_fusion, independent) {
+    LaunchBatch batch;
+    EXPECT_TRUE(batch.canAdd(launch(&bufferA, &bufferB), 16));
+    batch.add(launch(&bufferA, &bufferB));
+    // both read A
+    EXPECT_TRUE(batch.canAdd(launch(&bufferA, &bufferC), 16));
+    batch.add(launch(&bufferA, &bufferC));
+    EXPECT_EQ(2, batch.size());
+    EXPECT_EQ(4u, batch.getNumBlocks());
+    batch.clear();
+    EXPECT_EQ(0, batch.size());
+    EXPECT_EQ(0u, batch.getNumBlocks());
+}
+
+TEST(test_launch_fusion, dependent) {
+    LaunchBatch batch;
+    batch.add(launch(&bufferA, &bufferB));
+    // reads what the batch writes
+    EXPECT_FALSE(batch.canAdd(launch(&bufferB, &bufferC), 16));
+    // writes what the batch reads
+    EXPECT_FALSE(batch.canAdd(launch(&bufferC, &bufferA), 16));
+    // writes what the batch writes
+    EXPECT_FALSE(batch.canAdd(launch(&bufferC, &bufferB), 16));
+}
+
+TEST(test_launch_fusion, differentLaunches) {
+    LaunchBatch batch;
+    batch.add(launch(&bufferA, &bufferB));
+
+    FusableLaunch otherKernel = launch(&bufferA, &bufferC);
+    otherKernel.uniqueKernelName = "_Z3barPfS__1_2";
+    EXPECT_FALSE(batch.canAdd(otherKernel, 16));
+
+    FusableLaunch otherQueue = launch(&bufferA, &bufferC);
+    otherQueue.queue = &queue2;
+    EXPECT_FALSE(batch.canAdd(otherQueue, 16));
+
+    FusableLaunch otherBlock = launch(&bufferA, &bufferC);
+    otherBlock.block[0] = 128;
+    EXPECT_FALSE(batch.canAdd(otherBlock, 16));
+}
+
+TEST(test_launch_fusion, maxLaunches) {
+    LaunchBatch batch;
+    batch.add(launch(&bufferA, &bufferB));
+    batch.add(launch(&bufferA, &bufferC));
+    EXPECT_FALSE(batch.canAdd(launch(&bufferA, &bufferA), 2));
+    FusableLaunch readOnly = launch(&bufferA, &bufferA);
+    readOnly.writtenBuffers.clear();
+    EXPECT_TRUE(batch.canAdd(readOnly, 3));
+    EXPECT_FALSE(batch.canAdd(readOnly, 2));
+}
+
+TEST(test_launch_fusion, deviceLimits) {
+    LaunchFuser fuser("1");
+    // 1024 bytes is the least CL_DEVICE_MAX_PARAMETER_SIZE a device can have
+    EXPECT_EQ(16, fuser.getMaxLaunches(40, 8, 4352));
+    EXPECT_EQ(25, LaunchFuser("100").getMaxLaunches(40, 8, 1024));
+    EXPECT_EQ(10, fuser.getMaxLaunches(100, 8, 1024));
+    EXPECT_EQ(1, fuser.getMaxLaunches(2000, 8, 1024));
+}
+
+} // namespace
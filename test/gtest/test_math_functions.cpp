@@ -0,0 +1,98 @@
+// Copyright Hugh Perkins 2017
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cocl/math_functions.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace cocl;
+
+namespace {
+
+string write(string name, vector<string> args, bool fastMath = false) {
+    const MathFunction *function = findMathFunction(name);
+    if(function == 0) {
+        return "not found";
+    }
+    return function->write(args, fastMath);
+}
+
+TEST(test_math_functions, names) {
+    // libdevice, C, C++ overloads, and llvm intrinsics, all for the same function
+    EXPECT_EQ("exp(v1)", write("__nv_expf", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("__nv_exp", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("expf", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("_Z3expf", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("_ZSt3expf", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("_Z4expff", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("llvm.exp.f32", {"v1"}));
+    EXPECT_EQ("exp(v1)", write("llvm.exp.f64", {"v1"}));
+    EXPECT_EQ("fmin(v1, v2)", write("_Z5fminfff", {"v1", "v2"}));
+    EXPECT_EQ("isnan(v1)", write("_Z5isnanf", {"v1"}));
+    EXPECT_EQ("isnan(v1)", write("__nv_isnand", {"v1"}));
+    EXPECT_EQ("popcount(v1)", write("_Z6__popci", {"v1"}));
+    EXPECT_EQ("convert_int_sat_rtz(v1)", write("__nv_float2int_rz", {"v1"}));
+    EXPECT_EQ("convert_float_rte(v1)", write("__nv_ll2float_rn", {"v1"}));
+    EXPECT_EQ("convert_float_rtp(v1)", write("__nv_double2float_ru", {"v1"}));
+    EXPECT_EQ("not found", write("__nv_int2uint_rn", {"v1"}));
+    EXPECT_EQ("not found", write("_Z3fooPf", {"v1"}));
+}
+
+TEST(test_math_functions, templates) {
+    EXPECT_EQ("*v2 = sincos(v1, v3)", write("_Z6sincosfPfS_", {"v1", "v2", "v3"}));
+    EXPECT_EQ("*v2 = sincos(v1, v3)", write("_Z7sincosffPfS_", {"v1", "v2", "v3"}));
+    EXPECT_EQ("(1.0f / cbrt(v1))", write("rcbrtf", {"v1"}));
+    EXPECT_EQ("(1.0 / cbrt(v1))", write("__nv_rcbrt", {"v1"}));
+    EXPECT_EQ("(0.5f * erfc(-M_SQRT1_2_F * (v1 + v2)))", write("__nv_normcdff", {"(v1 + v2)"}));
+    EXPECT_EQ("(0.5 * erfc(-M_SQRT1_2 * (v1 + v2)))", write("__nv_normcdf", {"v1 + v2"}));
+    EXPECT_EQ("(exp(v1 * v1) * erfc(v1))", write("erfcxf", {"v1"}));
+    // isnt parenthesized as a whole, so gets parentheses
+    EXPECT_EQ("(exp(((v1) * (v2)) * ((v1) * (v2))) * erfc(((v1) * (v2))))", write("erfcxf", {"(v1) * (v2)"}));
+    EXPECT_EQ("ldexp(v1, 3)", write("scalbnf", {"v1", "3"}));
+}
+
+TEST(test_math_functions, fastMath) {
+    EXPECT_EQ("native_exp(v1)", write("__nv_expf", {"v1"}, true));
+    EXPECT_EQ("native_powr(v1, v2)", write("powf", {"v1", "v2"}, true));
+    EXPECT_EQ("native_sqrt(v1)", write("llvm.sqrt.f32", {"v1"}, true));
+    EXPECT_EQ("*v2 = native_sin(v1); *v3 = native_cos(v1)", write("__nv_sincosf", {"v1", "v2", "v3"}, true));
+    // no native_ double functions
+    EXPECT_EQ("exp(v1)", write("__nv_exp", {"v1"}, true));
+    // nothing faster than fabs
+    EXPECT_EQ("fabs(v1)", write("fabsf", {"v1"}, true));
+    // cuda's fast intrinsics are native whatever the options
+    EXPECT_EQ("native_exp(v1)", write("_Z6__expff", {"v1"}));
+    EXPECT_EQ(MathFunction::Fast, findMathFunction("_Z6__expff")->precision);
+}
+
+TEST(test_math_functions, unsupported) {
+    EXPECT_TRUE(isUnsupportedMathFunction("__nv_j0f"));
+    EXPECT_TRUE(isUnsupportedMathFunction("_Z2j1f"));
+    EXPECT_TRUE(isUnsupportedMathFunction("__nv_erfinv"));
+    // libdevice functions we dont know at all
+    EXPECT_TRUE(isUnsupportedMathFunction("__nv_fadd_rz"));
+    EXPECT_FALSE(isUnsupportedMathFunction("__nv_expf"));
+    EXPECT_FALSE(isUnsupportedMathFunction("_Z3fooPf"));
+    EXPECT_EQ(MathFunction::Exact, findMathFunction("floorf")->precision);
+    EXPECT_EQ(MathFunction::Approximate, findMathFunction("__nv_rhypotf")->precision);
+    EXPECT_EQ(MathFunction::Accurate, findMathFunction("__nv_fdiv_rn")->precision);
+    EXPECT_EQ(MathFunction::Exact, findMathFunction("__nv_ddiv_rn")->precision);
+}
+
+} // namespace
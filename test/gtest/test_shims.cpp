@@ -40,53 +40,87 @@ TEST(test_shims, notexist) {
     EXPECT_TRUE(threw);
 }
 
-TEST(test_shims, shfl3) {
+TEST(test_shims, shfl_down_deps) {
     cocl::Shims shims;
-    shims.use("__shfl_down_3");
+    shims.use("__shfl_down_float");
+    EXPECT_TRUE(shims.isUsed("__shfl_common"));
+    EXPECT_TRUE(shims.isUsed("__shfl_index_float"));
+    EXPECT_FALSE(shims.isUsed("__shfl_index_int"));
     std::ostringstream oss;
     shims.writeCl(oss);
-    std::cout << "actual: [" << oss.str() << "]" << std::endl;
-    EXPECT_EQ(R"(
-inline float __shfl_down_3(local int *scratch, float v0, int v1, int v2) {
-    // local float mem[1024];
-    local float *mem = (local float *)scratch;
-    int tid = get_local_id(0);
-    int warpid = tid % 32;
-    int warpstart = tid - warpid;
-    mem[tid] = v0;
-    //barrier(CLK_LOCAL_MEM_FENCE);
-    int warpsrc = warpid + v1;
-    warpsrc = warpsrc >= 32 ? warpid : warpsrc;
-    return mem[warpstart + warpsrc];
+    std::string cl = oss.str();
+    std::cout << "actual: [" << cl << "]" << std::endl;
+    // dependencies first
+    size_t commonPos = cl.find("inline int __shfl_lane(int width) {");
+    size_t indexPos = cl.find("inline float __shfl_index_float(local int *scratch, float v, int srcLane, int width) {");
+    size_t downPos = cl.find("inline float __shfl_down_float(local int *scratch, float v, int delta, int width) {");
+    EXPECT_NE(std::string::npos, commonPos);
+    EXPECT_NE(std::string::npos, indexPos);
+    EXPECT_NE(std::string::npos, downPos);
+    EXPECT_LT(commonPos, indexPos);
+    EXPECT_LT(indexPos, downPos);
+    EXPECT_NE(std::string::npos, cl.find("sub_group_shuffle(v, lane)"));
+    EXPECT_NE(std::string::npos, cl.find("barrier(CLK_LOCAL_MEM_FENCE);"));
 }
-)",
-        oss.str());
+
+TEST(test_shims, shfl_types) {
+    const char *ops[] = {"__shfl_", "__shfl_up_", "__shfl_down_", "__shfl_xor_"};
+    const char *types[] = {"int", "uint", "float", "double"};
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            cocl::Shims shims;
+            std::string name = std::string(ops[i]) + types[j];
+            shims.use(name);
+            std::ostringstream oss;
+            shims.writeCl(oss);
+            std::string type = types[j];
+            EXPECT_NE(std::string::npos, oss.str().find("inline " + type + " " + name + "(local int *scratch, " + type + " v, "));
+            EXPECT_NE(std::string::npos, oss.str().find("local " + type + " *mem = (local " + type + " *)scratch;"));
+        }
+    }
 }
 
-TEST(test_shims, shfl2_deps) {
+TEST(test_shims, vote_deps) {
     cocl::Shims shims;
-    shims.use("__shfl_down_2");
+    shims.use("__all_sync");
+    // dependencies of dependencies too
+    EXPECT_TRUE(shims.isUsed("__all"));
+    EXPECT_TRUE(shims.isUsed("__ballot"));
+    EXPECT_TRUE(shims.isUsed("__warp_common"));
+    EXPECT_FALSE(shims.isUsed("__any"));
     std::ostringstream oss;
     shims.writeCl(oss);
-    std::cout << "actual: [" << oss.str() << "]" << std::endl;
-    EXPECT_EQ(R"(
-inline float __shfl_down_3(local int *scratch, float v0, int v1, int v2) {
-    // local float mem[1024];
-    local float *mem = (local float *)scratch;
-    int tid = get_local_id(0);
-    int warpid = tid % 32;
-    int warpstart = tid - warpid;
-    mem[tid] = v0;
-    //barrier(CLK_LOCAL_MEM_FENCE);
-    int warpsrc = warpid + v1;
-    warpsrc = warpsrc >= 32 ? warpid : warpsrc;
-    return mem[warpstart + warpsrc];
+    std::string cl = oss.str();
+    std::cout << "actual: [" << cl << "]" << std::endl;
+    size_t commonPos = cl.find("inline int __warp_linear_local_id() {");
+    size_t ballotPos = cl.find("inline uint __ballot(local int *scratch, int predicate) {");
+    size_t allPos = cl.find("inline int __all(local int *scratch, int predicate) {");
+    size_t allSyncPos = cl.find("inline int __all_sync(local int *scratch, uint mask, int predicate) {");
+    EXPECT_NE(std::string::npos, commonPos);
+    EXPECT_LT(commonPos, ballotPos);
+    EXPECT_LT(ballotPos, allPos);
+    EXPECT_LT(allPos, allSyncPos);
+    EXPECT_NE(std::string::npos, cl.find("sub_group_ballot(predicate)"));
+    EXPECT_NE(std::string::npos, cl.find("sub_group_all(predicate)"));
 }
 
-inline float __shfl_down_2(local int *scratch, float v0, int v1) {
-    return __shfl_down_3(scratch, v0, v1, 32);
-}
-)", oss.str());
+TEST(test_shims, tile_reduce) {
+    cocl::Shims shims;
+    shims.use("__tile_reduce_max_float");
+    EXPECT_TRUE(shims.isUsed("__shfl_xor_float"));
+    EXPECT_TRUE(shims.isUsed("__warp_common"));
+    EXPECT_FALSE(shims.isUsed("__tile_reduce_add_float"));
+    std::ostringstream oss;
+    shims.writeCl(oss);
+    std::string cl = oss.str();
+    std::cout << "actual: [" << cl << "]" << std::endl;
+    size_t shflPos = cl.find("inline float __shfl_xor_float(local int *scratch, float v, int laneMask, int width) {");
+    size_t reducePos = cl.find("inline float __tile_reduce_max_float(local int *scratch, float v, int width) {");
+    EXPECT_NE(std::string::npos, shflPos);
+    EXPECT_NE(std::string::npos, reducePos);
+    EXPECT_LT(shflPos, reducePos);
+    EXPECT_NE(std::string::npos, cl.find("return sub_group_reduce_max(v);"));
+    EXPECT_NE(std::string::npos, cl.find("v = max(v, other);"));
 }
 
 TEST(test_shims, atomicadd_float) {
@@ -94,35 +128,39 @@ TEST(test_shims, atomicadd_float) {
     shims.use("__atomic_add_float");
     std::ostringstream oss;
     shims.writeCl(oss);
-    std::cout << "actual: [" << oss.str() << "]" << std::endl;
-    EXPECT_EQ(R"(
-inline float __atomic_add_float(volatile __global float *source, const float operand) {
-    union {
-        unsigned int intVal;
-        float floatVal;
-    } newVal;
-    union {
-        unsigned int intVal;
-        float floatVal;
-    } prevVal;
-    do {
-        prevVal.floatVal = *source;
-        newVal.floatVal = prevVal.floatVal + operand;
-    } while (atomic_cmpxchg((volatile __global unsigned int *)source, prevVal.intVal, newVal.intVal) != prevVal.intVal);
-    return prevVal.floatVal;
+    std::string cl = oss.str();
+    std::cout << "actual: [" << cl << "]" << std::endl;
+    EXPECT_EQ(0u, cl.find("\ninline float __atomic_add_float(volatile __global float *source, const float operand) {\n"));
+    // native first, then the fallback
+    size_t nativePos = cl.find("atomic_fetch_add_explicit((volatile __global atomic_float *)source, operand, memory_order_relaxed)");
+    size_t casPos = cl.find("atomic_cmpxchg((volatile __global unsigned int *)source, prevVal.intVal, newVal.intVal)");
+    EXPECT_NE(std::string::npos, nativePos);
+    EXPECT_NE(std::string::npos, casPos);
+    EXPECT_LT(nativePos, casPos);
 }
-)", oss.str());
+
+TEST(test_shims, atomicadd_double_deps) {
+    cocl::Shims shims;
+    shims.use("__atomic_add_double");
+    EXPECT_TRUE(shims.isUsed("__int64_atomics"));
+    std::ostringstream oss;
+    shims.writeCl(oss);
+    std::string cl = oss.str();
+    size_t pragmaPos = cl.find("#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable");
+    size_t shimPos = cl.find("inline double __atomic_add_double(");
+    EXPECT_NE(std::string::npos, pragmaPos);
+    EXPECT_LT(pragmaPos, shimPos);
 }
 
 TEST(test_shims, copyfrom) {
     cocl::Shims child;
-    child.use("__shfl_down_2");
+    child.use("__shfl_down_float");
 
     cocl::Shims shims;
     shims.copyFrom(child);
 
-    EXPECT_TRUE(shims.isUsed("__shfl_down_2"));
-    EXPECT_TRUE(shims.isUsed("__shfl_down_3"));
+    EXPECT_TRUE(shims.isUsed("__shfl_down_float"));
+    EXPECT_TRUE(shims.isUsed("__shfl_index_float"));
     EXPECT_FALSE(shims.isUsed("asdsdf"));
 }
 